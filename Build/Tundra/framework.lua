@@ -95,7 +95,7 @@ function _G.BuildPyLib(libName, libFolder, sourceDir, includeList, moduleList, o
     Default(pythonLib)
 end
 
-function _G.BuildProgram(programName, programSource, defines, sourceDir, includeList, moduleList, otherLibs, otherLibPaths)
+function _G.BuildProgram(programName, programSource, defines, sourceDir, includeList, moduleList, otherLibs, otherLibPaths, otherDeps)
     local prog = Program {
         Name = programName,
         Pass = "BuildCode",
@@ -104,7 +104,8 @@ function _G.BuildProgram(programName, programSource, defines, sourceDir, include
         },
         Includes = { _G.GetModuleIncludes(sourceDir, moduleList), includeList },
         Depends = { 
-            _G.GetModuleDeps(moduleList)
+            _G.GetModuleDeps(moduleList),
+            otherDeps
         },
         Libs = {
            otherLibs 
@@ -273,6 +273,8 @@ local CoalPyModuleTable = {
 
 -- C++ module external includes
 local CoalPyModuleIncludes = {
+    tasks = { cJSONDir },
+    files = { ZlibDir },
     render = {
         DxcIncludes,
         ImguiDir,
@@ -294,6 +296,8 @@ local CoalPyModuleIncludes = {
 }
 
 local CoalPyModuleDeps = {
+    tasks = { cjson },
+    files = { zlibLib },
     render = { imguiLib, implotLib, spirvreflect, tinyobjloader, cjson },
     texture = { zlibLib, libpngLib, libjpegLib }
 }
@@ -306,6 +310,7 @@ local SrcSO = "$(OBJECTDIR)$(SEP)libgpu.so"
 _G.BuildModules(SourceDir, CoalPyModuleTable, CoalPyModuleIncludes, CoalPyModuleDeps)
 _G.BuildPyLib("gpu", "pymodules/gpu", SourceDir, LibIncludes, CoalPyModules, Libraries, { CoalPyModuleDeps.render, CoalPyModuleDeps.texture, "core" }, LibPaths)
 _G.BuildProgram("coalpy_tests", "tests", { "CPY_ASSERT_ENABLED=1" }, SourceDir, LibIncludes, CoalPyModules, Libraries, LibPaths)
+_G.BuildProgram("coalpy_pak", "tools/pak", {}, SourceDir, {}, { "core", "tasks", "files" }, { { "pthread", Config = "linux-*-*" } }, {}, CoalPyModuleDeps.files)
 _G.DeployPyPackage("coalpy", "gpu", SrcDLL, SrcSO, Binaries, ScriptsDir)
 
 -- Deploy PIP package
@@ -0,0 +1,64 @@
+#include <coalpy.core/ByteAllocator.h>
+#include <coalpy.core/Assert.h>
+#include <algorithm>
+
+namespace coalpy
+{
+
+ArenaAllocator::ArenaAllocator(size_t blockSize)
+: m_blockSize(blockSize)
+{
+}
+
+ArenaAllocator::~ArenaAllocator()
+{
+    for (auto& b : m_blocks)
+        ::free(b.data);
+}
+
+u8* ArenaAllocator::allocate(size_t size)
+{
+    size = (size + Alignment - 1) & ~(size_t)(Alignment - 1);
+    while (m_currentBlock < m_blocks.size())
+    {
+        Block& block = m_blocks[m_currentBlock];
+        if (m_offset + size <= block.size)
+        {
+            u8* data = block.data + m_offset;
+            m_offset += size;
+            m_usedBytes += size;
+            return data;
+        }
+
+        ++m_currentBlock;
+        m_offset = 0;
+    }
+
+    //Allocations larger than a block get a block of their own.
+    Block block = { (u8*)::malloc(std::max(size, m_blockSize)), std::max(size, m_blockSize) };
+    CPY_ASSERT_MSG(block.data != nullptr, "Arena out of memory");
+    m_blocks.push_back(block);
+    m_reservedBytes += block.size;
+    m_currentBlock = m_blocks.size() - 1;
+    m_offset = size;
+    m_usedBytes += size;
+    return block.data;
+}
+
+void ArenaAllocator::reset()
+{
+    auto it = std::remove_if(m_blocks.begin(), m_blocks.end(), [this](const Block& b)
+    {
+        if (b.size <= m_blockSize)
+            return false;
+        ::free(b.data);
+        m_reservedBytes -= b.size;
+        return true;
+    });
+    m_blocks.erase(it, m_blocks.end());
+    m_currentBlock = 0;
+    m_offset = 0;
+    m_usedBytes = 0;
+}
+
+}
@@ -1,39 +1,61 @@
 #include <coalpy.core/ByteBuffer.h>
+#include <coalpy.core/ByteAllocator.h>
+#include <coalpy.core/Assert.h>
 #include <stdlib.h>
 #include <algorithm>
 #include <cstring>
+#include <utility>
 
 namespace coalpy
 {
 
 ByteBuffer::ByteBuffer()
-: m_data(nullptr), m_size(0), m_capacity(0)
+: m_data(m_inline), m_size(0), m_capacity(InlineCapacity), m_allocator(nullptr)
 {
     //DO NOT remove this constructor from inlining. Required by some gcc versions.
 }
 
+ByteBuffer::ByteBuffer(IByteAllocator* allocator)
+: m_data(m_inline), m_size(0), m_capacity(InlineCapacity), m_allocator(allocator)
+{
+}
+
 ByteBuffer::ByteBuffer(const u8* data, size_t size)
-: m_data(nullptr), m_size(0), m_capacity(0)
+: m_data(m_inline), m_size(0), m_capacity(InlineCapacity), m_allocator(nullptr)
 {
     append(data, size);
 }
 
 ByteBuffer::ByteBuffer(size_t size)
-: m_data(nullptr), m_size(0), m_capacity(0)
+: m_data(m_inline), m_size(0), m_capacity(InlineCapacity), m_allocator(nullptr)
 {
     resize(size);
 }
 
 ByteBuffer::ByteBuffer(ByteBuffer&& other)
+: m_data(m_inline), m_size(0), m_capacity(InlineCapacity), m_allocator(nullptr)
 {
     *this = std::move(other);
 }
 
 ByteBuffer& ByteBuffer::operator=(ByteBuffer&& other)
 {
-    m_data = other.m_data;
-    m_size = other.m_capacity;
-    m_capacity = other.m_capacity;
+    if (this == &other)
+        return *this;
+
+    free();
+    m_allocator = other.m_allocator;
+    if (other.isInline())
+    {
+        memcpy(m_inline, other.m_inline, other.m_size);
+        m_size = other.m_size;
+    }
+    else
+    {
+        m_data = other.m_data;
+        m_size = other.m_size;
+        m_capacity = other.m_capacity;
+    }
     other.forget();
     return *this;
 }
@@ -45,8 +67,8 @@ ByteBuffer::~ByteBuffer()
 
 void ByteBuffer::append(const u8* data, size_t size)
 {
-    size_t totalNewSize = std::max(m_capacity, m_size + size);
-    reserve(totalNewSize);
+    if (m_size + size > m_capacity)
+        reserve(std::max(m_size + size, m_capacity * 2));
     if (data)
         memcpy(m_data + m_size, data, size);
     m_size += size;
@@ -54,17 +76,29 @@ void ByteBuffer::append(const u8* data, size_t size)
 
 void ByteBuffer::reserve(size_t newCapacity)
 {
-    if (newCapacity > m_capacity)
+    if (newCapacity <= m_capacity)
+        return;
+
+    u8* newData = nullptr;
+    if (m_allocator == nullptr && !isInline())
+    {
+        newData = (u8*)::realloc(m_data, newCapacity);
+    }
+    else
     {
-        u8* newData = (u8*)malloc(newCapacity);
-        size_t currentSize = m_size;
-        if (currentSize > 0u)
-            memcpy(newData, m_data, currentSize);
-        free();
-        m_size = currentSize;
-        m_data = newData;
-        m_capacity = newCapacity;
+        newData = m_allocator ? m_allocator->allocate(newCapacity) : (u8*)::malloc(newCapacity);
+        if (newData && m_size > 0u)
+            memcpy(newData, m_data, m_size);
+        if (newData && !isInline() && m_allocator)
+            m_allocator->deallocate(m_data, m_capacity);
     }
+
+    CPY_ASSERT_FMT(newData != nullptr, "ByteBuffer out of memory reserving %llu bytes", (unsigned long long)newCapacity);
+    if (newData == nullptr)
+        return;
+
+    m_data = newData;
+    m_capacity = newCapacity;
 }
 
 void ByteBuffer::resize(size_t newSize)
@@ -75,16 +109,21 @@ void ByteBuffer::resize(size_t newSize)
 
 void ByteBuffer::free()
 {
-    if (m_data)
-        ::free(m_data);
+    if (!isInline())
+    {
+        if (m_allocator)
+            m_allocator->deallocate(m_data, m_capacity);
+        else
+            ::free(m_data);
+    }
     forget();
 }
 
 void ByteBuffer::forget()
 {
-    m_data = nullptr;
+    m_data = m_inline;
     m_size = 0;
-    m_capacity = 0;
+    m_capacity = InlineCapacity;
 }
 
 }
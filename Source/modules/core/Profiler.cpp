@@ -0,0 +1,532 @@
+#include <coalpy.core/Profiler.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <unordered_set>
+#include <string.h>
+#include <stdio.h>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#elif defined(__linux__)
+#include <time.h>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#include <cpuid.h>
+#define CPY_PROFILER_TSC 1
+#endif
+#else
+#include <chrono>
+#endif
+
+namespace coalpy
+{
+
+namespace
+{
+
+struct Event
+{
+    const char* name;
+    uint32_t frame;
+    uint64_t beginTicks;
+    uint64_t endTicks;
+};
+
+struct ThreadBuffer
+{
+    uint32_t tid = 0;
+    std::string name;
+    std::unique_ptr<Event[]> events;
+    std::atomic<uint64_t> writePos = 0;
+    //Everything before this got dropped by clear().
+    std::atomic<uint64_t> clearPos = 0;
+    //False once the owner thread exited, the next thread without a buffer takes it over.
+    bool inUse = true;
+};
+
+struct ProfilerState
+{
+    std::mutex mutex;
+    std::vector<std::unique_ptr<ThreadBuffer>> buffers;
+    std::unordered_set<std::string> internedNames;
+    std::atomic<uint32_t> frame = 0;
+    uint64_t baseTicks = 0;
+};
+
+ProfilerState& state()
+{
+    static ProfilerState s_state;
+    return s_state;
+}
+
+#ifdef __linux__
+uint64_t monotonicRawNs()
+{
+    //Raw is not slewed by ntp, so zone lengths stay comparable over a long capture.
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+//The tsc is only used when it is invariant (constant rate, keeps ticking in sleep states). Its rate
+//gets measured against CLOCK_MONOTONIC_RAW from process start, so it gets more precise the longer we run.
+struct TickSource
+{
+    bool useTsc = false;
+    uint64_t tscStart = 0;
+    uint64_t nsStart = 0;
+
+    TickSource()
+    {
+#ifdef CPY_PROFILER_TSC
+        unsigned eax, ebx, ecx, edx;
+        useTsc = __get_cpuid(0x80000007, &eax, &ebx, &ecx, &edx) && (edx & (1u << 8)) != 0;
+        nsStart = monotonicRawNs();
+        tscStart = __rdtsc();
+#endif
+    }
+};
+
+const TickSource s_tickSource;
+#endif
+
+struct LocalBuffer
+{
+    ThreadBuffer* buffer = nullptr;
+
+    //Releases the buffer when the thread exits. Its zones stay capturable until another thread takes it.
+    ~LocalBuffer()
+    {
+        if (buffer == nullptr)
+            return;
+
+        ProfilerState& s = state();
+        std::unique_lock lock(s.mutex);
+        buffer->inUse = false;
+    }
+};
+
+thread_local LocalBuffer t_buffer;
+thread_local std::string t_threadName;
+thread_local std::unordered_map<std::string, const char*> t_internedNames;
+
+ThreadBuffer& localBuffer()
+{
+    if (t_buffer.buffer != nullptr)
+        return *t_buffer.buffer;
+
+    ProfilerState& s = state();
+    std::unique_lock lock(s.mutex);
+    ThreadBuffer* buffer = nullptr;
+    for (auto& b : s.buffers)
+    {
+        if (b->inUse)
+            continue;
+
+        //The zones of the previous owner would show up under this thread's name.
+        buffer = b.get();
+        buffer->clearPos.store(buffer->writePos.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        buffer->inUse = true;
+        break;
+    }
+
+    if (buffer == nullptr)
+    {
+        auto newBuffer = std::make_unique<ThreadBuffer>();
+        newBuffer->events = std::make_unique<Event[]>(Profiler::ZonesPerThread);
+        newBuffer->tid = (uint32_t)s.buffers.size();
+        buffer = newBuffer.get();
+        s.buffers.push_back(std::move(newBuffer));
+    }
+
+    buffer->name = t_threadName.empty() ? std::string("thread ") + std::to_string(buffer->tid) : t_threadName;
+    t_buffer.buffer = buffer;
+    return *buffer;
+}
+
+void appendJsonString(std::string& out, const std::string& str)
+{
+    out += '"';
+    for (char c : str)
+    {
+        if (c == '"' || c == '\\')
+        {
+            out += '\\';
+            out += c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned)c);
+            out += escaped;
+        }
+        else
+        {
+            out += c;
+        }
+    }
+    out += '"';
+}
+
+struct BinaryHeader
+{
+    uint32_t magic;
+    uint32_t version;
+    uint64_t ticksPerSecond;
+    uint64_t baseTicks;
+};
+
+enum : uint32_t
+{
+    BinaryMagic = 'FRPC',
+    BinaryVersion = 1
+};
+
+void writeVarint(ByteBuffer& output, uint64_t value)
+{
+    u8 bytes[10];
+    int count = 0;
+    do
+    {
+        u8 b = (u8)(value & 0x7f);
+        value >>= 7;
+        bytes[count++] = b | (value != 0 ? 0x80 : 0);
+    } while (value != 0);
+    output.append(bytes, count);
+}
+
+void writeSigned(ByteBuffer& output, int64_t value)
+{
+    writeVarint(output, ((uint64_t)value << 1) ^ (uint64_t)(value >> 63));
+}
+
+void writeString(ByteBuffer& output, const std::string& str)
+{
+    writeVarint(output, str.size());
+    output.append((const u8*)str.data(), str.size());
+}
+
+struct BinaryReader
+{
+    const u8* data;
+    size_t size;
+    size_t offset = 0;
+    bool failed = false;
+
+    uint64_t varint()
+    {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64; shift += 7)
+        {
+            if (offset >= size)
+                break;
+            u8 b = data[offset++];
+            value |= (uint64_t)(b & 0x7f) << shift;
+            if ((b & 0x80) == 0)
+                return value;
+        }
+        failed = true;
+        return 0;
+    }
+
+    int64_t signedVarint()
+    {
+        uint64_t v = varint();
+        return (int64_t)(v >> 1) ^ -(int64_t)(v & 1);
+    }
+
+    void string(std::string& out)
+    {
+        uint64_t len = varint();
+        if (failed || len > size - offset)
+        {
+            failed = true;
+            return;
+        }
+        out.assign((const char*)data + offset, (size_t)len);
+        offset += (size_t)len;
+    }
+
+    //Rejects counts that could not possibly fit in what's left, before anything gets allocated for them.
+    uint64_t count(size_t minBytesEach)
+    {
+        uint64_t c = varint();
+        if (failed || c > (size - offset) / minBytesEach)
+        {
+            failed = true;
+            return 0;
+        }
+        return c;
+    }
+};
+
+}
+
+namespace Profiler
+{
+
+namespace Detail
+{
+    std::atomic<bool> s_enabled = false;
+}
+
+void setEnabled(bool enabled)
+{
+    if (enabled)
+    {
+        ProfilerState& s = state();
+        std::unique_lock lock(s.mutex);
+        if (s.baseTicks == 0)
+            s.baseTicks = now();
+    }
+
+    Detail::s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void setThreadName(const char* name)
+{
+    t_threadName = name;
+    if (t_buffer.buffer == nullptr)
+        return;
+
+    ProfilerState& s = state();
+    std::unique_lock lock(s.mutex);
+    t_buffer.buffer->name = t_threadName;
+}
+
+uint64_t now()
+{
+#ifdef _WIN32
+    LARGE_INTEGER counter;
+    QueryPerformanceCounter(&counter);
+    return (uint64_t)counter.QuadPart;
+#elif defined(__linux__)
+#ifdef CPY_PROFILER_TSC
+    if (s_tickSource.useTsc)
+        return __rdtsc();
+#endif
+    return monotonicRawNs();
+#else
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+uint64_t ticksPerSecond()
+{
+#ifdef _WIN32
+    LARGE_INTEGER frequency;
+    QueryPerformanceFrequency(&frequency);
+    return (uint64_t)frequency.QuadPart;
+#else
+#ifdef CPY_PROFILER_TSC
+    if (s_tickSource.useTsc)
+    {
+        //Too short a window gives a noisy rate, only happens right after startup.
+        uint64_t elapsedNs = monotonicRawNs() - s_tickSource.nsStart;
+        while (elapsedNs < 10000000ull)
+            elapsedNs = monotonicRawNs() - s_tickSource.nsStart;
+        uint64_t elapsedTicks = __rdtsc() - s_tickSource.tscStart;
+        return (uint64_t)((double)elapsedTicks * 1000000000.0 / (double)elapsedNs);
+    }
+#endif
+    return 1000000000ull;
+#endif
+}
+
+void nextFrame()
+{
+    state().frame.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32_t frame()
+{
+    return state().frame.load(std::memory_order_relaxed);
+}
+
+void record(const char* name, uint64_t beginTicks, uint64_t endTicks, uint32_t frame)
+{
+    ThreadBuffer& buffer = localBuffer();
+    uint64_t pos = buffer.writePos.load(std::memory_order_relaxed);
+    Event& e = buffer.events[pos & (ZonesPerThread - 1)];
+    e.name = name;
+    e.frame = frame;
+    e.beginTicks = beginTicks;
+    e.endTicks = endTicks;
+    buffer.writePos.store(pos + 1, std::memory_order_release);
+}
+
+const char* internName(const std::string& name)
+{
+    auto it = t_internedNames.find(name);
+    if (it != t_internedNames.end())
+        return it->second;
+
+    const char* interned = nullptr;
+    {
+        ProfilerState& s = state();
+        std::unique_lock lock(s.mutex);
+        interned = s.internedNames.insert(name).first->c_str();
+    }
+    t_internedNames.emplace(name, interned);
+    return interned;
+}
+
+void clear()
+{
+    ProfilerState& s = state();
+    std::unique_lock lock(s.mutex);
+    for (auto& buffer : s.buffers)
+        buffer->clearPos.store(buffer->writePos.load(std::memory_order_acquire), std::memory_order_relaxed);
+}
+
+void capture(ProfileCapture& outCapture)
+{
+    outCapture = ProfileCapture();
+    outCapture.ticksPerSecond = ticksPerSecond();
+
+    std::unordered_map<const char*, uint32_t> nameIndices;
+    std::vector<Event> events;
+    ProfilerState& s = state();
+    std::unique_lock lock(s.mutex);
+    outCapture.baseTicks = s.baseTicks;
+    for (auto& buffer : s.buffers)
+    {
+        const uint64_t capacity = ZonesPerThread;
+        uint64_t endPos = buffer->writePos.load(std::memory_order_acquire);
+        uint64_t beginPos = std::max(endPos > capacity ? endPos - capacity : 0, buffer->clearPos.load(std::memory_order_relaxed));
+        events.clear();
+        for (uint64_t i = beginPos; i < endPos; ++i)
+            events.push_back(buffer->events[i & (capacity - 1)]);
+
+        //The owner thread kept writing while copying, drop the slots it might have overwritten.
+        uint64_t newEndPos = buffer->writePos.load(std::memory_order_acquire);
+        size_t firstValid = newEndPos - beginPos > capacity ? (size_t)(newEndPos - beginPos - capacity) : 0;
+
+        outCapture.threads.emplace_back();
+        ProfileCapture::Thread& thread = outCapture.threads.back();
+        thread.tid = buffer->tid;
+        thread.name = buffer->name;
+        for (size_t i = firstValid; i < events.size(); ++i)
+        {
+            const Event& e = events[i];
+            auto it = nameIndices.find(e.name);
+            if (it == nameIndices.end())
+            {
+                it = nameIndices.insert(std::make_pair(e.name, (uint32_t)outCapture.names.size())).first;
+                outCapture.names.push_back(e.name);
+            }
+            thread.zones.push_back(ProfileCapture::Zone { it->second, e.frame, e.beginTicks, e.endTicks });
+        }
+    }
+}
+
+void writeChromeTrace(const ProfileCapture& capture, std::string& outJson)
+{
+    outJson = "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    double microSecondsPerTick = 1000000.0 / (double)std::max(capture.ticksPerSecond, (uint64_t)1);
+    bool first = true;
+    char numbers[128];
+    for (const auto& thread : capture.threads)
+    {
+        snprintf(numbers, sizeof(numbers), "\"ph\":\"M\",\"pid\":0,\"tid\":%u,\"args\":{\"name\":", thread.tid);
+        outJson += first ? "{\"name\":\"thread_name\"," : ",{\"name\":\"thread_name\",";
+        outJson += numbers;
+        appendJsonString(outJson, thread.name);
+        outJson += "}}";
+        first = false;
+
+        for (const auto& zone : thread.zones)
+        {
+            outJson += ",{\"name\":";
+            appendJsonString(outJson, zone.name < capture.names.size() ? capture.names[zone.name] : std::string());
+            snprintf(numbers, sizeof(numbers), ",\"cat\":\"zone\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":0,\"tid\":%u,\"args\":{\"frame\":%u}}",
+                (double)(int64_t)(zone.beginTicks - capture.baseTicks) * microSecondsPerTick,
+                (double)(zone.endTicks - zone.beginTicks) * microSecondsPerTick,
+                thread.tid, zone.frame);
+            outJson += numbers;
+        }
+    }
+    outJson += "]}";
+}
+
+void writeBinary(const ProfileCapture& capture, ByteBuffer& output)
+{
+    BinaryHeader header = { BinaryMagic, BinaryVersion, capture.ticksPerSecond, capture.baseTicks };
+    output.append(&header);
+
+    writeVarint(output, capture.names.size());
+    for (const auto& name : capture.names)
+        writeString(output, name);
+
+    writeVarint(output, capture.threads.size());
+    for (const auto& thread : capture.threads)
+    {
+        writeVarint(output, thread.tid);
+        writeString(output, thread.name);
+        writeVarint(output, thread.zones.size());
+        uint64_t prevBegin = capture.baseTicks;
+        uint32_t prevFrame = 0;
+        for (const auto& zone : thread.zones)
+        {
+            writeVarint(output, zone.name);
+            writeSigned(output, (int64_t)zone.frame - (int64_t)prevFrame);
+            writeSigned(output, (int64_t)(zone.beginTicks - prevBegin));
+            writeVarint(output, zone.endTicks - zone.beginTicks);
+            prevBegin = zone.beginTicks;
+            prevFrame = zone.frame;
+        }
+    }
+}
+
+bool readBinary(const u8* data, size_t size, ProfileCapture& outCapture)
+{
+    outCapture = ProfileCapture();
+    BinaryHeader header;
+    if (size < sizeof(header))
+        return false;
+
+    memcpy(&header, data, sizeof(header));
+    if (header.magic != BinaryMagic || header.version != BinaryVersion)
+        return false;
+
+    outCapture.ticksPerSecond = header.ticksPerSecond;
+    outCapture.baseTicks = header.baseTicks;
+
+    BinaryReader reader = { data, size, sizeof(header) };
+    outCapture.names.resize((size_t)reader.count(1));
+    for (auto& name : outCapture.names)
+        reader.string(name);
+
+    outCapture.threads.resize((size_t)reader.count(3));
+    for (auto& thread : outCapture.threads)
+    {
+        thread.tid = (uint32_t)reader.varint();
+        reader.string(thread.name);
+        thread.zones.resize((size_t)reader.count(4));
+        uint64_t prevBegin = header.baseTicks;
+        int64_t prevFrame = 0;
+        for (auto& zone : thread.zones)
+        {
+            zone.name = (uint32_t)reader.varint();
+            prevFrame += reader.signedVarint();
+            prevBegin += (uint64_t)reader.signedVarint();
+            zone.frame = (uint32_t)prevFrame;
+            zone.beginTicks = prevBegin;
+            zone.endTicks = prevBegin + reader.varint();
+            if (zone.name >= outCapture.names.size())
+                reader.failed = true;
+        }
+
+        if (reader.failed)
+            break;
+    }
+
+    return !reader.failed;
+}
+
+}
+
+}
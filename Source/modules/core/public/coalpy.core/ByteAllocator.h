@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdlib.h>
+#include <vector>
+
+namespace coalpy
+{
+
+typedef unsigned char u8;
+
+//Backing memory for ByteBuffer and friends.
+class IByteAllocator
+{
+public:
+    virtual ~IByteAllocator() {}
+    virtual u8* allocate(size_t size) = 0;
+    //size is what was passed to allocate.
+    virtual void deallocate(u8* data, size_t size) = 0;
+};
+
+//Bump allocator for data with a common, known end of life, like a frame worth of command lists.
+//deallocate does nothing, reset() recycles every allocation at once. Not thread safe.
+class ArenaAllocator : public IByteAllocator
+{
+public:
+    enum { Alignment = 16 };
+
+    explicit ArenaAllocator(size_t blockSize = 1024 * 1024);
+    virtual ~ArenaAllocator();
+
+    virtual u8* allocate(size_t size) override;
+    virtual void deallocate(u8*, size_t) override {}
+
+    //Every pointer handed out so far becomes invalid. Blocks get reused, oversized ones are freed.
+    void reset();
+
+    size_t usedBytes() const { return m_usedBytes; }
+    size_t reservedBytes() const { return m_reservedBytes; }
+
+private:
+    struct Block
+    {
+        u8* data;
+        size_t size;
+    };
+
+    size_t m_blockSize;
+    //m_blocks[m_currentBlock] is being bumped, the ones after it are free.
+    std::vector<Block> m_blocks;
+    size_t m_currentBlock = 0;
+    size_t m_offset = 0;
+    size_t m_usedBytes = 0;
+    size_t m_reservedBytes = 0;
+};
+
+}
@@ -7,10 +7,20 @@ namespace coalpy
 
 typedef unsigned char u8;
 
+class IByteAllocator;
+
 class ByteBuffer
 {
 public:
+    enum
+    {
+        //Payloads up to this size live inside the object and never touch the heap.
+        InlineCapacity = 32
+    };
+
     ByteBuffer();
+    //allocator must outlive the buffer. Null uses malloc, which lets growth realloc in place.
+    explicit ByteBuffer(IByteAllocator* allocator);
     ByteBuffer(const u8* data, size_t size);
     ByteBuffer(size_t size);
     ByteBuffer(ByteBuffer&& other);
@@ -19,6 +29,8 @@ public:
     u8* data() { return m_data; }
     const u8* data() const { return m_data; }
     size_t size() const { return m_size; }
+    size_t capacity() const { return m_capacity; }
+    IByteAllocator* allocator() const { return m_allocator; }
 
     template<typename StructType>
     void append(const StructType* t)
@@ -26,8 +38,10 @@ public:
         append((const u8*)t, sizeof(StructType));
     }
 
+    //Grows the capacity geometrically, so appending in chunks costs amortized linear time.
     void append(const u8* data, size_t size);
     inline void appendEmpty(size_t size) { append(nullptr, size); }
+    //Reserves exactly newSize if it has to grow.
     void resize(size_t newSize);
     void free();
     void forget();
@@ -36,9 +50,13 @@ public:
     ByteBuffer& operator=(ByteBuffer&& other);
 
 private:
+    bool isInline() const { return m_data == m_inline; }
+
     u8* m_data;
     size_t m_size;
     size_t m_capacity;
+    IByteAllocator* m_allocator;
+    u8 m_inline[InlineCapacity];
 };
 
 }
@@ -0,0 +1,270 @@
+#pragma once
+#include <atomic>
+#include <cstdint>
+
+namespace coalpy
+{
+
+//Thread safe handle pool. allocate and free can be called from any thread without locks, and
+//lookups by handle are wait free: slots live in fixed size chunks that never move, so references
+//returned stay valid while other threads allocate.
+//Handles carry the slot's generation above the index bits. Freeing bumps it, so a stale handle
+//fails contains() instead of aliasing whatever reuses the slot.
+//Freed slots are not destroyed, they get recycled as they are (the owner resets the state it needs).
+//This keeps the capacity of any containers inside DataType, so steady state allocation is free.
+//forEach can run concurrently with allocate, it may see an element before its owner filled it in.
+//Once MaxElements slots were handed out, allocate returns invalid handles (in every build) and callers have
+//to fail whatever they were creating.
+//A stale handle only aliases a live element again after its slot went through GenerationCount reuses while
+//the stale handle was kept around: 1023 with the default 22 index bits, more with fewer index bits.
+template<typename HandleType, typename DataType, unsigned chunkSizeLog2 = 10, unsigned maxChunksLog2 = 12>
+class ConcurrentHandleContainer
+{
+public:
+    using BaseHandleType = typename HandleType::BaseType;
+
+    enum : unsigned
+    {
+        ChunkSize = 1u << chunkSizeLog2,
+        MaxChunks = 1u << maxChunksLog2,
+        IndexBits = chunkSizeLog2 + maxChunksLog2,
+        IndexMask = (1u << IndexBits) - 1,
+        MaxElements = 1u << IndexBits,
+        //The last generation is skipped so no handle can be equal to InvalidId.
+        GenerationCount = (1u << (32 - IndexBits)) - 1
+    };
+    static_assert(sizeof(BaseHandleType) == 4, "Handles must be 32 bits.");
+    static_assert(IndexBits < 32, "Index bits must leave room for a generation.");
+
+    ConcurrentHandleContainer()
+    {
+        for (auto& c : m_chunks)
+            c.store(nullptr, std::memory_order_relaxed);
+    }
+
+    ~ConcurrentHandleContainer()
+    {
+        for (auto& c : m_chunks)
+            delete [] c.load(std::memory_order_relaxed);
+    }
+
+    //When the container is full outHandle is invalid and the returned element is a scratch one, don't touch it.
+    DataType& allocate(HandleType& outHandle)
+    {
+        BaseHandleType index = popFree();
+        if (index == FreeListEnd)
+        {
+            if (!reserveFresh(1, index))
+            {
+                outHandle = HandleType();
+                return m_overflow;
+            }
+            createChunk(index >> chunkSizeLog2);
+        }
+
+        m_numElements.fetch_add(1, std::memory_order_relaxed);
+        return publish(index, outHandle);
+    }
+
+    //Allocates counts handles at once: recycled slots come off the free list with a single exchange and
+    //the rest are reserved with a single bump, instead of one of each per handle.
+    //Either all of them get allocated or, if the container can't fit them, none and every handle is invalid.
+    bool allocate(HandleType* outHandles, int counts)
+    {
+        if (counts <= 0)
+            return true;
+
+        int recycled = popFree(outHandles, counts);
+        int fresh = counts - recycled;
+        if (fresh > 0)
+        {
+            BaseHandleType first;
+            if (!reserveFresh((BaseHandleType)fresh, first))
+            {
+                for (int i = 0; i < recycled; ++i)
+                    pushFree(outHandles[i].handleId);
+                for (int i = 0; i < counts; ++i)
+                    outHandles[i] = HandleType();
+                return false;
+            }
+
+            for (BaseHandleType c = first >> chunkSizeLog2; c <= (first + fresh - 1) >> chunkSizeLog2; ++c)
+                createChunk(c);
+            for (int i = 0; i < fresh; ++i)
+                outHandles[recycled + i].handleId = first + (BaseHandleType)i;
+        }
+
+        for (int i = 0; i < counts; ++i)
+            publish(outHandles[i].handleId, outHandles[i]);
+        m_numElements.fetch_add(counts, std::memory_order_relaxed);
+        return true;
+    }
+
+    //Returns false if the handle was not alive. Only one of several racing frees of a handle succeeds.
+    bool free(HandleType handle)
+    {
+        if (!contains(handle))
+            return false;
+
+        BaseHandleType index = handle.handleId & IndexMask;
+        Slot& slot = getSlot(index);
+        BaseHandleType expected = handle.handleId;
+        if (!slot.handleId.compare_exchange_strong(expected, HandleType::InvalidId, std::memory_order_acq_rel))
+            return false;
+
+        slot.generation = (slot.generation + 1) % GenerationCount;
+        m_numElements.fetch_sub(1, std::memory_order_relaxed);
+        pushFree(index);
+        return true;
+    }
+
+    bool contains(HandleType handle) const
+    {
+        if (!handle.valid())
+            return false;
+
+        BaseHandleType index = handle.handleId & IndexMask;
+        if (index >= m_nextIndex.load(std::memory_order_acquire))
+            return false;
+
+        Slot* chunk = m_chunks[index >> chunkSizeLog2].load(std::memory_order_acquire);
+        return chunk != nullptr && chunk[index & (ChunkSize - 1)].handleId.load(std::memory_order_acquire) == handle.handleId;
+    }
+
+    DataType& operator[](HandleType handle) { return getSlot(handle.handleId & IndexMask).data; }
+    const DataType& operator[](HandleType handle) const { return getSlot(handle.handleId & IndexMask).data; }
+
+    template<typename FnType>
+    void forEach(FnType fn)
+    {
+        BaseHandleType count = m_nextIndex.load(std::memory_order_acquire);
+        for (BaseHandleType i = 0; i < count; ++i)
+        {
+            Slot* chunk = m_chunks[i >> chunkSizeLog2].load(std::memory_order_acquire);
+            if (chunk == nullptr)
+                continue;
+
+            Slot& slot = chunk[i & (ChunkSize - 1)];
+            HandleType handle;
+            handle.handleId = slot.handleId.load(std::memory_order_acquire);
+            if (handle.valid())
+                fn(handle, slot.data);
+        }
+    }
+
+    int elementsCount() const { return m_numElements.load(std::memory_order_relaxed); }
+
+private:
+    enum : BaseHandleType { FreeListEnd = (BaseHandleType)~0u };
+
+    struct Slot
+    {
+        //Handle of the element living in the slot, InvalidId while free.
+        std::atomic<BaseHandleType> handleId = HandleType::InvalidId;
+        std::atomic<BaseHandleType> nextFree = FreeListEnd;
+        //Only touched by whoever owns the slot: the thread that popped it or the one that won the free.
+        BaseHandleType generation = 0;
+        DataType data;
+    };
+
+    DataType& publish(BaseHandleType index, HandleType& outHandle)
+    {
+        Slot& slot = getSlot(index);
+        outHandle.handleId = (slot.generation << IndexBits) | index;
+        slot.handleId.store(outHandle.handleId, std::memory_order_release);
+        return slot.data;
+    }
+
+    Slot& getSlot(BaseHandleType index) const
+    {
+        Slot* chunk = m_chunks[index >> chunkSizeLog2].load(std::memory_order_acquire);
+        return chunk[index & (ChunkSize - 1)];
+    }
+
+    //Claims counts slots that were never used. Fails rather than moving m_nextIndex past MaxElements,
+    //so nothing ever indexes past m_chunks.
+    bool reserveFresh(BaseHandleType counts, BaseHandleType& outFirst)
+    {
+        BaseHandleType next = m_nextIndex.load(std::memory_order_relaxed);
+        do
+        {
+            if (counts > MaxElements - next)
+                return false;
+        } while (!m_nextIndex.compare_exchange_weak(next, next + counts, std::memory_order_relaxed));
+
+        outFirst = next;
+        return true;
+    }
+
+    void createChunk(unsigned chunkId)
+    {
+        if (m_chunks[chunkId].load(std::memory_order_acquire) != nullptr)
+            return;
+
+        //Two threads can race for the first slots of a chunk, the loser throws its copy away.
+        Slot* newChunk = new Slot[ChunkSize];
+        Slot* expected = nullptr;
+        if (!m_chunks[chunkId].compare_exchange_strong(expected, newChunk, std::memory_order_acq_rel))
+            delete [] newChunk;
+    }
+
+    //The free list head packs a tag next to the index, bumped on every change, so a pop
+    //can't succeed on a head that got popped and pushed back in between (ABA).
+    static uint64_t packHead(BaseHandleType index, uint32_t tag) { return ((uint64_t)tag << 32) | index; }
+
+    BaseHandleType popFree()
+    {
+        uint64_t head = m_freeHead.load(std::memory_order_acquire);
+        for (;;)
+        {
+            BaseHandleType index = (BaseHandleType)head;
+            if (index == FreeListEnd)
+                return FreeListEnd;
+
+            BaseHandleType next = getSlot(index).nextFree.load(std::memory_order_relaxed);
+            if (m_freeHead.compare_exchange_weak(head, packHead(next, (uint32_t)(head >> 32) + 1), std::memory_order_acq_rel, std::memory_order_acquire))
+                return index;
+        }
+    }
+
+    //Pops up to counts slots in one go, their indices are written to the handles. Every link followed
+    //is a valid index, and the tag on the head makes the exchange fail if any of them changed meanwhile.
+    int popFree(HandleType* outHandles, int counts)
+    {
+        uint64_t head = m_freeHead.load(std::memory_order_acquire);
+        for (;;)
+        {
+            int popped = 0;
+            BaseHandleType index = (BaseHandleType)head;
+            while (popped < counts && index != FreeListEnd)
+            {
+                outHandles[popped++].handleId = index;
+                index = getSlot(index).nextFree.load(std::memory_order_relaxed);
+            }
+
+            if (popped == 0)
+                return 0;
+
+            if (m_freeHead.compare_exchange_weak(head, packHead(index, (uint32_t)(head >> 32) + 1), std::memory_order_acq_rel, std::memory_order_acquire))
+                return popped;
+        }
+    }
+
+    void pushFree(BaseHandleType index)
+    {
+        Slot& slot = getSlot(index);
+        uint64_t head = m_freeHead.load(std::memory_order_relaxed);
+        do
+        {
+            slot.nextFree.store((BaseHandleType)head, std::memory_order_relaxed);
+        } while (!m_freeHead.compare_exchange_weak(head, packHead(index, (uint32_t)(head >> 32) + 1), std::memory_order_release, std::memory_order_relaxed));
+    }
+
+    mutable std::atomic<Slot*> m_chunks[MaxChunks];
+    std::atomic<uint64_t> m_freeHead = packHead(FreeListEnd, 0);
+    std::atomic<BaseHandleType> m_nextIndex = 0;
+    std::atomic<int> m_numElements = 0;
+    DataType m_overflow = {};
+};
+
+}
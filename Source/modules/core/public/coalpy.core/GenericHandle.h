@@ -20,21 +20,14 @@ struct GenericHandle
         handleId = inHandleId;
     }
 
-    GenericHandle(const GenericHandle& other)
-    {
-        *this = other;
-    }
+    GenericHandle(const GenericHandle& other) = default;
 
     bool valid() const
     {
         return handleId != InvalidId;
     }
 
-    GenericHandle& operator=(const GenericHandle& other)
-    {
-        handleId = other.handleId;
-        return *this;
-    }
+    GenericHandle& operator=(const GenericHandle& other) = default;
 
     bool operator==(const GenericHandle<BaseHandle>& other) const
     {
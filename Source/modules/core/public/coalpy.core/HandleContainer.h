@@ -56,7 +56,8 @@ public:
         --m_numElements;
     }
 
-    void forEach(OnElementFn elementfn)
+    template<typename FnType = OnElementFn>
+    void forEach(FnType elementfn)
     {
         for (DataContainer& c : m_data)
         {
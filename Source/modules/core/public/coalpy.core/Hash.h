@@ -0,0 +1,129 @@
+#pragma once
+
+#include <cstdint>
+#include <cstddef>
+
+namespace coalpy
+{
+
+//64 bit hash in the style of wyhash: 8 or 16 bytes per step, mixed through a 64x64->128 multiply.
+//Everything is constexpr so string keys can be hashed at compile time (see stringHash in String.h),
+//the byte loads below get folded into plain word loads by the optimizer.
+//Not a cryptographic hash, and the values are not guaranteed to stay the same across versions,
+//so don't persist them.
+namespace HashDetail
+{
+    constexpr uint64_t P0 = 0xa0761d6478bd642full;
+    constexpr uint64_t P1 = 0xe7037ed1a0b428dbull;
+    constexpr uint64_t P2 = 0x8ebc6af09c88c6e3ull;
+    constexpr uint64_t P3 = 0x589965cc75374cc3ull;
+
+    constexpr void mum(uint64_t& a, uint64_t& b)
+    {
+#if defined(__SIZEOF_INT128__)
+        unsigned __int128 r = (unsigned __int128)a * b;
+        a = (uint64_t)r;
+        b = (uint64_t)(r >> 64);
+#else
+        uint64_t ha = a >> 32, hb = b >> 32, la = (uint32_t)a, lb = (uint32_t)b;
+        uint64_t rh = ha * hb, rm0 = ha * lb, rm1 = hb * la, rl = la * lb;
+        uint64_t t = rl + (rm0 << 32);
+        uint64_t c = t < rl ? 1 : 0;
+        uint64_t lo = t + (rm1 << 32);
+        c += lo < t ? 1 : 0;
+        a = lo;
+        b = rh + (rm0 >> 32) + (rm1 >> 32) + c;
+#endif
+    }
+
+    constexpr uint64_t mix(uint64_t a, uint64_t b)
+    {
+        mum(a, b);
+        return a ^ b;
+    }
+
+    constexpr uint64_t read8(const char* p)
+    {
+        return (uint64_t)(uint8_t)p[0] | ((uint64_t)(uint8_t)p[1] << 8) | ((uint64_t)(uint8_t)p[2] << 16) | ((uint64_t)(uint8_t)p[3] << 24)
+            | ((uint64_t)(uint8_t)p[4] << 32) | ((uint64_t)(uint8_t)p[5] << 40) | ((uint64_t)(uint8_t)p[6] << 48) | ((uint64_t)(uint8_t)p[7] << 56);
+    }
+
+    constexpr uint64_t read4(const char* p)
+    {
+        return (uint64_t)(uint8_t)p[0] | ((uint64_t)(uint8_t)p[1] << 8) | ((uint64_t)(uint8_t)p[2] << 16) | ((uint64_t)(uint8_t)p[3] << 24);
+    }
+
+    //1 to 3 bytes.
+    constexpr uint64_t read3(const char* p, size_t k)
+    {
+        return ((uint64_t)(uint8_t)p[0] << 16) | ((uint64_t)(uint8_t)p[k >> 1] << 8) | (uint64_t)(uint8_t)p[k - 1];
+    }
+}
+
+constexpr uint64_t hash64(const char* data, size_t size, uint64_t seed = 0)
+{
+    using namespace HashDetail;
+    const char* p = data;
+    seed ^= mix(seed ^ P0, P1);
+    uint64_t a = 0;
+    uint64_t b = 0;
+    if (size <= 16)
+    {
+        if (size >= 4)
+        {
+            size_t middle = (size >> 3) << 2;
+            a = (read4(p) << 32) | read4(p + middle);
+            b = (read4(p + size - 4) << 32) | read4(p + size - 4 - middle);
+        }
+        else if (size > 0)
+        {
+            a = read3(p, size);
+        }
+    }
+    else
+    {
+        size_t i = size;
+        if (i > 48)
+        {
+            uint64_t seed1 = seed;
+            uint64_t seed2 = seed;
+            do
+            {
+                seed = mix(read8(p) ^ P1, read8(p + 8) ^ seed);
+                seed1 = mix(read8(p + 16) ^ P2, read8(p + 24) ^ seed1);
+                seed2 = mix(read8(p + 32) ^ P3, read8(p + 40) ^ seed2);
+                p += 48;
+                i -= 48;
+            } while (i > 48);
+            seed ^= seed1 ^ seed2;
+        }
+
+        while (i > 16)
+        {
+            seed = mix(read8(p) ^ P1, read8(p + 8) ^ seed);
+            p += 16;
+            i -= 16;
+        }
+
+        a = read8(p + i - 16);
+        b = read8(p + i - 8);
+    }
+
+    a ^= P1;
+    b ^= seed;
+    mum(a, b);
+    return mix(a ^ P0 ^ (uint64_t)size, b ^ P1);
+}
+
+inline uint64_t hash64(const void* data, size_t size, uint64_t seed = 0)
+{
+    return hash64((const char*)data, size, seed);
+}
+
+//Folds a value into a running hash, for keys made of several parts.
+constexpr uint64_t hashCombine(uint64_t seed, uint64_t value)
+{
+    return HashDetail::mix(seed ^ HashDetail::P0, value ^ HashDetail::P1);
+}
+
+}
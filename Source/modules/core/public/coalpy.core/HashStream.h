@@ -1,39 +1,42 @@
 #pragma once
 
+#include <coalpy.core/Hash.h>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
 namespace coalpy
 {
 
+//Streaming hash of several values, each one is run through hash64 seeded with the hash so far.
+//Strings are hashed by contents; any other type is hashed by its bytes, so it must be trivially
+//copyable and should not have padding.
 class HashStream
 {
 public:
     HashStream() : m_val(0) {}
 
     template<typename T>
-    HashStream& operator << (T& o)
+    HashStream& operator << (const T& o)
     {
-        m_val = fnvHash((const char*)&o, (unsigned)sizeof(T), m_val);
-        return *this;
+        static_assert(std::is_trivially_copyable<T>::value, "HashStream hashes the bytes of a value, use append for anything else.");
+        return append(&o, sizeof(T));
     }
 
-    int val() const { return m_val; }
+    HashStream& operator << (std::string_view str) { return append(str.data(), str.size()); }
+    HashStream& operator << (const std::string& str) { return append(str.data(), str.size()); }
+    HashStream& operator << (const char* str) { return (*this) << std::string_view(str); }
 
-private:
-    static int fnvHash(const char* b, unsigned bytes, unsigned prevHash)
+    HashStream& append(const void* data, size_t bytes)
     {
-        const unsigned int fnvPrime = 0x811C9DC5;
-	    unsigned int hash = prevHash;
-	    unsigned int i = 0;
-        while (i < bytes)
-	    {
-	    	hash *= fnvPrime;
-	    	hash ^= *b++;
-            ++i;
-	    }
-
-	    return hash;
+        m_val = hash64(data, bytes, m_val);
+        return *this;
     }
 
-    unsigned int m_val;
+    uint64_t val() const { return m_val; }
+
+private:
+    uint64_t m_val;
 };
 
 }
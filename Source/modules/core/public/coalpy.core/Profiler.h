@@ -0,0 +1,115 @@
+#pragma once
+
+#include <coalpy.core/ByteBuffer.h>
+#include <string>
+#include <vector>
+#include <atomic>
+#include <cstdint>
+
+namespace coalpy
+{
+
+//Snapshot of the recorded zones, also what the binary format decodes into.
+struct ProfileCapture
+{
+    struct Zone
+    {
+        //Index into ProfileCapture::names.
+        uint32_t name;
+        uint32_t frame;
+        uint64_t beginTicks;
+        uint64_t endTicks;
+    };
+
+    struct Thread
+    {
+        uint32_t tid;
+        std::string name;
+        std::vector<Zone> zones;
+    };
+
+    uint64_t ticksPerSecond = 0;
+    //Timestamps get exported relative to this, the time the profiler was first enabled.
+    uint64_t baseTicks = 0;
+    std::vector<std::string> names;
+    std::vector<Thread> threads;
+};
+
+//CPU zone profiler. Zones are recorded by ProfileScope / CPY_PROFILE_SCOPE into per thread ring
+//buffers: each thread only writes its own, so recording a zone is two timestamps and a few stores.
+//Old zones get overwritten when a buffer wraps around. A buffer is handed to the next thread that records
+//once its owner exits, so only threads alive at the same time need one each.
+//Zone names are kept by pointer, they must be string literals or otherwise outlive the capture (see internName).
+namespace Profiler
+{
+    enum : int { ZonesPerThread = 1 << 16 };
+
+    namespace Detail
+    {
+        extern std::atomic<bool> s_enabled;
+    }
+
+    //Nothing is recorded until enabled, a disabled scope costs a load and a branch.
+    void setEnabled(bool enabled);
+    inline bool enabled() { return Detail::s_enabled.load(std::memory_order_relaxed); }
+
+    //Name shown for the calling thread, i.e. "worker 3". Defaults to "thread <tid>".
+    void setThreadName(const char* name);
+
+    //Invariant tsc on x86 linux, CLOCK_MONOTONIC_RAW on other linux targets, QueryPerformanceCounter on windows.
+    uint64_t now();
+    uint64_t ticksPerSecond();
+
+    //Global frame counter, zones are tagged with the frame they begin in.
+    void nextFrame();
+    uint32_t frame();
+
+    void record(const char* name, uint64_t beginTicks, uint64_t endTicks, uint32_t frame);
+
+    //Copy of name that lives as long as the process, for zone names built at runtime such as task names.
+    //Threads cache what they interned, so a repeated name only costs a hash lookup.
+    const char* internName(const std::string& name);
+
+    //Drops everything recorded so far.
+    void clear();
+
+    //Zones recorded while capturing might be dropped.
+    void capture(ProfileCapture& outCapture);
+
+    //Chrome trace_event format, loads in chrome://tracing or ui.perfetto.dev
+    void writeChromeTrace(const ProfileCapture& capture, std::string& outJson);
+
+    //Compact binary format: zones are varint and delta encoded, a handful of bytes each.
+    void writeBinary(const ProfileCapture& capture, ByteBuffer& output);
+    //Returns false if the data is truncated or not a capture.
+    bool readBinary(const u8* data, size_t size, ProfileCapture& outCapture);
+}
+
+class ProfileScope
+{
+public:
+    explicit ProfileScope(const char* name)
+    : m_name(name), m_begin(Profiler::enabled() ? Profiler::now() : 0), m_frame(m_begin != 0 ? Profiler::frame() : 0)
+    {
+    }
+
+    ~ProfileScope()
+    {
+        if (m_begin != 0)
+            Profiler::record(m_name, m_begin, Profiler::now(), m_frame);
+    }
+
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+
+private:
+    const char* m_name;
+    uint64_t m_begin;
+    uint32_t m_frame;
+};
+
+}
+
+#define CPY_PROFILE_CONCAT_INNER(a, b) a##b
+#define CPY_PROFILE_CONCAT(a, b) CPY_PROFILE_CONCAT_INNER(a, b)
+#define CPY_PROFILE_SCOPE(name) ::coalpy::ProfileScope CPY_PROFILE_CONCAT(cpyProfileScope, __LINE__)(name)
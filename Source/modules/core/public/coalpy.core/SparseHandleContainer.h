@@ -0,0 +1,145 @@
+#pragma once
+#include <coalpy.core/Assert.h>
+#include <vector>
+#include <utility>
+
+namespace coalpy
+{
+
+//Handle container with generational handles and densely packed storage (a sparse set).
+//Handles pack a slot index in the low indexBits and a generation in the rest. Freeing a handle
+//bumps its slot's generation, so stale handles fail contains() instead of aliasing the next object
+//allocated in the slot (until the generation wraps around).
+//Live elements are kept contiguous: forEach only touches live data, and free swaps the last element
+//into the hole. This means references and iteration order are not stable across free, and
+//elements must not be freed from inside forEach.
+//Freed objects are kept at the tail of the dense arrays and recycled by the next allocate,
+//reset to DataType() unless free is told otherwise.
+template<typename HandleType, typename DataType, int indexBits = 20>
+class SparseHandleContainer
+{
+public:
+    using BaseHandleType = typename HandleType::BaseType;
+    static_assert(indexBits > 0 && indexBits < (int)sizeof(BaseHandleType) * 8, "indexBits must leave room for a generation.");
+
+    static constexpr BaseHandleType IndexMask = ((BaseHandleType)1 << indexBits) - 1;
+    static constexpr BaseHandleType GenerationMask = (BaseHandleType)~(BaseHandleType)0 >> indexBits;
+    //The last index is never handed out, so no handle can be equal to InvalidId.
+    static constexpr BaseHandleType MaxElements = IndexMask;
+
+    DataType& allocate(HandleType& outHandle)
+    {
+        BaseHandleType index;
+        if (m_freeHead != FreeListEnd)
+        {
+            index = m_freeHead;
+            m_freeHead = m_sparse[index].dense;
+        }
+        else
+        {
+            CPY_ERROR_MSG((BaseHandleType)m_sparse.size() < MaxElements, "Sparse handle container exceeded capacity.");
+            index = (BaseHandleType)m_sparse.size();
+            m_sparse.emplace_back();
+        }
+
+        Slot& slot = m_sparse[index];
+        slot.dense = (BaseHandleType)m_numElements;
+        outHandle.handleId = (slot.generation << indexBits) | index;
+        if (m_numElements == (int)m_data.size())
+        {
+            m_data.emplace_back();
+            m_handles.push_back(outHandle);
+        }
+        else
+        {
+            m_handles[m_numElements] = outHandle;
+        }
+
+        return m_data[m_numElements++];
+    }
+
+    void free(HandleType handle, bool resetObject = true)
+    {
+        if (!contains(handle))
+            return;
+
+        BaseHandleType index = handle.handleId & IndexMask;
+        Slot& slot = m_sparse[index];
+        BaseHandleType last = (BaseHandleType)(m_numElements - 1);
+        if (slot.dense != last)
+        {
+            std::swap(m_data[slot.dense], m_data[last]);
+            m_handles[slot.dense] = m_handles[last];
+            m_sparse[m_handles[slot.dense].handleId & IndexMask].dense = slot.dense;
+        }
+
+        if (resetObject)
+            m_data[last] = DataType();
+
+        --m_numElements;
+        slot.generation = (slot.generation + 1) & GenerationMask;
+        slot.dense = m_freeHead;
+        m_freeHead = index;
+    }
+
+    template<typename FnType>
+    void forEach(FnType elementFn)
+    {
+        for (int i = 0; i < m_numElements; ++i)
+            elementFn(m_handles[i], m_data[i]);
+    }
+
+    bool contains(HandleType h) const
+    {
+        if (!h.valid())
+            return false;
+
+        BaseHandleType index = h.handleId & IndexMask;
+        if (index >= (BaseHandleType)m_sparse.size())
+            return false;
+
+        const Slot& slot = m_sparse[index];
+        return slot.generation == (h.handleId >> indexBits) && slot.dense < (BaseHandleType)m_numElements && m_handles[slot.dense] == h;
+    }
+
+    DataType& operator[](HandleType h)
+    {
+        CPY_ASSERT_MSG(contains(h), "Stale or invalid handle.");
+        return m_data[m_sparse[h.handleId & IndexMask].dense];
+    }
+
+    const DataType& operator[](HandleType h) const
+    {
+        CPY_ASSERT_MSG(contains(h), "Stale or invalid handle.");
+        return m_data[m_sparse[h.handleId & IndexMask].dense];
+    }
+
+    int elementsCount() const { return m_numElements; }
+
+    void clear()
+    {
+        m_numElements = 0;
+        m_freeHead = FreeListEnd;
+        m_sparse.clear();
+        m_handles.clear();
+        m_data.clear();
+    }
+
+private:
+    static constexpr BaseHandleType FreeListEnd = (BaseHandleType)~(BaseHandleType)0;
+
+    struct Slot
+    {
+        BaseHandleType generation = 0;
+        //Position in the dense arrays while alive, next free slot once freed.
+        BaseHandleType dense = 0;
+    };
+
+    int m_numElements = 0;
+    BaseHandleType m_freeHead = FreeListEnd;
+    std::vector<Slot> m_sparse;
+    std::vector<HandleType> m_handles;
+    std::vector<DataType> m_data;
+};
+
+}
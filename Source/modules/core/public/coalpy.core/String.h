@@ -1,6 +1,8 @@
 #pragma once
 
+#include <coalpy.core/Hash.h>
 #include <string>
+#include <string_view>
 #include <locale>
 #include <codecvt>
 
@@ -21,25 +23,10 @@ inline std::wstring s2ws(const std::string& s)
     return converterX.from_bytes(s);
 }
 
-inline unsigned int stringHash(const char* str)
+//Usable at compile time, i.e. for switch cases or static keys.
+constexpr uint64_t stringHash(std::string_view str)
 {
-    //FNV hash
-    const unsigned int fnvPrime = 0x811C9DC5;
-	unsigned int hash = 0;
-	unsigned int i = 0;
-    const char* curr = str;
-    while (*curr)
-	{
-		hash *= fnvPrime;
-		hash ^= *curr++;
-	}
-
-	return hash;
-}
-
-inline unsigned int stringHash(const std::string& str)
-{
-    return stringHash(str.c_str());
+    return hash64(str.data(), str.size());
 }
 
 
@@ -0,0 +1,69 @@
+#include "ContentCache.h"
+#include <iterator>
+
+namespace coalpy
+{
+
+ContentCache::ContentCache(unsigned long long byteBudget)
+: m_byteBudget(byteBudget)
+{
+}
+
+ContentCache::Buffer ContentCache::find(const std::string& absolutePath, unsigned long long modifiedTime, unsigned long long size)
+{
+    std::unique_lock lock(m_mutex);
+    auto it = m_lookup.find(absolutePath);
+    if (it == m_lookup.end())
+        return nullptr;
+
+    auto entryIt = it->second;
+    if (entryIt->modifiedTime != modifiedTime || entryIt->size != size)
+    {
+        erase(entryIt);
+        return nullptr;
+    }
+
+    m_entries.splice(m_entries.begin(), m_entries, entryIt);
+    return entryIt->data;
+}
+
+void ContentCache::insert(const std::string& absolutePath, unsigned long long modifiedTime, unsigned long long size, Buffer data)
+{
+    std::unique_lock lock(m_mutex);
+    auto it = m_lookup.find(absolutePath);
+    if (it != m_lookup.end())
+        erase(it->second);
+
+    if (size > m_byteBudget)
+        return;
+
+    while (!m_entries.empty() && m_usedBytes + size > m_byteBudget)
+        erase(std::prev(m_entries.end()));
+
+    m_entries.push_front(Entry { absolutePath, modifiedTime, size, std::move(data) });
+    m_lookup[absolutePath] = m_entries.begin();
+    m_usedBytes += size;
+}
+
+void ContentCache::invalidate(const std::string& absolutePath)
+{
+    std::unique_lock lock(m_mutex);
+    auto it = m_lookup.find(absolutePath);
+    if (it != m_lookup.end())
+        erase(it->second);
+}
+
+unsigned long long ContentCache::usedBytes() const
+{
+    std::unique_lock lock(m_mutex);
+    return m_usedBytes;
+}
+
+void ContentCache::erase(EntryList::iterator it)
+{
+    m_usedBytes -= it->size;
+    m_lookup.erase(it->path);
+    m_entries.erase(it);
+}
+
+}
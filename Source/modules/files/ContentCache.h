@@ -0,0 +1,53 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+
+namespace coalpy
+{
+
+//LRU cache of whole file contents keyed by absolute path, bounded by a byte budget.
+//Buffers are shared and never written once inserted: evicting or invalidating an entry
+//only drops the cache's reference, reads that still hold the buffer keep it alive.
+class ContentCache
+{
+public:
+    using Buffer = std::shared_ptr<char[]>;
+
+    explicit ContentCache(unsigned long long byteBudget);
+
+    //Returns null if the path is not cached or the cached copy has a different write time or size.
+    Buffer find(const std::string& absolutePath, unsigned long long modifiedTime, unsigned long long size);
+
+    //Files larger than the whole budget are not cached.
+    void insert(const std::string& absolutePath, unsigned long long modifiedTime, unsigned long long size, Buffer data);
+
+    void invalidate(const std::string& absolutePath);
+
+    unsigned long long usedBytes() const;
+
+private:
+    struct Entry
+    {
+        std::string path;
+        unsigned long long modifiedTime = 0;
+        unsigned long long size = 0;
+        Buffer data;
+    };
+
+    using EntryList = std::list<Entry>;
+
+    void erase(EntryList::iterator it);
+
+    unsigned long long m_byteBudget;
+    unsigned long long m_usedBytes = 0;
+    mutable std::mutex m_mutex;
+    //Most recently used entries first.
+    EntryList m_entries;
+    std::unordered_map<std::string, EntryList::iterator> m_lookup;
+};
+
+}
@@ -1,24 +1,69 @@
 #include "FileSystem.h"
 #include <coalpy.tasks/ITaskSystem.h>
 #include <coalpy.core/Assert.h>
+#include <coalpy.core/Profiler.h>
 #include <coalpy.files/Utils.h>
+#include <coalpy.files/PakDefs.h>
 #include <sstream>
+#include <algorithm>
+#include <cstring>
 
 namespace coalpy
 {
 
+namespace
+{
+
+std::string pathFileName(const std::string& path)
+{
+    size_t separator = path.find_last_of("/\\");
+    return separator == std::string::npos ? path : path.substr(separator + 1);
+}
+
+}
+
 FileSystem::FileSystem(const FileSystemDesc& desc)
 : m_desc(desc)
 , m_ts(*desc.taskSystem)
 {
-    
+    if (m_desc.useIoRing)
+        m_ioRing.reset(IoRing::create(m_ts));
+
+    if (m_desc.contentCacheBytes > 0)
+        m_contentCache.reset(new ContentCache(m_desc.contentCacheBytes));
+
+    if (m_desc.watcher)
+        m_desc.watcher->addListener(this);
 }
 
 FileSystem::~FileSystem()
 {
+    if (m_desc.watcher)
+        m_desc.watcher->removeListener(this);
+
     CPY_ASSERT_FMT(m_requests.elementsCount() == 0, "%d File requests still alive. Please close the handles.", m_requests.elementsCount());
 }
 
+void FileSystem::prepareRead(Request& requestData, const std::string& path, const std::vector<std::string>& roots, int flags, int chunkSize, const CancelToken& cancelToken)
+{
+    requestData.type = InternalFileSystem::RequestType::Read;
+    requestData.filenames.push(path);
+    for (auto& root : roots)
+    {
+        if (root[root.size() - 1] == '/' || root[root.size() - 1] == '\\')
+            requestData.filenames.push(root + path);
+        else
+            requestData.filenames.push(root + FILE_SEP + path);
+    }
+
+    requestData.flags = flags;
+    requestData.chunkSize = chunkSize > 0 ? (unsigned int)chunkSize : 0u;
+    requestData.cancelToken = cancelToken;
+    requestData.opaqueHandle = {};
+    requestData.error = IoError::None;
+    requestData.fileStatus = FileStatus::Idle;
+}
+
 AsyncFileHandle FileSystem::read(const FileReadRequest& request)
 {
     CPY_ASSERT_MSG(request.doneCallback, "File read request must provide a done callback.");
@@ -27,127 +72,810 @@ AsyncFileHandle FileSystem::read(const FileReadRequest& request)
     Task task;
     
     {
-        std::unique_lock lock(m_requestsMutex);
         Request*& requestData = m_requests.allocate(asyncHandle);
+        if (!asyncHandle.valid())
+            return asyncHandle;
+
         requestData = new Request();
-        requestData->type = InternalFileSystem::RequestType::Read;
-        requestData->filenames.push(request.path);
+        prepareRead(*requestData, request.path, request.additionalRoots, request.flags, request.chunkSize, request.cancelToken);
+        requestData->readCallback = request.doneCallback;
+        requestData->task = m_ts.createTask(TaskDesc("FileSystem::read", (int)TaskFlags::IoBound, [this](TaskContext& ctx)
         {
-            for (auto& root : request.additionalRoots)
-            {
-                if (root[root.size() - 1] == '/' || root[root.size() - 1] == '\\')
-                    requestData->filenames.push(root + request.path);
-                else
-                    requestData->filenames.push(root + FILE_SEP + request.path);
-            }
+            readFile(ctx);
+        }), requestData);
+        task = requestData->task;
+    }
+
+    if (!task.valid())
+        return discardRequest(asyncHandle);
+
+    if ((request.flags & (int)FileRequestFlags::AutoStart) != 0)
+        m_ts.execute(task);
+    return asyncHandle;
+}
+
+AsyncFileHandle FileSystem::readMany(const FileReadManyRequest& request)
+{
+    CPY_ASSERT_MSG(request.fileCallback, "File read many request must provide a file callback.");
+
+    AsyncFileHandle asyncHandle;
+    Request*& groupSlot = m_requests.allocate(asyncHandle);
+    if (!asyncHandle.valid())
+        return asyncHandle;
+
+    //Roots get probed once for the whole group instead of once per file.
+    std::vector<std::string> roots;
+    for (auto& root : request.additionalRoots)
+    {
+        FileAttributes attr = {};
+        getFileAttributes(root.c_str(), attr);
+        if (!root.empty() && attr.exists && attr.isDir)
+            roots.push_back(root);
+    }
+
+    auto* group = new Request();
+    groupSlot = group;
+    group->flags = request.flags;
+    group->cancelToken = request.cancelToken;
+    group->error = IoError::None;
+    group->fileStatus = FileStatus::Idle;
+    group->groupFileCallback = request.fileCallback;
+    group->groupCallback = request.groupCallback;
+    group->queueDepth = request.queueDepth;
+    group->groupSignal = m_ts.createTask(TaskDesc("FileSystem::readManyDone", (int)TaskFlags::External, nullptr));
+
+    //All the file tasks get created under a single lock, they are started by the group task.
+    int fileFlags = request.flags & ~(int)FileRequestFlags::AutoStart;
+    TaskBatch batch;
+    group->groupFiles.reserve(request.paths.size());
+    for (int fileIndex = 0; fileIndex < (int)request.paths.size(); ++fileIndex)
+    {
+        auto file = std::make_unique<Request>();
+        prepareRead(*file, request.paths[fileIndex], roots, fileFlags, request.chunkSize, request.cancelToken);
+        file->readCallback = [this, group, fileIndex](FileReadResponse& response)
+        {
+            group->groupFileCallback(fileIndex, response);
+            if (response.status == FileStatus::Success || response.status == FileStatus::Fail)
+                onGroupFileDone(*group, response.status == FileStatus::Fail);
+        };
+        batch.add(TaskDesc("FileSystem::read", (int)TaskFlags::IoBound, [this](TaskContext& ctx)
+        {
+            readFile(ctx);
+        }), file.get());
+        group->groupFiles.push_back(std::move(file));
+    }
+    m_ts.submit(batch, false);
+    for (int fileIndex = 0; fileIndex < (int)group->groupFiles.size(); ++fileIndex)
+        group->groupFiles[fileIndex]->task = batch.tasks[fileIndex];
+
+    group->task = m_ts.createTask(TaskDesc("FileSystem::readMany", (int)TaskFlags::IoBound, [this](TaskContext& ctx)
+    {
+        readGroup(ctx);
+    }), group);
+
+    //The batch gets all of its tasks or none.
+    bool filesCreated = group->groupFiles.empty() || group->groupFiles.front()->task.valid();
+    if (!group->task.valid() || !group->groupSignal.valid() || !filesCreated)
+        return discardRequest(asyncHandle);
+
+    if ((request.flags & (int)FileRequestFlags::AutoStart) != 0)
+        m_ts.execute(group->task);
+    return asyncHandle;
+}
+
+void FileSystem::readGroup(TaskContext& ctx)
+{
+    CPY_PROFILE_SCOPE("FileSystem::readGroup");
+    auto& group = *(Request*)ctx.data;
+    //Every file that finishes starts the next one, the last one signals the group.
+    int fileCount = (int)group.groupFiles.size();
+    int depth = group.queueDepth <= 0 ? fileCount : std::min(group.queueDepth, fileCount);
+    group.groupNext = depth;
+    if (fileCount == 0)
+    {
+        m_ts.signal(group.groupSignal);
+    }
+    else
+    {
+        std::vector<Task> firstTasks;
+        firstTasks.reserve(depth);
+        for (int fileIndex = 0; fileIndex < depth; ++fileIndex)
+            firstTasks.push_back(group.groupFiles[fileIndex]->task);
+        m_ts.execute(firstTasks.data(), depth);
+    }
+
+    m_ts.continueAfter(ctx.task, group.groupSignal, [this](TaskContext& ctx)
+    {
+        finishGroup(*(Request*)ctx.data);
+    });
+}
+
+void FileSystem::onGroupFileDone(Request& group, bool failed)
+{
+    int fileCount = (int)group.groupFiles.size();
+    if (failed)
+        group.groupFailed.fetch_add(1);
+
+    int next = group.groupNext.fetch_add(1);
+    if (next < fileCount)
+        m_ts.execute(group.groupFiles[next]->task);
+
+    if (group.groupDone.fetch_add(1) + 1 == fileCount)
+        m_ts.signal(group.groupSignal);
+}
+
+void FileSystem::finishGroup(Request& group)
+{
+    group.fileStatus = group.groupFailed == 0 ? FileStatus::Success : FileStatus::Fail;
+    if (!group.groupCallback)
+        return;
+
+    FileReadGroupResponse response;
+    response.fileCount = (int)group.groupFiles.size();
+    response.failedCount = group.groupFailed;
+    group.groupCallback(response);
+}
+
+void FileSystem::readFile(TaskContext& ctx)
+{
+    CPY_PROFILE_SCOPE("FileSystem::readFile");
+    auto* requestData = (Request*)ctx.data;
+    auto failCancelled = [requestData](const std::string& filePath)
+    {
+        if (InternalFileSystem::valid(requestData->opaqueHandle))
+            InternalFileSystem::close(requestData->opaqueHandle);
+
+        requestData->error = IoError::Cancelled;
+        requestData->fileStatus = FileStatus::Fail;
+        FileReadResponse response;
+        response.error = IoError::Cancelled;
+        response.filePath = filePath;
+        response.status = FileStatus::Fail;
+        requestData->readCallback(response);
+    };
+
+    if (requestData->cancelToken.isCancelled())
+    {
+        failCancelled(requestData->filenames.empty() ? std::string() : requestData->filenames.front());
+        return;
+    }
+
+    {
+        requestData->fileStatus = FileStatus::Opening;
+        FileReadResponse response;
+        response.status = FileStatus::Opening;
+        requestData->readCallback(response);
+    }
+
+    if (readArchiveEntry(*requestData))
+        return;
+
+    std::string resolvedFileName;
+    openReadCandidate(*requestData, resolvedFileName);
+    if (!InternalFileSystem::valid(requestData->opaqueHandle))
+    {
+        {
+            requestData->error = IoError::FailedOpening;
+            requestData->fileStatus = FileStatus::Fail;
+            FileReadResponse response;
+            if (!requestData->filenames.empty())
+                response.filePath = requestData->filenames.front();
+            response.error = IoError::FailedOpening;
+            response.status = FileStatus::Fail;
+            requestData->readCallback(response);
         }
+        return;
+    }
+
+    requestData->fileStatus = FileStatus::Reading;
+
+    requestData->resolvedPath = resolvedFileName;
+    requestData->fileSize = InternalFileSystem::fileSize(requestData->opaqueHandle);
+    requestData->modifiedTime = InternalFileSystem::modifiedTime(requestData->opaqueHandle);
+    if ((requestData->flags & (int)FileRequestFlags::MemoryMap) != 0)
+    {
+        readMapped(*requestData);
+        return;
+    }
+
+    bool wholeFile = (requestData->flags & (int)FileRequestFlags::WholeFile) != 0;
+    bool readahead = (requestData->flags & (int)FileRequestFlags::Readahead) != 0;
+    if (wholeFile && readCachedContents(*requestData))
+        return;
+
+    if (m_ioRing || (readahead && !wholeFile))
+    {
+        startStreamRead(ctx, *requestData);
+        return;
+    }
+
+    if (wholeFile)
+    {
+        readWholeFile(*requestData);
+        return;
+    }
+
+    struct ReadState {
+        char* output = nullptr;
+        int bytesRead = 0;
+        bool isEof = false;
+        bool successRead = false;
+    } readState;
+    int chunkSize = requestData->chunkSize != 0 ? (int)requestData->chunkSize : (int)InternalFileSystem::defaultChunkSize;
+    while (!readState.isEof)
+    {
+        if (requestData->cancelToken.isCancelled())
+        {
+            failCancelled(resolvedFileName);
+            return;
+        }
+
+        TaskUtil::yieldUntil([&readState, requestData, chunkSize]() {
+            readState.successRead = InternalFileSystem::readBytes(
+                requestData->opaqueHandle, chunkSize, readState.output, readState.bytesRead, readState.isEof);
+        });
 
-        requestData->readCallback = request.doneCallback;
-        requestData->opaqueHandle = {};
-        requestData->error = IoError::None;
-        requestData->fileStatus = FileStatus::Idle;
-        requestData->task = m_ts.createTask(TaskDesc("FileSystem::read", [this](TaskContext& ctx)
         {
-            auto* requestData = (Request*)ctx.data;
+            FileReadResponse response;
+            response.status = FileStatus::Reading;
+            response.buffer = readState.output;
+            response.size = readState.bytesRead;
+            response.filePath = resolvedFileName;
+            requestData->readCallback(response);
+        }
+
+        if (!readState.successRead)
+        {
             {
-                requestData->fileStatus = FileStatus::Opening;
+                if (InternalFileSystem::valid(requestData->opaqueHandle))
+                    InternalFileSystem::close(requestData->opaqueHandle);
+
+                requestData->error = IoError::FailedReading;
+                requestData->fileStatus = FileStatus::Fail;
                 FileReadResponse response;
-                response.status = FileStatus::Opening;
+                response.error = IoError::FailedReading;
+                response.filePath = resolvedFileName;
+                response.status = FileStatus::Fail;
                 requestData->readCallback(response);
             }
+            return;
+        }
+    }
 
-            //pop all the candidate files that don't exist
-            while(!requestData->filenames.empty())
-            {
-                FileAttributes attr;
-                getFileAttributes(requestData->filenames.front().c_str(), attr);
-                if (!attr.exists || attr.isDir || attr.isDot)
-                    requestData->filenames.pop();
-                else
-                    break;
-            } 
-    
-            if (!requestData->filenames.empty())
-                requestData->opaqueHandle = InternalFileSystem::openFile(requestData->filenames.front().c_str(), InternalFileSystem::RequestType::Read);
+    {
+        if (InternalFileSystem::valid(requestData->opaqueHandle))
+            InternalFileSystem::close(requestData->opaqueHandle);
+
+        requestData->fileStatus = FileStatus::Success;
+        FileReadResponse response;
+        response.filePath = resolvedFileName;
+        response.status = FileStatus::Success;
+        requestData->readCallback(response);
+    }
+}
 
-            if (!InternalFileSystem::valid(requestData->opaqueHandle))
+bool FileSystem::readArchiveEntry(Request& requestData)
+{
+    std::shared_ptr<PakArchive> archive;
+    int entryIndex = -1;
+    {
+        std::shared_lock lock(m_archivesMutex);
+        if (m_archives.empty())
+            return false;
+
+        std::string name;
+        for (auto candidates = requestData.filenames; !candidates.empty() && entryIndex == -1; candidates.pop())
+        {
+            PakUtils::entryName(candidates.front(), name);
+            for (auto& a : m_archives)
             {
+                entryIndex = a->find(name);
+                if (entryIndex != -1)
                 {
-                    requestData->error = IoError::FailedOpening;
-                    requestData->fileStatus = FileStatus::Fail;
-                    FileReadResponse response;
-                    if (!requestData->filenames.empty())
-                        response.filePath = requestData->filenames.front();
-                    response.error = IoError::FailedOpening;
-                    response.status = FileStatus::Fail;
-                    requestData->readCallback(response);
+                    archive = a;
+                    break;
                 }
-                return;
             }
+        }
+    }
 
-            std::string resolvedFileName;
-            FileUtils::getAbsolutePath(requestData->filenames.front(), resolvedFileName);
+    if (!archive)
+        return false;
 
-            requestData->fileStatus = FileStatus::Reading;
+    const auto& entry = archive->entry(entryIndex);
+    requestData.archive = archive;
+    requestData.fileStatus = FileStatus::Reading;
+    requestData.fileSize = entry.size;
+    requestData.modifiedTime = archive->modifiedTime();
+    requestData.resolvedPath = archive->path() + FILE_SEP;
+    requestData.resolvedPath += archive->name(entryIndex);
 
-            struct ReadState {
-                char* output = nullptr;
-                int bytesRead = 0;
-                bool isEof = false;
-                bool successRead = false;
-            } readState;
-            while (!readState.isEof)
+    const char* contents = archive->data(entryIndex);
+    bool compressed = (entry.flags & PakArchive::CompressedFlag) != 0;
+    bool wholeFile = (requestData.flags & (int)FileRequestFlags::WholeFile) != 0;
+    bool memoryMap = (requestData.flags & (int)FileRequestFlags::MemoryMap) != 0;
+    //The mapping of a stored entry runs straight into the next entry, WholeFile reads need a terminated copy.
+    if (compressed || (wholeFile && !memoryMap))
+    {
+        if (wholeFile)
+            requestData.wholeFileData = m_contentCache ? m_contentCache->find(requestData.resolvedPath, requestData.modifiedTime, requestData.fileSize) : nullptr;
+        requestData.wholeFileCached = requestData.wholeFileData != nullptr;
+
+        if (!requestData.wholeFileData)
+        {
+            requestData.wholeFileData = ContentCache::Buffer(new char[requestData.fileSize + 1]);
+            requestData.wholeFileData[requestData.fileSize] = '\0';
+            bool success = true;
+            if (compressed)
             {
-                TaskUtil::yieldUntil([&readState, requestData]() {
-                    readState.successRead = InternalFileSystem::readBytes(
-                        requestData->opaqueHandle, readState.output, readState.bytesRead, readState.isEof);
+                TaskUtil::yieldUntil([&requestData, &archive, entryIndex, &success]() {
+                    success = archive->decompress(entryIndex, requestData.wholeFileData.get());
                 });
+            }
+            else
+            {
+                memcpy(requestData.wholeFileData.get(), contents, (size_t)requestData.fileSize);
+            }
+            if (!success)
+                requestData.error = IoError::FailedReading;
+        }
+        contents = requestData.wholeFileData.get();
+    }
+    else
+    {
+        requestData.mappedView = contents;
+    }
 
-                {
-                    FileReadResponse response;
-                    response.status = FileStatus::Reading;
-                    response.buffer = readState.output;
-                    response.size = readState.bytesRead;
-                    response.filePath = resolvedFileName;
-                    requestData->readCallback(response);
-                }
+    if ((requestData.flags & ((int)FileRequestFlags::WholeFile | (int)FileRequestFlags::MemoryMap)) != 0
+        || requestData.error != IoError::None)
+    {
+        finishRead(requestData);
+        return true;
+    }
+
+    //Chunked reads still get their chunks, carved out of the contents.
+    unsigned int chunkSize = requestData.chunkSize != 0 ? requestData.chunkSize : (unsigned int)InternalFileSystem::defaultChunkSize;
+    for (unsigned long long offset = 0; offset < requestData.fileSize; offset += chunkSize)
+    {
+        if (requestData.cancelToken.isCancelled())
+        {
+            requestData.error = IoError::Cancelled;
+            break;
+        }
+
+        FileReadResponse response;
+        response.status = FileStatus::Reading;
+        response.buffer = contents + offset;
+        response.size = std::min<unsigned long long>(chunkSize, requestData.fileSize - offset);
+        response.filePath = requestData.resolvedPath;
+        requestData.readCallback(response);
+    }
 
-                if (!readState.successRead)
+    requestData.wholeFileData.reset();
+    requestData.mappedView = nullptr;
+
+    FileReadResponse response;
+    response.filePath = requestData.resolvedPath;
+    response.error = requestData.error;
+    response.status = requestData.error == IoError::None ? FileStatus::Success : FileStatus::Fail;
+    requestData.fileStatus = response.status;
+    requestData.readCallback(response);
+    return true;
+}
+
+void FileSystem::openReadCandidate(Request& requestData, std::string& outResolvedPath)
+{
+    std::string fileName;
+    if (m_desc.watcher && !requestData.filenames.empty())
+        fileName = pathFileName(requestData.filenames.front());
+
+    //pop all the candidate files that don't exist, trusting the cache only where the watcher would report changes
+    while (!requestData.filenames.empty())
+    {
+        const std::string& candidate = requestData.filenames.front();
+        bool watched = m_desc.watcher && m_desc.watcher->isWatched(candidate.c_str());
+        ResolvedPath resolved;
+        bool cached = false;
+        if (watched)
+        {
+            std::shared_lock lock(m_pathCacheMutex);
+            auto nameIt = m_pathCache.find(fileName);
+            if (nameIt != m_pathCache.end())
+            {
+                auto it = nameIt->second.find(candidate);
+                if (it != nameIt->second.end())
                 {
-                    {
-                        if (InternalFileSystem::valid(requestData->opaqueHandle))
-                            InternalFileSystem::close(requestData->opaqueHandle);
-
-                        requestData->error = IoError::FailedReading;
-                        requestData->fileStatus = FileStatus::Fail;
-                        FileReadResponse response;
-                        response.error = IoError::FailedReading;
-                        response.filePath = resolvedFileName;
-                        response.status = FileStatus::Fail;
-                        requestData->readCallback(response);
-                    }
-                    return;
+                    resolved = it->second;
+                    cached = true;
                 }
             }
+        }
+
+        if (!cached)
+        {
+            FileAttributes attr;
+            getFileAttributes(candidate.c_str(), attr);
+            resolved.exists = attr.exists && !attr.isDir && !attr.isDot;
+        }
 
+        if (!resolved.exists)
+        {
+            if (watched && !cached)
             {
-                if (InternalFileSystem::valid(requestData->opaqueHandle))
-                    InternalFileSystem::close(requestData->opaqueHandle);
+                std::unique_lock lock(m_pathCacheMutex);
+                m_pathCache[fileName][candidate] = resolved;
+            }
+            requestData.filenames.pop();
+            continue;
+        }
+
+        requestData.opaqueHandle = InternalFileSystem::openFile(candidate.c_str(), InternalFileSystem::RequestType::Read);
+        if (!InternalFileSystem::valid(requestData.opaqueHandle))
+        {
+            if (!cached)
+                return; //Files that exist but failed opening don't get cached.
+
+            //Gone before the watcher noticed, probe this candidate again.
+            std::unique_lock lock(m_pathCacheMutex);
+            m_pathCache[fileName].erase(candidate);
+            continue;
+        }
+
+        if (cached)
+        {
+            outResolvedPath = resolved.absolutePath;
+            return;
+        }
+
+        FileUtils::getAbsolutePath(candidate, outResolvedPath);
+        if (watched)
+        {
+            resolved.absolutePath = outResolvedPath;
+            std::unique_lock lock(m_pathCacheMutex);
+            m_pathCache[fileName][candidate] = std::move(resolved);
+        }
+        return;
+    }
+}
+
+void FileSystem::invalidateResolvedPaths(const std::string& filePath)
+{
+    if (!m_desc.watcher)
+        return;
+
+    std::unique_lock lock(m_pathCacheMutex);
+    m_pathCache.erase(pathFileName(filePath));
+}
+
+bool FileSystem::readCachedContents(Request& requestData)
+{
+    if (!m_contentCache)
+        return false;
+
+    requestData.wholeFileData = m_contentCache->find(requestData.resolvedPath, requestData.modifiedTime, requestData.fileSize);
+    if (!requestData.wholeFileData)
+        return false;
+
+    requestData.wholeFileCached = true;
+    finishRead(requestData);
+    return true;
+}
+
+void FileSystem::invalidateContents(const std::string& filePath)
+{
+    if (!m_contentCache)
+        return;
+
+    std::string absolutePath;
+    FileUtils::getAbsolutePath(filePath, absolutePath);
+    if (!absolutePath.empty())
+        m_contentCache->invalidate(absolutePath);
+}
+
+void FileSystem::onFilesChanged(const std::set<std::string>& filesChanged)
+{
+    if (m_contentCache)
+    {
+        for (auto& filePath : filesChanged)
+            invalidateContents(filePath);
+    }
+
+    std::unique_lock lock(m_pathCacheMutex);
+    for (auto& filePath : filesChanged)
+        m_pathCache.erase(pathFileName(filePath));
+}
+
+void FileSystem::startStreamRead(TaskContext& ctx, Request& requestData)
+{
+    requestData.streamNextOffset = 0;
+    requestData.streamCurrent = 0;
+    requestData.streamInFlight = 0;
+    requestData.streamSlotCount = 0;
+    if (requestData.chunkSize == 0)
+        requestData.chunkSize = m_ioRing ? (unsigned int)IoRing::ChunkSize : (unsigned int)InternalFileSystem::defaultChunkSize;
+
+    bool wholeFile = (requestData.flags & (int)FileRequestFlags::WholeFile) != 0;
+    if (wholeFile)
+    {
+        requestData.wholeFileData = ContentCache::Buffer(new char[requestData.fileSize + 1]);
+        requestData.wholeFileData[requestData.fileSize] = '\0';
+    }
 
-                requestData->fileStatus = FileStatus::Success;
+    if (requestData.fileSize == 0)
+    {
+        finishRead(requestData);
+        return;
+    }
+
+    if (wholeFile)
+    {
+        //A single read for the whole file, finishRead delivers it.
+        auto& op = requestData.streamOps[0];
+        op.fd = InternalFileSystem::posixHandle(requestData.opaqueHandle);
+        op.bufferIndex = -1;
+        op.buffer = requestData.wholeFileData.get();
+        op.offset = 0;
+        op.size = (unsigned int)std::min<unsigned long long>(requestData.fileSize, IoRing::MaxReadSize);
+        requestData.streamSlotCount = 1;
+        requestData.streamNextOffset = requestData.fileSize;
+        submitStreamOp(requestData, 0);
+        pumpStreamReads(ctx, requestData);
+        return;
+    }
+
+    //Files that fit in a chunk take a single read into memory of their own size.
+    //Bigger ones stream through two chunks, registered with the kernel when one is free and big enough.
+    unsigned long long chunkSize = std::min(requestData.fileSize, (unsigned long long)requestData.chunkSize);
+    requestData.streamSlotCount = requestData.fileSize > chunkSize ? 2 : 1;
+    bool registeredBuffers = m_ioRing && requestData.streamSlotCount > 1 && chunkSize <= IoRing::ChunkSize;
+    if (!m_ioRing)
+        InternalFileSystem::adviseSequential(requestData.opaqueHandle);
+    int heapSlots = 0;
+    for (int slot = 0; slot < requestData.streamSlotCount; ++slot)
+    {
+        auto& op = requestData.streamOps[slot];
+        op.fd = InternalFileSystem::posixHandle(requestData.opaqueHandle);
+        op.bufferIndex = registeredBuffers ? m_ioRing->acquireBuffer(op.buffer) : -1;
+        if (op.bufferIndex < 0)
+            ++heapSlots;
+    }
+
+    if (heapSlots > 0)
+    {
+        requestData.streamMemory = std::unique_ptr<char[]>(new char[heapSlots * chunkSize]);
+        char* memory = requestData.streamMemory.get();
+        for (int slot = 0; slot < requestData.streamSlotCount; ++slot)
+        {
+            auto& op = requestData.streamOps[slot];
+            if (op.bufferIndex >= 0)
+                continue;
+
+            op.buffer = memory;
+            memory += chunkSize;
+        }
+    }
+
+    for (int slot = 0; slot < requestData.streamSlotCount; ++slot)
+        queueStreamRead(requestData, slot);
+
+    pumpStreamReads(ctx, requestData);
+}
+
+void FileSystem::pumpStreamReads(TaskContext& ctx, Request& requestData)
+{
+    for (;;)
+    {
+        auto& op = requestData.streamOps[requestData.streamCurrent];
+        if (!requestData.streamReady[requestData.streamCurrent])
+        {
+            //Awaited ops become dependencies of the read task, closeHandle cleans them with it.
+            m_ts.continueAfter(ctx.task, op.signal, [this](TaskContext& ctx)
+            {
+                auto& requestData = *(Request*)ctx.data;
+                if (deliverStreamRead(requestData))
+                    pumpStreamReads(ctx, requestData);
+            });
+            return;
+        }
+
+        //Completed while being submitted (page cache hits mostly), delivered without suspending the task.
+        m_ts.cleanTaskTree(op.signal);
+        if (!deliverStreamRead(requestData))
+            return;
+    }
+}
+
+bool FileSystem::deliverStreamRead(Request& requestData)
+{
+    auto& op = requestData.streamOps[requestData.streamCurrent];
+    --requestData.streamInFlight;
+
+    //After an error nothing new gets queued, the reads still in flight are drained before finishing.
+    if (requestData.error == IoError::None)
+    {
+        if (requestData.cancelToken.isCancelled())
+        {
+            requestData.error = IoError::Cancelled;
+        }
+        else if (op.result <= 0)
+        {
+            requestData.error = IoError::FailedReading;
+        }
+        else if (requestData.wholeFileData)
+        {
+            //Short reads and files bigger than a single read continue where the last read stopped.
+            op.buffer += op.result;
+            op.offset += (unsigned long long)op.result;
+            if (op.offset < requestData.fileSize)
+            {
+                op.size = (unsigned int)std::min<unsigned long long>(requestData.fileSize - op.offset, IoRing::MaxReadSize);
+                submitStreamOp(requestData, requestData.streamCurrent);
+                return true;
+            }
+        }
+        else
+        {
+            {
                 FileReadResponse response;
-                response.filePath = resolvedFileName;
-                response.status = FileStatus::Success;
-                requestData->readCallback(response);
+                response.status = FileStatus::Reading;
+                response.buffer = op.buffer;
+                response.size = (unsigned long long)op.result;
+                response.filePath = requestData.resolvedPath;
+                requestData.readCallback(response);
             }
 
-        }), requestData);
-        task = requestData->task;
+            if ((unsigned int)op.result < op.size)
+            {
+                //Short read, the rest goes into the same slot, which stays the next one to deliver.
+                op.offset += (unsigned long long)op.result;
+                op.size -= (unsigned int)op.result;
+                submitStreamOp(requestData, requestData.streamCurrent);
+                return true;
+            }
+
+            queueStreamRead(requestData, requestData.streamCurrent);
+        }
     }
 
-    if ((request.flags & (int)FileRequestFlags::AutoStart) != 0)
-        m_ts.execute(task);
-    return asyncHandle;
+    if (requestData.streamInFlight == 0)
+    {
+        finishRead(requestData);
+        return false;
+    }
+
+    requestData.streamCurrent = (requestData.streamCurrent + 1) % requestData.streamSlotCount;
+    return true;
+}
+
+bool FileSystem::queueStreamRead(Request& requestData, int slot)
+{
+    if (requestData.streamNextOffset >= requestData.fileSize)
+        return false;
+
+    auto& op = requestData.streamOps[slot];
+    op.offset = requestData.streamNextOffset;
+    op.size = (unsigned int)std::min(requestData.fileSize - op.offset, (unsigned long long)requestData.chunkSize);
+    requestData.streamNextOffset += op.size;
+
+    //pread only keeps two chunks in flight, the page cache can fetch the one after them meanwhile.
+    if (!m_ioRing && requestData.streamNextOffset < requestData.fileSize)
+        InternalFileSystem::adviseWillNeed(requestData.opaqueHandle, requestData.streamNextOffset, requestData.chunkSize);
+    submitStreamOp(requestData, slot);
+    return true;
+}
+
+void FileSystem::submitStreamOp(Request& requestData, int slot)
+{
+    auto& op = requestData.streamOps[slot];
+    op.result = 0;
+    ++requestData.streamInFlight;
+    if (m_ioRing)
+    {
+        op.signal = m_ts.createTask(TaskDesc("FileSystem::streamRead", (int)TaskFlags::External, nullptr));
+        if (op.signal.valid())
+        {
+            requestData.streamReady[slot] = m_ioRing->read(op);
+            return;
+        }
+    }
+    else
+    {
+        //Without a ring each chunk is a pread task of its own, started now so it overlaps the callback.
+        op.signal = m_ts.createTask(TaskDesc("FileSystem::streamRead", (int)TaskFlags::IoBound, [slot](TaskContext& ctx)
+        {
+            auto& requestData = *(Request*)ctx.data;
+            auto& op = requestData.streamOps[slot];
+            int bytesRead = 0;
+            bool success = InternalFileSystem::readAt(requestData.opaqueHandle, op.buffer, op.size, op.offset, bytesRead);
+            op.result = success ? bytesRead : -1;
+        }), &requestData);
+        if (op.signal.valid())
+        {
+            requestData.streamReady[slot] = false;
+            m_ts.execute(op.signal);
+            return;
+        }
+    }
+
+    //The task table is full, read on the calling thread instead.
+    int bytesRead = 0;
+    bool success = InternalFileSystem::readAt(requestData.opaqueHandle, op.buffer, op.size, op.offset, bytesRead);
+    op.result = success ? bytesRead : -1;
+    requestData.streamReady[slot] = true;
+}
+
+void FileSystem::readWholeFile(Request& requestData)
+{
+    requestData.wholeFileData = ContentCache::Buffer(new char[requestData.fileSize + 1]);
+    requestData.wholeFileData[requestData.fileSize] = '\0';
+
+    bool success = false;
+    TaskUtil::yieldUntil([&requestData, &success]() {
+        success = InternalFileSystem::readAll(requestData.opaqueHandle, requestData.wholeFileData.get(), requestData.fileSize);
+    });
+
+    if (!success)
+        requestData.error = IoError::FailedReading;
+    finishRead(requestData);
+}
+
+void FileSystem::readMapped(Request& requestData)
+{
+    const char* view = nullptr;
+    if (InternalFileSystem::mapFile(requestData.opaqueHandle, view))
+        requestData.mappedView = view;
+    else
+        requestData.error = IoError::FailedReading;
+    finishRead(requestData);
+}
+
+void FileSystem::finishRead(Request& requestData)
+{
+    for (int slot = 0; slot < requestData.streamSlotCount; ++slot)
+    {
+        if (m_ioRing)
+            m_ioRing->releaseBuffer(requestData.streamOps[slot].bufferIndex);
+        requestData.streamOps[slot].bufferIndex = -1;
+    }
+    requestData.streamMemory.reset();
+
+    bool success = requestData.error == IoError::None;
+    if (!success)
+        requestData.wholeFileData.reset();
+    else if (m_contentCache && requestData.wholeFileData && !requestData.wholeFileCached)
+        m_contentCache->insert(requestData.resolvedPath, requestData.modifiedTime, requestData.fileSize, requestData.wholeFileData);
+
+    //The mapping needs the file open, closeHandle closes it.
+    if (requestData.mappedView == nullptr && InternalFileSystem::valid(requestData.opaqueHandle))
+        InternalFileSystem::close(requestData.opaqueHandle);
+
+    const char* contents = requestData.mappedView != nullptr ? requestData.mappedView : requestData.wholeFileData.get();
+    if (success && contents != nullptr)
+    {
+        FileReadResponse response;
+        response.status = FileStatus::Reading;
+        response.buffer = contents;
+        response.size = requestData.fileSize;
+        response.filePath = requestData.resolvedPath;
+        requestData.readCallback(response);
+    }
+
+    FileReadResponse response;
+    response.filePath = requestData.resolvedPath;
+    if (success)
+    {
+        requestData.fileStatus = FileStatus::Success;
+        response.status = FileStatus::Success;
+        response.buffer = contents;
+        response.size = contents != nullptr ? requestData.fileSize : 0ull;
+    }
+    else
+    {
+        requestData.fileStatus = FileStatus::Fail;
+        response.status = FileStatus::Fail;
+        response.error = requestData.error;
+    }
+    requestData.readCallback(response);
 }
 
 void FileSystem::execute(AsyncFileHandle handle)
@@ -158,135 +886,248 @@ void FileSystem::execute(AsyncFileHandle handle)
 
 Task FileSystem::asTask(AsyncFileHandle handle)
 {
-    Task task;
+    CPY_ASSERT(m_requests.contains(handle));
+    return m_requests[handle]->task;
+}
+
+FileSystem::Request* FileSystem::allocateWrite(const FileWriteRequest& request, AsyncFileHandle& outHandle)
+{
+    Request*& requestData = m_requests.allocate(outHandle);
+    if (!outHandle.valid())
+        return nullptr;
+
+    requestData = new Request();
+    requestData->type = InternalFileSystem::RequestType::Write;
+    requestData->filenames.push(request.path);
+    InternalFileSystem::fixStringPath(requestData->filenames.front());
+    requestData->writeCallback = request.doneCallback;
+    requestData->flags = request.flags;
+    requestData->opaqueHandle = {};
+    requestData->error = IoError::None;
+    requestData->fileStatus = FileStatus::Idle;
+    requestData->writeOffset = request.offset;
+    return requestData;
+}
+
+bool FileSystem::openForWrite(Request& requestData)
+{
     {
-        std::unique_lock lock(m_requestsMutex);
-        CPY_ASSERT(m_requests.contains(handle));
-        Request* requestData = m_requests[handle];
-        task = requestData->task;
+        requestData.fileStatus = FileStatus::Opening;
+        FileWriteResponse response;
+        response.status = FileStatus::Opening;
+        requestData.writeCallback(response);
+    }
+
+    if (!InternalFileSystem::carvePath(requestData.filenames.front()))
+    {
+        requestData.error = IoError::FailedCreatingDir;
+        return false;
+    }
+
+    bool append = (requestData.flags & (int)FileRequestFlags::Append) != 0;
+    bool atOffset = (requestData.flags & (int)FileRequestFlags::WriteAtOffset) != 0;
+    requestData.opaqueHandle = InternalFileSystem::openFile(requestData.filenames.front().c_str(), InternalFileSystem::RequestType::Write, !append && !atOffset);
+    if (!InternalFileSystem::valid(requestData.opaqueHandle))
+    {
+        requestData.error = IoError::FailedOpening;
+        return false;
     }
-    return task;
+
+    //The file may have just been created, lookups that missed it have to probe again.
+    invalidateResolvedPaths(requestData.filenames.front());
+    invalidateContents(requestData.filenames.front());
+
+    if (append)
+        requestData.writeOffset = InternalFileSystem::fileSize(requestData.opaqueHandle);
+    else if (!atOffset)
+        requestData.writeOffset = 0;
+
+    {
+        requestData.fileStatus = FileStatus::Writing;
+        FileWriteResponse response;
+        response.status = FileStatus::Writing;
+        requestData.writeCallback(response);
+    }
+    return true;
+}
+
+void FileSystem::finishWrite(Request& requestData)
+{
+    if (requestData.error == IoError::None && (requestData.flags & (int)FileRequestFlags::Sync) != 0)
+    {
+        bool synced = false;
+        TaskUtil::yieldUntil([&requestData, &synced]() {
+            synced = InternalFileSystem::syncData(requestData.opaqueHandle);
+        });
+
+        if (!synced)
+            requestData.error = IoError::FailedWriting;
+    }
+
+    if (InternalFileSystem::valid(requestData.opaqueHandle))
+        InternalFileSystem::close(requestData.opaqueHandle);
+
+    //Reads that raced with the write may have cached partial contents.
+    invalidateContents(requestData.filenames.front());
+
+    FileWriteResponse response;
+    if (requestData.error == IoError::None)
+    {
+        requestData.fileStatus = FileStatus::Success;
+        response.status = FileStatus::Success;
+    }
+    else
+    {
+        requestData.fileStatus = FileStatus::Fail;
+        response.status = FileStatus::Fail;
+        response.error = requestData.error;
+    }
+    requestData.writeCallback(response);
 }
 
 AsyncFileHandle FileSystem::write(const FileWriteRequest& request)
 {
-    CPY_ASSERT_MSG(request.doneCallback, "File read request must provide a done callback.");
+    CPY_ASSERT_MSG(request.doneCallback, "File write request must provide a done callback.");
 
     AsyncFileHandle asyncHandle;
-    Task task;
-    
+    Request* requestData = allocateWrite(request, asyncHandle);
+    if (requestData == nullptr)
+        return asyncHandle;
+
+    if ((request.flags & (int)FileRequestFlags::BorrowBuffer) != 0)
+    {
+        requestData->writeData = request.buffer;
+    }
+    else
     {
-        std::unique_lock lock(m_requestsMutex);
-        Request*& requestData = m_requests.allocate(asyncHandle);
-        requestData = new Request();
-        requestData->type = InternalFileSystem::RequestType::Write;
-        requestData->filenames.push(request.path);
-        InternalFileSystem::fixStringPath(requestData->filenames.front());
-        requestData->writeCallback = request.doneCallback;
-        requestData->opaqueHandle = {};
-        requestData->error = IoError::None;
-        requestData->fileStatus = FileStatus::Idle;
         requestData->writeBuffer.append((const u8*)request.buffer, (size_t)request.size);
-        requestData->writeSize = request.size;
-        requestData->task = m_ts.createTask(TaskDesc([this](TaskContext& ctx)
+        requestData->writeData = (const char*)requestData->writeBuffer.data();
+    }
+    requestData->writeSize = request.size;
+    requestData->task = m_ts.createTask(TaskDesc("FileSystem::write", (int)TaskFlags::IoBound, [this](TaskContext& ctx)
+    {
+        CPY_PROFILE_SCOPE("FileSystem::write");
+        auto* requestData = (Request*)ctx.data;
+        if (openForWrite(*requestData))
         {
-            auto* requestData = (Request*)ctx.data;
-            {
-                requestData->fileStatus = FileStatus::Opening;
-                FileWriteResponse response;
-                response.status = FileStatus::Opening;
-                requestData->writeCallback(response);
-            }
+            bool successWrite = false;
+            TaskUtil::yieldUntil([&successWrite, requestData]() {
+                successWrite = InternalFileSystem::writeAt(
+                    requestData->opaqueHandle, requestData->writeData, requestData->writeSize, requestData->writeOffset);
+            });
 
-            if (!InternalFileSystem::carvePath(requestData->filenames.front()))
-            {
-                requestData->error = IoError::FailedCreatingDir;
-                requestData->fileStatus = FileStatus::Fail;
-                FileWriteResponse response;
-                response.error = IoError::FailedCreatingDir;
-                response.status = FileStatus::Fail;
-                requestData->writeCallback(response);
-                {
-                    FileWriteResponse response;
-                    response.status = FileStatus::Fail;
-                    response.error = IoError::FailedCreatingDir;
-                    requestData->writeCallback(response);
-                }
-                return;
-            }
-            requestData->opaqueHandle = InternalFileSystem::openFile(requestData->filenames.front().c_str(), InternalFileSystem::RequestType::Write);
-            if (!InternalFileSystem::valid(requestData->opaqueHandle))
-            {
-                {
-                    requestData->error = IoError::FailedOpening;
-                    requestData->fileStatus = FileStatus::Fail;
-                    FileWriteResponse response;
-                    response.error = IoError::FailedOpening;
-                    response.status = FileStatus::Fail;
-                    requestData->writeCallback(response);
-                }
-                return;
-            }
+            if (!successWrite)
+                requestData->error = IoError::FailedWriting;
+        }
 
-            requestData->fileStatus = FileStatus::Writing;
+        finishWrite(*requestData);
+    }), requestData);
 
-            struct WriteState {
-                const char* buffer;
-                int bufferSize;
-                bool successWrite;
-            } writeState = { (const char*)requestData->writeBuffer.data(), requestData->writeSize, false };
+    if (!requestData->task.valid())
+        return discardRequest(asyncHandle);
 
-            TaskUtil::yieldUntil([&writeState, requestData]() {
-                writeState.successWrite = InternalFileSystem::writeBytes(
-                    requestData->opaqueHandle, writeState.buffer, writeState.bufferSize);
-            });
+    if ((request.flags & (int)FileRequestFlags::AutoStart) != 0)
+        m_ts.execute(requestData->task);
+    return asyncHandle;
+}
 
-            if (!writeState.successWrite)
-            {
-                {
-                    if (InternalFileSystem::valid(requestData->opaqueHandle))
-                        InternalFileSystem::close(requestData->opaqueHandle);
-
-                    requestData->error = IoError::FailedWriting;
-                    requestData->fileStatus = FileStatus::Fail;
-                    FileWriteResponse response;
-                    response.error = IoError::FailedWriting;
-                    response.status = FileStatus::Fail;
-                    requestData->writeCallback(response);
-                }
-                return;
-            }
+AsyncFileHandle FileSystem::openWriteStream(const FileWriteRequest& request)
+{
+    CPY_ASSERT_MSG(request.doneCallback, "File write request must provide a done callback.");
 
-            {
-                if (InternalFileSystem::valid(requestData->opaqueHandle))
-                    InternalFileSystem::close(requestData->opaqueHandle);
+    AsyncFileHandle asyncHandle;
+    Request* requestData = allocateWrite(request, asyncHandle);
+    if (requestData == nullptr)
+        return asyncHandle;
 
-                requestData->fileStatus = FileStatus::Success;
-                FileWriteResponse response;
-                response.status = FileStatus::Success;
-                requestData->writeCallback(response);
-            }
+    requestData->writeStream = true;
+    requestData->openTask = m_ts.createTask(TaskDesc("FileSystem::openWriteStream", (int)TaskFlags::IoBound, [this](TaskContext& ctx)
+    {
+        openForWrite(*(Request*)ctx.data);
+    }), requestData);
 
-        }), requestData);
-        task = requestData->task;
-    }
+    //A finished dependency starts its parent once nothing else is pending, so without the gate the open
+    //or the last chunk written so far would start task before finishWriteStream.
+    requestData->task = m_ts.createTask(TaskDesc("FileSystem::finishWriteStream", (int)TaskFlags::IoBound, [this](TaskContext& ctx)
+    {
+        finishWrite(*(Request*)ctx.data);
+    }), requestData);
+    requestData->streamGate = m_ts.createTask(TaskDesc("FileSystem::writeStreamGate", (int)TaskFlags::External, nullptr));
+    if (!requestData->openTask.valid() || !requestData->task.valid() || !requestData->streamGate.valid())
+        return discardRequest(asyncHandle);
 
-    if ((request.flags & (int)FileRequestFlags::AutoStart) != 0)
-        m_ts.execute(task);
+    Task dependencies[] = { requestData->openTask, requestData->streamGate };
+    m_ts.depends(requestData->task, dependencies, 2);
+    m_ts.execute(requestData->openTask);
+
+    if (request.buffer != nullptr && request.size > 0)
+        appendWriteStream(asyncHandle, request.buffer, request.size);
     return asyncHandle;
 }
 
+void FileSystem::appendWriteStream(AsyncFileHandle handle, const char* buffer, unsigned long long size)
+{
+    CPY_ASSERT(m_requests.contains(handle));
+    Request* requestData = m_requests[handle];
 
-void FileSystem::wait(AsyncFileHandle handle)
+    CPY_ASSERT_MSG(requestData->writeStream, "Chunks can only be appended to handles from openWriteStream.");
+    if (size == 0)
+        return;
+
+    //Borrowed chunks are written straight from the caller's memory, copies are freed once written.
+    char* ownedCopy = nullptr;
+    if ((requestData->flags & (int)FileRequestFlags::BorrowBuffer) == 0)
+    {
+        ownedCopy = new char[size];
+        memcpy(ownedCopy, buffer, (size_t)size);
+        buffer = ownedCopy;
+    }
+
+    std::unique_lock lock(requestData->streamMutex);
+    CPY_ASSERT_MSG(!requestData->streamFinished, "Cannot append to a write stream after finishWriteStream.");
+    unsigned long long chunkOffset = requestData->streamWriteSize;
+    requestData->streamWriteSize += size;
+    Task chunkTask = m_ts.createTask(TaskDesc("FileSystem::writeStreamChunk", (int)TaskFlags::IoBound, [buffer, size, chunkOffset, ownedCopy](TaskContext& ctx)
+    {
+        auto& requestData = *(Request*)ctx.data;
+        //A failed open or an earlier failed chunk fails the whole stream.
+        if (requestData.error == IoError::None
+            && !InternalFileSystem::writeAt(requestData.opaqueHandle, buffer, size, requestData.writeOffset + chunkOffset))
+            requestData.error = IoError::FailedWriting;
+        delete [] ownedCopy;
+    }), requestData);
+    if (!chunkTask.valid())
+    {
+        //Without its chunk the stream is incomplete, fail it as a whole.
+        requestData->error = IoError::FailedWriting;
+        delete [] ownedCopy;
+        return;
+    }
+
+    m_ts.depends(chunkTask, requestData->openTask);
+    m_ts.depends(requestData->task, chunkTask);
+    m_ts.execute(chunkTask);
+}
+
+void FileSystem::finishWriteStream(AsyncFileHandle handle)
 {
-    Task task;
+    CPY_ASSERT(m_requests.contains(handle));
+    Request* requestData = m_requests[handle];
+
+    CPY_ASSERT_MSG(requestData->writeStream, "Only handles from openWriteStream can be finished.");
     {
-        std::unique_lock lock(m_requestsMutex);
-        Request* r = m_requests[handle];
-        task = r->task;
+        std::unique_lock lock(requestData->streamMutex);
+        if (requestData->streamFinished)
+            return;
+        requestData->streamFinished = true;
     }
+    m_ts.signal(requestData->streamGate);
+}
+
 
-    m_ts.wait(task);
+void FileSystem::wait(AsyncFileHandle handle)
+{
+    m_ts.wait(m_requests[handle]->task);
 }
 
 bool FileSystem::readStatus (AsyncFileHandle handle, FileReadResponse& response)
@@ -301,29 +1142,51 @@ bool FileSystem::writeStatus(AsyncFileHandle handle, FileWriteResponse& response
 
 void FileSystem::closeHandle(AsyncFileHandle handle)
 {
-    Request* requestData = nullptr;
-    {
-        std::unique_lock lock(m_requestsMutex);
-        if (!m_requests.contains(handle))
-            return;
+    if (!m_requests.contains(handle))
+        return;
 
-        requestData = m_requests[handle];
-        if (requestData == nullptr)
-            return;
-    }
+    Request* requestData = m_requests[handle];
+    if (requestData == nullptr)
+        return;
+
+    if (requestData->writeStream)
+        finishWriteStream(handle);
 
     m_ts.wait(requestData->task);
     m_ts.cleanTaskTree(requestData->task);
 
+    //Files of a group can still be returning from their last callback.
+    for (auto& file : requestData->groupFiles)
+    {
+        m_ts.wait(file->task);
+        m_ts.cleanTaskTree(file->task);
+        if (InternalFileSystem::valid(file->opaqueHandle))
+            InternalFileSystem::close(file->opaqueHandle);
+    }
+
     if (InternalFileSystem::valid(requestData->opaqueHandle))
         InternalFileSystem::close(requestData->opaqueHandle);
 
     delete requestData;
-    
-    {
-        std::unique_lock lock(m_requestsMutex);
-        m_requests.free(handle);
-    }
+    m_requests.free(handle);
+}
+
+//Drops a request whose tasks could not all be created. None of them got started.
+AsyncFileHandle FileSystem::discardRequest(AsyncFileHandle handle)
+{
+    Request* requestData = m_requests[handle];
+    for (auto& file : requestData->groupFiles)
+        if (file->task.valid())
+            m_ts.cleanTaskTree(file->task);
+
+    Task tasks[] = { requestData->task, requestData->openTask, requestData->streamGate, requestData->groupSignal };
+    for (Task task : tasks)
+        if (task.valid())
+            m_ts.cleanTaskTree(task);
+
+    delete requestData;
+    m_requests.free(handle);
+    return AsyncFileHandle();
 }
 
 bool FileSystem::carveDirectoryPath(const char* directoryName)
@@ -346,6 +1209,8 @@ bool FileSystem::deleteDirectory(const char* directoryName)
 
 bool FileSystem::deleteFile(const char* fileName)
 {
+    invalidateResolvedPaths(fileName);
+    invalidateContents(fileName);
     return InternalFileSystem::deleteFile(fileName);
 }
 
@@ -354,6 +1219,34 @@ void FileSystem::getFileAttributes(const char* fileName, FileAttributes& attribu
     InternalFileSystem::getAttributes(fileName, attributes.exists, attributes.isDir, attributes.isDot);
 }
 
+bool FileSystem::mountArchive(const char* archivePath)
+{
+    auto archive = PakArchive::open(archivePath);
+    if (!archive)
+        return false;
+
+    std::unique_lock lock(m_archivesMutex);
+    m_archives.insert(m_archives.begin(), std::move(archive));
+    return true;
+}
+
+bool FileSystem::unmountArchive(const char* archivePath)
+{
+    std::string absolutePath;
+    FileUtils::getAbsolutePath(archivePath, absolutePath);
+
+    std::unique_lock lock(m_archivesMutex);
+    for (auto it = m_archives.begin(); it != m_archives.end(); ++it)
+    {
+        if ((*it)->path() == absolutePath)
+        {
+            m_archives.erase(it);
+            return true;
+        }
+    }
+    return false;
+}
+
 IFileSystem* IFileSystem::create(const FileSystemDesc& desc)
 {
     return new FileSystem(desc);
@@ -1,9 +1,13 @@
 #pragma once
 #include <coalpy.files/IFileSystem.h>
+#include <coalpy.files/IFileWatcher.h>
 #include <coalpy.tasks/TaskDefs.h>
 #include <coalpy.core/ByteBuffer.h>
-#include <coalpy.core/HandleContainer.h>
+#include <coalpy.core/ConcurrentHandleContainer.h>
 #include "InternalFileSystem.h"
+#include "IoRing.h"
+#include "ContentCache.h"
+#include "PakArchive.h"
 #include <vector>
 #include <queue>
 #include <variant>
@@ -11,6 +15,8 @@
 #include <mutex>
 #include <shared_mutex>
 #include <atomic>
+#include <memory>
+#include <unordered_map>
 
 namespace coalpy
 {
@@ -21,13 +27,17 @@ namespace coalpy
 #define FILE_SEP '\\'
 #endif
 
-class FileSystem : public IFileSystem
+class FileSystem : public IFileSystem, public IFileWatchListener
 {
 public:
     FileSystem(const FileSystemDesc& desc);
     virtual ~FileSystem();
     virtual AsyncFileHandle read(const FileReadRequest& request) override;
+    virtual AsyncFileHandle readMany(const FileReadManyRequest& request) override;
     virtual AsyncFileHandle write(const FileWriteRequest& request) override;
+    virtual AsyncFileHandle openWriteStream(const FileWriteRequest& request) override;
+    virtual void appendWriteStream(AsyncFileHandle handle, const char* buffer, unsigned long long size) override;
+    virtual void finishWriteStream(AsyncFileHandle handle) override;
     virtual void execute(AsyncFileHandle handle) override;
     virtual Task asTask(AsyncFileHandle handle) override;
     virtual void wait(AsyncFileHandle handle) override;
@@ -39,6 +49,9 @@ public:
     virtual bool deleteDirectory(const char* directoryName) override;
     virtual bool deleteFile(const char* fileName) override;
     virtual void getFileAttributes(const char* fileName, FileAttributes& attributes) override;
+    virtual bool mountArchive(const char* archivePath) override;
+    virtual bool unmountArchive(const char* archivePath) override;
+    virtual void onFilesChanged(const std::set<std::string>& filesChanged) override;
 
 private:
 
@@ -51,17 +64,108 @@ private:
         InternalFileSystem::OpaqueFileHandle opaqueHandle = {};
 
         ByteBuffer writeBuffer;
-        int writeSize = 0;
+        //Either writeBuffer or borrowed caller memory.
+        const char* writeData = nullptr;
+        unsigned long long writeSize = 0;
+        //Requested offset, then where the data starts in the opened file.
+        unsigned long long writeOffset = 0;
+
+        //Write streams: every chunk waits on openTask and task waits on every chunk.
+        //task also waits on streamGate, which finishWriteStream signals.
+        bool writeStream = false;
+        bool streamFinished = false;
+        Task openTask;
+        Task streamGate;
+        std::mutex streamMutex;
+        unsigned long long streamWriteSize = 0;
+
+        //readMany: the group owns its file requests, they don't get handles of their own.
+        std::vector<std::unique_ptr<Request>> groupFiles;
+        FileReadManyCallback groupFileCallback;
+        FileReadGroupCallback groupCallback;
+        int queueDepth = 0;
+        std::atomic<int> groupNext = 0;
+        std::atomic<int> groupDone = 0;
+        std::atomic<int> groupFailed = 0;
+        //Signalled by the last file to finish.
+        Task groupSignal;
 
         Task task;
+        CancelToken cancelToken;
         std::atomic<IoError> error;
         std::atomic<FileStatus> fileStatus;
+        int flags = 0;
+        //Bytes per Reading response, resolved against the engine default when the read starts.
+        unsigned int chunkSize = 0;
+
+        //WholeFile and MemoryMap contents, handed out until the handle gets closed.
+        //WholeFile buffers may be shared with the content cache and other reads, never write them once read.
+        ContentCache::Buffer wholeFileData;
+        bool wholeFileCached = false;
+        unsigned long long modifiedTime = 0;
+        const char* mappedView = nullptr;
+        unsigned long long fileSize = 0;
+        std::string resolvedPath;
+        //Keeps the mapping of archive reads alive.
+        std::shared_ptr<PakArchive> archive;
+
+        //Streamed reads (io ring, or pread tasks with Readahead): up to two chunks in flight,
+        //one gets delivered while the other one lands.
+        IoRing::ReadOp streamOps[2];
+        bool streamReady[2] = {};
+        std::unique_ptr<char[]> streamMemory;
+        unsigned long long streamNextOffset = 0;
+        int streamSlotCount = 0;
+        int streamCurrent = 0;
+        int streamInFlight = 0;
     };
 
+    void prepareRead(Request& requestData, const std::string& path, const std::vector<std::string>& roots, int flags, int chunkSize, const CancelToken& cancelToken);
+    void readFile(TaskContext& ctx);
+    bool readArchiveEntry(Request& requestData);
+    void openReadCandidate(Request& requestData, std::string& outResolvedPath);
+    void invalidateResolvedPaths(const std::string& filePath);
+    bool readCachedContents(Request& requestData);
+    void invalidateContents(const std::string& filePath);
+    void readGroup(TaskContext& ctx);
+    void onGroupFileDone(Request& group, bool failed);
+    void finishGroup(Request& group);
+    void startStreamRead(TaskContext& ctx, Request& requestData);
+    void pumpStreamReads(TaskContext& ctx, Request& requestData);
+    bool deliverStreamRead(Request& requestData);
+    bool queueStreamRead(Request& requestData, int slot);
+    void submitStreamOp(Request& requestData, int slot);
+    void readWholeFile(Request& requestData);
+    void readMapped(Request& requestData);
+    void finishRead(Request& requestData);
+    Request* allocateWrite(const FileWriteRequest& request, AsyncFileHandle& outHandle);
+    bool openForWrite(Request& requestData);
+    void finishWrite(Request& requestData);
+    AsyncFileHandle discardRequest(AsyncFileHandle handle);
+
     ITaskSystem& m_ts;
     FileSystemDesc m_desc;
-    mutable std::shared_mutex m_requestsMutex;
-    HandleContainer<AsyncFileHandle, Request*> m_requests;
+    //Lock free, handles are looked up on every call of the async api.
+    ConcurrentHandleContainer<AsyncFileHandle, Request*> m_requests;
+    std::unique_ptr<IoRing> m_ioRing;
+    std::unique_ptr<ContentCache> m_contentCache;
+
+    //Mounted pak archives, most recent first.
+    std::shared_mutex m_archivesMutex;
+    std::vector<std::shared_ptr<PakArchive>> m_archives;
+
+    //Whether a read candidate inside a watched directory exists.
+    struct ResolvedPath
+    {
+        bool exists = false;
+        std::string absolutePath;
+    };
+
+    //Keyed by file name then candidate path, so a watcher notification drops every lookup that could resolve differently.
+    //Only candidates the watcher covers get here, the rest are probed on every read.
+    using ResolvedPathMap = std::unordered_map<std::string, ResolvedPath>;
+    std::shared_mutex m_pathCacheMutex;
+    std::unordered_map<std::string, ResolvedPathMap> m_pathCache;
 };
 
 }
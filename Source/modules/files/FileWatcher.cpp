@@ -1,12 +1,13 @@
 #include <coalpy.core/Assert.h>
 #include <coalpy.core/String.h>
-#include <coalpy.tasks/ThreadQueue.h>
+#include <coalpy.tasks/LockFreeQueue.h>
 #include <iostream>
 #include <string>
 #include <sstream>
 #include <chrono>
 #include <thread>
 #include <shared_mutex>
+#include <unordered_map>
 #include "FileWatcher.h"
 
 #ifdef _WIN32 
@@ -21,7 +22,10 @@
 #include <dirent.h>
 #include <unistd.h>
 #include <errno.h>
+#include <string.h>
 #include <sys/inotify.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #endif
 
 #define WATCH_SERVICE_DEBUG_OUTPUT 0
@@ -53,15 +57,22 @@ public:
     std::shared_mutex fileWatchMutex;
     std::set<std::string> directoriesSet;
     std::vector<std::string> directories;
+    //The directories actually watched, as absolute paths for isWatched.
+    std::vector<std::string> watchedRoots;
     std::vector<WatchHandle> handles;
     std::set<IFileWatchListener*> listeners;
-    ThreadQueue<FileWatchMessage> queue;
+    LockFreeQueue<FileWatchMessage> queue;
 
 #ifdef _WIN32 
     std::vector<bool> waitResults;
     std::vector<HANDLE> events;
 #elif defined(__linux__)
     int inotifyInstance;
+    //Written by stop() to wake the listening thread out of epoll_wait.
+    int wakeEvent;
+    int epollInstance;
+    //Every directory below the added ones has a watch of its own.
+    std::unordered_map<int, std::string> watchedDirs;
 #endif
 
 };
@@ -69,6 +80,71 @@ public:
 namespace
 {
 
+//Absolute form of path with '/' separators and '.' / '..' resolved on the string alone,
+//so paths that do not exist yet still compare against the watched directories.
+std::string absoluteWatchPath(const std::string& path)
+{
+    std::string fullPath = path;
+    for (auto& c : fullPath)
+        if (c == '\\')
+            c = '/';
+
+#ifdef _WIN32
+    bool isAbsolute = (fullPath.size() >= 2 && fullPath[1] == ':') || (!fullPath.empty() && fullPath[0] == '/');
+#else
+    bool isAbsolute = !fullPath.empty() && fullPath[0] == '/';
+#endif
+    if (!isAbsolute)
+    {
+        char cwd[4096];
+#ifdef _WIN32
+        DWORD cwdLen = GetCurrentDirectoryA((DWORD)sizeof(cwd), cwd);
+        bool hasCwd = cwdLen > 0 && cwdLen < (DWORD)sizeof(cwd);
+#else
+        bool hasCwd = getcwd(cwd, sizeof(cwd)) != nullptr;
+#endif
+        if (hasCwd)
+        {
+            std::string cwdStr = cwd;
+            for (auto& c : cwdStr)
+                if (c == '\\')
+                    c = '/';
+            fullPath = cwdStr + "/" + fullPath;
+        }
+    }
+
+    //Keep a drive prefix ("C:") as is and resolve the rest.
+    std::string prefix;
+    size_t start = 0;
+    if (fullPath.size() >= 2 && fullPath[1] == ':')
+    {
+        prefix = fullPath.substr(0, 2);
+        start = 2;
+    }
+
+    std::vector<std::string> parts;
+    while (start < fullPath.size())
+    {
+        size_t end = fullPath.find('/', start);
+        if (end == std::string::npos)
+            end = fullPath.size();
+        std::string part = fullPath.substr(start, end - start);
+        if (part == "..")
+        {
+            if (!parts.empty())
+                parts.pop_back();
+        }
+        else if (!part.empty() && part != ".")
+            parts.push_back(part);
+        start = end + 1;
+    }
+
+    std::string result = prefix;
+    for (const auto& part : parts)
+        result += "/" + part;
+    return result.empty() || result == prefix ? result + "/" : result;
+}
+
 #ifdef _WIN32 
 bool findResults(
     const std::string& rootDir,
@@ -105,14 +181,11 @@ bool findResults(
     
     return true;
 }
-#endif
 
 bool waitListenForDirs(FileWatchState& state, int millisecondsToWait)
 {
     std::set<std::string> caughtFiles;
 
-#ifdef _WIN32 
-
     if (state.handles.empty())
         return true;
 
@@ -162,55 +235,153 @@ bool waitListenForDirs(FileWatchState& state, int millisecondsToWait)
             state.waitResults[i] = false;
         }
     }
+
+    if (!caughtFiles.empty())
+    {
+        for (auto* listener : state.listeners)
+            listener->onFilesChanged(caughtFiles);
+    }
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(millisecondsToWait));
+
+    return true;
+}
+
 #elif defined(__linux__)
-    const size_t fileName = 64;
-    const size_t maxEvents = 512;
-    const size_t buffLen = maxEvents * (sizeof(struct inotify_event) + fileName);
 
-    char eventBuffer[buffLen];
-    ssize_t bytesRead = ::read(state.inotifyInstance, eventBuffer, buffLen);
-    ssize_t i = 0;
+const uint32_t s_watchMask = IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_MOVE_SELF | IN_ONLYDIR;
 
-    while (i < bytesRead)
+std::string joinPath(const std::string& dir, const char* name)
+{
+    if (!dir.empty() && dir[dir.size() - 1] != '/')
+        return dir + '/' + name;
+    return dir + name;
+}
+
+//Watches directory and every directory below it. Directories that show up while watching get here too,
+//their files may have been written before the watch existed so they get reported in foundFiles.
+//Returns false if directory itself could not be watched.
+bool watchTree(FileWatchState& state, const std::string& directory, std::set<std::string>* foundFiles)
+{
+    int wd = inotify_add_watch(state.inotifyInstance, directory.c_str(), s_watchMask);
+    if (wd == -1)
+        return false;
+
+    state.watchedDirs[wd] = directory;
+
+    DIR* dir = opendir(directory.c_str());
+    if (dir == nullptr)
+        return true;
+
+    struct dirent* entry;
+    while ((entry = readdir(dir)) != nullptr)
     {
-        struct inotify_event *event = (struct inotify_event *) &eventBuffer[i];
-        if(event->len)
+        if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+            continue;
+
+        std::string path = joinPath(directory, entry->d_name);
+        bool isDir = entry->d_type == DT_DIR;
+        if (entry->d_type == DT_UNKNOWN)
         {
-            if ( event->mask & IN_MODIFY )
-            {
-                //find the watch descriptor
-                std::stringstream ss;
-                for (int k = 0; k < (int)state.handles.size(); ++k)
-                {
-                    auto wd = state.handles[k];
-                    if (wd != event->wd)
-                        continue;
-                    
-                    const auto& dirName = state.directories[k];
-                    ss << dirName;
-                    if (!dirName.empty() && dirName[dirName.size() - 1] != '/')
-                        ss << '/';
-                    break;
-                }
-                ss << event->name;
-                caughtFiles.insert(ss.str());
-            }
+            struct stat statbuf;
+            isDir = stat(path.c_str(), &statbuf) == 0 && S_ISDIR(statbuf.st_mode);
         }
-        i += sizeof(struct inotify_event) + event->len;
+
+        if (isDir)
+            watchTree(state, path, foundFiles);
+        else if (foundFiles != nullptr)
+            foundFiles->insert(path);
     }
-#endif
+    closedir(dir);
+    return true;
+}
 
-    if (!caughtFiles.empty())
+//Drops the watches of directory and everything below it, their paths are stale once it moved.
+void unwatchTree(FileWatchState& state, const std::string& directory)
+{
+    std::string prefix = joinPath(directory, "");
+    for (auto it = state.watchedDirs.begin(); it != state.watchedDirs.end();)
     {
-        for (auto* listener : state.listeners)
-            listener->onFilesChanged(caughtFiles);
+        if (it->second == directory || it->second.compare(0, prefix.size(), prefix) == 0)
+        {
+            inotify_rm_watch(state.inotifyInstance, it->first);
+            it = state.watchedDirs.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
     }
+}
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(millisecondsToWait));
+//Drains the inotify instance, returns true if there was anything to read.
+bool readEvents(FileWatchState& state, std::set<std::string>& caughtFiles)
+{
+    alignas(struct inotify_event) char eventBuffer[64 * 1024];
+    bool anyEvent = false;
+    while (true)
+    {
+        ssize_t bytesRead = ::read(state.inotifyInstance, eventBuffer, sizeof(eventBuffer));
+        if (bytesRead <= 0)
+            break;
 
-    return true;
+        anyEvent = true;
+        std::unique_lock lock(state.fileWatchMutex);
+        for (ssize_t i = 0; i < bytesRead; i += sizeof(struct inotify_event) + ((struct inotify_event*)&eventBuffer[i])->len)
+        {
+            auto* event = (struct inotify_event*)&eventBuffer[i];
+            if ((event->mask & IN_IGNORED) != 0)
+            {
+                state.watchedDirs.erase(event->wd);
+                continue;
+            }
+
+            auto dirIt = state.watchedDirs.find(event->wd);
+            if (dirIt == state.watchedDirs.end())
+                continue;
+
+            //Moves inside the tree are handled by the parents: the source drops its watches, the destination
+            //watches the directory again under its new path. Only the directories added with addDirectory have no
+            //watched parent, they get watched again in case something was moved in their place.
+            if ((event->mask & IN_MOVE_SELF) != 0)
+            {
+                std::string directory = dirIt->second;
+                unwatchTree(state, directory);
+                if (state.directoriesSet.count(directory) != 0)
+                    watchTree(state, directory, &caughtFiles);
+                continue;
+            }
+
+            if (event->len == 0)
+                continue;
+
+            std::string path = joinPath(dirIt->second, event->name);
+            if ((event->mask & IN_ISDIR) != 0)
+            {
+                if ((event->mask & IN_MOVED_FROM) != 0)
+                    unwatchTree(state, path);
+                else if ((event->mask & (IN_CREATE | IN_MOVED_TO)) != 0)
+                    watchTree(state, path, &caughtFiles);
+            }
+            //Creations count as changes too, they can shadow a file resolved through another root.
+            else if ((event->mask & (IN_MODIFY | IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO)) != 0)
+            {
+                caughtFiles.insert(path);
+            }
+        }
+    }
+    return anyEvent;
+}
+
+void notifyListeners(FileWatchState& state, const std::set<std::string>& caughtFiles)
+{
+    std::shared_lock lock(state.fileWatchMutex);
+    for (auto* listener : state.listeners)
+        listener->onFilesChanged(caughtFiles);
 }
 
+#endif
+
 }
 
 FileWatcher::FileWatcher(const FileWatchDesc& desc)
@@ -229,10 +400,20 @@ void FileWatcher::start()
     m_state = new FileWatchState;
 
 #ifdef __linux__
-    m_state->inotifyInstance = ::inotify_init();
+    m_state->inotifyInstance = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
     CPY_ASSERT(m_state->inotifyInstance != -1);
-    int hresult = fcntl(m_state->inotifyInstance, F_SETFL, O_NONBLOCK);
-    CPY_ASSERT(hresult == 0);
+    m_state->wakeEvent = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    CPY_ASSERT(m_state->wakeEvent != -1);
+    m_state->epollInstance = ::epoll_create1(EPOLL_CLOEXEC);
+    CPY_ASSERT(m_state->epollInstance != -1);
+    for (int fd : { m_state->inotifyInstance, m_state->wakeEvent })
+    {
+        struct epoll_event ev = {};
+        ev.events = EPOLLIN;
+        ev.data.fd = fd;
+        int result = epoll_ctl(m_state->epollInstance, EPOLL_CTL_ADD, fd, &ev);
+        CPY_ASSERT(result == 0);
+    }
 #endif
 
     m_state->thread = std::thread(
@@ -241,9 +422,11 @@ void FileWatcher::start()
         onFileListening();
     });
 
+#ifdef _WIN32
     FileWatchMessage msg;
     msg.type = FileWatchMessageType::ListenToDirectories;
     m_state->queue.push(msg);
+#endif
 }
 
 void FileWatcher::stop()
@@ -254,6 +437,10 @@ void FileWatcher::stop()
     FileWatchMessage msg;
     msg.type = FileWatchMessageType::Exit;
     m_state->queue.push(msg);
+#ifdef __linux__
+    uint64_t wake = 1;
+    ::write(m_state->wakeEvent, &wake, sizeof(wake));
+#endif
     m_state->thread.join();
 
 #ifdef _WIN32 
@@ -263,8 +450,9 @@ void FileWatcher::stop()
     for (auto e : m_state->events)
         CloseHandle((HANDLE)e);
 #elif defined(__linux__)
-    for (auto h : m_state->handles)
-        inotify_rm_watch(m_state->inotifyInstance, (int)h);
+    //Closing the instance drops all of its watches.
+    ::close(m_state->epollInstance);
+    ::close(m_state->wakeEvent);
     ::close(m_state->inotifyInstance);
 #endif
     
@@ -302,10 +490,29 @@ void FileWatcher::addDirectory(const char* directory)
     m_state->events.push_back(CreateEvent(NULL, TRUE, TRUE, NULL));
 #elif defined(__linux__)
     m_state->directories.push_back(dirStr);
-    int wd = inotify_add_watch(
-        m_state->inotifyInstance, directory, IN_MODIFY | IN_CREATE | IN_DELETE);
-    m_state->handles.push_back((WatchHandle)wd);
+    if (!watchTree(*m_state, dirStr, nullptr))
+        return;
 #endif
+
+    m_state->watchedRoots.push_back(absoluteWatchPath(dirStr));
+}
+
+bool FileWatcher::isWatched(const char* path)
+{
+    if (!m_state)
+        return false;
+
+    std::string absolutePath = absoluteWatchPath(path);
+    std::shared_lock lock(m_state->fileWatchMutex);
+    for (const auto& root : m_state->watchedRoots)
+    {
+        if (absolutePath.compare(0, root.size(), root) != 0)
+            continue;
+
+        if (absolutePath.size() == root.size() || absolutePath[root.size()] == '/' || root.back() == '/')
+            return true;
+    }
+    return false;
 }
 
 void FileWatcher::addListener(IFileWatchListener* listener)
@@ -328,6 +535,65 @@ void FileWatcher::removeListener(IFileWatchListener* listener)
     m_state->listeners.erase(it);
 }
 
+#ifdef __linux__
+void FileWatcher::onFileListening()
+{
+    using Clock = std::chrono::steady_clock;
+    std::set<std::string> pendingFiles;
+    Clock::time_point quietDeadline;
+    Clock::time_point flushDeadline;
+    bool active = true;
+
+    while (active)
+    {
+        int timeoutMS = -1;
+        if (!pendingFiles.empty())
+        {
+            auto remaining = std::min(quietDeadline, flushDeadline) - Clock::now();
+            timeoutMS = std::max(0, (int)std::chrono::ceil<std::chrono::milliseconds>(remaining).count());
+        }
+
+        struct epoll_event events[2];
+        int eventCount = epoll_wait(m_state->epollInstance, events, 2, timeoutMS);
+        for (int i = 0; i < eventCount; ++i)
+        {
+            if (events[i].data.fd == m_state->wakeEvent)
+            {
+                uint64_t wakeCount = 0;
+                ::read(m_state->wakeEvent, &wakeCount, sizeof(wakeCount));
+                continue;
+            }
+
+            bool wasEmpty = pendingFiles.empty();
+            if (readEvents(*m_state, pendingFiles))
+            {
+                //Saves come in bursts (temp file, rename, close), report them once things settle down.
+                auto now = Clock::now();
+                quietDeadline = now + std::chrono::milliseconds(m_desc.debounceMS);
+                if (wasEmpty)
+                    flushDeadline = now + std::chrono::milliseconds(4 * m_desc.debounceMS);
+            }
+        }
+
+        FileWatchMessage msg;
+        while (m_state->queue.tryPop(msg))
+        {
+            if (msg.type == FileWatchMessageType::Exit)
+                active = false;
+        }
+
+        //report changes that landed right before stopping.
+        if (!active)
+            readEvents(*m_state, pendingFiles);
+
+        if (!pendingFiles.empty() && (!active || Clock::now() >= std::min(quietDeadline, flushDeadline)))
+        {
+            notifyListeners(*m_state, pendingFiles);
+            pendingFiles.clear();
+        }
+    }
+}
+#else
 void FileWatcher::onFileListening()
 {
     bool active = true;
@@ -357,11 +623,14 @@ void FileWatcher::onFileListening()
         case FileWatchMessageType::Exit:
         default:
             {
+                //report changes that landed after the last poll.
+                waitListenForDirs(*m_state, 0);
                 active = false;
             }
         }
     }
 }
+#endif
 
 IFileWatcher* IFileWatcher::create(const FileWatchDesc& desc)
 {
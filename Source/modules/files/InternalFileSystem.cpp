@@ -2,6 +2,7 @@
 #include <coalpy.core/Assert.h>
 #include <sstream>
 #include <cstring>
+#include <algorithm>
 #include <coalpy.core/ClTokenizer.h>
 
 #ifdef _WIN32 
@@ -11,6 +12,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/stat.h>
+#include <sys/mman.h>
 #include <linux/limits.h>
 #include <fcntl.h>
 #include <dirent.h>
@@ -27,9 +29,13 @@ namespace InternalFileSystem
     struct WindowsFile
     {
         HANDLE h;
-        unsigned int fileSize;
+        unsigned long long fileSize;
         OVERLAPPED overlapped;
-        char buffer[bufferSize];
+        HANDLE mapping;
+        const void* view;
+        char* buffer;
+        int bufferSize;
+        unsigned long long modifiedTime;
     };
 
     bool valid(OpaqueFileHandle h)
@@ -37,7 +43,7 @@ namespace InternalFileSystem
         return h != nullptr;
     }
 
-    OpaqueFileHandle openFile(const char* filename, RequestType request)
+    OpaqueFileHandle openFile(const char* filename, RequestType request, bool truncate)
     {
         bool retry = true;
         UINT attempt = 0;
@@ -47,9 +53,9 @@ namespace InternalFileSystem
             h = CreateFileA(
                 filename, //file name
                 request == RequestType::Read ? GENERIC_READ : GENERIC_WRITE, //dwDesiredAccess
-                request == RequestType::Read ? (FILE_SHARE_READ | FILE_SHARE_WRITE) : 0u, //dwShareMode
+                request == RequestType::Read || !truncate ? (FILE_SHARE_READ | FILE_SHARE_WRITE) : 0u, //dwShareMode
                 NULL, //lpSecurityAttributes
-                request == RequestType::Read ? OPEN_EXISTING : CREATE_ALWAYS,//dwCreationDisposition
+                request == RequestType::Read ? OPEN_EXISTING : (truncate ? CREATE_ALWAYS : OPEN_ALWAYS),//dwCreationDisposition
                 FILE_ATTRIBUTE_NORMAL | FILE_FLAG_OVERLAPPED, //dwFlagsAndAttributes
                 NULL); //template attribute
 
@@ -68,8 +74,17 @@ namespace InternalFileSystem
 
         auto* wf = new WindowsFile;
         wf->h = h;
-        wf->fileSize = GetFileSize(wf->h, NULL);
+        LARGE_INTEGER fileSize = {};
+        GetFileSizeEx(wf->h, &fileSize);
+        wf->fileSize = (unsigned long long)fileSize.QuadPart;
         wf->overlapped = {};
+        wf->mapping = nullptr;
+        wf->view = nullptr;
+        wf->buffer = nullptr;
+        wf->bufferSize = 0;
+        FILETIME lastWrite = {};
+        GetFileTime(wf->h, NULL, NULL, &lastWrite);
+        wf->modifiedTime = ((unsigned long long)lastWrite.dwHighDateTime << 32) | (unsigned long long)lastWrite.dwLowDateTime;
         wf->overlapped.hEvent = CreateEvent(
             NULL, //default security attribute
             TRUE, //manual reset event
@@ -79,7 +94,7 @@ namespace InternalFileSystem
         return (OpaqueFileHandle)wf;
     }
 
-    bool readBytes(OpaqueFileHandle h, char*& outputBuffer, int& bytesRead, bool& isEof)
+    bool readBytes(OpaqueFileHandle h, int chunkSize, char*& outputBuffer, int& bytesRead, bool& isEof)
     {
         CPY_ASSERT(h != nullptr);
         isEof = false;
@@ -89,11 +104,18 @@ namespace InternalFileSystem
         auto* wf = (WindowsFile*)h;
         CPY_ASSERT(wf->h != INVALID_HANDLE_VALUE);
 
+        if (wf->bufferSize != chunkSize)
+        {
+            delete [] wf->buffer;
+            wf->buffer = new char[chunkSize];
+            wf->bufferSize = chunkSize;
+        }
+
         DWORD dwordBytesRead;
         bool result = ReadFile(
             wf->h,
             wf->buffer,
-            bufferSize,
+            (DWORD)chunkSize,
             &dwordBytesRead,
             &wf->overlapped);
 
@@ -144,9 +166,14 @@ namespace InternalFileSystem
             }
         }
 
+        unsigned long long offset = ((unsigned long long)wf->overlapped.OffsetHigh << 32) | wf->overlapped.Offset;
         if (result)
-            wf->overlapped.Offset += dwordBytesRead;
-        if (wf->overlapped.Offset >= wf->fileSize)
+        {
+            offset += dwordBytesRead;
+            wf->overlapped.Offset = (DWORD)offset;
+            wf->overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        }
+        if (offset >= wf->fileSize)
             isEof = true;
 
         bytesRead = (int)dwordBytesRead;
@@ -154,64 +181,166 @@ namespace InternalFileSystem
         return result;
     }
 
-    bool writeBytes(OpaqueFileHandle h, const char* buffer, int bufferSize)
+    bool writeAt(OpaqueFileHandle h, const char* buffer, unsigned long long size, unsigned long long offset)
     {
-        CPY_ASSERT(h != nullptr);
-        if (h == nullptr)
+        auto* wf = (WindowsFile*)h;
+        if (wf == nullptr || wf->h == INVALID_HANDLE_VALUE)
             return false;
 
+        //Own event so concurrent writes on the same handle don't wait on each other.
+        OVERLAPPED overlapped = {};
+        overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        bool result = true;
+        while (result && size > 0)
+        {
+            overlapped.Offset = (DWORD)offset;
+            overlapped.OffsetHigh = (DWORD)(offset >> 32);
+            //WriteFile takes a 32 bit size, bigger buffers go out in 1GB pieces.
+            DWORD dwordBytesWritten = 0;
+            DWORD chunkSize = (DWORD)std::min<unsigned long long>(size, 1ull << 30);
+            result = WriteFile(wf->h, buffer, chunkSize, &dwordBytesWritten, &overlapped);
+            if (!result && GetLastError() == ERROR_IO_PENDING)
+                result = GetOverlappedResult(wf->h, &overlapped, &dwordBytesWritten, TRUE);
+            result = result && dwordBytesWritten > 0;
+            buffer += dwordBytesWritten;
+            size -= dwordBytesWritten;
+            offset += dwordBytesWritten;
+        }
+        CloseHandle(overlapped.hEvent);
+        return result;
+    }
+
+    bool syncData(OpaqueFileHandle h)
+    {
         auto* wf = (WindowsFile*)h;
-        CPY_ASSERT(wf->h != INVALID_HANDLE_VALUE);
+        if (wf == nullptr || wf->h == INVALID_HANDLE_VALUE)
+            return false;
 
-        DWORD dwordBytesWritten;
-        bool result = WriteFile(
-            wf->h,
-            buffer,
-            (DWORD)bufferSize,
-            &dwordBytesWritten,
-            &wf->overlapped);
+        return FlushFileBuffers(wf->h) != 0;
+    }
 
-        if (!result)
+    unsigned long long fileSize(OpaqueFileHandle h)
+    {
+        auto* wf = (WindowsFile*)h;
+        return wf == nullptr ? 0ull : wf->fileSize;
+    }
+
+    unsigned long long modifiedTime(OpaqueFileHandle h)
+    {
+        auto* wf = (WindowsFile*)h;
+        return wf == nullptr ? 0ull : wf->modifiedTime;
+    }
+
+    int posixHandle(OpaqueFileHandle h)
+    {
+        return -1;
+    }
+
+    bool readAll(OpaqueFileHandle h, char* buffer, unsigned long long size)
+    {
+        auto* wf = (WindowsFile*)h;
+        if (wf == nullptr || wf->h == INVALID_HANDLE_VALUE)
+            return false;
+
+        //ReadFile takes 32 bit sizes, big files take several calls.
+        const unsigned long long maxRead = 1ull << 30;
+        unsigned long long offset = 0;
+        while (offset < size)
         {
-            auto dwError = GetLastError();
-            switch (dwError)
+            OVERLAPPED overlapped = {};
+            overlapped.Offset = (DWORD)offset;
+            overlapped.OffsetHigh = (DWORD)(offset >> 32);
+            overlapped.hEvent = wf->overlapped.hEvent;
+            DWORD dwordBytesRead = 0;
+            DWORD readSize = (DWORD)(size - offset > maxRead ? maxRead : size - offset);
+            if (!ReadFile(wf->h, buffer + offset, readSize, &dwordBytesRead, &overlapped))
             {
-            case ERROR_IO_PENDING:
-                {
-                    bool overlappedSuccess = GetOverlappedResult(wf->h,
-                                                  &wf->overlapped,
-                                                  &dwordBytesWritten,
-                                                  TRUE); 
-                    if (!overlappedSuccess)
-                    {
-                        result = false;
-                    }
-                    else
-                    {
-                        result = true;
-                        ResetEvent(wf->overlapped.hEvent);
-                    }
-
-                    break;
-                }
-            default:
-                //file IO issue occured here
-                result = false;
+                if (GetLastError() != ERROR_IO_PENDING || !GetOverlappedResult(wf->h, &overlapped, &dwordBytesRead, TRUE))
+                    return false;
+                ResetEvent(wf->overlapped.hEvent);
             }
+
+            if (dwordBytesRead == 0)
+                return false;
+            offset += dwordBytesRead;
         }
+        return true;
+    }
 
-        if (bufferSize != dwordBytesWritten)
+    bool readAt(OpaqueFileHandle h, char* buffer, unsigned int size, unsigned long long offset, int& bytesRead)
+    {
+        auto* wf = (WindowsFile*)h;
+        if (wf == nullptr || wf->h == INVALID_HANDLE_VALUE)
             return false;
 
+        //Own event so concurrent reads on the same handle don't wait on each other.
+        OVERLAPPED overlapped = {};
+        overlapped.Offset = (DWORD)offset;
+        overlapped.OffsetHigh = (DWORD)(offset >> 32);
+        overlapped.hEvent = CreateEvent(NULL, TRUE, FALSE, NULL);
+        DWORD dwordBytesRead = 0;
+        bool result = ReadFile(wf->h, buffer, (DWORD)size, &dwordBytesRead, &overlapped);
+        if (!result && GetLastError() == ERROR_IO_PENDING)
+            result = GetOverlappedResult(wf->h, &overlapped, &dwordBytesRead, TRUE);
+        if (!result && GetLastError() == ERROR_HANDLE_EOF)
+            result = true;
+        CloseHandle(overlapped.hEvent);
+
+        bytesRead = (int)dwordBytesRead;
         return result;
     }
 
+    void adviseSequential(OpaqueFileHandle h)
+    {
+    }
+
+    void adviseWillNeed(OpaqueFileHandle h, unsigned long long offset, unsigned int size)
+    {
+    }
+
+    bool mapFile(OpaqueFileHandle h, const char*& outView)
+    {
+        auto* wf = (WindowsFile*)h;
+        if (wf == nullptr || wf->h == INVALID_HANDLE_VALUE)
+            return false;
+
+        //Mapping an empty file fails, there is nothing to map anyway.
+        if (wf->fileSize == 0)
+        {
+            outView = "";
+            return true;
+        }
+
+        if (wf->view == nullptr)
+        {
+            wf->mapping = CreateFileMappingA(wf->h, NULL, PAGE_READONLY, 0, 0, NULL);
+            if (wf->mapping == nullptr)
+                return false;
+
+            wf->view = MapViewOfFile(wf->mapping, FILE_MAP_READ, 0, 0, 0);
+            if (wf->view == nullptr)
+            {
+                CloseHandle(wf->mapping);
+                wf->mapping = nullptr;
+                return false;
+            }
+        }
+
+        outView = (const char*)wf->view;
+        return true;
+    }
+
     void close(OpaqueFileHandle& h)
     {
         CPY_ASSERT(h != nullptr);
         auto* wf = (WindowsFile*)h;
         CPY_ASSERT(wf->h != INVALID_HANDLE_VALUE);
+        if (wf->view != nullptr)
+            UnmapViewOfFile(wf->view);
+        if (wf->mapping != nullptr)
+            CloseHandle(wf->mapping);
         CloseHandle(wf->h);
+        delete [] wf->buffer;
         CloseHandle(wf->overlapped.hEvent);
         h = {};
         delete wf;
@@ -373,9 +502,12 @@ namespace InternalFileSystem
     struct PosixFile 
     {
         int h;
-        unsigned int fileSize;
-        ssize_t offset;
-        char buffer[bufferSize];
+        unsigned long long fileSize;
+        unsigned long long offset;
+        void* view;
+        char* buffer;
+        int bufferSize;
+        unsigned long long modifiedTime;
     };
 
     bool valid(OpaqueFileHandle h)
@@ -383,9 +515,10 @@ namespace InternalFileSystem
         return (PosixFile*)h != nullptr;
     }
 
-    OpaqueFileHandle openFile(const char* filename, RequestType request)
+    OpaqueFileHandle openFile(const char* filename, RequestType request, bool truncate)
     {
-        int fd = ::open(filename, request == InternalFileSystem::Read ? O_RDONLY : (O_CREAT | O_TRUNC | O_WRONLY ), S_IRUSR | S_IWUSR);
+        int writeFlags = O_CREAT | O_WRONLY | (truncate ? O_TRUNC : 0);
+        int fd = ::open(filename, request == InternalFileSystem::Read ? O_RDONLY : writeFlags, S_IRUSR | S_IWUSR);
 
         if (fd == -1)
             return nullptr;
@@ -397,35 +530,157 @@ namespace InternalFileSystem
             ::close(fd);
             return nullptr;
         }
-        auto* pf = new PosixFile { fd, (unsigned)statbuf.st_size, 0u };
+        auto* pf = new PosixFile { fd, (unsigned long long)statbuf.st_size, 0ull, nullptr, nullptr, 0,
+            (unsigned long long)statbuf.st_mtim.tv_sec * 1000000000ull + (unsigned long long)statbuf.st_mtim.tv_nsec };
         return (OpaqueFileHandle)pf;
     }
 
-    bool readBytes(OpaqueFileHandle h, char*& outputBuffer, int& bytesRead, bool& isEof)
+    bool readBytes(OpaqueFileHandle h, int chunkSize, char*& outputBuffer, int& bytesRead, bool& isEof)
     {
         auto* pf = (PosixFile*)h;
         if (pf == nullptr || pf->h == -1)
             return false;
 
-        ssize_t preadBytes = pread(pf->h, pf->buffer, std::min((ssize_t)bufferSize, pf->fileSize - pf->offset), pf->offset);
+        if (pf->bufferSize != chunkSize)
+        {
+            delete [] pf->buffer;
+            pf->buffer = new char[chunkSize];
+            pf->bufferSize = chunkSize;
+        }
+
+        size_t readSize = (size_t)std::min((unsigned long long)chunkSize, pf->fileSize - std::min(pf->offset, pf->fileSize));
+        ssize_t preadBytes = pread(pf->h, pf->buffer, readSize, (off_t)pf->offset);
         if (preadBytes == -1)
             return false;
 
-        pf->offset += preadBytes;
-        bytesRead = preadBytes;
+        pf->offset += (unsigned long long)preadBytes;
+        bytesRead = (int)preadBytes;
         outputBuffer = pf->buffer;
         isEof = pf->offset >= pf->fileSize;
         return true;
     }
 
-    bool writeBytes(OpaqueFileHandle h, const char* buffer, int bufferSize)
+    bool writeAt(OpaqueFileHandle h, const char* buffer, unsigned long long size, unsigned long long offset)
     {
         auto* pf = (PosixFile*)h;
         if (pf == nullptr || pf->h == -1)
             return false;
-        
-        ssize_t pwriteBytes = pwrite(pf->h, buffer, (size_t)bufferSize, 0u);
-        return pwriteBytes != -1;
+
+        while (size > 0)
+        {
+            ssize_t pwriteBytes = pwrite(pf->h, buffer, (size_t)size, (off_t)offset);
+            if (pwriteBytes == -1 && errno == EINTR)
+                continue;
+            if (pwriteBytes <= 0)
+                return false;
+
+            buffer += pwriteBytes;
+            size -= (unsigned long long)pwriteBytes;
+            offset += (unsigned long long)pwriteBytes;
+        }
+        return true;
+    }
+
+    bool syncData(OpaqueFileHandle h)
+    {
+        auto* pf = (PosixFile*)h;
+        if (pf == nullptr || pf->h == -1)
+            return false;
+
+        return fdatasync(pf->h) == 0;
+    }
+
+    unsigned long long fileSize(OpaqueFileHandle h)
+    {
+        auto* pf = (PosixFile*)h;
+        return pf == nullptr ? 0ull : pf->fileSize;
+    }
+
+    unsigned long long modifiedTime(OpaqueFileHandle h)
+    {
+        auto* pf = (PosixFile*)h;
+        return pf == nullptr ? 0ull : pf->modifiedTime;
+    }
+
+    int posixHandle(OpaqueFileHandle h)
+    {
+        auto* pf = (PosixFile*)h;
+        return pf == nullptr ? -1 : pf->h;
+    }
+
+    bool readAll(OpaqueFileHandle h, char* buffer, unsigned long long size)
+    {
+        auto* pf = (PosixFile*)h;
+        if (pf == nullptr || pf->h == -1)
+            return false;
+
+        //pread stops at about 2gb per call, the loop picks up the rest.
+        unsigned long long offset = 0;
+        while (offset < size)
+        {
+            ssize_t preadBytes = pread(pf->h, buffer + offset, (size_t)(size - offset), (off_t)offset);
+            if (preadBytes == -1 && errno == EINTR)
+                continue;
+            if (preadBytes <= 0)
+                return false;
+            offset += (unsigned long long)preadBytes;
+        }
+        return true;
+    }
+
+    bool readAt(OpaqueFileHandle h, char* buffer, unsigned int size, unsigned long long offset, int& bytesRead)
+    {
+        auto* pf = (PosixFile*)h;
+        if (pf == nullptr || pf->h == -1)
+            return false;
+
+        ssize_t preadBytes;
+        do
+        {
+            preadBytes = pread(pf->h, buffer, size, (off_t)offset);
+        } while (preadBytes == -1 && errno == EINTR);
+
+        bytesRead = preadBytes < 0 ? 0 : (int)preadBytes;
+        return preadBytes != -1;
+    }
+
+    void adviseSequential(OpaqueFileHandle h)
+    {
+        auto* pf = (PosixFile*)h;
+        if (pf != nullptr && pf->h != -1)
+            posix_fadvise(pf->h, 0, 0, POSIX_FADV_SEQUENTIAL);
+    }
+
+    void adviseWillNeed(OpaqueFileHandle h, unsigned long long offset, unsigned int size)
+    {
+        auto* pf = (PosixFile*)h;
+        if (pf != nullptr && pf->h != -1)
+            posix_fadvise(pf->h, (off_t)offset, (off_t)size, POSIX_FADV_WILLNEED);
+    }
+
+    bool mapFile(OpaqueFileHandle h, const char*& outView)
+    {
+        auto* pf = (PosixFile*)h;
+        if (pf == nullptr || pf->h == -1)
+            return false;
+
+        //mmap refuses empty ranges, there is nothing to map anyway.
+        if (pf->fileSize == 0)
+        {
+            outView = "";
+            return true;
+        }
+
+        if (pf->view == nullptr)
+        {
+            void* view = mmap(nullptr, pf->fileSize, PROT_READ, MAP_PRIVATE, pf->h, 0);
+            if (view == MAP_FAILED)
+                return false;
+            pf->view = view;
+        }
+
+        outView = (const char*)pf->view;
+        return true;
     }
 
     void close(OpaqueFileHandle& h)
@@ -434,6 +689,9 @@ namespace InternalFileSystem
         if (pf == nullptr)
             return;
 
+        if (pf->view != nullptr)
+            munmap(pf->view, pf->fileSize);
+        delete [] pf->buffer;
         ::close(pf->h);
         delete pf;
         h = {};
@@ -580,8 +838,8 @@ namespace InternalFileSystem
             if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
                 continue;
 
-            // determinate a full path of an entry
-            full_path = (char*)calloc(path_len + strlen(entry->d_name) + 1, sizeof(char));
+            // determinate a full path of an entry, room for the separator and the terminator
+            full_path = (char*)calloc(path_len + strlen(entry->d_name) + 2, sizeof(char));
             strcpy(full_path, path.c_str());
             strcat(full_path, "/");
             strcat(full_path, entry->d_name);
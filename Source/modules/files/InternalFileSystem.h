@@ -11,7 +11,7 @@ namespace InternalFileSystem
 {
     enum
     {
-        bufferSize = 16 * 1024 //16kb buffer size
+        defaultChunkSize = 16 * 1024 //16kb chunks unless a request asks for another size
     };
 
     enum RequestType
@@ -32,11 +32,38 @@ namespace InternalFileSystem
 
     bool valid(OpaqueFileHandle h);
 
-    OpaqueFileHandle openFile(const char* filename, RequestType request);
+    //Writes truncate the file unless truncate is false, the file gets created if missing either way.
+    OpaqueFileHandle openFile(const char* filename, RequestType request, bool truncate = true);
 
-    bool readBytes(OpaqueFileHandle h, char*& outputBuffer, int& bytesRead, bool& isEof);
+    //Reads the next chunkSize bytes into a buffer owned by the handle, reallocated when chunkSize changes.
+    bool readBytes(OpaqueFileHandle h, int chunkSize, char*& outputBuffer, int& bytesRead, bool& isEof);
 
-    bool writeBytes(OpaqueFileHandle h, const char* buffer, int bufferSize);
+    //Positional write of all of buffer, safe to issue concurrently on the same handle for different ranges.
+    bool writeAt(OpaqueFileHandle h, const char* buffer, unsigned long long size, unsigned long long offset);
+
+    //Flushes written data to the device (fdatasync).
+    bool syncData(OpaqueFileHandle h);
+
+    unsigned long long fileSize(OpaqueFileHandle h);
+
+    //Last write time captured when the file got opened, in platform ticks. Only meant for equality checks.
+    unsigned long long modifiedTime(OpaqueFileHandle h);
+
+    //File descriptor on linux, -1 elsewhere.
+    int posixHandle(OpaqueFileHandle h);
+
+    //Reads the first size bytes of the file into buffer, bypassing the internal chunk buffer.
+    bool readAll(OpaqueFileHandle h, char* buffer, unsigned long long size);
+
+    //Positional read, safe to issue concurrently on the same handle. bytesRead is 0 at the end of the file.
+    bool readAt(OpaqueFileHandle h, char* buffer, unsigned int size, unsigned long long offset, int& bytesRead);
+
+    //Readahead hints for the OS page cache, no-ops where the platform has no equivalent.
+    void adviseSequential(OpaqueFileHandle h);
+    void adviseWillNeed(OpaqueFileHandle h, unsigned long long offset, unsigned int size);
+
+    //Read only view of the whole file, unmapped by close.
+    bool mapFile(OpaqueFileHandle h, const char*& outView);
 
     void close(OpaqueFileHandle& h);
 
@@ -0,0 +1,354 @@
+#include "IoRing.h"
+#include <coalpy.tasks/ITaskSystem.h>
+#include <coalpy.core/Assert.h>
+#include <algorithm>
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#define COALPY_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#include <errno.h>
+#include <string.h>
+#endif
+
+namespace coalpy
+{
+
+#if COALPY_IO_URING
+
+namespace
+{
+
+int ringSetup(unsigned entries, io_uring_params& params)
+{
+    return (int)syscall(__NR_io_uring_setup, entries, &params);
+}
+
+int ringEnter(int ringFd, unsigned toSubmit, unsigned minComplete, unsigned flags)
+{
+    return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, nullptr, 0);
+}
+
+int ringRegister(int ringFd, unsigned opcode, const void* args, unsigned argCount)
+{
+    return (int)syscall(__NR_io_uring_register, ringFd, opcode, args, argCount);
+}
+
+//IORING_OP_READ needs kernel 5.6, the ring itself can be set up on older ones.
+//The probe arrived in 5.6 too, so failing to register it also means plain reads are missing.
+bool ringSupportsRead(int ringFd)
+{
+    const unsigned opCount = IORING_OP_LAST;
+    std::vector<char> storage(sizeof(io_uring_probe) + opCount * sizeof(io_uring_probe_op), 0);
+    auto* probe = (io_uring_probe*)storage.data();
+    if (ringRegister(ringFd, IORING_REGISTER_PROBE, probe, opCount) < 0)
+        return false;
+
+    return IORING_OP_READ <= probe->last_op && (probe->ops[IORING_OP_READ].flags & IO_URING_OP_SUPPORTED) != 0;
+}
+
+unsigned* ringField(void* ring, unsigned offset)
+{
+    return (unsigned*)((char*)ring + offset);
+}
+
+}
+
+IoRing::IoRing(ITaskSystem& ts)
+: m_ts(ts)
+, m_inFlight(0)
+, m_exiting(false)
+{
+}
+
+IoRing* IoRing::create(ITaskSystem& ts)
+{
+    auto* ring = new IoRing(ts);
+    if (!ring->init())
+    {
+        delete ring;
+        return nullptr;
+    }
+    return ring;
+}
+
+bool IoRing::init()
+{
+    io_uring_params params = {};
+    m_ringFd = ringSetup(QueueDepth, params);
+    if (m_ringFd < 0 || !ringSupportsRead(m_ringFd))
+        return false;
+
+    m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    bool singleMmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+    if (singleMmap)
+        m_sqRingSize = m_cqRingSize = std::max(m_sqRingSize, m_cqRingSize);
+
+    m_sqRing = mmap(nullptr, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+    if (m_sqRing == MAP_FAILED)
+    {
+        m_sqRing = nullptr;
+        return false;
+    }
+
+    if (singleMmap)
+    {
+        m_cqRing = m_sqRing;
+    }
+    else
+    {
+        m_cqRing = mmap(nullptr, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+        if (m_cqRing == MAP_FAILED)
+        {
+            m_cqRing = nullptr;
+            return false;
+        }
+    }
+
+    m_sqesSize = params.sq_entries * sizeof(io_uring_sqe);
+    m_sqes = mmap(nullptr, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+    if (m_sqes == MAP_FAILED)
+    {
+        m_sqes = nullptr;
+        return false;
+    }
+
+    m_sqHead = ringField(m_sqRing, params.sq_off.head);
+    m_sqTail = ringField(m_sqRing, params.sq_off.tail);
+    m_sqMask = ringField(m_sqRing, params.sq_off.ring_mask);
+    m_sqArray = ringField(m_sqRing, params.sq_off.array);
+    m_sqEntries = params.sq_entries;
+    m_cqHead = ringField(m_cqRing, params.cq_off.head);
+    m_cqTail = ringField(m_cqRing, params.cq_off.tail);
+    m_cqMask = ringField(m_cqRing, params.cq_off.ring_mask);
+    m_cqes = (char*)m_cqRing + params.cq_off.cqes;
+    m_cqEntries = params.cq_entries;
+
+    //Page aligned so the kernel pins whole pages. If registering fails (memlock limits) the buffers
+    //are still handed out, they just get read into like any other memory.
+    const size_t pageSize = 4096;
+    m_bufferMemory = std::unique_ptr<char[]>(new char[(size_t)ChunkSize * RegisteredBufferCount + pageSize]);
+    m_buffers = (char*)(((uintptr_t)m_bufferMemory.get() + pageSize - 1) & ~(uintptr_t)(pageSize - 1));
+    iovec iovecs[RegisteredBufferCount];
+    for (int i = 0; i < RegisteredBufferCount; ++i)
+    {
+        iovecs[i].iov_base = m_buffers + (size_t)i * ChunkSize;
+        iovecs[i].iov_len = ChunkSize;
+        m_freeBuffers.push_back(RegisteredBufferCount - 1 - i);
+    }
+    m_buffersRegistered = ringRegister(m_ringFd, IORING_REGISTER_BUFFERS, iovecs, RegisteredBufferCount) == 0;
+
+    m_reaper = std::thread([this]() { reaperLoop(); });
+    return true;
+}
+
+IoRing::~IoRing()
+{
+    if (m_reaper.joinable())
+    {
+        //A nop without an op tells the reaper to exit, every read submitted before it has completed by then.
+        bool pushed = false;
+        while (!pushed)
+        {
+            std::unique_lock lock(m_submitMutex);
+            pushed = pushSqe(nullptr, true);
+            if (!pushed)
+                std::this_thread::yield();
+        }
+        m_reaper.join();
+    }
+
+    if (m_sqes)
+        munmap(m_sqes, m_sqesSize);
+    if (m_cqRing && m_cqRing != m_sqRing)
+        munmap(m_cqRing, m_cqRingSize);
+    if (m_sqRing)
+        munmap(m_sqRing, m_sqRingSize);
+    if (m_ringFd >= 0)
+        close(m_ringFd);
+}
+
+bool IoRing::pushSqe(const ReadOp* op, bool nop)
+{
+    //No SQPOLL, so the kernel only consumes entries inside io_uring_enter, which we call under the same lock.
+    unsigned tail = *m_sqTail;
+    unsigned head = __atomic_load_n(m_sqHead, __ATOMIC_ACQUIRE);
+    if (tail - head >= m_sqEntries || m_inFlight.load() >= m_cqEntries)
+        return false;
+
+    unsigned index = tail & *m_sqMask;
+    auto& sqe = ((io_uring_sqe*)m_sqes)[index];
+    memset(&sqe, 0, sizeof(sqe));
+    if (nop)
+    {
+        sqe.opcode = IORING_OP_NOP;
+        sqe.user_data = 0;
+    }
+    else
+    {
+        bool fixed = m_buffersRegistered && op->bufferIndex >= 0;
+        sqe.opcode = fixed ? IORING_OP_READ_FIXED : IORING_OP_READ;
+        sqe.fd = op->fd;
+        sqe.addr = (unsigned long long)(uintptr_t)op->buffer;
+        sqe.len = op->size;
+        sqe.off = op->offset;
+        sqe.buf_index = fixed ? (unsigned short)op->bufferIndex : 0;
+        sqe.user_data = (unsigned long long)(uintptr_t)op;
+    }
+    m_sqArray[index] = index;
+    __atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+    int submitted;
+    do
+    {
+        submitted = ringEnter(m_ringFd, 1, 0, 0);
+    } while (submitted < 0 && errno == EINTR);
+
+    if (submitted != 1)
+    {
+        //The kernel did not take it, nothing else can have been queued behind it.
+        __atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+        return false;
+    }
+
+    m_inFlight.fetch_add(1);
+    return true;
+}
+
+bool IoRing::read(ReadOp& op)
+{
+    bool submitted = false;
+    {
+        std::unique_lock lock(m_submitMutex);
+        submitted = pushSqe(&op, false);
+    }
+
+    if (!submitted)
+    {
+        readSync(op);
+        return true;
+    }
+
+    //Reads hitting the page cache complete inside the submit call, reaping them here saves waking the reaper.
+    std::unique_lock lock(m_completionMutex, std::try_to_lock);
+    return lock.owns_lock() && reapCompletions(&op);
+}
+
+void IoRing::readSync(ReadOp& op)
+{
+    ssize_t bytesRead;
+    do
+    {
+        bytesRead = pread(op.fd, op.buffer, op.size, (off_t)op.offset);
+    } while (bytesRead < 0 && errno == EINTR);
+
+    op.result = bytesRead < 0 ? -errno : (int)bytesRead;
+    m_ts.signal(op.signal);
+}
+
+void IoRing::reaperLoop()
+{
+    while (!m_exiting.load())
+    {
+        int waited = ringEnter(m_ringFd, 0, 1, IORING_ENTER_GETEVENTS);
+        if (waited < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY)
+        {
+            CPY_ERROR_MSG(false, "io_uring wait failed, io ring reaper exiting.");
+            break;
+        }
+
+        std::unique_lock lock(m_completionMutex);
+        reapCompletions(nullptr);
+    }
+}
+
+bool IoRing::reapCompletions(const ReadOp* ownOp)
+{
+    bool ownOpReaped = false;
+    unsigned head = *m_cqHead;
+    unsigned tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+    for (; head != tail; ++head)
+    {
+        const auto& cqe = ((const io_uring_cqe*)m_cqes)[head & *m_cqMask];
+        auto* op = (ReadOp*)(uintptr_t)cqe.user_data;
+        int result = cqe.res;
+        __atomic_store_n(m_cqHead, head + 1, __ATOMIC_RELEASE);
+        m_inFlight.fetch_sub(1);
+
+        if (op == nullptr)
+        {
+            m_exiting = true;
+            continue;
+        }
+
+        ownOpReaped = ownOpReaped || op == ownOp;
+
+        //Once signalled, the op belongs to whoever awaited it.
+        op->result = result;
+        m_ts.signal(op->signal);
+    }
+
+    return ownOpReaped;
+}
+
+int IoRing::acquireBuffer(char*& outBuffer)
+{
+    std::unique_lock lock(m_buffersMutex);
+    if (m_freeBuffers.empty())
+        return -1;
+
+    int bufferIndex = m_freeBuffers.back();
+    m_freeBuffers.pop_back();
+    outBuffer = m_buffers + (size_t)bufferIndex * ChunkSize;
+    return bufferIndex;
+}
+
+void IoRing::releaseBuffer(int bufferIndex)
+{
+    if (bufferIndex < 0)
+        return;
+
+    std::unique_lock lock(m_buffersMutex);
+    m_freeBuffers.push_back(bufferIndex);
+}
+
+#else
+
+IoRing::IoRing(ITaskSystem& ts)
+: m_ts(ts)
+, m_inFlight(0)
+, m_exiting(false)
+{
+}
+
+IoRing::~IoRing()
+{
+}
+
+IoRing* IoRing::create(ITaskSystem& ts)
+{
+    return nullptr;
+}
+
+bool IoRing::read(ReadOp& op)
+{
+    CPY_ASSERT_MSG(false, "io_uring is not available on this platform.");
+    return false;
+}
+
+int IoRing::acquireBuffer(char*& outBuffer)
+{
+    return -1;
+}
+
+void IoRing::releaseBuffer(int bufferIndex)
+{
+}
+
+#endif
+
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <coalpy.tasks/TaskDefs.h>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <vector>
+#include <memory>
+
+namespace coalpy
+{
+
+class ITaskSystem;
+
+//Linux io_uring read engine, talks to the kernel through raw syscalls (no liburing).
+//Reads get submitted from any thread and a single reaper thread completes them by signalling
+//the op's task (TaskFlags::External), so whoever awaits it resumes through the task system.
+//create returns null if io_uring is not available (other platforms, kernels older than 5.6 without
+//IORING_OP_READ, seccomp), callers then read with pread.
+class IoRing
+{
+public:
+    enum
+    {
+        //Size of a read and of each registered buffer.
+        ChunkSize = 1024 * 1024,
+        //Largest single read, whole file reads of bigger files take several. Linux stops short of 2gb per read anyway.
+        MaxReadSize = 1024 * 1024 * 1024,
+        RegisteredBufferCount = 8,
+        QueueDepth = 256
+    };
+
+    struct ReadOp
+    {
+        Task signal;
+        int fd = -1;
+        char* buffer = nullptr;
+        //Index of the registered buffer holding buffer, -1 for plain memory.
+        int bufferIndex = -1;
+        unsigned int size = 0;
+        unsigned long long offset = 0;
+        //Bytes read or -errno, valid once signal finished.
+        int result = 0;
+    };
+
+    static IoRing* create(ITaskSystem& ts);
+    ~IoRing();
+
+    //op must stay alive until op.signal finishes. Reads synchronously with pread if the ring is full.
+    //Returns true if the read already completed and op.signal finished on the calling thread.
+    bool read(ReadOp& op);
+
+    //Registered buffers are ChunkSize bytes and get pinned once by the kernel.
+    //Returns -1 when all of them are in use, callers then read into their own memory.
+    int acquireBuffer(char*& outBuffer);
+    void releaseBuffer(int bufferIndex);
+
+private:
+    IoRing(ITaskSystem& ts);
+    bool init();
+    bool pushSqe(const ReadOp* op, bool nop);
+    void reaperLoop();
+    //Returns true if ownOp was among the completions.
+    bool reapCompletions(const ReadOp* ownOp);
+    void readSync(ReadOp& op);
+
+    ITaskSystem& m_ts;
+    int m_ringFd = -1;
+
+    void* m_sqRing = nullptr;
+    void* m_cqRing = nullptr;
+    size_t m_sqRingSize = 0;
+    size_t m_cqRingSize = 0;
+    void* m_sqes = nullptr;
+    size_t m_sqesSize = 0;
+
+    unsigned* m_sqHead = nullptr;
+    unsigned* m_sqTail = nullptr;
+    unsigned* m_sqMask = nullptr;
+    unsigned* m_sqArray = nullptr;
+    unsigned m_sqEntries = 0;
+    unsigned* m_cqHead = nullptr;
+    unsigned* m_cqTail = nullptr;
+    unsigned* m_cqMask = nullptr;
+    void* m_cqes = nullptr;
+    unsigned m_cqEntries = 0;
+
+    std::mutex m_submitMutex;
+    //Reads the kernel still owes a completion for, kept below the completion queue size.
+    std::atomic<unsigned> m_inFlight;
+    //Taken by the reaper, and opportunistically by submitters, to consume completions.
+    std::mutex m_completionMutex;
+    std::atomic<bool> m_exiting;
+
+    std::unique_ptr<char[]> m_bufferMemory;
+    char* m_buffers = nullptr;
+    bool m_buffersRegistered = false;
+    std::mutex m_buffersMutex;
+    std::vector<int> m_freeBuffers;
+
+    std::thread m_reaper;
+};
+
+}
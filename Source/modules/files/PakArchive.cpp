@@ -0,0 +1,250 @@
+#include "PakArchive.h"
+#include <coalpy.files/PakDefs.h>
+#include <coalpy.files/Utils.h>
+#include <zlib.h>
+#include <algorithm>
+#include <vector>
+
+namespace coalpy
+{
+
+std::shared_ptr<PakArchive> PakArchive::open(const std::string& path)
+{
+    auto handle = InternalFileSystem::openFile(path.c_str(), InternalFileSystem::RequestType::Read);
+    if (!InternalFileSystem::valid(handle))
+        return nullptr;
+
+    const char* view = nullptr;
+    unsigned long long fileSize = InternalFileSystem::fileSize(handle);
+    if (fileSize < sizeof(PakHeader) || !InternalFileSystem::mapFile(handle, view))
+    {
+        InternalFileSystem::close(handle);
+        return nullptr;
+    }
+
+    std::shared_ptr<PakArchive> archive(new PakArchive);
+    archive->m_handle = handle;
+    archive->m_view = view;
+    archive->m_modifiedTime = InternalFileSystem::modifiedTime(handle);
+    FileUtils::getAbsolutePath(path, archive->m_path);
+
+    const auto& header = *(const PakHeader*)view;
+    unsigned long long namesOffset = sizeof(PakHeader) + (unsigned long long)header.entryCount * sizeof(PakTocEntry);
+    if (header.magic != Magic || header.version != Version || namesOffset + header.namesSize > fileSize)
+        return nullptr;
+
+    archive->m_toc = (const PakTocEntry*)(view + sizeof(PakHeader));
+    archive->m_names = view + namesOffset;
+    archive->m_entryCount = header.entryCount;
+
+    //Everything after this gets trusted by the reads.
+    for (uint32_t i = 0; i < header.entryCount; ++i)
+    {
+        const auto& e = archive->m_toc[i];
+        if ((unsigned long long)e.nameOffset + e.nameSize > header.namesSize
+            || e.dataOffset + e.storedSize > fileSize
+            || ((e.flags & CompressedFlag) == 0 && e.storedSize != e.size)
+            || (i > 0 && archive->name(i - 1) >= archive->name(i)))
+            return nullptr;
+    }
+
+    return archive;
+}
+
+PakArchive::~PakArchive()
+{
+    if (InternalFileSystem::valid(m_handle))
+        InternalFileSystem::close(m_handle);
+}
+
+int PakArchive::find(std::string_view name) const
+{
+    int lo = 0;
+    int hi = (int)m_entryCount;
+    while (lo < hi)
+    {
+        int mid = lo + (hi - lo) / 2;
+        int cmp = this->name(mid).compare(name);
+        if (cmp == 0)
+            return mid;
+        if (cmp < 0)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return -1;
+}
+
+bool PakArchive::decompress(int index, char* output) const
+{
+    const auto& e = m_toc[index];
+    uLongf destSize = (uLongf)e.size;
+    int result = uncompress((Bytef*)output, &destSize, (const Bytef*)data(index), (uLong)e.storedSize);
+    return result == Z_OK && destSize == (uLongf)e.size;
+}
+
+namespace PakUtils
+{
+
+void entryName(const std::string& path, std::string& outName)
+{
+    outName = path;
+    std::replace(outName.begin(), outName.end(), '\\', '/');
+    size_t start = 0;
+    while (outName.compare(start, 2, "./") == 0)
+        start += 2;
+    outName.erase(0, start);
+}
+
+namespace
+{
+
+void collectDirectory(const std::string& directory, const std::string& prefix, std::vector<PakBuildEntry>& outEntries)
+{
+    std::vector<std::string> files;
+    InternalFileSystem::enumerateFiles(directory, files);
+    for (auto& f : files)
+    {
+        bool exists, isDir, isDots;
+        InternalFileSystem::getAttributes(f, exists, isDir, isDots);
+        if (!exists || isDots)
+            continue;
+
+        std::string fileName;
+        InternalFileSystem::getFileName(f, fileName);
+        if (isDir)
+            collectDirectory(f, prefix + fileName + "/", outEntries);
+        else
+            outEntries.push_back(PakBuildEntry { prefix + fileName, f });
+    }
+}
+
+bool readSource(const std::string& path, std::vector<char>& output)
+{
+    auto handle = InternalFileSystem::openFile(path.c_str(), InternalFileSystem::RequestType::Read);
+    if (!InternalFileSystem::valid(handle))
+        return false;
+
+    output.resize(InternalFileSystem::fileSize(handle));
+    bool success = output.empty() || InternalFileSystem::readAll(handle, output.data(), (unsigned int)output.size());
+    InternalFileSystem::close(handle);
+    return success;
+}
+
+}
+
+void collectDirectory(const std::string& directory, std::vector<PakBuildEntry>& outEntries)
+{
+    collectDirectory(directory, "", outEntries);
+}
+
+bool buildArchive(const PakBuildDesc& desc, std::string& outError)
+{
+    struct Entry
+    {
+        std::string name;
+        const std::string* sourcePath;
+    };
+
+    std::vector<Entry> entries;
+    entries.reserve(desc.entries.size());
+    for (auto& e : desc.entries)
+    {
+        entries.emplace_back();
+        entryName(e.name, entries.back().name);
+        entries.back().sourcePath = &e.sourcePath;
+    }
+
+    std::sort(entries.begin(), entries.end(), [](const Entry& a, const Entry& b) { return a.name < b.name; });
+    for (size_t i = 1; i < entries.size(); ++i)
+    {
+        if (entries[i - 1].name == entries[i].name)
+        {
+            outError = "Duplicate pak entry: " + entries[i].name;
+            return false;
+        }
+    }
+
+    std::vector<PakArchive::PakTocEntry> toc(entries.size());
+    std::string names;
+    for (size_t i = 0; i < entries.size(); ++i)
+    {
+        toc[i] = {};
+        toc[i].nameOffset = (uint32_t)names.size();
+        toc[i].nameSize = (uint32_t)entries[i].name.size();
+        names += entries[i].name;
+    }
+
+    PakArchive::PakHeader header = { PakArchive::Magic, PakArchive::Version, (uint32_t)entries.size(), (uint32_t)names.size() };
+    unsigned long long offset = sizeof(header) + toc.size() * sizeof(PakArchive::PakTocEntry) + names.size();
+
+    if (!InternalFileSystem::carvePath(desc.archivePath))
+    {
+        outError = "Could not create the directory of " + desc.archivePath;
+        return false;
+    }
+
+    auto output = InternalFileSystem::openFile(desc.archivePath.c_str(), InternalFileSystem::RequestType::Write);
+    if (!InternalFileSystem::valid(output))
+    {
+        outError = "Could not open for writing " + desc.archivePath;
+        return false;
+    }
+
+    //Data first, the table of contents is only complete once every entry got compressed.
+    std::vector<char> source;
+    std::vector<char> compressed;
+    bool success = true;
+    for (size_t i = 0; i < entries.size() && success; ++i)
+    {
+        if (!readSource(*entries[i].sourcePath, source))
+        {
+            outError = "Could not read " + *entries[i].sourcePath;
+            success = false;
+            break;
+        }
+
+        const char* stored = source.data();
+        uLongf storedSize = (uLongf)source.size();
+        if (desc.compress && !source.empty())
+        {
+            compressed.resize(compressBound((uLong)source.size()));
+            uLongf compressedSize = (uLongf)compressed.size();
+            int result = compress2((Bytef*)compressed.data(), &compressedSize, (const Bytef*)source.data(), (uLong)source.size(), desc.compressionLevel);
+            if (result == Z_OK && compressedSize < storedSize)
+            {
+                stored = compressed.data();
+                storedSize = compressedSize;
+                toc[i].flags |= PakArchive::CompressedFlag;
+            }
+        }
+
+        toc[i].dataOffset = offset;
+        toc[i].storedSize = (uint32_t)storedSize;
+        toc[i].size = (uint32_t)source.size();
+        if (storedSize > 0 && !InternalFileSystem::writeAt(output, stored, (unsigned int)storedSize, offset))
+        {
+            outError = "Failed writing " + desc.archivePath;
+            success = false;
+        }
+        offset += storedSize;
+    }
+
+    if (success)
+    {
+        success = InternalFileSystem::writeAt(output, (const char*)&header, (unsigned int)sizeof(header), 0)
+            && (toc.empty() || InternalFileSystem::writeAt(output, (const char*)toc.data(), (unsigned int)(toc.size() * sizeof(PakArchive::PakTocEntry)), sizeof(header)))
+            && (names.empty() || InternalFileSystem::writeAt(output, names.data(), (unsigned int)names.size(), sizeof(header) + toc.size() * sizeof(PakArchive::PakTocEntry)));
+        if (!success)
+            outError = "Failed writing " + desc.archivePath;
+    }
+
+    InternalFileSystem::close(output);
+    if (!success)
+        InternalFileSystem::deleteFile(desc.archivePath.c_str());
+    return success;
+}
+
+}
+
+}
@@ -0,0 +1,73 @@
+#pragma once
+
+#include "InternalFileSystem.h"
+#include <string>
+#include <string_view>
+#include <memory>
+#include <cstdint>
+
+namespace coalpy
+{
+
+//Read only view of a mounted pak archive, the whole file is memory mapped.
+//Layout: PakHeader, PakTocEntry[entryCount] sorted by name, the names blob, then the entry data.
+class PakArchive
+{
+public:
+    enum : uint32_t
+    {
+        Magic = 'KAPC',
+        Version = 1,
+        CompressedFlag = 1u << 0
+    };
+
+    struct PakHeader
+    {
+        uint32_t magic;
+        uint32_t version;
+        uint32_t entryCount;
+        uint32_t namesSize;
+    };
+
+    struct PakTocEntry
+    {
+        uint32_t nameOffset;
+        uint32_t nameSize;
+        uint64_t dataOffset;
+        //Bytes in the archive, differs from size when compressed.
+        uint32_t storedSize;
+        uint32_t size;
+        uint32_t flags;
+        uint32_t reserved;
+    };
+
+    //Returns null if the file can't be mapped or its table of contents is malformed.
+    static std::shared_ptr<PakArchive> open(const std::string& path);
+    ~PakArchive();
+
+    const std::string& path() const { return m_path; }
+    unsigned long long modifiedTime() const { return m_modifiedTime; }
+
+    //Binary search of the table of contents, -1 if missing.
+    int find(std::string_view name) const;
+    const PakTocEntry& entry(int index) const { return m_toc[index]; }
+    std::string_view name(int index) const { return std::string_view(m_names + m_toc[index].nameOffset, m_toc[index].nameSize); }
+
+    //Stored bytes, straight from the mapping.
+    const char* data(int index) const { return m_view + m_toc[index].dataOffset; }
+    //Inflates a compressed entry into output, which holds entry(index).size bytes.
+    bool decompress(int index, char* output) const;
+
+private:
+    PakArchive() {}
+
+    std::string m_path;
+    InternalFileSystem::OpaqueFileHandle m_handle = {};
+    unsigned long long m_modifiedTime = 0;
+    const char* m_view = nullptr;
+    const PakTocEntry* m_toc = nullptr;
+    const char* m_names = nullptr;
+    uint32_t m_entryCount = 0;
+};
+
+}
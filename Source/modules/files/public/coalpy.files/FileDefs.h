@@ -1,6 +1,7 @@
 #pragma once
 #include <coalpy.core/GenericHandle.h>
 #include <coalpy.core/ByteBuffer.h>
+#include <coalpy.tasks/TaskDefs.h>
 #include <vector>
 #include <string>
 #include <functional>
@@ -9,10 +10,22 @@ namespace coalpy
 {
 
 class ITaskSystem;
+class IFileWatcher;
 
 struct FileSystemDesc
 {
     ITaskSystem* taskSystem = nullptr;
+    //Linux only: reads go through an io_uring engine in large chunks, completed by a single reaper thread.
+    //Falls back to chunked pread if false or if io_uring is not available.
+    bool useIoRing = true;
+    //When set, reads cache whether each additionalRoots candidate exists and drop those entries when the
+    //watcher reports changes to a file of the same name. Only candidates inside watched directories are cached,
+    //the rest are checked on disk on every read.
+    IFileWatcher* watcher = nullptr;
+    //Byte budget of an LRU cache of WholeFile read contents, 0 disables it. Entries are keyed by absolute path and
+    //checked against the file write time and size on every read, so repeated reads of an unchanged file skip the disk.
+    //Writes and deletes through the file system and watcher reports drop entries right away.
+    unsigned long long contentCacheBytes = 0;
 };
 
 enum class IoError
@@ -22,6 +35,7 @@ enum class IoError
     FailedWriting,
     FailedReading,
     FailedCreatingDir,
+    Cancelled,
     None
 };
 
@@ -39,6 +53,8 @@ inline const char* IoError2String(IoError err)
         return "IoError::FailedReading";
     case IoError::FailedCreatingDir:
         return "IoError::FailedCreatingDir";
+    case IoError::Cancelled:
+        return "IoError::Cancelled";
     default:
     case IoError::None:
         return "IoError::None";
@@ -60,8 +76,9 @@ struct FileReadResponse
     IoError error = IoError::None;
     FileStatus status = FileStatus::Idle;
     std::string filePath;
+    //Chunk being read. On Success, the whole contents for WholeFile and MemoryMap reads, null otherwise.
     const char* buffer = nullptr;
-    int size = 0;
+    unsigned long long size = 0;
 };
 
 struct FileWriteResponse
@@ -74,9 +91,37 @@ using AsyncFileHandle = GenericHandle<unsigned int>;
 using FileReadDoneCallback = std::function<void(FileReadResponse& response)>;
 using FileWriteDoneCallback = std::function<void(FileWriteResponse& response)>;
 
+struct FileReadGroupResponse
+{
+    int fileCount = 0;
+    //Files that ended with FileStatus::Fail, cancelled ones included.
+    int failedCount = 0;
+};
+
+using FileReadManyCallback = std::function<void(int fileIndex, FileReadResponse& response)>;
+using FileReadGroupCallback = std::function<void(FileReadGroupResponse& response)>;
+
 enum class FileRequestFlags : int
 {
-    AutoStart = 1 << 0
+    AutoStart = 1 << 0,
+    //Reads: the whole file lands in one buffer sized from the file size, followed by a null terminator.
+    //Delivered as a single Reading response, Success points at the same buffer. Valid until closeHandle.
+    WholeFile = 1 << 1,
+    //Reads: maps the file read only instead of copying it. The Reading and Success responses point at the
+    //mapped view (not null terminated), valid until closeHandle. Takes precedence over WholeFile.
+    MemoryMap = 1 << 2,
+    //Reads: keeps the next chunk in flight (and hints the OS to prefetch past it) while the callback
+    //consumes the current one. Always on for the io_uring engine.
+    Readahead = 1 << 3,
+    //Writes: the buffer is not copied, it has to stay alive and unchanged until the write finishes.
+    BorrowBuffer = 1 << 4,
+    //Writes: keeps the file contents and writes at FileWriteRequest::offset, so separate requests
+    //can write disjoint ranges of one file in parallel.
+    WriteAtOffset = 1 << 5,
+    //Writes: keeps the file contents and writes after its current end.
+    Append = 1 << 6,
+    //Writes: flushes the data to the device (fdatasync) before reporting Success.
+    Sync = 1 << 7
 };
 
 struct FileReadRequest
@@ -85,6 +130,10 @@ struct FileReadRequest
     std::vector<std::string> additionalRoots;
     FileReadDoneCallback doneCallback;
     int flags;
+    //Checked before opening and between chunks, a cancelled read fails with IoError::Cancelled.
+    CancelToken cancelToken;
+    //Maximum bytes per Reading response. 0 picks the engine default (16kb for pread, 1mb for io_uring).
+    int chunkSize = 0;
 
     FileReadRequest() {}
 
@@ -95,20 +144,39 @@ struct FileReadRequest
     : flags(flags), path(path), doneCallback(doneCallback) {}
 };
 
+struct FileReadManyRequest
+{
+    std::vector<std::string> paths;
+    //Probed once for the whole group, roots that don't exist are dropped.
+    std::vector<std::string> additionalRoots;
+    //Same responses as a single read, fileIndex is the position in paths. Different files call it concurrently.
+    FileReadManyCallback fileCallback;
+    //Called once, after the last file finished.
+    FileReadGroupCallback groupCallback;
+    //FileRequestFlags for every file, AutoStart starts the whole group.
+    int flags = 0;
+    int chunkSize = 0;
+    //Files being read at the same time, 0 starts all of them at once.
+    int queueDepth = 16;
+    CancelToken cancelToken;
+};
+
 struct FileWriteRequest
 {
     std::string path;
     FileWriteDoneCallback doneCallback;
     const char* buffer;
-    int size;
+    unsigned long long size;
     int flags;
+    //Where the buffer lands with WriteAtOffset.
+    unsigned long long offset = 0;
     
-    FileWriteRequest() {}
+    FileWriteRequest() : buffer(nullptr), size(0), flags(0) {}
 
-    FileWriteRequest(std::string path, FileWriteDoneCallback doneCallback, const char* buffer, int size)
+    FileWriteRequest(std::string path, FileWriteDoneCallback doneCallback, const char* buffer, unsigned long long size)
     : flags(0), path(path), doneCallback(doneCallback), buffer(buffer), size(size) {}
 
-    FileWriteRequest(std::string path, FileWriteDoneCallback doneCallback, const char* buffer, int size, int flags)
+    FileWriteRequest(std::string path, FileWriteDoneCallback doneCallback, const char* buffer, unsigned long long size, int flags)
     : flags(flags), path(path), doneCallback(doneCallback), buffer(buffer), size(size) {}
 };
 
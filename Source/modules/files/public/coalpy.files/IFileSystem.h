@@ -17,8 +17,21 @@ public:
     
     virtual ~IFileSystem() {}
 
+    //Requests return an invalid handle when the file system has no room for more open handles.
     virtual AsyncFileHandle read (const FileReadRequest& request) = 0;
+    //Reads a list of files through one handle: a task per file, at most queueDepth of them in flight.
+    //wait, asTask and closeHandle act on the whole group.
+    virtual AsyncFileHandle readMany(const FileReadManyRequest& request) = 0;
     virtual AsyncFileHandle write(const FileWriteRequest& request) = 0;
+
+    //Streaming writes: the file stays open and takes chunks as they get produced. Every chunk is written
+    //by an io task of its own, at the offset following the previous chunk. request.buffer is the first
+    //chunk when size > 0. The handle finishes (Success or Fail callback, wait, asTask) after finishWriteStream.
+    virtual AsyncFileHandle openWriteStream(const FileWriteRequest& request) = 0;
+    //The chunk is copied unless the stream was opened with FileRequestFlags::BorrowBuffer.
+    virtual void appendWriteStream(AsyncFileHandle handle, const char* buffer, unsigned long long size) = 0;
+    virtual void finishWriteStream(AsyncFileHandle handle) = 0;
+
     virtual void execute(AsyncFileHandle handle) = 0;
     virtual Task asTask(AsyncFileHandle handle) = 0;
     virtual void wait(AsyncFileHandle handle) = 0;
@@ -30,6 +43,13 @@ public:
     virtual bool deleteDirectory(const char* directoryName) = 0;
     virtual bool deleteFile(const char* fileName) = 0;
     virtual void getFileAttributes(const char* fileName, FileAttributes& attributes) = 0;
+
+    //Mounts a pak archive (see PakDefs.h) as a read root. Reads look every candidate path up in the mounted
+    //archives, most recently mounted first, before touching loose files. Entries are served from the mapped
+    //archive and stay valid until the read handle is closed, even if the archive gets unmounted.
+    //Returns false if the archive can't be opened or is malformed.
+    virtual bool mountArchive(const char* archivePath) = 0;
+    virtual bool unmountArchive(const char* archivePath) = 0;
 };
 
 }
@@ -15,16 +15,25 @@ public:
 
 struct FileWatchDesc
 {
+    //Windows: how often the watched directories get checked.
     int pollingRateMS = 1000;
+    //Linux: the watcher wakes up on inotify events, and reports a burst of them once debounceMS pass
+    //without new ones, or at the latest 4 * debounceMS after the first one.
+    int debounceMS = 20;
 };
 
 class IFileWatcher
 {
 public:
     static IFileWatcher* create(const FileWatchDesc& desc);
+    virtual ~IFileWatcher() {}
     virtual void start() = 0;
     virtual void stop() = 0;
+    //Watches the directory and everything below it, including directories created later on.
     virtual void addDirectory(const char* directory) = 0;
+    //True if path is inside one of the watched directories, so changes to it get reported.
+    //Checked on the path string alone: path does not need to exist, links are not followed. False once stopped.
+    virtual bool isWatched(const char* path) = 0;
     virtual void addListener(IFileWatchListener* listener) = 0;
     virtual void removeListener(IFileWatchListener* listener) = 0;
 };
@@ -0,0 +1,39 @@
+#pragma once
+#include <vector>
+#include <string>
+
+namespace coalpy
+{
+
+//Pak archives pack many small files into one, so a cold start pays for a single open instead of a
+//stat, open, fstat and close per file. See IFileSystem::mountArchive.
+struct PakBuildEntry
+{
+    //Name the entry is looked up by, relative with '/' separators, i.e. "shaders/common.hlsl".
+    std::string name;
+    //Loose file the contents come from.
+    std::string sourcePath;
+};
+
+struct PakBuildDesc
+{
+    std::string archivePath;
+    std::vector<PakBuildEntry> entries;
+    //Entries are zlib compressed, and stored as they are if that doesn't make them smaller.
+    bool compress = true;
+    int compressionLevel = 6;
+};
+
+namespace PakUtils
+{
+    //Normalizes a path the way archive entry names are stored: '/' separators and no leading "./".
+    void entryName(const std::string& path, std::string& outName);
+
+    //Appends every file under directory, recursively, named relative to directory.
+    void collectDirectory(const std::string& directory, std::vector<PakBuildEntry>& outEntries);
+
+    //Writes the archive synchronously. Returns false and a message if a source can't be read or the archive written.
+    bool buildArchive(const PakBuildDesc& desc, std::string& outError);
+}
+
+}
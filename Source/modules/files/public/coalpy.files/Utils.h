@@ -1,6 +1,7 @@
 #pragma once
 #include <vector>
 #include <string>
+#include <cstdint>
 
 namespace coalpy
 {
@@ -13,10 +14,11 @@ namespace coalpy
         void getAbsolutePath(const std::string& path, std::string& outDir);
     }
 
+    //Hashed once up front, compares hash first and only falls back to the name when the hashes match.
     struct FileLookup
     {
         std::string filename;
-        unsigned int hash;
+        uint64_t hash;
     
         FileLookup();
         FileLookup(const char* filename);
@@ -24,27 +26,32 @@ namespace coalpy
     
         bool operator==(const FileLookup& other) const
         {
-            return hash == other.hash;
+            return hash == other.hash && filename == other.filename;
+        }
+
+        bool operator!=(const FileLookup& other) const
+        {
+            return !((*this) == other);
         }
     
-        bool operator>(const FileLookup& other) const
+        bool operator<(const FileLookup& other) const
         {
-            return hash > other.hash;
+            return hash != other.hash ? hash < other.hash : filename < other.filename;
         }
     
-        bool operator>=(const FileLookup& other) const
+        bool operator>(const FileLookup& other) const
         {
-            return hash >= other.hash;
+            return other < (*this);
         }
     
-        bool operator<(const FileLookup& other) const
+        bool operator>=(const FileLookup& other) const
         {
-            return hash < other.hash;
+            return !((*this) < other);
         }
     
         bool operator<=(const FileLookup& other) const
         {
-            return hash < other.hash;
+            return !(other < (*this));
         }
     };
 
@@ -3,6 +3,7 @@
 #include <string>
 #include <sstream>
 #include <coalpy.core/Assert.h>
+#include <coalpy.core/Profiler.h>
 #include <coalpy.files/IFileSystem.h>
 #include <coalpy.files/IFileWatcher.h>
 #include <coalpy.files/Utils.h>
@@ -38,6 +39,9 @@ struct CompileState
     Task compileStep;
     std::set<FileLookup> files;
     bool success;
+    //Cancelled when a newer recompile of the same shader supersedes this one.
+    CancelToken cancelToken = CancelToken::create();
+    CompileState* superseded = nullptr;
 };
 
 BaseShaderDb::BaseShaderDb(const ShaderDbDesc& desc)
@@ -119,24 +123,31 @@ void BaseShaderDb::addPath(const char* path)
         m_liveEditWatcher->addDirectory(path);
 }
 
-BaseShaderDb::ShaderState& BaseShaderDb::createShaderState(ShaderHandle& outHandle)
+BaseShaderDb::ShaderState* BaseShaderDb::createShaderState(ShaderHandle& outHandle)
 {
-    ShaderState& shaderState = *(new ShaderState);
-    {
-        std::unique_lock lock(m_shadersMutex);
-        auto& statePtr = m_shaders.allocate(outHandle);
-        statePtr = &shaderState;
-    }
+    ShaderState*& slot = m_shaders.allocate(outHandle);
+    CPY_ERROR_MSG(outHandle.valid(), "Shader table is full.");
+    if (!outHandle.valid())
+        return nullptr;
 
+    ShaderState& shaderState = *(new ShaderState);
+    slot = &shaderState;
     shaderState.initialize();
     shaderState.compiling = true;
-    return shaderState;
+    return &shaderState;
 }
 
 ShaderHandle BaseShaderDb::requestCompile(const ShaderDesc& desc)
 {
     preparePdbDir();
 
+    //Shaders are never freed, so the table filling up fails the request before anything gets started.
+    ShaderHandle shaderHandle;
+    ShaderState* newState = createShaderState(shaderHandle);
+    if (newState == nullptr)
+        return shaderHandle;
+
+    ShaderState& shaderState = *newState;
     auto* compileState = new CompileState;
 
     std::string filePath = desc.path;
@@ -154,8 +165,6 @@ ShaderHandle BaseShaderDb::requestCompile(const ShaderDesc& desc)
     prepareIoJob(*compileState, filePath);
     prepareCompileJobs(*compileState);
 
-    ShaderHandle shaderHandle;
-    ShaderState& shaderState = createShaderState(shaderHandle);
     shaderState.debugName = desc.name;
     shaderState.recipe.type = desc.type;
     shaderState.recipe.name = desc.name;
@@ -174,6 +183,12 @@ ShaderHandle BaseShaderDb::requestCompile(const ShaderInlineDesc& desc)
 {
     preparePdbDir();
 
+    ShaderHandle shaderHandle;
+    ShaderState* newState = createShaderState(shaderHandle);
+    if (newState == nullptr)
+        return shaderHandle;
+
+    ShaderState& shaderState = *newState;
     auto* compileState = new CompileState;
 
     compileState->compileArgs = {};
@@ -193,8 +208,6 @@ ShaderHandle BaseShaderDb::requestCompile(const ShaderInlineDesc& desc)
 
     prepareCompileJobs(*compileState);
 
-    ShaderHandle shaderHandle;
-    ShaderState& shaderState = createShaderState(shaderHandle);
     shaderState.recipe.type = desc.type;
     shaderState.recipe.name = desc.name;
     shaderState.recipe.mainFn = desc.mainFn;
@@ -223,13 +236,15 @@ void BaseShaderDb::requestRecompile(ShaderHandle handle)
         if (!shaderState)
             return;
 
-        if (shaderState->compileState)
-            return;
-
         if (shaderState->compiling)
             return;
     }
 
+    //A recompile still in flight is stale now, skip whatever it has not started yet. resolve cleans it up.
+    CompileState* superseded = shaderState->compileState;
+    if (superseded)
+        superseded->cancelToken.cancel();
+
     auto& recipe = shaderState->recipe;
     auto& compileState = *(new CompileState());
     compileState.shaderName = recipe.name;
@@ -255,14 +270,17 @@ void BaseShaderDb::requestRecompile(ShaderHandle handle)
         m_desc.ts->depends(compileState.compileStep, m_desc.fs->asTask(compileState.readStep));
     }
 
+    compileState.superseded = superseded;
     shaderState->compileState = &compileState;
     compileState.shaderHandle = handle;
-    Task patchTask = m_desc.ts->createTask(TaskDesc(
+    TaskDesc patchDesc(
         [this, &compileState, shaderState](TaskContext& ctx)
         {
             std::unique_lock lock(m_shadersMutex);
             shaderState->compiling = true;
-        }));
+        });
+    patchDesc.cancelToken = compileState.cancelToken;
+    Task patchTask = m_desc.ts->createTask(patchDesc);
 
     m_desc.ts->depends(patchTask, compileState.compileStep);
     compileState.compileStep = patchTask;
@@ -276,16 +294,13 @@ void BaseShaderDb::prepareIoJob(CompileState& compileState, const std::string& r
     compileState.compileArgs.debugName = compileState.filePath.c_str();
     compileState.compileArgs.mainFn = compileState.mainFn.c_str();
 
+    //The source is read whole and compiled in place, readStep stays open until the compile finished.
     const auto& readPath = compileState.filePath;
     FileReadRequest readRequest(readPath, [&compileState, this](FileReadResponse& response){
-        if (response.status == FileStatus::Reading)
-        {
-            compileState.buffer.append((const u8*)response.buffer, response.size);
-        }
-        else if (response.status == FileStatus::Success)
+        if (response.status == FileStatus::Success)
         {
-            compileState.compileArgs.source = (const char*)compileState.buffer.data();
-            compileState.compileArgs.sourceSize = (int)compileState.buffer.size();
+            compileState.compileArgs.source = response.buffer;
+            compileState.compileArgs.sourceSize = (int)response.size;
 
             if (m_desc.enableLiveEditing)
             {
@@ -300,7 +315,7 @@ void BaseShaderDb::prepareIoJob(CompileState& compileState, const std::string& r
         {
             compileState.compileArgs.source = nullptr;
             compileState.compileArgs.sourceSize = 0u;
-            if (m_desc.onErrorFn)
+            if (m_desc.onErrorFn && response.error != IoError::Cancelled)
             {
                 std::stringstream ss;
                 ss << "Failed reading " << compileState.filePath.c_str() << ". Reason: " << IoError2String(response.error);
@@ -310,19 +325,23 @@ void BaseShaderDb::prepareIoJob(CompileState& compileState, const std::string& r
     });
 
     readRequest.additionalRoots.insert(readRequest.additionalRoots.end(), m_additionalPaths.begin(), m_additionalPaths.end());
+    readRequest.cancelToken = compileState.cancelToken;
+    readRequest.flags = (int)FileRequestFlags::WholeFile;
     compileState.readStep = m_desc.fs->read(readRequest);
 }
 
 void BaseShaderDb::prepareCompileJobs(CompileState& compileState)
 {
-    compileState.compileStep = m_desc.ts->createTask(TaskDesc(
+    TaskDesc compileDesc(
         compileState.shaderName.c_str(),
         [&compileState, this](TaskContext& ctx)
     {
         compileState.success = false;
         if (compileState.compileArgs.source != nullptr)
             m_compiler.compileShader(compileState.compileArgs);
-    }));
+    }, TaskPriority::Background);
+    compileDesc.cancelToken = compileState.cancelToken;
+    compileState.compileStep = m_desc.ts->createTask(compileDesc);
 
     if (m_desc.onErrorFn)
         compileState.compileArgs.onError = [&compileState, this](const char* name, const char* errorString)
@@ -344,7 +363,7 @@ void BaseShaderDb::prepareCompileJobs(CompileState& compileState)
             {
                 result = true;
             }
-        }));
+        }, (int)FileRequestFlags::WholeFile));
 
         m_desc.fs->execute(handle);
         m_desc.fs->wait(handle);
@@ -390,7 +409,9 @@ void BaseShaderDb::prepareCompileJobs(CompileState& compileState)
             req.doneCallback = [](FileWriteResponse& response) {};
             req.path = ss.str();
             req.buffer = (const char*)payload.pdbBlob->GetBufferPointer();
-            req.size = (int)payload.pdbBlob->GetBufferSize();
+            req.size = (unsigned long long)payload.pdbBlob->GetBufferSize();
+            //The blob outlives the wait below, no need for a copy.
+            req.flags = (int)FileRequestFlags::BorrowBuffer;
             AsyncFileHandle writeHandle = m_desc.fs->write(req);
     
             m_desc.fs->execute(writeHandle);
@@ -402,16 +423,13 @@ void BaseShaderDb::prepareCompileJobs(CompileState& compileState)
 
 void BaseShaderDb::resolve(ShaderHandle handle)
 {
+    CPY_PROFILE_SCOPE("ShaderDb::resolve");
     CPY_ASSERT(handle.valid());
 
     if (!handle.valid())
         return;
 
-    ShaderState* shaderState = nullptr;
-    {
-        std::shared_lock lock(m_shadersMutex);
-        shaderState = m_shaders[handle];
-    }
+    ShaderState* shaderState = m_shaders[handle];
 
     CompileState* compileState = nullptr;
     while (shaderState->compiling)
@@ -459,6 +477,19 @@ void BaseShaderDb::resolve(ShaderHandle handle)
             m_desc.fs->closeHandle(compileState->readStep);
         m_desc.ts->cleanTaskTree(compileState->compileStep);
 
+        //Cancelled recompiles, their remaining tasks were skipped so these waits are short.
+        for (CompileState* superseded = compileState->superseded; superseded != nullptr;)
+        {
+            m_desc.ts->wait(superseded->compileStep);
+            if (superseded->readStep.valid())
+                m_desc.fs->closeHandle(superseded->readStep);
+            m_desc.ts->cleanTaskTree(superseded->compileStep);
+
+            CompileState* next = superseded->superseded;
+            delete superseded;
+            superseded = next;
+        }
+
         {
             std::shared_lock lock(m_shadersMutex);
             
@@ -1,7 +1,7 @@
 #pragma once
 
 #include <coalpy.core/GenericHandle.h>
-#include <coalpy.core/HandleContainer.h>
+#include <coalpy.core/ConcurrentHandleContainer.h>
 #include <coalpy.render/IShaderDb.h>
 #include <coalpy.files/IFileWatcher.h>
 #include <coalpy.files/Utils.h>
@@ -82,8 +82,9 @@ protected:
     ShaderDbDesc m_desc;
     render::IDevice* m_parentDevice = nullptr;
 
+    //Guards the shader states, lookups in m_shaders don't need it.
     mutable std::shared_mutex m_shadersMutex;
-    HandleContainer<ShaderHandle, ShaderState*> m_shaders;
+    ConcurrentHandleContainer<ShaderHandle, ShaderState*> m_shaders;
 
 private:
     void preparePdbDir();
@@ -92,7 +93,8 @@ private:
 
     DxcCompiler m_compiler;
 
-    ShaderState& createShaderState(ShaderHandle& outHandle);
+    //Returns nullptr and an invalid handle when the shader table is full.
+    ShaderState* createShaderState(ShaderHandle& outHandle);
 
     void startLiveEdit();
     void stopLiveEdit();
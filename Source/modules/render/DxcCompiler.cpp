@@ -1,6 +1,7 @@
 #include <Config.h>
 #include "DxcCompiler.h"
 #include <coalpy.core/Assert.h>
+#include <coalpy.core/Profiler.h>
 #include <coalpy.core/GenericHandle.h>
 #include <coalpy.core/HandleContainer.h>
 #include <coalpy.core/SmartPtr.h>
@@ -362,6 +363,7 @@ void addSpirvArguments(std::vector<std::wstring>& args)
 
 void DxcCompiler::compileShader(const DxcCompileArgs& args)
 {
+    CPY_PROFILE_SCOPE("DxcCompiler::compileShader");
     CPY_ASSERT(args.shaderModel >= ShaderModel::Begin && args.shaderModel <= ShaderModel::End);
     const wchar_t** smTargets = getShaderModelTargets(args.shaderModel);
 
@@ -1,6 +1,9 @@
 #include "WorkBundleDb.h"
 #include <coalpy.core/Assert.h>
+#include <coalpy.core/Profiler.h>
 #include <coalpy.render/IDevice.h>
+#include <coalpy.tasks/ITaskSystem.h>
+#include <algorithm>
 #include <iostream>
 #include <sstream>
 
@@ -16,6 +19,8 @@ namespace
 enum 
 {
     ConstantBufferAlignment = 256,
+    //Commands validated per task when checking runs on the task system.
+    CommandsPerCheckTask = 32,
 };
 
 struct WorkBuildContext
@@ -284,102 +289,59 @@ bool commitResourceStates(const ResourceStateMap& input, WorkResourceInfos& reso
     return true;
 }
 
-bool processCompute(const AbiComputeCmd* cmd, const unsigned char* data, WorkBuildContext& context)
+//Result of checking a command on its own, before resource states get tracked.
+struct CommandCheck
 {
-    {
-        const InResourceTable* inTables = cmd->inResourceTables.data(data);
-        for (int i = 0; i < cmd->inResourceTablesCounts; ++i)
-        {
-            if (!processTable(inTables[i], context))
-                return false;
-        }
-    }
-
-    {
-        const OutResourceTable* outTables = cmd->outResourceTables.data(data);
-        for (int i = 0; i < cmd->outResourceTablesCounts; ++i)
-        {
-            if (!processTable(outTables[i], context))
-                return false;
-        }
-    }
-
-    {
-        const SamplerTable* samplerTables = cmd->samplerTables.data(data);
-        for (int i = 0; i < cmd->samplerTablesCounts; ++i)
-        {
-            if (!processSamplerTable(samplerTables[i], context))
-                return false;
-        }
-    }
+    //First error found in the command, reported once the ordered pass reaches it.
+    ScheduleErrorType errorType = ScheduleErrorType::Ok;
+    std::string errorMsg;
+    //Upload buffer bytes the command needs, offsets get assigned in list order.
+    int uploadSize = 0;
+    Buffer counterBuffer;
+};
 
-    {
-        const Buffer* cbuffers = cmd->constants.data(data);
-        CommandInfo& cmdInfo = context.currentCommandInfo();
-        if (cmd->inlineConstantBufferSize > 0)
-        {
-            //TODO: hack, dx12 requires aligned buffers to be 256.
-            cmdInfo.uploadBufferOffset = context.totalUploadBufferSize;
-            int alignedBufferOffset = ((cmdInfo.uploadBufferOffset + (ConstantBufferAlignment - 1)) / ConstantBufferAlignment) * ConstantBufferAlignment;
-            int alignedBufferSize = ((cmd->inlineConstantBufferSize + (ConstantBufferAlignment - 1))/ConstantBufferAlignment) * ConstantBufferAlignment;
-            int padding = alignedBufferOffset - context.totalUploadBufferSize;
-            cmdInfo.uploadBufferOffset += padding;
-            context.totalUploadBufferSize += alignedBufferSize + padding;
+//Immutable during the build, shared by all the threads checking commands.
+struct CommandCheckContext
+{
+    IDevice* device = nullptr;
+    const WorkResourceInfos* resourceInfos = nullptr;
+};
 
-            cmdInfo.constantBufferTableOffset = context.totalConstantBuffers;
-            ++context.totalConstantBuffers;
-        }
-        else
-        {
-            for (int i = 0; i < cmd->constantCounts; ++i)
-            {
-                if (!transitionResource(cbuffers[i], ResourceGpuState::Cbv, context))
-                    return false;
-            }
+bool applyCheck(CommandCheck& check, WorkBuildContext& context)
+{
+    if (check.errorType == ScheduleErrorType::Ok)
+        return true;
 
-            cmdInfo.constantBufferCount = cmd->constantCounts;
-            cmdInfo.constantBufferTableOffset = context.totalConstantBuffers;
-            context.totalConstantBuffers += cmdInfo.constantBufferCount;
-        }
-    }
+    context.errorType = check.errorType;
+    context.errorMsg = std::move(check.errorMsg);
+    return false;
+}
 
-    if (cmd->isIndirect)
+bool checkCompute(const AbiComputeCmd* cmd, CommandCheck& check)
+{
+    if (cmd->isIndirect && !cmd->indirectArguments.valid())
     {
-        if (!cmd->indirectArguments.valid())
-        {
-            std::stringstream ss;
-            ss << "Indirect argument buffer is not valid for indirect dispatch command ";
-            context.errorMsg = ss.str();
-            context.errorType = ScheduleErrorType::InvalidResource;
-            return false;
-        }
-
-        if (!transitionResource(cmd->indirectArguments, ResourceGpuState::IndirectArgs, context))
-            return false;
+        std::stringstream ss;
+        ss << "Indirect argument buffer is not valid for indirect dispatch command ";
+        check.errorMsg = ss.str();
+        check.errorType = ScheduleErrorType::InvalidResource;
+        return false;
     }
 
-    ++context.currentListInfo().computeCommandsCount;
-
     return true;
 }
 
-bool processCopy(const AbiCopyCmd* cmd, const unsigned char* data, WorkBuildContext& context)
+bool checkCopy(const AbiCopyCmd* cmd, const CommandCheckContext& context, CommandCheck& check)
 {
-    if (!transitionResource(cmd->source, ResourceGpuState::CopySrc, context))
-        return false;
-
-    if (!transitionResource(cmd->destination, ResourceGpuState::CopyDst, context))
-        return false;
-
-    auto fitsInCopyCmd = [&context, &cmd](ResourceHandle handle, const char* resourceTypeName, int offsetX, int offsetY, int offsetZ, int mipLevel)
+    auto fitsInCopyCmd = [&context, &check, &cmd](ResourceHandle handle, const char* resourceTypeName, int offsetX, int offsetY, int offsetZ, int mipLevel)
     {
         auto it = context.resourceInfos->find(handle);
         if (it == context.resourceInfos->end())
         {
             std::stringstream ss;
             ss << "Invalid resource passed on copy command";
-            context.errorMsg = ss.str();
-            context.errorType = ScheduleErrorType::InvalidResource;
+            check.errorMsg = ss.str();
+            check.errorType = ScheduleErrorType::InvalidResource;
             return false;
         }
 
@@ -394,8 +356,8 @@ bool processCopy(const AbiCopyCmd* cmd, const unsigned char* data, WorkBuildCont
                << resourceInfo.sizeX << ", " << resourceInfo.sizeY << ", " << resourceInfo.sizeZ << "]"
                << ", attempted to access offset [" << offsetX << ", " << offsetY << ", " << offsetZ << "]"
                << ", remaining resource size being [" << remainingSizeX << ", " << remainingSizeY << ", " << remainingSizeZ << "]";
-            context.errorMsg = ss.str();
-            context.errorType = ScheduleErrorType::OutOfBounds;
+            check.errorMsg = ss.str();
+            check.errorType = ScheduleErrorType::OutOfBounds;
             return false;
         }
 
@@ -404,8 +366,8 @@ bool processCopy(const AbiCopyCmd* cmd, const unsigned char* data, WorkBuildCont
             std::stringstream ss;
             ss << resourceTypeName << " in copy command accesses a mip that is out of bounds," 
                << " mipLevel is " << mipLevel << " and total mip size is " << resourceInfo.mipLevels;
-            context.errorMsg = ss.str();
-            context.errorType = ScheduleErrorType::OutOfBounds;
+            check.errorMsg = ss.str();
+            check.errorType = ScheduleErrorType::OutOfBounds;
             return false;
         }
 
@@ -420,8 +382,8 @@ bool processCopy(const AbiCopyCmd* cmd, const unsigned char* data, WorkBuildCont
         {
             std::stringstream ss;
             ss << "Invalid resource passed on copy command";
-            context.errorMsg = ss.str();
-            context.errorType = ScheduleErrorType::InvalidResource;
+            check.errorMsg = ss.str();
+            check.errorType = ScheduleErrorType::InvalidResource;
             return false;
         }
 
@@ -431,8 +393,8 @@ bool processCopy(const AbiCopyCmd* cmd, const unsigned char* data, WorkBuildCont
         {
             std::stringstream ss;
             ss << "Cannot copy resources, mismatching sizes.";
-            context.errorMsg = ss.str();
-            context.errorType = ScheduleErrorType::InvalidResource;
+            check.errorMsg = ss.str();
+            check.errorType = ScheduleErrorType::InvalidResource;
             return false;
         }
     }
@@ -448,17 +410,13 @@ bool processCopy(const AbiCopyCmd* cmd, const unsigned char* data, WorkBuildCont
     return true;
 }
 
-bool processUpload(const AbiUploadCmd* cmd, const unsigned char* data, WorkBuildContext& context)
+bool checkUpload(const AbiUploadCmd* cmd, const CommandCheckContext& context, CommandInfo& info, CommandCheck& check)
 {
-    if (!transitionResource(cmd->destination, ResourceGpuState::CopyDst, context))
-        return false;
+    //Unregistered destinations fail the state transition, which comes first in the ordered pass.
+    if (context.resourceInfos->find(cmd->destination) == context.resourceInfos->end())
+        return true;
 
     IDevice& device = *context.device;
-
-    const auto resourceInfoIt = context.resourceInfos->find(cmd->destination);
-    const WorkResourceInfo& resourceInfo = resourceInfoIt->second;
-
-    CommandInfo& info = context.currentCommandInfo();
     device.getResourceMemoryInfo(cmd->destination, info.uploadDestinationMemoryInfo);
 
     if (info.uploadDestinationMemoryInfo.isBuffer)
@@ -472,13 +430,12 @@ bool processUpload(const AbiUploadCmd* cmd, const unsigned char* data, WorkBuild
                 << info.uploadDestinationMemoryInfo.byteSize << "bytes." 
                 << "offset being " << cmd->destX << " and remaining size being " << remainingSize;
 
-            context.errorMsg = ss.str();
-            context.errorType = ScheduleErrorType::OutOfBounds;
+            check.errorMsg = ss.str();
+            check.errorType = ScheduleErrorType::OutOfBounds;
             return false;
         }
 
-        info.uploadBufferOffset = context.totalUploadBufferSize;
-        context.totalUploadBufferSize += (int)remainingSize;
+        check.uploadSize = (int)remainingSize;
     }
     else
     {
@@ -493,8 +450,8 @@ bool processUpload(const AbiUploadCmd* cmd, const unsigned char* data, WorkBuild
                 << cmd->sourceSize << "bytes. The box source size being "
                 << szX << ", " << szY << ", " << szZ << "with a pixel pitch of " << info.uploadDestinationMemoryInfo.texelElementPitch 
                 << "amounts to a total size of " << srcBoxByteSize;
-            context.errorMsg = ss.str();
-            context.errorType = ScheduleErrorType::OutOfBounds;
+            check.errorMsg = ss.str();
+            check.errorType = ScheduleErrorType::OutOfBounds;
             return false;
         }
 
@@ -508,20 +465,18 @@ bool processUpload(const AbiUploadCmd* cmd, const unsigned char* data, WorkBuild
                 << szX << ", " << szY << ", " << szZ 
                 << " Exceeds the destination remaining size of "
                 << sizeLeftX << ", " << sizeLeftY << ", ", sizeLeftZ;
-            context.errorMsg = ss.str();
-            context.errorType = ScheduleErrorType::OutOfBounds;
+            check.errorMsg = ss.str();
+            check.errorType = ScheduleErrorType::OutOfBounds;
             return false;
         }
 
-        int hardwareUploadSize = info.uploadDestinationMemoryInfo.rowPitch * szY * szZ; 
-        info.uploadBufferOffset = context.totalUploadBufferSize;
-        context.totalUploadBufferSize += hardwareUploadSize;
+        check.uploadSize = info.uploadDestinationMemoryInfo.rowPitch * szY * szZ;
     }
 
     return true;
 }
 
-bool processDownload(const AbiDownloadCmd* cmd, const unsigned char* data, WorkBuildContext& context)
+bool checkDownload(const AbiDownloadCmd* cmd, const CommandCheckContext& context, CommandCheck& check)
 {
     const auto& resourceInfos = *context.resourceInfos;
     const auto& resourceInfoIt = resourceInfos.find(cmd->source);
@@ -529,45 +484,29 @@ bool processDownload(const AbiDownloadCmd* cmd, const unsigned char* data, WorkB
     {
         std::stringstream ss;
         ss << "Could not find resource with ID: " << cmd->source.handleId;
-        context.errorType = ScheduleErrorType::InvalidResource;
-        context.errorMsg = ss.str();
+        check.errorType = ScheduleErrorType::InvalidResource;
+        check.errorMsg = ss.str();
         return false;
     }
 
     if (cmd->mipLevel >= resourceInfoIt->second.mipLevels)
     {
-        context.errorType = ScheduleErrorType::OutOfBounds;
-        context.errorMsg = "Mip level for download out of bounds. Must be within range of resource";
+        check.errorType = ScheduleErrorType::OutOfBounds;
+        check.errorMsg = "Mip level for download out of bounds. Must be within range of resource";
         return false;
     }
 
     if (cmd->arraySlice >= resourceInfoIt->second.arraySlices)
     {
-        context.errorType = ScheduleErrorType::OutOfBounds;
-        context.errorMsg = "Array slice out of bounds. Must be within range of array slices";
+        check.errorType = ScheduleErrorType::OutOfBounds;
+        check.errorMsg = "Array slice out of bounds. Must be within range of array slices";
         return false;
     }
 
-    ResourceDownloadKey downloadKey { cmd->source, cmd->mipLevel, cmd->arraySlice };
-
-    auto it = context.resourcesToDownload.insert(downloadKey);
-    if (!it.second)
-    {
-        context.errorType = ScheduleErrorType::MultipleDownloadsOnSameResource;
-        context.errorMsg = "Multiple downloads on the same resource during the same schedule call. You are only allowed to download a resource once per scheduling bundle.";
-        return false;
-    }
-
-    if (!transitionResource(cmd->source, ResourceGpuState::CopySrc, context))
-        return false;
-
-    context.currentCommandInfo().commandDownloadIndex = context.currentListInfo().downloadCommandsCount;
-    ++context.currentListInfo().downloadCommandsCount;
-
     return true;
 }
 
-bool processCopyAppendConsumeCounter(const AbiCopyAppendConsumeCounter* cmd, const unsigned char* data, WorkBuildContext& context)
+bool checkCopyAppendConsumeCounter(const AbiCopyAppendConsumeCounter* cmd, const CommandCheckContext& context, CommandCheck& check)
 {
     const auto& resourceInfos = *context.resourceInfos;
     const auto& srcResourceInfoIt = resourceInfos.find((ResourceHandle)cmd->source);
@@ -575,8 +514,8 @@ bool processCopyAppendConsumeCounter(const AbiCopyAppendConsumeCounter* cmd, con
     {
         std::stringstream ss;
         ss << "Could not find resource with ID: " << cmd->source.handleId;
-        context.errorType = ScheduleErrorType::InvalidResource;
-        context.errorMsg = ss.str();
+        check.errorType = ScheduleErrorType::InvalidResource;
+        check.errorMsg = ss.str();
         return false;
     }
 
@@ -585,8 +524,8 @@ bool processCopyAppendConsumeCounter(const AbiCopyAppendConsumeCounter* cmd, con
     {
         std::stringstream ss;
         ss << "Could not find resource with ID: " << cmd->destination.handleId;
-        context.errorType = ScheduleErrorType::InvalidResource;
-        context.errorMsg = ss.str();
+        check.errorType = ScheduleErrorType::InvalidResource;
+        check.errorMsg = ss.str();
         return false;
     }
 
@@ -594,8 +533,8 @@ bool processCopyAppendConsumeCounter(const AbiCopyAppendConsumeCounter* cmd, con
     {
         std::stringstream ss;
         ss << "source Resource in command copyAppendConsumeCounter is not an append consume buffer. Ensure this resource is a buffer with the flag isAppendConsume.";
-        context.errorType = ScheduleErrorType::InvalidResource;
-        context.errorMsg = ss.str();
+        check.errorType = ScheduleErrorType::InvalidResource;
+        check.errorMsg = ss.str();
         return false;
     }
 
@@ -603,21 +542,16 @@ bool processCopyAppendConsumeCounter(const AbiCopyAppendConsumeCounter* cmd, con
     {
         std::stringstream ss;
         ss << "Cannot fit 4 bytes in destination resource of copyAppendConsumeBuffer destination. Destination buffer must have at least 4 bytes of size left.";
-        context.errorType = ScheduleErrorType::OutOfBounds;
-        context.errorMsg = ss.str();
+        check.errorType = ScheduleErrorType::OutOfBounds;
+        check.errorMsg = ss.str();
         return false;
     }
 
-    if (!transitionResource(srcResourceInfoIt->second.counterBuffer, ResourceGpuState::CopySrc, context))
-        return false;
-
-    if (!transitionResource(cmd->destination, ResourceGpuState::CopyDst, context))
-        return false;
-
+    check.counterBuffer = srcResourceInfoIt->second.counterBuffer;
     return true;
 }
 
-bool processClearAppendConsume(const AbiClearAppendConsumeCounter* cmd, const unsigned char* data, WorkBuildContext& context)
+bool checkClearAppendConsume(const AbiClearAppendConsumeCounter* cmd, const CommandCheckContext& context, CommandCheck& check)
 {
     const auto& resourceInfos = *context.resourceInfos;
     const auto& resourceInfoIt = resourceInfos.find(cmd->source);
@@ -625,8 +559,8 @@ bool processClearAppendConsume(const AbiClearAppendConsumeCounter* cmd, const un
     {
         std::stringstream ss;
         ss << "Could not find resource with ID: " << cmd->source.handleId;
-        context.errorType = ScheduleErrorType::InvalidResource;
-        context.errorMsg = ss.str();
+        check.errorType = ScheduleErrorType::InvalidResource;
+        check.errorMsg = ss.str();
         return false;
     }
 
@@ -634,21 +568,201 @@ bool processClearAppendConsume(const AbiClearAppendConsumeCounter* cmd, const un
     {
         std::stringstream ss;
         ss << "Resource in command clearAppendConsume is not an append consume buffer. Ensure this resource is a buffer with the flag isAppendConsume.";
-        context.errorType = ScheduleErrorType::InvalidResource;
-        context.errorMsg = ss.str();
+        check.errorType = ScheduleErrorType::InvalidResource;
+        check.errorMsg = ss.str();
+        return false;
+    }
+
+    check.counterBuffer = resourceInfoIt->second.counterBuffer;
+    check.uploadSize = 4; //we are gonna just copy one int.
+    return true;
+}
+
+//Validation, resource lookups and memory queries only read the command and the registered resources,
+//so every command gets checked independently of the others and this runs in parallel.
+void checkCommand(const unsigned char* data, const CommandCheckContext& context, CommandInfo& info, CommandCheck& check)
+{
+    MemOffset offset = info.commandOffset;
+    switch ((AbiCmdTypes)(*((int*)(data + offset))))
+    {
+        case AbiCmdTypes::Compute:
+            checkCompute((const AbiComputeCmd*)(data + offset), check);
+            break;
+        case AbiCmdTypes::Copy:
+            checkCopy((const AbiCopyCmd*)(data + offset), context, check);
+            break;
+        case AbiCmdTypes::Upload:
+            checkUpload((const AbiUploadCmd*)(data + offset), context, info, check);
+            break;
+        case AbiCmdTypes::Download:
+            checkDownload((const AbiDownloadCmd*)(data + offset), context, check);
+            break;
+        case AbiCmdTypes::CopyAppendConsumeCounter:
+            checkCopyAppendConsumeCounter((const AbiCopyAppendConsumeCounter*)(data + offset), context, check);
+            break;
+        case AbiCmdTypes::ClearAppendConsumeCounter:
+            checkClearAppendConsume((const AbiClearAppendConsumeCounter*)(data + offset), context, check);
+            break;
+        default:
+            break;
+    }
+}
+
+//The process functions below track resource states and assign offsets, which depend on all the
+//commands before. Errors found by checkCommand are reported at the point they were originally found.
+bool processCompute(const AbiComputeCmd* cmd, const unsigned char* data, CommandCheck& check, WorkBuildContext& context)
+{
+    {
+        const InResourceTable* inTables = cmd->inResourceTables.data(data);
+        for (int i = 0; i < cmd->inResourceTablesCounts; ++i)
+        {
+            if (!processTable(inTables[i], context))
+                return false;
+        }
+    }
+
+    {
+        const OutResourceTable* outTables = cmd->outResourceTables.data(data);
+        for (int i = 0; i < cmd->outResourceTablesCounts; ++i)
+        {
+            if (!processTable(outTables[i], context))
+                return false;
+        }
+    }
+
+    {
+        const SamplerTable* samplerTables = cmd->samplerTables.data(data);
+        for (int i = 0; i < cmd->samplerTablesCounts; ++i)
+        {
+            if (!processSamplerTable(samplerTables[i], context))
+                return false;
+        }
+    }
+
+    {
+        const Buffer* cbuffers = cmd->constants.data(data);
+        CommandInfo& cmdInfo = context.currentCommandInfo();
+        if (cmd->inlineConstantBufferSize > 0)
+        {
+            //TODO: hack, dx12 requires aligned buffers to be 256.
+            cmdInfo.uploadBufferOffset = context.totalUploadBufferSize;
+            int alignedBufferOffset = ((cmdInfo.uploadBufferOffset + (ConstantBufferAlignment - 1)) / ConstantBufferAlignment) * ConstantBufferAlignment;
+            int alignedBufferSize = ((cmd->inlineConstantBufferSize + (ConstantBufferAlignment - 1))/ConstantBufferAlignment) * ConstantBufferAlignment;
+            int padding = alignedBufferOffset - context.totalUploadBufferSize;
+            cmdInfo.uploadBufferOffset += padding;
+            context.totalUploadBufferSize += alignedBufferSize + padding;
+
+            cmdInfo.constantBufferTableOffset = context.totalConstantBuffers;
+            ++context.totalConstantBuffers;
+        }
+        else
+        {
+            for (int i = 0; i < cmd->constantCounts; ++i)
+            {
+                if (!transitionResource(cbuffers[i], ResourceGpuState::Cbv, context))
+                    return false;
+            }
+
+            cmdInfo.constantBufferCount = cmd->constantCounts;
+            cmdInfo.constantBufferTableOffset = context.totalConstantBuffers;
+            context.totalConstantBuffers += cmdInfo.constantBufferCount;
+        }
+    }
+
+    if (cmd->isIndirect)
+    {
+        if (!applyCheck(check, context))
+            return false;
+
+        if (!transitionResource(cmd->indirectArguments, ResourceGpuState::IndirectArgs, context))
+            return false;
+    }
+
+    ++context.currentListInfo().computeCommandsCount;
+
+    return true;
+}
+
+bool processCopy(const AbiCopyCmd* cmd, CommandCheck& check, WorkBuildContext& context)
+{
+    if (!transitionResource(cmd->source, ResourceGpuState::CopySrc, context))
+        return false;
+
+    if (!transitionResource(cmd->destination, ResourceGpuState::CopyDst, context))
+        return false;
+
+    return applyCheck(check, context);
+}
+
+bool processUpload(const AbiUploadCmd* cmd, CommandCheck& check, WorkBuildContext& context)
+{
+    if (!transitionResource(cmd->destination, ResourceGpuState::CopyDst, context))
+        return false;
+
+    if (!applyCheck(check, context))
+        return false;
+
+    CommandInfo& info = context.currentCommandInfo();
+    info.uploadBufferOffset = context.totalUploadBufferSize;
+    context.totalUploadBufferSize += check.uploadSize;
+    return true;
+}
+
+bool processDownload(const AbiDownloadCmd* cmd, CommandCheck& check, WorkBuildContext& context)
+{
+    if (!applyCheck(check, context))
+        return false;
+
+    ResourceDownloadKey downloadKey { cmd->source, cmd->mipLevel, cmd->arraySlice };
+
+    auto it = context.resourcesToDownload.insert(downloadKey);
+    if (!it.second)
+    {
+        context.errorType = ScheduleErrorType::MultipleDownloadsOnSameResource;
+        context.errorMsg = "Multiple downloads on the same resource during the same schedule call. You are only allowed to download a resource once per scheduling bundle.";
         return false;
     }
 
-    if (!transitionResource(resourceInfoIt->second.counterBuffer, ResourceGpuState::CopyDst, context))
+    if (!transitionResource(cmd->source, ResourceGpuState::CopySrc, context))
+        return false;
+
+    context.currentCommandInfo().commandDownloadIndex = context.currentListInfo().downloadCommandsCount;
+    ++context.currentListInfo().downloadCommandsCount;
+
+    return true;
+}
+
+bool processCopyAppendConsumeCounter(const AbiCopyAppendConsumeCounter* cmd, CommandCheck& check, WorkBuildContext& context)
+{
+    if (!applyCheck(check, context))
+        return false;
+
+    if (!transitionResource(check.counterBuffer, ResourceGpuState::CopySrc, context))
+        return false;
+
+    if (!transitionResource(cmd->destination, ResourceGpuState::CopyDst, context))
+        return false;
+
+    return true;
+}
+
+bool processClearAppendConsume(const AbiClearAppendConsumeCounter* cmd, CommandCheck& check, WorkBuildContext& context)
+{
+    if (!applyCheck(check, context))
+        return false;
+
+    if (!transitionResource(check.counterBuffer, ResourceGpuState::CopyDst, context))
         return false;
 
     CommandInfo& info = context.currentCommandInfo();
     info.uploadBufferOffset = context.totalUploadBufferSize;
-    context.totalUploadBufferSize += 4u; //we are gonna just copy one int.
+    context.totalUploadBufferSize += check.uploadSize;
     return true;
 }
 
-void parseCommandList(const unsigned char* data, WorkBuildContext& context)
+//Walks the command list and records the offset of every command. Lists are scanned independently,
+//so this part of the build runs in parallel.
+void scanCommandList(const unsigned char* data, int listIndex, ProcessedList& processedList)
 {
     MemOffset offset = 0ull;
     const auto& header = *((AbiCommandListHeader*)data);
@@ -656,83 +770,90 @@ void parseCommandList(const unsigned char* data, WorkBuildContext& context)
 
     offset += sizeof(AbiCommandListHeader);
 
-    int listIndex = context.listIndex;
-    context.processedList[listIndex].listIndex = context.listIndex;
-    context.processedList[listIndex].commandSchedule = {};
+    processedList.listIndex = listIndex;
+    processedList.commandSchedule = {};
 
     bool finished = false;
-    int currentCommandIndex = 0;
     while (!finished)
     {
         auto currentSentinel = (AbiCmdTypes)(*((int*)(data + offset)));
-        context.command = offset;
-        context.currentCommandIndex = currentCommandIndex;
         if (currentSentinel != AbiCmdTypes::CommandListEndSentinel)
         {
-            context.processedList[listIndex].commandSchedule.emplace_back();
-            auto& cmdInfo = context.processedList[listIndex].commandSchedule.back();
-            cmdInfo.commandOffset = offset;
+            processedList.commandSchedule.emplace_back();
+            processedList.commandSchedule.back().commandOffset = offset;
         }
-            
+
         switch (currentSentinel)
         {
             case AbiCmdTypes::CommandListEndSentinel:
                 finished = true;
-                offset += sizeof(int);
                 break;
             case AbiCmdTypes::Compute:
-                {
-                    const auto* abiCmd = (const AbiComputeCmd*)(data + offset);
-                    finished = !processCompute(abiCmd, data, context);
-                    offset += abiCmd->cmdSize;
-                }
+                offset += ((const AbiComputeCmd*)(data + offset))->cmdSize;
                 break;
             case AbiCmdTypes::Copy:
-                {
-                    const auto* abiCmd = (const AbiCopyCmd*)(data + offset);
-                    finished = !processCopy(abiCmd, data, context);
-                    offset += abiCmd->cmdSize;
-                }
+                offset += ((const AbiCopyCmd*)(data + offset))->cmdSize;
                 break;
             case AbiCmdTypes::Upload:
-                {
-                    const auto* abiCmd = (const AbiUploadCmd*)(data + offset);
-                    finished = !processUpload(abiCmd, data, context);
-                    offset += abiCmd->cmdSize;
-                }
+                offset += ((const AbiUploadCmd*)(data + offset))->cmdSize;
                 break;
             case AbiCmdTypes::Download:
-                {
-                    const auto* abiCmd = (const AbiDownloadCmd*)(data + offset);
-                    finished = !processDownload(abiCmd, data, context);
-                    offset += abiCmd->cmdSize;
-                }
+                offset += ((const AbiDownloadCmd*)(data + offset))->cmdSize;
                 break;
             case AbiCmdTypes::CopyAppendConsumeCounter:
-                {
-                    const auto* abiCmd = (const AbiCopyAppendConsumeCounter*)(data + offset);
-                    finished = !processCopyAppendConsumeCounter(abiCmd, data, context);
-                    offset += abiCmd->cmdSize;
-                }
+                offset += ((const AbiCopyAppendConsumeCounter*)(data + offset))->cmdSize;
                 break;
             case AbiCmdTypes::ClearAppendConsumeCounter:
-                {
-                    const auto* abiCmd = (const AbiClearAppendConsumeCounter*)(data + offset);
-                    finished = !processClearAppendConsume(abiCmd, data, context);
-                    offset += abiCmd->cmdSize;
-                }
+                offset += ((const AbiClearAppendConsumeCounter*)(data + offset))->cmdSize;
                 break;
             case AbiCmdTypes::BeginMarker:
-                {
-                    const auto* abiCmd = (const AbiBeginMarker*)(data + offset);
-                    offset += abiCmd->cmdSize;
-                }
+                offset += ((const AbiBeginMarker*)(data + offset))->cmdSize;
                 break;
             case AbiCmdTypes::EndMarker:
-                {
-                    const auto* abiCmd = (const AbiEndMarker*)(data + offset);
-                    offset += abiCmd->cmdSize;
-                }
+                offset += ((const AbiEndMarker*)(data + offset))->cmdSize;
+                break;
+            default:
+                //The unrecognized command stays in the schedule, processCommandList reports it.
+                finished = true;
+                break;
+        }
+    }
+}
+
+//Resource states carry over from one command to the next, so lists get processed in order.
+void processCommandList(const unsigned char* data, std::vector<CommandCheck>& checks, WorkBuildContext& context)
+{
+    auto& commandSchedule = context.currentListInfo().commandSchedule;
+    bool finished = false;
+    for (int currentCommandIndex = 0; !finished && currentCommandIndex < (int)commandSchedule.size(); ++currentCommandIndex)
+    {
+        MemOffset offset = commandSchedule[currentCommandIndex].commandOffset;
+        auto currentSentinel = (AbiCmdTypes)(*((int*)(data + offset)));
+        CommandCheck& check = checks[currentCommandIndex];
+        context.command = offset;
+        context.currentCommandIndex = currentCommandIndex;
+        switch (currentSentinel)
+        {
+            case AbiCmdTypes::Compute:
+                finished = !processCompute((const AbiComputeCmd*)(data + offset), data, check, context);
+                break;
+            case AbiCmdTypes::Copy:
+                finished = !processCopy((const AbiCopyCmd*)(data + offset), check, context);
+                break;
+            case AbiCmdTypes::Upload:
+                finished = !processUpload((const AbiUploadCmd*)(data + offset), check, context);
+                break;
+            case AbiCmdTypes::Download:
+                finished = !processDownload((const AbiDownloadCmd*)(data + offset), check, context);
+                break;
+            case AbiCmdTypes::CopyAppendConsumeCounter:
+                finished = !processCopyAppendConsumeCounter((const AbiCopyAppendConsumeCounter*)(data + offset), check, context);
+                break;
+            case AbiCmdTypes::ClearAppendConsumeCounter:
+                finished = !processClearAppendConsume((const AbiClearAppendConsumeCounter*)(data + offset), check, context);
+                break;
+            case AbiCmdTypes::BeginMarker:
+            case AbiCmdTypes::EndMarker:
                 break;
             default:
             {
@@ -744,51 +865,106 @@ void parseCommandList(const unsigned char* data, WorkBuildContext& context)
                 break;
             }
         }
-        ++currentCommandIndex;
     }
 }
 
+struct ListScanResult
+{
+    ScheduleErrorType errorType = ScheduleErrorType::Ok;
+    std::string errorMsg;
+    std::vector<CommandCheck> commandChecks;
+};
+
 }
 
 ScheduleStatus WorkBundleDb::build(CommandList** lists, int listCount)
 {
+    CPY_PROFILE_SCOPE("WorkBundleDb::build");
     WorkHandle handle;
     WorkBundle newBundle;
 
-    //todo build the bundle here
     {
         std::unique_lock lock(m_workMutex);
-        //todo error handling
         WorkBuildContext ctx;
         ctx.device = &m_device;
         ctx.resourceInfos = &m_resources;
         ctx.tableInfos = &m_tables;
+        ctx.processedList.resize(listCount);
+
+        std::vector<ListScanResult> scanResults(listCount);
+        auto scanLists = [lists, &ctx, &scanResults](int begin, int end)
+        {
+            for (int l = begin; l < end; ++l)
+            {
+                CommandList* list = lists[l];
+                ListScanResult& scanResult = scanResults[l];
+                if (!list)
+                {
+                    std::stringstream ss;
+                    ss << "List at index " << l << " is a null pointer.";
+                    scanResult.errorType = ScheduleErrorType::NullListFound;
+                    scanResult.errorMsg = ss.str();
+                    continue;
+                }
+
+                if (!list->isFinalized())
+                {
+                    std::stringstream ss;
+                    ss << "List at index " << l << " not finalized.";
+                    scanResult.errorType = ScheduleErrorType::ListNotFinalized;
+                    scanResult.errorMsg = ss.str();
+                    continue;
+                }
+
+                scanCommandList(list->data(), l, ctx.processedList[l]);
+                scanResult.commandChecks.resize(ctx.processedList[l].commandSchedule.size());
+            }
+        };
+
+        if (m_ts)
+            m_ts->parallelFor(0, listCount, 1, scanLists);
+        else
+            scanLists(0, listCount);
+
+        //Commands get checked over one flat range, so the work spreads evenly even if a single list holds most of it.
+        std::vector<int> listCommandBegin(listCount + 1, 0);
         for (int l = 0; l < listCount; ++l)
+            listCommandBegin[l + 1] = listCommandBegin[l] + (int)ctx.processedList[l].commandSchedule.size();
+
+        CommandCheckContext checkCtx;
+        checkCtx.device = &m_device;
+        checkCtx.resourceInfos = &m_resources;
+        auto checkCommands = [lists, &ctx, &scanResults, &listCommandBegin, &checkCtx](int begin, int end)
         {
-            CommandList* list = lists[l];
-            if (!list)
+            int l = (int)(std::upper_bound(listCommandBegin.begin(), listCommandBegin.end(), begin) - listCommandBegin.begin()) - 1;
+            for (int c = begin; c < end; ++c)
             {
-                std::stringstream ss;
-                ss << "List at index " << l << " is a null pointer.";
-                ctx.errorType = ScheduleErrorType::NullListFound;
-                ctx.errorMsg = ss.str();
-                break;
+                while (c >= listCommandBegin[l + 1])
+                    ++l;
+
+                int commandIndex = c - listCommandBegin[l];
+                checkCommand(lists[l]->data(), checkCtx, ctx.processedList[l].commandSchedule[commandIndex], scanResults[l].commandChecks[commandIndex]);
             }
+        };
+
+        if (m_ts)
+            m_ts->parallelFor(0, listCommandBegin[listCount], CommandsPerCheckTask, checkCommands);
+        else
+            checkCommands(0, listCommandBegin[listCount]);
 
-            if (!list->isFinalized())
+        for (int l = 0; l < listCount && ctx.errorType == ScheduleErrorType::Ok; ++l)
+        {
+            if (scanResults[l].errorType != ScheduleErrorType::Ok)
             {
-                std::stringstream ss;
-                ss << "List at index " << l << " not finalized.";
-                ctx.errorType = ScheduleErrorType::ListNotFinalized;
-                ctx.errorMsg = ss.str();
+                ctx.errorType = scanResults[l].errorType;
+                ctx.errorMsg = std::move(scanResults[l].errorMsg);
                 break;
             }
 
             ctx.listIndex = l;
             ctx.currentCommandIndex = 0;
             ctx.command = 0;
-            ctx.processedList.emplace_back();
-            parseCommandList(list->data(), ctx);
+            processCommandList(lists[l]->data(), scanResults[l].commandChecks, ctx);
         }
 
         if (ctx.errorType != ScheduleErrorType::Ok)
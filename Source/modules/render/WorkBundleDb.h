@@ -14,6 +14,8 @@
 namespace coalpy
 {
 
+class ITaskSystem;
+
 namespace render
 {
 
@@ -239,7 +241,7 @@ using WorkResourceInfos = std::unordered_map<ResourceHandle, WorkResourceInfo>;
 class WorkBundleDb
 {
 public:
-    WorkBundleDb(IDevice& device) : m_device(device) {}
+    WorkBundleDb(IDevice& device, ITaskSystem* ts = nullptr) : m_device(device), m_ts(ts) {}
     ~WorkBundleDb() {}
 
     ScheduleStatus build(CommandList** lists, int listCount);
@@ -272,6 +274,7 @@ private:
     std::mutex m_workMutex;
 
     IDevice& m_device;
+    ITaskSystem* m_ts;
     HandleContainer<WorkHandle, WorkBundle> m_works;
 
     WorkTableInfos m_tables;
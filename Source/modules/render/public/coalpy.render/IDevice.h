@@ -13,6 +13,7 @@ namespace coalpy
 {
 
 class IShaderDb;
+class ITaskSystem;
 
 namespace render
 {
@@ -36,6 +37,7 @@ struct DeviceConfig
     DevicePlat platform = DevicePlat::Dx12;
     ModuleOsHandle moduleHandle = nullptr;
     IShaderDb* shaderDb = nullptr;
+    ITaskSystem* ts = nullptr; //optional, used to spread cpu side work of schedule() across threads.
     DeviceFlags flags = DeviceFlags::None;
     std::string resourcePath;
     int index = -1;
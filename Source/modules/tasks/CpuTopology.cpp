@@ -0,0 +1,235 @@
+#include "CpuTopology.h"
+#include <algorithm>
+#include <string>
+#include <thread>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#include <windows.h>
+#elif defined(__linux__)
+#include <sched.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#endif
+
+namespace coalpy
+{
+
+namespace
+{
+
+#ifdef _WIN32
+
+int findMaskEntry(const std::vector<GROUP_AFFINITY>& masks, int cpuId)
+{
+    for (int i = 0; i < (int)masks.size(); ++i)
+    {
+        if (masks[i].Group == (WORD)(cpuId / 64) && (masks[i].Mask & ((KAFFINITY)1 << (cpuId % 64))) != 0)
+            return i;
+    }
+    return -1;
+}
+
+bool queryOsTopology(std::vector<CpuCore>& cores)
+{
+    DWORD length = 0;
+    GetLogicalProcessorInformationEx(RelationAll, nullptr, &length);
+    if (length == 0)
+        return false;
+
+    std::vector<char> buffer(length);
+    if (!GetLogicalProcessorInformationEx(RelationAll, (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)buffer.data(), &length))
+        return false;
+
+    std::vector<GROUP_AFFINITY> l3Masks;
+    std::vector<GROUP_AFFINITY> numaMasks;
+    std::vector<int> numaNodes;
+    for (DWORD offset = 0; offset < length;)
+    {
+        auto* info = (PSYSTEM_LOGICAL_PROCESSOR_INFORMATION_EX)(buffer.data() + offset);
+        switch (info->Relationship)
+        {
+        case RelationProcessorCore:
+            for (WORD g = 0; g < info->Processor.GroupCount; ++g)
+            {
+                const GROUP_AFFINITY& groupMask = info->Processor.GroupMask[g];
+                for (int bit = 0; bit < 64; ++bit)
+                    if ((groupMask.Mask & ((KAFFINITY)1 << bit)) != 0)
+                        cores.push_back(CpuCore { (int)groupMask.Group * 64 + bit, 0, 0 });
+            }
+            break;
+        case RelationCache:
+            if (info->Cache.Level == 3)
+                l3Masks.push_back(info->Cache.GroupMask);
+            break;
+        case RelationNumaNode:
+            numaMasks.push_back(info->NumaNode.GroupMask);
+            numaNodes.push_back((int)info->NumaNode.NodeNumber);
+            break;
+        default:
+            break;
+        }
+        offset += info->Size;
+    }
+
+    for (auto& c : cores)
+    {
+        c.l3Domain = findMaskEntry(l3Masks, c.cpuId);
+        int numaEntry = findMaskEntry(numaMasks, c.cpuId);
+        c.numaNode = numaEntry >= 0 ? numaNodes[numaEntry] : 0;
+    }
+
+    return !cores.empty();
+}
+
+#elif defined(__linux__)
+
+bool readInt(const std::string& path, int& outValue)
+{
+    FILE* f = fopen(path.c_str(), "r");
+    if (!f)
+        return false;
+
+    //cpu lists ("0-3,8") parse as their first cpu.
+    bool success = fscanf(f, "%d", &outValue) == 1;
+    fclose(f);
+    return success;
+}
+
+int readNumaNode(const std::string& cpuPath)
+{
+    DIR* dir = opendir(cpuPath.c_str());
+    if (!dir)
+        return 0;
+
+    int node = 0;
+    while (dirent* entry = readdir(dir))
+    {
+        if (strncmp(entry->d_name, "node", 4) == 0 && isdigit((unsigned char)entry->d_name[4]))
+        {
+            node = atoi(entry->d_name + 4);
+            break;
+        }
+    }
+    closedir(dir);
+    return node;
+}
+
+//First cpu sharing the highest level cache, -1 if the kernel does not expose caches.
+int readLastLevelCacheKey(const std::string& cpuPath)
+{
+    int bestLevel = -1;
+    int key = -1;
+    for (int index = 0; ; ++index)
+    {
+        std::string cachePath = cpuPath + "/cache/index" + std::to_string(index);
+        int level = 0;
+        if (!readInt(cachePath + "/level", level))
+            break;
+
+        int firstCpu = 0;
+        if (level > bestLevel && readInt(cachePath + "/shared_cpu_list", firstCpu))
+        {
+            bestLevel = level;
+            key = firstCpu;
+        }
+    }
+    return key;
+}
+
+bool queryOsTopology(std::vector<CpuCore>& cores)
+{
+    cpu_set_t allowed;
+    CPU_ZERO(&allowed);
+    if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0)
+        return false;
+
+    for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu)
+    {
+        if (!CPU_ISSET(cpu, &allowed))
+            continue;
+
+        std::string cpuPath = "/sys/devices/system/cpu/cpu" + std::to_string(cpu);
+        cores.push_back(CpuCore { cpu, readLastLevelCacheKey(cpuPath), readNumaNode(cpuPath) });
+    }
+
+    return !cores.empty();
+}
+
+#else
+
+bool queryOsTopology(std::vector<CpuCore>& cores)
+{
+    return false;
+}
+
+#endif
+
+//Remaps the raw ids in a member to 0..n-1, in the order they first appear.
+int compactIds(std::vector<CpuCore>& cores, int CpuCore::* member)
+{
+    std::vector<int> rawIds;
+    for (auto& c : cores)
+    {
+        auto it = std::find(rawIds.begin(), rawIds.end(), c.*member);
+        int id = (int)(it - rawIds.begin());
+        if (it == rawIds.end())
+            rawIds.push_back(c.*member);
+        c.*member = id;
+    }
+    return std::max((int)rawIds.size(), 1);
+}
+
+}
+
+void queryCpuTopology(CpuTopology& outTopology)
+{
+    outTopology.cores.clear();
+    if (!queryOsTopology(outTopology.cores))
+    {
+        outTopology.cores.clear();
+        int cpuCount = std::max((int)std::thread::hardware_concurrency(), 1);
+        for (int cpu = 0; cpu < cpuCount; ++cpu)
+            outTopology.cores.push_back(CpuCore { cpu, 0, 0 });
+    }
+
+    std::stable_sort(outTopology.cores.begin(), outTopology.cores.end(), [](const CpuCore& a, const CpuCore& b)
+    {
+        if (a.numaNode != b.numaNode)
+            return a.numaNode < b.numaNode;
+        if (a.l3Domain != b.l3Domain)
+            return a.l3Domain < b.l3Domain;
+        return a.cpuId < b.cpuId;
+    });
+
+    outTopology.numaNodeCount = compactIds(outTopology.cores, &CpuCore::numaNode);
+    outTopology.l3DomainCount = compactIds(outTopology.cores, &CpuCore::l3Domain);
+}
+
+bool pinCurrentThread(int cpuId)
+{
+#ifdef _WIN32
+    GROUP_AFFINITY affinity = {};
+    affinity.Group = (WORD)(cpuId / 64);
+    affinity.Mask = (KAFFINITY)1 << (cpuId % 64);
+    return SetThreadGroupAffinity(GetCurrentThread(), &affinity, nullptr) != 0;
+#elif defined(__linux__)
+    if (cpuId < 0 || cpuId >= CPU_SETSIZE)
+        return false;
+
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(cpuId, &set);
+    return pthread_setaffinity_np(pthread_self(), sizeof(set), &set) == 0;
+#else
+    return false;
+#endif
+}
+
+}
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <vector>
+
+namespace coalpy
+{
+
+struct CpuCore
+{
+    //Os logical processor index (on windows the processor group is folded in: group * 64 + index).
+    int cpuId;
+    //Logical processors sharing the last level cache get the same id.
+    int l3Domain;
+    int numaNode;
+};
+
+//Logical processors this process is allowed to run on, sorted by numa node, then l3 domain, then cpu id.
+//Domain ids are compacted, so they go from 0 to count - 1.
+struct CpuTopology
+{
+    std::vector<CpuCore> cores;
+    int l3DomainCount = 1;
+    int numaNodeCount = 1;
+};
+
+//Falls back to a single domain with std::thread::hardware_concurrency cores when the os does not tell.
+void queryCpuTopology(CpuTopology& outTopology);
+
+//Pins the calling thread to a logical processor, returns false if the os refused or does not support it.
+bool pinCurrentThread(int cpuId);
+
+}
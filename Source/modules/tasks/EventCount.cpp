@@ -0,0 +1,131 @@
+#include <coalpy.tasks/EventCount.h>
+#include <chrono>
+
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include <time.h>
+#include <climits>
+#include <cerrno>
+#else
+#include <mutex>
+#include <condition_variable>
+#endif
+
+namespace coalpy
+{
+
+#ifdef __linux__
+
+struct EventCount::ParkState {};
+
+namespace
+{
+
+bool futexWait(std::atomic<unsigned>* addr, unsigned expected, int milliseconds)
+{
+    timespec ts;
+    timespec* timeout = nullptr;
+    if (milliseconds >= 0)
+    {
+        ts.tv_sec = milliseconds / 1000;
+        ts.tv_nsec = (long)(milliseconds % 1000) * 1000000;
+        timeout = &ts;
+    }
+
+    long r = syscall(SYS_futex, reinterpret_cast<unsigned*>(addr), FUTEX_WAIT_PRIVATE, expected, timeout, nullptr, 0);
+    return r == 0 || errno != ETIMEDOUT;
+}
+
+void futexWake(std::atomic<unsigned>* addr, bool all)
+{
+    syscall(SYS_futex, reinterpret_cast<unsigned*>(addr), FUTEX_WAKE_PRIVATE, all ? INT_MAX : 1, nullptr, nullptr, 0);
+}
+
+}
+
+#else
+
+struct EventCount::ParkState
+{
+    std::mutex mutex;
+    std::condition_variable cv;
+};
+
+#endif
+
+EventCount::EventCount()
+: m_epoch(0), m_waiters(0)
+{
+#ifndef __linux__
+    m_parkState = new ParkState;
+#endif
+}
+
+EventCount::~EventCount()
+{
+    delete m_parkState;
+}
+
+unsigned EventCount::prepareWait()
+{
+    m_waiters.fetch_add(1, std::memory_order_relaxed);
+    //pairs with the fence in notify: either the notifier sees this waiter, or the waiter's re-check sees the new state.
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    return m_epoch.load(std::memory_order_relaxed);
+}
+
+void EventCount::cancelWait()
+{
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+}
+
+void EventCount::wait(unsigned key)
+{
+    waitFor(key, -1);
+}
+
+bool EventCount::waitFor(unsigned key, int milliseconds)
+{
+    bool notified = true;
+#ifdef __linux__
+    //spurious wake ups are fine, callers re-check their condition.
+    if (m_epoch.load(std::memory_order_acquire) == key)
+        notified = futexWait(&m_epoch, key, milliseconds);
+#else
+    {
+        std::unique_lock<std::mutex> lock(m_parkState->mutex);
+        auto pred = [this, key]() { return m_epoch.load(std::memory_order_acquire) != key; };
+        if (milliseconds < 0)
+            m_parkState->cv.wait(lock, pred);
+        else
+            notified = m_parkState->cv.wait_for(lock, std::chrono::milliseconds(milliseconds), pred);
+    }
+#endif
+    m_waiters.fetch_sub(1, std::memory_order_relaxed);
+    return notified;
+}
+
+void EventCount::notify(bool all)
+{
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (m_waiters.load(std::memory_order_relaxed) == 0)
+        return;
+
+    m_epoch.fetch_add(1, std::memory_order_release);
+#ifdef __linux__
+    futexWake(&m_epoch, all);
+#else
+    {
+        //an empty critical section is enough, a waiter either saw the new epoch or is already parked on the cv.
+        std::lock_guard<std::mutex> lock(m_parkState->mutex);
+    }
+    if (all)
+        m_parkState->cv.notify_all();
+    else
+        m_parkState->cv.notify_one();
+#endif
+}
+
+}
@@ -1,6 +1,10 @@
 #include "TaskSystem.h"
-#include <coalpy.tasks/ThreadQueue.h>
+#include "WorkStealingQueue.h"
+#include "TaskTracer.h"
+#include <coalpy.tasks/LockFreeQueue.h>
 #include <coalpy.core/Assert.h>
+#include <coalpy.core/Profiler.h>
+#include <algorithm>
 #include <chrono>
 #include <thread>
 
@@ -21,19 +25,62 @@ struct TaskScheduleMessage
     std::vector<Task> tasks;
 };
 
-class TaskSchedulerQueue : public ThreadQueue<TaskScheduleMessage> {};
+//Every worker reports finished tasks to the scheduler thread.
+class TaskSchedulerQueue : public LockFreeQueue<TaskScheduleMessage> {};
+
+//Tasks made ready by threads that are not workers of this system land here, all idle workers poll it.
+class TaskInjectionQueue : public LockFreeQueue<Task> {};
+
+namespace
+{
+
+//Scratch lists used while walking the task graph, recycled per thread.
+struct SchedulingScratch
+{
+    std::vector<Task> pendingTasks;
+    std::vector<Task> readyTasks;
+    std::vector<Task> nextTasks;
+    std::vector<Task> graphTasks;
+    std::vector<Task> graphSources;
+    std::vector<int> wokenWorkers;
+};
+
+thread_local SchedulingScratch t_schedulingScratch;
+
+void eraseTask(std::vector<Task>& tasks, Task t)
+{
+    tasks.erase(std::remove(tasks.begin(), tasks.end(), t), tasks.end());
+}
+
+}
+
+void TaskSystem::TaskData::reset()
+{
+    desc = TaskDesc();
+    sharedDesc = nullptr;
+    data = nullptr;
+    dependencies.clear();
+    parents.clear();
+    pendingDependencies = 0;
+    state = TaskState::Unscheduled;
+    externalWaiters = 0;
+    waitingWorkers.clear();
+    continuation = nullptr;
+    cancelled = false;
+}
 
 Task TaskSystem::createTask(const TaskDesc& taskDesc, void* taskData)
 {
 
     Task outHandle;
-    {
-        std::unique_lock lock(m_stateMutex);
-        TaskData& data = m_taskTable.allocate(outHandle);
-        data.desc = taskDesc;
-        data.data = taskData;
-        data.syncData = new SyncData;
-    }
+    TaskData& data = m_taskTable.allocate(outHandle);
+    CPY_ERROR_MSG(outHandle.valid(), "Task table is full.");
+    if (!outHandle.valid())
+        return outHandle;
+
+    data.reset();
+    data.desc = taskDesc;
+    data.data = taskData;
 
     if ((taskDesc.flags & (int)TaskFlags::AutoStart) != 0)
         execute(outHandle);
@@ -41,9 +88,25 @@ Task TaskSystem::createTask(const TaskDesc& taskDesc, void* taskData)
 }
 
 TaskSystem::TaskSystem(const TaskSystemDesc& desc)
-: m_schedulerQueue(std::make_unique<TaskSchedulerQueue>())
+: m_desc(desc)
+, m_schedulerQueue(std::make_unique<TaskSchedulerQueue>())
+, m_idleCount(0)
 , m_nextWorker(0u)
+, m_nextIoWorker(0u)
+, m_steals(0)
+, m_cancelledTasks(0)
+, m_externalBlockedNs(0)
 {
+    m_desc.ioThreadPoolSize = std::max(m_desc.ioThreadPoolSize, 0);
+    queryCpuTopology(m_topology);
+    if (m_desc.threadPoolSize <= 0)
+        m_desc.threadPoolSize = (int)m_topology.cores.size();
+    if (m_desc.enableTracing)
+        m_tracer = std::make_unique<TaskTracer>(m_desc.traceEventsPerThread);
+    for (auto& q : m_injectionQueues)
+        q = std::make_unique<TaskInjectionQueue>();
+    for (auto& q : m_ioQueues)
+        q = std::make_unique<TaskInjectionQueue>();
 }
 
 TaskSystem::~TaskSystem()
@@ -53,10 +116,7 @@ TaskSystem::~TaskSystem()
     signalStop();
     join();
 
-    int aliveTasks = 0;
-    m_taskTable.forEach([&aliveTasks](Task task, TaskData& data){
-        aliveTasks += data.syncData == nullptr ? 0 : 1;
-    });
+    int aliveTasks = m_taskTable.elementsCount();
 
     CPY_ASSERT_FMT(aliveTasks == 0, "%d still alive tasks detected. This will cause memory leaks.", aliveTasks);
 }
@@ -65,23 +125,53 @@ void TaskSystem::start()
 {
     std::unique_lock lock(m_stateMutex);
 
-    CPY_ASSERT_MSG(m_schedulerThread == nullptr, "Task system cannot start, must call signalStop followed by join().");
-    if (m_schedulerThread)
+    CPY_ASSERT_MSG(!m_started, "Task system cannot start, must call signalStop followed by join().");
+    if (m_started)
         return;
 
-    m_workers.resize(m_desc.threadPoolSize);
+    m_started = true;
+    m_computeWorkerCount = m_desc.threadPoolSize;
+    m_workers.resize(m_desc.threadPoolSize + m_desc.ioThreadPoolSize);
+
+    if (isWorkStealing())
+    {
+        m_idleWorkers = std::make_unique<std::atomic<bool>[]>(m_workers.size());
+        for (int i = 0; i < (int)m_workers.size(); ++i)
+            m_idleWorkers[i] = false;
+        m_idleCount = 0;
+    }
+
     int nextId = 0;
     for (auto& w : m_workers)
-    {
         w.setId(nextId++);
-        w.start([this](Task t) { this->onTaskComplete(t); });
+    layoutWorkers();
+
+    for (auto& w : m_workers)
+    {
+        w.setTracer(m_tracer.get());
+        YieldFn yieldFn = [this](ThreadWorker& worker, TaskBlockFn& blockFn) { this->onYield(worker, blockFn); };
+        if (isWorkStealing())
+            w.start(
+                [this](Task t) { this->onTaskComplete(t); },
+                [this](ThreadWorker& worker, TaskFn& fn, TaskContext& ctx) { return this->findTask(worker, fn, ctx); },
+                yieldFn);
+        else
+            w.start([this](Task t) { this->onTaskComplete(t); }, nullptr, yieldFn);
     }
 
-    m_schedulerThread = std::make_unique<std::thread>([this]() { onMessageLoop(); });
+    if (!isWorkStealing())
+        m_schedulerThread = std::make_unique<std::thread>([this]() { onMessageLoop(); });
 }
 
 void TaskSystem::signalStop()
 {
+    if (isWorkStealing())
+    {
+        for (auto& w : m_workers)
+            w.signalStop();
+        return;
+    }
+
     TaskScheduleMessage msg;
     msg.type = TaskScheduleMessageType::Exit;
     m_schedulerQueue->push(msg);
@@ -89,18 +179,27 @@ void TaskSystem::signalStop()
 
 void TaskSystem::join()
 {
-    if (!m_schedulerThread)
+    if (!m_started)
         return;
 
-    m_schedulerThread->join();
+    if (m_schedulerThread)
+        m_schedulerThread->join();
+
     for (auto& w : m_workers)
         w.join();
 
-    m_schedulerThread.release();
+    m_schedulerThread.reset();
+    m_started = false;
 }
 
 void TaskSystem::execute(Task task)
 {
+    if (isWorkStealing())
+    {
+        scheduleReadyTasks(&task, 1, false);
+        return;
+    }
+
     TaskScheduleMessage msg = {};
     msg.type = TaskScheduleMessageType::RunJob;
     msg.task = task;
@@ -109,33 +208,26 @@ void TaskSystem::execute(Task task)
 
 void TaskSystem::execute(Task* tasks, int counts)
 {
+    if (isWorkStealing())
+    {
+        scheduleReadyTasks(tasks, counts, false);
+        return;
+    }
+
     TaskScheduleMessage msg = {};
     msg.type = TaskScheduleMessageType::RunJobs;
     msg.tasks.assign(tasks, tasks + counts);
-    m_schedulerQueue->push(msg);
+    m_schedulerQueue->push(std::move(msg));
 }
 
 void TaskSystem::depends(Task src, Task dst)
 {
-    std::unique_lock lock(m_stateMutex);
-
-    bool hasSrcTask = m_taskTable.contains(src);
-    bool hasDstTask = m_taskTable.contains(dst);
-    CPY_ASSERT_MSG(hasSrcTask, "Src task must exist");
-    CPY_ASSERT_MSG(hasDstTask, "Dst task must exist");
-    if (!hasSrcTask || !hasDstTask)
-        return;
-
-    TaskData& srcTaskData = m_taskTable[src];
-    TaskData& dstTaskData = m_taskTable[dst];
-    srcTaskData.initialDependencies.insert(dst);
-    srcTaskData.dependencies.insert(dst);
-    dstTaskData.parents.insert(src);
+    depends(src, &dst, 1);
 }
 
 void TaskSystem::depends(Task src, Task* dsts, int counts)
 {
-    std::unique_lock lock(m_stateMutex);
+    std::shared_lock lock(m_stateMutex);
 
     bool hasSrcTask = m_taskTable.contains(src);
     CPY_ASSERT_MSG(hasSrcTask, "Src task must exist");
@@ -153,54 +245,90 @@ void TaskSystem::depends(Task src, Task* dsts, int counts)
         
         TaskData& dstTaskData = m_taskTable[dstTask];
 
-        srcTaskData.initialDependencies.insert(dstTask);
-        srcTaskData.dependencies.insert(dstTask);
-        dstTaskData.parents.insert(src);
+        //Running tasks are allowed to add dependencies to the same parent (see parallelFor).
+        srcTaskData.lockEdges();
+        srcTaskData.dependencies.push_back(dstTask);
+        srcTaskData.unlockEdges();
+
+        //A finished dependency only needs to be tracked for cleanTaskTree.
+        dstTaskData.lockEdges();
+        if (dstTaskData.state.load() != TaskState::Finished)
+        {
+            dstTaskData.parents.push_back(src);
+            srcTaskData.pendingDependencies.fetch_add(1);
+        }
+        dstTaskData.unlockEdges();
     }
 }
 
-void TaskSystem::onScheduleTask(Task* tasks, int counts)
+void TaskSystem::collectReadyTasks(const Task* tasks, int counts, std::vector<Task>& readyTasks)
 {
-    struct RunCommand
+    std::vector<Task>& pendingTasks = t_schedulingScratch.pendingTasks;
+    pendingTasks.assign(tasks, tasks + counts);
+    while (!pendingTasks.empty())
     {
-        TaskContext context;
-        TaskFn fn;
-    };
+        Task t = pendingTasks.back();
+        pendingTasks.pop_back();
+        if (!m_taskTable.contains(t))
+        {
+            CPY_ERROR_MSG(false, "Missing task while scheduling it?");
+            continue;
+        }
 
-    for (int i = 0; i < counts; ++i)
-    {
-        Task t = tasks[i];
+        auto& taskData = m_taskTable[t];
+        if (taskData.state.load() != TaskState::Unscheduled)
+            continue;
+
+        //Only signal finishes these.
+        if ((taskData.getDesc().flags & (int)TaskFlags::External) != 0)
+            continue;
+
+        if (taskData.pendingDependencies.load() > 0)
         {
-            std::unique_lock lock(m_stateMutex);
-            std::vector<Task> childTasks;
-            if (!m_taskTable.contains(t))
+            for (auto dep : taskData.dependencies)
             {
-                CPY_ERROR_MSG(false, "Missing task while scheduling it?");
-                continue;
+                if (m_taskTable[dep].state.load() == TaskState::Unscheduled)
+                    pendingTasks.push_back(dep);
             }
-        
-            auto& taskData = m_taskTable[t];
-            if (taskData.syncData->state != TaskState::Unscheduled)
-                continue;
+            continue;
+        }
 
-            if (!taskData.dependencies.empty())
-            {
-                taskData.syncData->state = TaskState::Unscheduled;
-                for (auto dep : taskData.dependencies)
-                {
-                    if (m_taskTable[dep].syncData->state == TaskState::Unscheduled)
-                        childTasks.push_back(dep);
-                }
-            }
-            else
-            {
-                taskData.syncData->state = TaskState::InWorker;
-                taskData.syncData->workerId = m_nextWorker;
-                TaskContext context = { t, taskData.data, this };
-                m_workers[m_nextWorker].schedule(taskData.desc.fn, context);
-                m_nextWorker = (m_nextWorker + 1) % (int)m_workers.size();
-            }
-            execute(childTasks.data(), (int)childTasks.size());
+        //Races against the completion of the last dependency, only one thread gets to schedule it.
+        TaskState expected = TaskState::Unscheduled;
+        if (taskData.state.compare_exchange_strong(expected, TaskState::InWorker))
+            readyTasks.push_back(t);
+    }
+}
+
+void TaskSystem::onScheduleTask(Task* tasks, int counts)
+{
+    std::vector<Task>& readyTasks = t_schedulingScratch.readyTasks;
+    readyTasks.clear();
+    collectReadyTasks(tasks, counts, readyTasks);
+
+    //Worker queues are fifo, so higher priority tasks of a batch get dispatched first.
+    std::stable_sort(readyTasks.begin(), readyTasks.end(), [this](Task a, Task b)
+    {
+        return m_taskTable[a].getDesc().priority < m_taskTable[b].getDesc().priority;
+    });
+
+    int ioWorkerCount = (int)m_workers.size() - m_computeWorkerCount;
+    for (Task t : readyTasks)
+    {
+        auto& taskData = m_taskTable[t];
+        if (m_tracer)
+            m_tracer->record(TraceEventType::Scheduled, t, taskData.getDesc().name);
+
+        TaskContext context = { t, taskData.data, this };
+        if (isIoTask(taskData.getDesc()))
+        {
+            m_workers[m_computeWorkerCount + m_nextIoWorker].schedule(dispatchFn(taskData), context);
+            m_nextIoWorker = (m_nextIoWorker + 1) % ioWorkerCount;
+        }
+        else
+        {
+            m_workers[m_nextWorker].schedule(dispatchFn(taskData), context);
+            m_nextWorker = (m_nextWorker + 1) % m_computeWorkerCount;
         }
     }
 }
@@ -230,61 +358,721 @@ void TaskSystem::onMessageLoop()
     }
 }
 
-void TaskSystem::runSingleJob(ThreadWorker& worker)
+bool TaskSystem::isOwnWorker(const ThreadWorker* worker) const
+{
+    return worker != nullptr && !m_workers.empty()
+        && worker >= m_workers.data() && worker < (m_workers.data() + m_workers.size());
+}
+
+bool TaskSystem::isIoWorker(const ThreadWorker* worker) const
+{
+    return isOwnWorker(worker) && worker->id() >= m_computeWorkerCount;
+}
+
+void TaskSystem::scheduleReadyTasks(Task* tasks, int counts, bool fromCompletion)
+{
+    if (counts == 0)
+        return;
+
+    std::vector<Task>& readyTasks = t_schedulingScratch.readyTasks;
+    readyTasks.clear();
+    collectReadyTasks(tasks, counts, readyTasks);
+    pushReadyTasks(readyTasks, fromCompletion);
+}
+
+void TaskSystem::pushReadyTasks(const std::vector<Task>& readyTasks, bool fromCompletion)
+{
+    if (readyTasks.empty())
+        return;
+
+    ThreadWorker* localWorker = ThreadWorker::getLocalThreadWorker();
+    bool isLocalWorker = isOwnWorker(localWorker);
+    bool pushToDeque = isLocalWorker && !isIoWorker(localWorker);
+    int computeWakeCount = 0;
+    int ioWakeCount = 0;
+    for (Task t : readyTasks)
+    {
+        const TaskDesc& desc = m_taskTable[t].getDesc();
+        if (m_tracer)
+            m_tracer->record(TraceEventType::Scheduled, t, desc.name);
+
+        if (isIoTask(desc))
+        {
+            m_ioQueues[(int)desc.priority]->push(t);
+            ++ioWakeCount;
+        }
+        else
+        {
+            if (pushToDeque)
+                localWorker->deque(desc.priority).push(t);
+            else
+                m_injectionQueues[(int)desc.priority]->push(t);
+            ++computeWakeCount;
+        }
+    }
+
+    //A worker completing a task picks up one of the tasks of its lane itself right away.
+    if (fromCompletion && isLocalWorker)
+    {
+        int& localWakeCount = isIoWorker(localWorker) ? ioWakeCount : computeWakeCount;
+        localWakeCount = std::max(localWakeCount - 1, 0);
+    }
+
+    wakeWorkers(false, computeWakeCount);
+    wakeWorkers(true, ioWakeCount);
+}
+
+void TaskSystem::layoutWorkers()
+{
+    //Cores come sorted by numa node and cache domain, so consecutive workers share caches.
+    //A pool bigger than the machine wraps around.
+    int coreCount = (int)m_topology.cores.size();
+    std::vector<int> numaNodes(m_workers.size(), 0);
+    std::vector<int> domainsUsed;
+    for (int i = 0; i < (int)m_workers.size(); ++i)
+    {
+        ThreadWorker& w = m_workers[i];
+        if (i >= m_computeWorkerCount)
+        {
+            //Io workers spend their time blocked on the os, they are not worth a core.
+            w.setCpuAffinity(-1);
+            w.setDomain(0);
+            continue;
+        }
+
+        const CpuCore& core = m_topology.cores[i % coreCount];
+        int domain = 0;
+        if (m_desc.workerGrouping == TaskWorkerGrouping::L3Cache)
+            domain = core.l3Domain;
+        else if (m_desc.workerGrouping == TaskWorkerGrouping::NumaNode)
+            domain = core.numaNode;
+
+        w.setCpuAffinity(m_desc.pinWorkers ? core.cpuId : -1);
+        w.setDomain(domain);
+        numaNodes[i] = core.numaNode;
+        if (std::find(domainsUsed.begin(), domainsUsed.end(), domain) == domainsUsed.end())
+            domainsUsed.push_back(domain);
+    }
+    m_workerDomainCount = std::max((int)domainsUsed.size(), 1);
+
+    m_stealOrders.assign(m_workers.size(), std::vector<int>());
+    for (int i = 0; i < (int)m_workers.size(); ++i)
+    {
+        bool isCompute = i < m_computeWorkerCount;
+        auto distance = [&](int victim)
+        {
+            if (!isCompute || m_desc.workerGrouping == TaskWorkerGrouping::None)
+                return 0;
+            if (m_workers[victim].domain() == m_workers[i].domain())
+                return 0;
+            return numaNodes[victim] == numaNodes[i] ? 1 : 2;
+        };
+
+        //Round robin starting after the worker itself, so neighbours do not all pick the same victim.
+        std::vector<int>& order = m_stealOrders[i];
+        for (int v = 1; v <= m_computeWorkerCount; ++v)
+            order.push_back((i + v) % m_computeWorkerCount);
+        std::stable_sort(order.begin(), order.end(), [&distance](int a, int b) { return distance(a) < distance(b); });
+    }
+}
+
+bool TaskSystem::nextComputeTask(ThreadWorker& worker, Task& outTask)
+{
+    bool canPopLocal = !isIoWorker(&worker);
+    for (int p = 0; p < (int)TaskPriority::Count; ++p)
+    {
+        auto priority = (TaskPriority)p;
+
+        //Only the owner pushes to its deque, so an empty read here is reliable and skips the pop fence.
+        if (canPopLocal && !worker.deque(priority).empty() && worker.deque(priority).pop(outTask))
+            return true;
+
+        if (m_injectionQueues[p]->tryPop(outTask))
+            return true;
+
+        for (int victimId : m_stealOrders[worker.id()])
+        {
+            ThreadWorker& victim = m_workers[victimId];
+            if (victim.deque(priority).steal(outTask))
+            {
+                if (&victim != &worker)
+                    onTaskStolen(outTask);
+                return true;
+            }
+        }
+    }
+
+    return false;
+}
+
+bool TaskSystem::nextIoTask(Task& outTask)
+{
+    for (auto& q : m_ioQueues)
+    {
+        if (q->tryPop(outTask))
+            return true;
+    }
+
+    return false;
+}
+
+bool TaskSystem::nextReadyTask(ThreadWorker& worker, Task& outTask, bool anyLane)
+{
+    //Io workers blocked in wait() also help with compute work, compute workers never run io tasks.
+    if (isIoWorker(&worker))
+        return nextIoTask(outTask) || (anyLane && nextComputeTask(worker, outTask));
+
+    return nextComputeTask(worker, outTask);
+}
+
+bool TaskSystem::resolveTask(Task task, TaskFn& fn, TaskContext& ctx)
+{
+    if (!m_taskTable.contains(task))
+    {
+        CPY_ERROR_MSG(false, "Missing task while running it?");
+        return false;
+    }
+
+    auto& taskData = m_taskTable[task];
+    fn = dispatchFn(taskData);
+    ctx = { task, taskData.data, this };
+    return true;
+}
+
+bool TaskSystem::shouldSkip(const TaskData& taskData) const
+{
+    return taskData.cancelled.load(std::memory_order_relaxed)
+        || taskData.getDesc().cancelToken.isCancelled()
+        || (taskData.getDesc().deadline != TaskClock::time_point::max() && TaskClock::now() > taskData.getDesc().deadline);
+}
+
+const TaskFn& TaskSystem::dispatchFn(TaskData& taskData)
+{
+    //Skipped tasks still go through a worker and complete, so waiters get released and dependents get resolved.
+    static const TaskFn s_skipFn = [](TaskContext&) {};
+    if (!shouldSkip(taskData))
+        return taskData.getDesc().fn;
+
+    taskData.cancelled.store(true, std::memory_order_relaxed);
+    m_cancelledTasks.fetch_add(1, std::memory_order_relaxed);
+    return s_skipFn;
+}
+
+bool TaskSystem::isCancelled(Task task)
+{
+    if (!m_taskTable.contains(task))
+    {
+        CPY_ASSERT_MSG(false, "Task does not exist");
+        return false;
+    }
+
+    return shouldSkip(m_taskTable[task]);
+}
+
+void TaskSystem::signal(Task task)
+{
+    {
+        std::shared_lock lock(m_stateMutex);
+        bool isExternal = m_taskTable.contains(task) && (m_taskTable[task].getDesc().flags & (int)TaskFlags::External) != 0;
+        CPY_ASSERT_MSG(isExternal, "Only tasks created with TaskFlags::External can be signalled.");
+        if (!isExternal)
+            return;
+
+        TaskState expected = TaskState::Unscheduled;
+        bool firstSignal = m_taskTable[task].state.compare_exchange_strong(expected, TaskState::InWorker);
+        CPY_ASSERT_MSG(firstSignal, "External task signalled twice.");
+        if (!firstSignal)
+            return;
+    }
+
+    onTaskComplete(task);
+}
+
+bool TaskSystem::findTask(ThreadWorker& worker, TaskFn& fn, TaskContext& ctx)
+{
+    Task task;
+    if (!nextReadyTask(worker, task, false))
+    {
+        //Publish this worker as idle before checking one last time, this way a concurrent
+        //push either sees the idle flag or this thread sees the pushed task.
+        setWorkerIdle(worker);
+        if (!nextReadyTask(worker, task, false))
+            return false;
+    }
+
+    clearWorkerIdle(worker);
+    return resolveTask(task, fn, ctx);
+}
+
+void TaskSystem::setWorkerIdle(ThreadWorker& worker)
+{
+    if (!m_idleWorkers[worker.id()].exchange(true))
+        m_idleCount.fetch_add(1);
+}
+
+void TaskSystem::clearWorkerIdle(ThreadWorker& worker)
+{
+    if (m_idleWorkers[worker.id()].load(std::memory_order_relaxed) && m_idleWorkers[worker.id()].exchange(false))
+        m_idleCount.fetch_sub(1);
+}
+
+void TaskSystem::wakeWorkers(bool ioLane, int count)
+{
+    if (count <= 0)
+        return;
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    int begin = ioLane ? m_computeWorkerCount : 0;
+    int end = ioLane ? (int)m_workers.size() : m_computeWorkerCount;
+    for (int i = begin; i < end && count > 0 && m_idleCount.load() > 0; ++i)
+    {
+        if (!m_idleWorkers[i].exchange(false))
+            continue;
+
+        m_idleCount.fetch_sub(1);
+        m_workers[i].signal();
+        --count;
+    }
+}
+
+bool TaskSystem::runSingleJob(ThreadWorker& worker)
 {
     TaskFn fn;
     TaskContext ctx;
-    for (ThreadWorker& otherWorker : m_workers)
+    if (isWorkStealing())
     {
+        Task task;
+        if (!nextReadyTask(worker, task, true))
+            return false;
+
+        //A skipped task still counts, it made progress on the graph.
+        if (resolveTask(task, fn, ctx))
+            worker.runInThread(fn, ctx);
+        return true;
+    }
+
+    //Same lane rules as work stealing: io workers help anywhere, compute workers only take compute jobs.
+    int workerCount = isIoWorker(&worker) ? (int)m_workers.size() : m_computeWorkerCount;
+    for (int i = 0; i < workerCount; ++i)
+    {
+        ThreadWorker& otherWorker = m_workers[i];
         if (otherWorker.stealJob(fn, ctx))
         {
+            if (&otherWorker != &worker)
+                onTaskStolen(ctx.task);
             worker.runInThread(fn, ctx);
-            return;
+            return true;
         }
     }
+
+    return false;
 }
 
 void TaskSystem::onTaskComplete(Task t)
 {
-    std::vector<Task> nextTasks;
-    SyncData* syncData = nullptr;
+    std::vector<Task>& nextTasks = t_schedulingScratch.nextTasks;
+    nextTasks.clear();
+
+    TaskData& taskData = m_taskTable[t];
+    ThreadWorker* worker = ThreadWorker::getLocalThreadWorker();
+    if (m_tracer)
+        m_tracer->record(TraceEventType::Run, t, taskData.getDesc().name, worker ? worker->taskStartNs() : TaskTracer::now(), TaskTracer::now());
+
+    //Task runs show up as zones, on the same clock and threads as the CPY_PROFILE_SCOPE zones inside them.
+    //Tasks finished elsewhere (signal, skipped) have no run to record.
+    if (worker && worker->taskStartTicks() != 0 && worker->runningTask() == t)
+    {
+        const std::string& name = taskData.getDesc().name;
+        Profiler::record(name.empty() ? "task" : Profiler::internName(name), worker->taskStartTicks(), Profiler::now(), worker->taskStartFrame());
+    }
+
+    if (taskData.continuation)
+    {
+        resumeAsContinuation(t, taskData);
+        return;
+    }
+
+    //A task that bailed out because of its token counts as cancelled too.
+    bool cancelled = taskData.cancelled.load(std::memory_order_relaxed) || taskData.getDesc().cancelToken.isCancelled();
+
+    std::vector<int>& wokenWorkers = t_schedulingScratch.wokenWorkers;
+    taskData.lockEdges();
+    taskData.state.store(TaskState::Finished);
+    for (auto p : taskData.parents)
+    {
+        if (cancelled)
+            m_taskTable[p].cancelled.store(true, std::memory_order_relaxed);
+        if (m_taskTable[p].pendingDependencies.fetch_sub(1) == 1)
+            nextTasks.push_back(p);
+    }
+
+    //Once the lock is released the task can be cleaned and its slot recycled, do not touch it after.
+    bool hasExternalWaiters = taskData.externalWaiters.load() > 0;
+    wokenWorkers.swap(taskData.waitingWorkers);
+    taskData.unlockEdges();
+
+    if (hasExternalWaiters)
+    {
+        std::unique_lock lock(m_externalWaitMutex);
+        m_externalWaitCv.notify_all();
+    }
+
+    for (int workerId : wokenWorkers)
+        m_workers[workerId].signal();
+    wokenWorkers.clear();
+
+    if (nextTasks.empty())
+        return;
+
+    if (isWorkStealing())
+        scheduleReadyTasks(nextTasks.data(), (int)nextTasks.size(), true);
+    else
+        execute(nextTasks.data(), (int)nextTasks.size());
+}
+
+void TaskSystem::resumeAsContinuation(Task t, TaskData& taskData)
+{
+    //The task stays alive: its function becomes the continuation and it gets scheduled again.
+    if (taskData.sharedDesc)
+    {
+        taskData.desc = *taskData.sharedDesc;
+        taskData.sharedDesc = nullptr;
+    }
+    taskData.desc.fn = std::move(taskData.continuation);
+    taskData.continuation = nullptr;
+    taskData.state.store(TaskState::Unscheduled);
+
+    //Awaited tasks that were never executed get scheduled while the hold taken by continueAfter
+    //still keeps this task from becoming ready, so none of them can finish and clean it meanwhile.
+    std::vector<Task>& awaited = t_schedulingScratch.nextTasks;
+    taskData.lockEdges();
+    for (auto dep : taskData.dependencies)
+    {
+        if (m_taskTable[dep].state.load() == TaskState::Unscheduled)
+            awaited.push_back(dep);
+    }
+    taskData.unlockEdges();
+
+    if (!awaited.empty())
+    {
+        if (isWorkStealing())
+            scheduleReadyTasks(awaited.data(), (int)awaited.size(), true);
+        else
+            execute(awaited.data(), (int)awaited.size());
+        awaited.clear();
+    }
+
+    //Dropping the hold, if awaited tasks are still running the last one to finish schedules the
+    //continuation instead, so it only ever gets scheduled once.
+    if (taskData.pendingDependencies.fetch_sub(1) != 1)
+        return;
+
+    if (isWorkStealing())
+        scheduleReadyTasks(&t, 1, true);
+    else
+        execute(t);
+}
+
+void TaskSystem::continueAfter(Task self, Task* awaited, int counts, TaskFn continuation)
+{
+    {
+        std::shared_lock lock(m_stateMutex);
+        bool isRunning = m_taskTable.contains(self) && m_taskTable[self].state.load() == TaskState::InWorker;
+        CPY_ASSERT_MSG(isRunning, "continueAfter can only be called from inside the function of the task being continued.");
+        if (!isRunning)
+            return;
+
+        //Held until self returns, so awaited tasks finishing meanwhile can't make it ready while it runs.
+        m_taskTable[self].continuation = std::move(continuation);
+        m_taskTable[self].pendingDependencies.fetch_add(1);
+    }
+
+    depends(self, awaited, counts);
+}
+
+TaskGraph TaskSystem::createGraph(const TaskGraphDesc& desc)
+{
+    int nodeCount = (int)desc.nodes.size();
+    std::vector<int> dependencyCounts(nodeCount, 0);
+    std::vector<int> parentOffsets(nodeCount + 1, 0);
+    for (const auto& e : desc.edges)
+    {
+        bool validEdge = e.node >= 0 && e.node < nodeCount && e.dependency >= 0 && e.dependency < nodeCount;
+        CPY_ASSERT_MSG(validEdge, "Task graph edge points to a node that does not exist.");
+        if (!validEdge)
+            return TaskGraph();
+
+        ++dependencyCounts[e.node];
+        ++parentOffsets[e.dependency + 1];
+    }
+
+    for (int i = 0; i < nodeCount; ++i)
+        parentOffsets[i + 1] += parentOffsets[i];
+
+    std::vector<int> parents(desc.edges.size());
+    {
+        std::vector<int> cursors(parentOffsets.begin(), parentOffsets.end() - 1);
+        for (const auto& e : desc.edges)
+            parents[cursors[e.dependency]++] = e.node;
+    }
+
+    //Kahn's algorithm, whatever does not make it into the order is part of a cycle.
+    std::vector<int> order;
+    order.reserve(nodeCount);
+    std::vector<int> remaining = dependencyCounts;
+    for (int i = 0; i < nodeCount; ++i)
+        if (remaining[i] == 0)
+            order.push_back(i);
+
+    for (int head = 0; head < (int)order.size(); ++head)
+    {
+        int n = order[head];
+        for (int k = parentOffsets[n]; k < parentOffsets[n + 1]; ++k)
+            if (--remaining[parents[k]] == 0)
+                order.push_back(parents[k]);
+    }
+
+    bool isAcyclic = (int)order.size() == nodeCount;
+    CPY_ASSERT_MSG(isAcyclic, "Task graph has a cycle.");
+    if (!isAcyclic)
+        return TaskGraph();
+
+    std::vector<int> topoIndices(nodeCount);
+    for (int t = 0; t < nodeCount; ++t)
+        topoIndices[order[t]] = t;
+
+    GraphTemplate g;
+    g.name = desc.name;
+    g.nodes.reserve(nodeCount);
+    g.nodeIndices = order;
+    g.dependencyCounts.resize(nodeCount);
+    g.parentOffsets.reserve(nodeCount + 1);
+    g.dependencies.reserve(desc.edges.size());
+    g.parents.reserve(desc.edges.size());
+    for (int t = 0; t < nodeCount; ++t)
+    {
+        int n = order[t];
+        g.nodes.push_back(desc.nodes[n]);
+        //Instances are started by executeGraph or by executing the returned task, never per node.
+        g.nodes.back().flags &= ~(int)TaskFlags::AutoStart;
+        g.dependencyCounts[t] = dependencyCounts[n];
+
+        g.parentOffsets.push_back((int)g.parents.size());
+        for (int k = parentOffsets[n]; k < parentOffsets[n + 1]; ++k)
+            g.parents.push_back(topoIndices[parents[k]]);
+
+        if (dependencyCounts[n] == 0)
+            g.sources.push_back(t);
+        if (parentOffsets[n] == parentOffsets[n + 1])
+            g.sinks.push_back(t);
+    }
+    g.parentOffsets.push_back((int)g.parents.size());
+    if (g.sinks.size() != 1)
+        g.rootDesc = std::make_unique<TaskDesc>(g.name, [](TaskContext&) {});
+
+    //Dependencies are the transposed parent lists.
+    g.dependencyOffsets.push_back(0);
+    for (int t = 0; t < nodeCount; ++t)
+        g.dependencyOffsets.push_back(g.dependencyOffsets[t] + g.dependencyCounts[t]);
+
+    std::vector<int> dependencyCursors(g.dependencyOffsets.begin(), g.dependencyOffsets.end() - 1);
+    g.dependencies.resize(desc.edges.size());
+    for (int t = 0; t < nodeCount; ++t)
+        for (int k = g.parentOffsets[t]; k < g.parentOffsets[t + 1]; ++k)
+            g.dependencies[dependencyCursors[g.parents[k]]++] = t;
+
+    TaskGraph outHandle;
+    std::unique_lock lock(m_stateMutex);
+    m_graphs.allocate(outHandle) = std::move(g);
+    return outHandle;
+}
+
+void TaskSystem::destroyGraph(TaskGraph graph)
+{
+    std::unique_lock lock(m_stateMutex);
+    CPY_ASSERT_MSG(m_graphs.contains(graph), "Task graph does not exist.");
+    if (m_graphs.contains(graph))
+        m_graphs.free(graph);
+}
+
+Task TaskSystem::internalInstantiateGraph(TaskGraph graph, void* data, void* const* nodeData, std::vector<Task>& outSources)
+{
+    outSources.clear();
+    std::shared_lock lock(m_stateMutex);
+    bool hasGraph = m_graphs.contains(graph);
+    CPY_ASSERT_MSG(hasGraph, "Task graph does not exist.");
+    if (!hasGraph)
+        return Task();
+
+    const GraphTemplate& g = m_graphs[graph];
+    int nodeCount = (int)g.nodes.size();
+    //A single sink already finishes after every other node, it stands in for the root (one less task to schedule).
+    bool needsRoot = g.sinks.size() != 1;
+    int taskCount = nodeCount + (needsRoot ? 1 : 0);
+    std::vector<Task>& tasks = t_schedulingScratch.graphTasks;
+    tasks.resize(taskCount);
+    bool allocated = m_taskTable.allocate(tasks.data(), taskCount);
+    CPY_ERROR_MSG(allocated, "Task table is full.");
+    if (!allocated)
+        return Task();
+
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        TaskData& taskData = m_taskTable[tasks[i]];
+        taskData.reset();
+        taskData.sharedDesc = &g.nodes[i];
+        taskData.data = nodeData ? nodeData[g.nodeIndices[i]] : data;
+    }
+
+    //The edges and counts were resolved when freezing, they only need translating to this instance's handles.
+    //Nobody else can see these tasks yet, so the edge locks are not needed.
+    for (int i = 0; i < nodeCount; ++i)
+    {
+        TaskData& taskData = m_taskTable[tasks[i]];
+        for (int k = g.dependencyOffsets[i]; k < g.dependencyOffsets[i + 1]; ++k)
+            taskData.dependencies.push_back(tasks[g.dependencies[k]]);
+        for (int k = g.parentOffsets[i]; k < g.parentOffsets[i + 1]; ++k)
+            taskData.parents.push_back(tasks[g.parents[k]]);
+        taskData.pendingDependencies = g.dependencyCounts[i];
+    }
+
+    for (int s : g.sources)
+        outSources.push_back(tasks[s]);
+    if (!needsRoot)
+        return tasks[g.sinks[0]];
+
+    Task root = tasks[nodeCount];
+    TaskData& rootData = m_taskTable[root];
+    rootData.reset();
+    rootData.sharedDesc = g.rootDesc.get();
+    for (int s : g.sinks)
+    {
+        m_taskTable[tasks[s]].parents.push_back(root);
+        rootData.dependencies.push_back(tasks[s]);
+    }
+    rootData.pendingDependencies = (int)g.sinks.size();
+    return root;
+}
+
+Task TaskSystem::instantiateGraph(TaskGraph graph, void* data, void* const* nodeData)
+{
+    return internalInstantiateGraph(graph, data, nodeData, t_schedulingScratch.graphSources);
+}
+
+Task TaskSystem::executeGraph(TaskGraph graph, void* data, void* const* nodeData)
+{
+    std::vector<Task>& sources = t_schedulingScratch.graphSources;
+    Task root = internalInstantiateGraph(graph, data, nodeData, sources);
+    if (!root.valid())
+        return root;
+
+    //Only the sources are ready, no need to walk the instance looking for them.
+    if (sources.empty())
+        sources.push_back(root);
+    execute(sources.data(), (int)sources.size());
+    return root;
+}
+
+void TaskSystem::submit(TaskBatch& batch, bool execute)
+{
+    int taskCount = (int)batch.descs.size();
+    CPY_ASSERT_MSG(batch.datas.size() == batch.descs.size(), "Task batch data and descs are out of sync, use TaskBatch::add.");
+    batch.tasks.resize(taskCount);
+
+    std::vector<Task>& roots = t_schedulingScratch.graphSources;
+    roots.clear();
     {
-        std::unique_lock lock(m_stateMutex);
-        TaskData& taskData = m_taskTable[t];
-        syncData = taskData.syncData;
-        CPY_ERROR_MSG(syncData != nullptr, "Sync data not found when task has been completed.");
-        syncData->state = TaskState::Finished;
+        std::shared_lock lock(m_stateMutex);
+        bool allocated = m_taskTable.allocate(batch.tasks.data(), taskCount);
+        CPY_ERROR_MSG(allocated, "Task table is full.");
+        if (!allocated)
+            return;
 
-        for (auto p : taskData.parents)
+        for (int i = 0; i < taskCount; ++i)
         {
-            auto& parentTask = m_taskTable[p];
-            parentTask.dependencies.erase(t);
-            if (parentTask.dependencies.empty() && parentTask.syncData->state == TaskState::Unscheduled)
-                nextTasks.push_back(p);
+            TaskData& taskData = m_taskTable[batch.tasks[i]];
+            taskData.reset();
+            taskData.desc = std::move(batch.descs[i]);
+            taskData.data = batch.datas[i];
         }
 
+        //The new tasks are not visible to anyone else yet, only external tasks need their edges locked.
+        for (const auto& e : batch.edges)
         {
-            std::unique_lock lock(m_finishedTasksMutex);
-            m_finishedTasksList.insert(t);
+            bool validEdge = e.node >= 0 && e.node < taskCount && e.dependency >= 0 && e.dependency < taskCount;
+            CPY_ASSERT_MSG(validEdge, "Task batch edge points to a task that is not in the batch.");
+            if (!validEdge)
+                continue;
+
+            TaskData& nodeData = m_taskTable[batch.tasks[e.node]];
+            nodeData.dependencies.push_back(batch.tasks[e.dependency]);
+            m_taskTable[batch.tasks[e.dependency]].parents.push_back(batch.tasks[e.node]);
+            nodeData.pendingDependencies.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        //Tasks without dependencies inside the batch are enough to start it, the rest gets reached through them.
+        //Checked before the external edges, collectReadyTasks walks into unscheduled externals.
+        if (execute)
+        {
+            for (int i = 0; i < taskCount; ++i)
+                if (m_taskTable[batch.tasks[i]].pendingDependencies.load(std::memory_order_relaxed) == 0)
+                    roots.push_back(batch.tasks[i]);
         }
 
-        syncData->cv.notify_all();
+        for (const auto& e : batch.externalEdges)
+        {
+            bool validEdge = e.node >= 0 && e.node < taskCount && m_taskTable.contains(e.dependency);
+            CPY_ASSERT_MSG(validEdge, "Task batch external dependency does not exist.");
+            if (!validEdge)
+                continue;
+
+            TaskData& nodeData = m_taskTable[batch.tasks[e.node]];
+            TaskData& dependencyData = m_taskTable[e.dependency];
+            nodeData.dependencies.push_back(e.dependency);
+            dependencyData.lockEdges();
+            if (dependencyData.state.load() != TaskState::Finished)
+            {
+                dependencyData.parents.push_back(batch.tasks[e.node]);
+                nodeData.pendingDependencies.fetch_add(1);
+            }
+            dependencyData.unlockEdges();
+        }
     }
-    execute(nextTasks.data(), (int)nextTasks.size());
+
+    if (!roots.empty())
+        this->execute(roots.data(), (int)roots.size());
 }
 
 void TaskSystem::removeTask(Task t)
 {
     auto& taskData = m_taskTable[t];
+    bool isFinished = taskData.state.load() == TaskState::Finished;
+
+    taskData.lockEdges();
     for (auto p : taskData.parents)
     {
         if (!m_taskTable.contains(p))
             continue;
+
         auto& pdata = m_taskTable[p];
-        pdata.initialDependencies.erase(t);
-        pdata.dependencies.erase(t);
+        eraseTask(pdata.dependencies, t);
+        if (!isFinished)
+            pdata.pendingDependencies.fetch_sub(1);
+    }
+    taskData.unlockEdges();
+
+    for (auto d : taskData.dependencies)
+    {
+        if (!m_taskTable.contains(d))
+            continue;
+
+        auto& ddata = m_taskTable[d];
+        ddata.lockEdges();
+        eraseTask(ddata.parents, t);
+        ddata.unlockEdges();
     }
-    delete taskData.syncData;
+
+    taskData.reset();
     m_taskTable.free(t);
 }
 
@@ -292,101 +1080,174 @@ void TaskSystem::cleanFinishedTasks()
 {
     CPY_ASSERT_MSG(ThreadWorker::getLocalThreadWorker() == nullptr, "cleanFinishedTasks cannot be called from a worker thread.");
     std::unique_lock lock(m_stateMutex);
-    std::unique_lock lock2(m_finishedTasksMutex);
 
-    for (auto t : m_finishedTasksList)
-        removeTask(t);
+    std::vector<Task> finishedTasks;
+    m_taskTable.forEach([&finishedTasks](Task t, TaskData& data)
+    {
+        if (data.state.load() == TaskState::Finished)
+            finishedTasks.push_back(t);
+    });
 
-    m_finishedTasksList.clear();
+    for (auto t : finishedTasks)
+        removeTask(t);
 }
 
 void TaskSystem::cleanTaskTree(Task src)
 {
     std::unique_lock lock(m_stateMutex);
-    std::unique_lock lock2(m_finishedTasksMutex);
     std::vector<Task> tasksToClean;
-    std::set<Task> erasedTasks;
     tasksToClean.push_back(src);
 
     while (!tasksToClean.empty())
     {
         auto t = tasksToClean.back();
         tasksToClean.pop_back();
-        if (erasedTasks.insert(t).second == false)
+
+        //Shared dependencies get removed on their first visit.
+        if (!m_taskTable.contains(t))
             continue;
 
         auto& tableData = m_taskTable[t];
-        for (auto d : tableData.initialDependencies)
-            tasksToClean.push_back(d);
-
+        tasksToClean.insert(tasksToClean.end(), tableData.dependencies.begin(), tableData.dependencies.end());
         removeTask(t);
-        m_finishedTasksList.erase(t);
     }
 }
 
 bool TaskSystem::isTaskFinished(Task t)
 {
-    std::shared_lock lock(m_stateMutex);
-    SyncData* syncData = nullptr;
     if (!m_taskTable.contains(t))
     {
         CPY_ASSERT_MSG(false, "Task does not exist");
         return true;
     }
     
-    syncData = m_taskTable[t].syncData;
-    if (syncData == nullptr)
-    {
-        CPY_ASSERT_MSG(false, "Task does not exist");
-        return true;
-    }
-    
-    if (syncData->state == TaskState::Finished)
-        return true;
-
-    return false;
+    return m_taskTable[t].state.load() == TaskState::Finished;
 }
 
 void TaskSystem::wait(Task other)
 {
     ThreadWorker* worker = ThreadWorker::getLocalThreadWorker();
-    if (worker != nullptr)
-    {
-        bool finished = false;
-        while (!isTaskFinished(other))
-            runSingleJob(*worker);
-    }
+    if (worker != nullptr && isOwnWorker(worker))
+        workerWait(*worker, other);
     else
-    {
         internalWait(other);
-    }
 }
 
-void TaskSystem::internalWait(Task other)
+void TaskSystem::workerWait(ThreadWorker& worker, Task other)
 {
-    SyncData* syncData = nullptr;
+    //Every job picked up here runs on top of the waiting task's stack, so deep chains of waits stop
+    //helping and only run what gets sent to this worker directly.
+    int depth = worker.waitDepth();
+    worker.setWaitDepth(depth + 1);
+    while (!isTaskFinished(other))
     {
-        std::shared_lock lock(m_stateMutex);
-        if (!m_taskTable.contains(other))
+        bool canHelp = depth < MaxHelpingWaitDepth;
+        if (canHelp && runSingleJob(worker))
+            continue;
+
+        //Same protocol as findTask: publish the worker as idle, then look once more, so work pushed
+        //in between is never missed.
+        if (isWorkStealing() && canHelp)
         {
-            CPY_ASSERT_MSG(false, "Cannot wait for task that does not exist");
-            return;
+            setWorkerIdle(worker);
+            if (runSingleJob(worker))
+            {
+                clearWorkerIdle(worker);
+                continue;
+            }
         }
 
-        syncData = m_taskTable[other].syncData;
-        CPY_ERROR_MSG(syncData != nullptr, "Error, no sync data found during wait.");
+        //Parks until the awaited task finishes, or new work wakes it up like any idle worker.
+        TaskData& taskData = m_taskTable[other];
+        taskData.lockEdges();
+        bool finished = taskData.state.load() == TaskState::Finished;
+        if (!finished)
+            taskData.waitingWorkers.push_back(worker.id());
+        taskData.unlockEdges();
+
+        if (!finished)
+            worker.park();
+
+        if (isWorkStealing() && canHelp)
+            clearWorkerIdle(worker);
+    }
+    worker.setWaitDepth(depth);
+}
+
+void TaskSystem::internalWait(Task other)
+{
+    if (!m_taskTable.contains(other))
+    {
+        CPY_ASSERT_MSG(false, "Cannot wait for task that does not exist");
+        return;
     }
 
+    TaskData& taskData = m_taskTable[other];
+    unsigned long long startNs = TaskTracer::now();
+    taskData.externalWaiters.fetch_add(1);
     {
-        std::unique_lock lock(syncData->m);
-        syncData->cv.wait(lock, [syncData]() { return syncData->state == TaskState::Finished; });
+        std::unique_lock lock(m_externalWaitMutex);
+        m_externalWaitCv.wait(lock, [&taskData]() { return taskData.state.load() == TaskState::Finished; });
     }
+    taskData.externalWaiters.fetch_sub(1);
+
+    unsigned long long endNs = TaskTracer::now();
+    m_externalBlockedNs.fetch_add(endNs - startNs, std::memory_order_relaxed);
+    if (m_tracer)
+        m_tracer->record(TraceEventType::Blocked, other, std::string("wait"), startNs, endNs);
+}
+
+void TaskSystem::onTaskStolen(Task task)
+{
+    m_steals.fetch_add(1, std::memory_order_relaxed);
+    if (m_tracer)
+        m_tracer->record(TraceEventType::Stolen, task, m_taskTable[task].getDesc().name);
 }
 
 void TaskSystem::getStats(ITaskSystem::Stats& outStats)
 {
     std::shared_lock lock(m_stateMutex);
     outStats.numElements = m_taskTable.elementsCount();
+    outStats.queuedTasks = 0;
+    outStats.queuedIoTasks = 0;
+    outStats.steals = m_steals.load(std::memory_order_relaxed);
+    outStats.cancelledTasks = m_cancelledTasks.load(std::memory_order_relaxed);
+    outStats.computeWorkers = m_desc.threadPoolSize;
+    outStats.ioWorkers = m_desc.ioThreadPoolSize;
+    outStats.workerDomains = m_workerDomainCount;
+
+    unsigned long long idleNs = 0;
+    unsigned long long blockedNs = m_externalBlockedNs.load(std::memory_order_relaxed);
+    for (int p = 0; p < (int)TaskPriority::Count; ++p)
+    {
+        outStats.queuedTasks += m_injectionQueues[p]->size();
+        outStats.queuedIoTasks += m_ioQueues[p]->size();
+    }
+
+    for (auto& w : m_workers)
+    {
+        //In work stealing mode the worker message queues only carry signals.
+        int& queued = isIoWorker(&w) ? outStats.queuedIoTasks : outStats.queuedTasks;
+        if (!isWorkStealing())
+            queued += w.queueSize();
+        for (int p = 0; p < (int)TaskPriority::Count; ++p)
+            queued += w.deque((TaskPriority)p).size();
+
+        idleNs += w.counters().idleTimeNs.load(std::memory_order_relaxed);
+        blockedNs += w.counters().blockedTimeNs.load(std::memory_order_relaxed);
+    }
+
+    outStats.idleTimeMs = (double)idleNs / 1000000.0;
+    outStats.blockedTimeMs = (double)blockedNs / 1000000.0;
+}
+
+bool TaskSystem::writeTrace(std::string& outJson)
+{
+    if (!m_tracer)
+        return false;
+
+    m_tracer->writeChromeTrace(outJson);
+    return true;
 }
 
 void TaskSystem::yield()
@@ -398,6 +1259,139 @@ void TaskSystem::yield()
     runSingleJob(*localWorker);
 }
 
+struct TaskSystem::ParallelForRange
+{
+    ParallelForState* state;
+    int begin;
+    int end;
+};
+
+struct TaskSystem::ParallelForState
+{
+    const ParallelForFn* fn;
+    int grainSize;
+
+    //All range tasks are dependencies of this task, it finishes when the last range is done.
+    Task root;
+
+    //Range slots, sized once by splitBudget so splitting never allocates. Once they are all
+    //claimed ranges stop splitting and run on whoever holds them.
+    std::vector<ParallelForRange> ranges;
+    std::atomic<int> nextRange;
+};
+
+namespace
+{
+
+//Every worker (and the caller) can split each range it holds once per halving level,
+//so workers * log2(count / grainSize) ranges keep everyone busy.
+int splitBudget(int count, int grainSize, int workerCount)
+{
+    int levels = 1;
+    for (int grains = count / grainSize; grains > 1; grains >>= 1)
+        ++levels;
+
+    //Every range runs at least half a grain of elements itself.
+    int maxRanges = count / std::max((grainSize + 1) / 2, 1) + 1;
+    return std::min((workerCount + 1) * levels, maxRanges);
+}
+
+}
+
+void TaskSystem::parallelFor(int begin, int end, int grainSize, ParallelForFn fn)
+{
+    if (end <= begin)
+        return;
+
+    grainSize = std::max(grainSize, 1);
+    int count = end - begin;
+    if (count <= grainSize || !m_started)
+    {
+        fn(begin, end);
+        return;
+    }
+
+    ParallelForState state;
+    state.fn = &fn;
+    state.grainSize = grainSize;
+    state.ranges.resize(splitBudget(count, grainSize, m_computeWorkerCount));
+    state.nextRange = 0;
+    state.root = createTask(TaskDesc(), nullptr);
+
+    //The task table is full, run the whole range on the calling thread.
+    if (!state.root.valid() || !spawnParallelRange(state, begin, end))
+    {
+        if (state.root.valid())
+            cleanTaskTree(state.root);
+
+        while (begin < end)
+        {
+            int chunkEnd = begin + std::min(grainSize, end - begin);
+            fn(begin, chunkEnd);
+            begin = chunkEnd;
+        }
+        return;
+    }
+
+    wait(state.root);
+    cleanTaskTree(state.root);
+}
+
+bool TaskSystem::spawnParallelRange(ParallelForState& state, int begin, int end)
+{
+    if (state.nextRange.load(std::memory_order_relaxed) >= (int)state.ranges.size())
+        return false;
+
+    int rangeIndex = state.nextRange.fetch_add(1);
+    if (rangeIndex >= (int)state.ranges.size())
+        return false;
+
+    ParallelForRange& range = state.ranges[rangeIndex];
+    range = { &state, begin, end };
+
+    Task rangeTask = createTask(TaskDesc("parallelFor", [this](TaskContext& ctx)
+    {
+        runParallelRange(*(ParallelForRange*)ctx.data);
+    }), &range);
+    if (!rangeTask.valid())
+        return false;
+
+    //The spawning task is still running, so the root cannot finish while the edge gets added.
+    depends(state.root, rangeTask);
+    execute(rangeTask);
+    return true;
+}
+
+void TaskSystem::runParallelRange(ParallelForRange& range)
+{
+    ParallelForState& state = *range.state;
+    int begin = range.begin;
+    int end = range.end;
+    while (begin < end)
+    {
+        int mid = begin + (end - begin) / 2;
+        if ((end - begin) > state.grainSize && shouldSplitRange() && spawnParallelRange(state, mid, end))
+        {
+            end = mid;
+            continue;
+        }
+
+        int chunkEnd = std::min(begin + state.grainSize, end);
+        (*state.fn)(begin, chunkEnd);
+        begin = chunkEnd;
+    }
+}
+
+bool TaskSystem::shouldSplitRange()
+{
+    ThreadWorker* localWorker = ThreadWorker::getLocalThreadWorker();
+    if (!isWorkStealing() || !isOwnWorker(localWorker) || isIoWorker(localWorker))
+        return true;
+
+    //Lazy splitting: while the local deque has work left, thieves already have something to take.
+    return localWorker->deque(TaskPriority::Normal).empty();
+}
+
 
 ITaskSystem* ITaskSystem::create(const TaskSystemDesc& desc)
 {
@@ -409,6 +1403,25 @@ void TaskUtil::sleepThread(int ms)
     std::this_thread::sleep_for(std::chrono::milliseconds(ms));
 }
 
+void TaskSystem::onYield(ThreadWorker& worker, TaskBlockFn& blockFn)
+{
+    //Io workers are there to block, and without an io lane there is nowhere else to send it.
+    if (isIoWorker(&worker) || m_desc.ioThreadPoolSize == 0)
+    {
+        worker.runBlocking(blockFn);
+        return;
+    }
+
+    Task blockTask = createTask(TaskDesc("yieldUntil", (int)TaskFlags::IoBound, [&blockFn](TaskContext&)
+    {
+        ThreadWorker::getLocalThreadWorker()->runBlocking(blockFn);
+    }), nullptr);
+
+    execute(blockTask);
+    wait(blockTask);
+    cleanTaskTree(blockTask);
+}
+
 void TaskUtil::yieldUntil(TaskBlockFn fn)
 {
     ThreadWorker* localWorker = ThreadWorker::getLocalThreadWorker();
@@ -1,10 +1,13 @@
 #pragma once
 
 #include <coalpy.tasks/ITaskSystem.h>
-#include <coalpy.core/HandleContainer.h>
 #include "ThreadWorker.h"
+#include "CpuTopology.h"
+#include <coalpy.core/ConcurrentHandleContainer.h>
+#include <coalpy.core/SparseHandleContainer.h>
 #include <memory>
-#include <set>
+#include <vector>
+#include <atomic>
 #include <mutex>
 #include <shared_mutex>
 #include <condition_variable>
@@ -18,6 +21,8 @@ namespace coalpy
 {
 
 class TaskSchedulerQueue;
+class TaskInjectionQueue;
+class TaskTracer;
 
 class TaskSystem : public ITaskSystem
 {
@@ -38,13 +43,52 @@ public:
     virtual void cleanFinishedTasks() override;
     virtual void cleanTaskTree(Task src) override;
     virtual void yield() override;
+    virtual void parallelFor(int begin, int end, int grainSize, ParallelForFn fn) override;
+    virtual void continueAfter(Task self, Task* awaited, int counts, TaskFn continuation) override;
+    virtual TaskGraph createGraph(const TaskGraphDesc& desc) override;
+    virtual void destroyGraph(TaskGraph graph) override;
+    virtual Task instantiateGraph(TaskGraph graph, void* data, void* const* nodeData) override;
+    virtual Task executeGraph(TaskGraph graph, void* data, void* const* nodeData) override;
+    virtual void submit(TaskBatch& batch, bool execute) override;
+    virtual bool isCancelled(Task task) override;
+    virtual void signal(Task task) override;
 
     void getStats(Stats& outStats) override;
+    virtual bool writeTrace(std::string& outJson) override;
 
 protected:
     void onMessageLoop();
-    void runSingleJob(ThreadWorker& worker);
+    //Returns false if there was nothing to run.
+    bool runSingleJob(ThreadWorker& worker);
     void onScheduleTask(Task* t, int counts);
+
+    //work stealing mode
+    bool isWorkStealing() const { return m_desc.schedulerMode == TaskSchedulerMode::WorkStealing; }
+    bool isOwnWorker(const ThreadWorker* worker) const;
+    bool isIoWorker(const ThreadWorker* worker) const;
+    bool isIoTask(const TaskDesc& desc) const { return (desc.flags & (int)TaskFlags::IoBound) != 0 && m_desc.ioThreadPoolSize > 0; }
+    void collectReadyTasks(const Task* tasks, int counts, std::vector<Task>& readyTasks);
+    void scheduleReadyTasks(Task* tasks, int counts, bool fromCompletion);
+    void pushReadyTasks(const std::vector<Task>& readyTasks, bool fromCompletion);
+    bool nextReadyTask(ThreadWorker& worker, Task& outTask, bool anyLane);
+    bool nextComputeTask(ThreadWorker& worker, Task& outTask);
+    bool nextIoTask(Task& outTask);
+    bool resolveTask(Task task, TaskFn& fn, TaskContext& ctx);
+    bool findTask(ThreadWorker& worker, TaskFn& fn, TaskContext& ctx);
+    void setWorkerIdle(ThreadWorker& worker);
+    void clearWorkerIdle(ThreadWorker& worker);
+    void wakeWorkers(bool ioLane, int count);
+    void onYield(ThreadWorker& worker, TaskBlockFn& blockFn);
+    void layoutWorkers();
+
+    struct ParallelForState;
+    struct ParallelForRange;
+    bool spawnParallelRange(ParallelForState& state, int begin, int end);
+    void runParallelRange(ParallelForRange& range);
+    bool shouldSplitRange();
+
+    enum { MaxHelpingWaitDepth = 16 };
+    void workerWait(ThreadWorker& worker, Task other);
     void internalWait(Task other);
     void removeTask(Task t);
     bool isTaskFinished(Task t);
@@ -56,40 +100,105 @@ protected:
         Finished
     };
 
-    struct SyncData
-    {
-        TaskState state = TaskState::Unscheduled;
-        int workerId = -1;
-        std::mutex m;
-        std::condition_variable cv;
-    };
-
     struct TaskData
     {
         TaskDesc desc;
+        //Graph instances point at the frozen node of their template instead of copying it into desc.
+        const TaskDesc* sharedDesc = nullptr;
         void* data = nullptr;
-        std::set<Task> initialDependencies;
-        std::set<Task> dependencies;
-        std::set<Task> parents;
-        SyncData* syncData = nullptr;
 
-        TaskState state() { return syncData->state; }
+        //Edges are kept in plain vectors. Task slots are recycled, so after warm up these don't allocate.
+        std::vector<Task> dependencies;
+        std::vector<Task> parents;
+
+        std::atomic<int> pendingDependencies = 0;
+        std::atomic<TaskState> state = TaskState::Unscheduled;
+        std::atomic<int> externalWaiters = 0;
+        //Ids of the workers parked in wait() on this task, guarded by the edges lock.
+        std::vector<int> waitingWorkers;
+
+        //Set by continueAfter, only touched by the thread running the task.
+        TaskFn continuation;
+
+        //Skipped at dispatch, set on the dependents of a skipped task when it completes.
+        std::atomic<bool> cancelled = false;
+
+        //Protects the edge lists, taken when adding edges and when the task finishes.
+        std::atomic<bool> edgesLock = false;
+
+        void lockEdges()
+        {
+            while (edgesLock.exchange(true, std::memory_order_acquire))
+                while (edgesLock.load(std::memory_order_relaxed));
+        }
+
+        void unlockEdges() { edgesLock.store(false, std::memory_order_release); }
+
+        const TaskDesc& getDesc() const { return sharedDesc ? *sharedDesc : desc; }
+        void reset();
+    };
+
+    //Frozen graph template. Nodes are stored in topological order, edges are flattened into
+    //offset + index arrays pointing at topological indices.
+    struct GraphTemplate
+    {
+        std::string name;
+        std::vector<TaskDesc> nodes;
+        std::vector<int> nodeIndices; //topological index -> index in TaskGraphDesc::nodes
+        std::vector<int> dependencyCounts;
+        std::vector<int> dependencyOffsets;
+        std::vector<int> dependencies;
+        std::vector<int> parentOffsets;
+        std::vector<int> parents;
+        std::vector<int> sources;
+        std::vector<int> sinks;
+        //Shared by the root task of every instance, only needed with several sinks.
+        //Boxed like the nodes, so it stays put when the template moves.
+        std::unique_ptr<TaskDesc> rootDesc;
     };
 
+    Task internalInstantiateGraph(TaskGraph graph, void* data, void* const* nodeData, std::vector<Task>& outSources);
+
+    bool shouldSkip(const TaskData& taskData) const;
+    const TaskFn& dispatchFn(TaskData& taskData);
     void onTaskComplete(Task task);
+    void resumeAsContinuation(Task task, TaskData& taskData);
+    void onTaskStolen(Task task);
 
     TaskSystemDesc m_desc;
     std::unique_ptr<TaskSchedulerQueue> m_schedulerQueue;
     std::unique_ptr<std::thread> m_schedulerThread;
+    //Compute workers first, followed by the io lane workers.
     std::vector<ThreadWorker> m_workers;
-
+    int m_computeWorkerCount = 0;
+    int m_workerDomainCount = 1;
+    CpuTopology m_topology;
+    //Per worker list of compute workers to steal from: own domain first, then same numa node, then the rest.
+    std::vector<std::vector<int>> m_stealOrders;
+    std::unique_ptr<TaskInjectionQueue> m_injectionQueues[(int)TaskPriority::Count];
+    std::unique_ptr<TaskInjectionQueue> m_ioQueues[(int)TaskPriority::Count];
+    std::unique_ptr<std::atomic<bool>[]> m_idleWorkers;
+    std::atomic<int> m_idleCount;
+    bool m_started = false;
+
+    //Task allocation and lookups are lock free. Destroying tasks takes this lock exclusively, so code
+    //that looks up a task and then follows its edges holds it shared.
     mutable std::shared_mutex m_stateMutex;
-    HandleContainer<Task, TaskData> m_taskTable;
+    ConcurrentHandleContainer<Task, TaskData> m_taskTable;
+    SparseHandleContainer<TaskGraph, GraphTemplate> m_graphs;
 
-    mutable std::shared_mutex m_finishedTasksMutex;
-    std::set<Task> m_finishedTasksList;
+    //Threads outside of the pool block here in wait().
+    std::mutex m_externalWaitMutex;
+    std::condition_variable m_externalWaitCv;
 
     int m_nextWorker;
+    int m_nextIoWorker;
+
+    //Null unless tracing is enabled, every trace point checks it first.
+    std::unique_ptr<TaskTracer> m_tracer;
+    std::atomic<unsigned long long> m_steals;
+    std::atomic<unsigned long long> m_cancelledTasks;
+    std::atomic<unsigned long long> m_externalBlockedNs;
 };
 
 }
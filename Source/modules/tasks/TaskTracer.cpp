@@ -0,0 +1,189 @@
+#include "TaskTracer.h"
+#include "ThreadWorker.h"
+#include <cJSON.h>
+#include <algorithm>
+#include <chrono>
+#include <thread>
+#include <string.h>
+
+namespace coalpy
+{
+
+namespace
+{
+
+std::atomic<unsigned> s_nextTracerId = 1;
+
+enum { CachedTracersPerThread = 4 };
+
+//Last few tracers the thread recorded into. A miss only costs a lookup in the tracer,
+//which owns the buffers, so switching between several tracers never allocates a new one.
+//Entries of destroyed tracers are never matched again, ids are not reused.
+struct LocalTraceBuffers
+{
+    struct Entry
+    {
+        unsigned tracerId = 0;
+        void* buffer = nullptr;
+    };
+
+    Entry entries[CachedTracersPerThread];
+    unsigned nextEntry = 0;
+};
+
+thread_local LocalTraceBuffers t_localTraceBuffers;
+
+const char* eventName(TraceEventType type)
+{
+    switch (type)
+    {
+    case TraceEventType::Scheduled: return "scheduled";
+    case TraceEventType::Stolen: return "stolen";
+    case TraceEventType::Run: return "run";
+    case TraceEventType::Blocked: return "blocked";
+    case TraceEventType::Idle:
+    default: return "idle";
+    }
+}
+
+}
+
+TaskTracer::TaskTracer(int eventsPerThread)
+: m_id(s_nextTracerId.fetch_add(1))
+, m_startNs(now())
+{
+    m_eventsPerThread = 2;
+    while (m_eventsPerThread < (unsigned long long)eventsPerThread)
+        m_eventsPerThread <<= 1;
+}
+
+TaskTracer::~TaskTracer()
+{
+}
+
+unsigned long long TaskTracer::now()
+{
+    return (unsigned long long)std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+TaskTracer::ThreadBuffer& TaskTracer::localBuffer()
+{
+    LocalTraceBuffers& local = t_localTraceBuffers;
+    for (auto& entry : local.entries)
+    {
+        if (entry.tracerId == m_id)
+            return *(ThreadBuffer*)entry.buffer;
+    }
+
+    ThreadBuffer* buffer = nullptr;
+    {
+        std::unique_lock lock(m_buffersMutex);
+        auto it = m_threadBuffers.find(std::this_thread::get_id());
+        if (it != m_threadBuffers.end())
+        {
+            buffer = it->second;
+        }
+        else
+        {
+            auto newBuffer = std::make_unique<ThreadBuffer>();
+            newBuffer->events = std::make_unique<Event[]>(m_eventsPerThread);
+            newBuffer->mask = m_eventsPerThread - 1;
+            newBuffer->writePos = 0;
+            newBuffer->tid = (int)m_buffers.size();
+
+            ThreadWorker* worker = ThreadWorker::getLocalThreadWorker();
+            newBuffer->threadName = worker ? std::string("worker ") + std::to_string(worker->id()) : std::string("thread ") + std::to_string(newBuffer->tid);
+            buffer = newBuffer.get();
+            m_buffers.push_back(std::move(newBuffer));
+            m_threadBuffers[std::this_thread::get_id()] = buffer;
+        }
+    }
+
+    auto& entry = local.entries[local.nextEntry++ % CachedTracersPerThread];
+    entry.tracerId = m_id;
+    entry.buffer = buffer;
+    return *buffer;
+}
+
+void TaskTracer::record(TraceEventType type, Task task, const std::string& name, unsigned long long startNs, unsigned long long endNs)
+{
+    ThreadBuffer& buffer = localBuffer();
+    unsigned long long pos = buffer.writePos.load(std::memory_order_relaxed);
+    Event& e = buffer.events[pos & buffer.mask];
+    e.type = type;
+    e.task = task;
+    e.startNs = startNs;
+    e.endNs = endNs;
+    size_t nameLen = std::min(name.size(), sizeof(e.name) - 1);
+    memcpy(e.name, name.c_str(), nameLen);
+    e.name[nameLen] = '\0';
+    buffer.writePos.store(pos + 1, std::memory_order_release);
+}
+
+void TaskTracer::writeChromeTrace(std::string& outJson)
+{
+    cJSON* root = cJSON_CreateObject();
+    cJSON* traceEvents = cJSON_CreateArray();
+    cJSON_AddItemToObject(root, "traceEvents", traceEvents);
+    cJSON_AddStringToObject(root, "displayTimeUnit", "ns");
+
+    std::vector<Event> events;
+    std::unique_lock lock(m_buffersMutex);
+    for (auto& buffer : m_buffers)
+    {
+        cJSON* meta = cJSON_CreateObject();
+        cJSON_AddStringToObject(meta, "name", "thread_name");
+        cJSON_AddStringToObject(meta, "ph", "M");
+        cJSON_AddNumberToObject(meta, "pid", 0);
+        cJSON_AddNumberToObject(meta, "tid", buffer->tid);
+        cJSON* metaArgs = cJSON_CreateObject();
+        cJSON_AddStringToObject(metaArgs, "name", buffer->threadName.c_str());
+        cJSON_AddItemToObject(meta, "args", metaArgs);
+        cJSON_AddItemToArray(traceEvents, meta);
+
+        unsigned long long capacity = buffer->mask + 1;
+        unsigned long long endPos = buffer->writePos.load(std::memory_order_acquire);
+        unsigned long long beginPos = endPos > capacity ? endPos - capacity : 0;
+        events.clear();
+        for (unsigned long long i = beginPos; i < endPos; ++i)
+            events.push_back(buffer->events[i & buffer->mask]);
+
+        //the owner thread kept writing while copying, drop the slots it might have overwritten.
+        unsigned long long newEndPos = buffer->writePos.load(std::memory_order_acquire);
+        size_t firstValid = newEndPos - beginPos > capacity ? (size_t)(newEndPos - beginPos - capacity) : 0;
+
+        for (size_t i = firstValid; i < events.size(); ++i)
+        {
+            const Event& e = events[i];
+            bool isSpan = e.type == TraceEventType::Run || e.type == TraceEventType::Blocked || e.type == TraceEventType::Idle;
+            cJSON* item = cJSON_CreateObject();
+            cJSON_AddStringToObject(item, "name", e.type == TraceEventType::Run && e.name[0] ? e.name : eventName(e.type));
+            cJSON_AddStringToObject(item, "cat", eventName(e.type));
+            cJSON_AddStringToObject(item, "ph", isSpan ? "X" : "i");
+            cJSON_AddNumberToObject(item, "ts", (double)(e.startNs - m_startNs) / 1000.0);
+            if (isSpan)
+                cJSON_AddNumberToObject(item, "dur", (double)(e.endNs - e.startNs) / 1000.0);
+            else
+                cJSON_AddStringToObject(item, "s", "t");
+            cJSON_AddNumberToObject(item, "pid", 0);
+            cJSON_AddNumberToObject(item, "tid", buffer->tid);
+
+            cJSON* args = cJSON_CreateObject();
+            if (e.task.valid())
+                cJSON_AddNumberToObject(args, "task", e.task.handleId);
+            if (e.name[0])
+                cJSON_AddStringToObject(args, "taskName", e.name);
+            cJSON_AddItemToObject(item, "args", args);
+            cJSON_AddItemToArray(traceEvents, item);
+        }
+    }
+    lock.unlock();
+
+    char* str = cJSON_PrintUnformatted(root);
+    outJson = str;
+    cJSON_free(str);
+    cJSON_Delete(root);
+}
+
+}
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <coalpy.tasks/TaskDefs.h>
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace coalpy
+{
+
+enum class TraceEventType : unsigned char
+{
+    Scheduled, //task became ready and was pushed to a queue
+    Stolen,    //task was taken from another worker's queue
+    Run,       //task function, span
+    Blocked,   //TaskUtil::yieldUntil or an external wait, span
+    Idle       //worker parked with nothing to do, span
+};
+
+//Records task events into per thread ring buffers. Each thread only writes to its own buffer,
+//so recording is a couple of stores. Old events get overwritten when a buffer wraps around.
+//The buffers are read when writing the trace, events recorded while reading might be dropped.
+class TaskTracer
+{
+public:
+    explicit TaskTracer(int eventsPerThread);
+    ~TaskTracer();
+
+    static unsigned long long now();
+
+    void record(TraceEventType type, Task task, const std::string& name, unsigned long long startNs, unsigned long long endNs);
+    void record(TraceEventType type, Task task, const std::string& name) { unsigned long long t = now(); record(type, task, name, t, t); }
+
+    //Chrome trace_event format, loads in chrome://tracing or ui.perfetto.dev
+    void writeChromeTrace(std::string& outJson);
+
+private:
+    struct Event
+    {
+        TraceEventType type;
+        Task task;
+        unsigned long long startNs;
+        unsigned long long endNs;
+        char name[40];
+    };
+
+    struct ThreadBuffer
+    {
+        int tid;
+        std::string threadName;
+        std::unique_ptr<Event[]> events;
+        unsigned long long mask;
+        std::atomic<unsigned long long> writePos;
+    };
+
+    ThreadBuffer& localBuffer();
+
+    unsigned m_id;
+    unsigned long long m_eventsPerThread;
+    unsigned long long m_startNs;
+    std::mutex m_buffersMutex;
+    //Owns the buffers of every thread that recorded, they are released with the tracer.
+    std::vector<std::unique_ptr<ThreadBuffer>> m_buffers;
+    std::unordered_map<std::thread::id, ThreadBuffer*> m_threadBuffers;
+};
+
+}
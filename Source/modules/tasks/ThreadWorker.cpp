@@ -1,6 +1,10 @@
 #include "ThreadWorker.h"
-#include <coalpy.tasks/ThreadQueue.h>
+#include "WorkStealingQueue.h"
+#include "TaskTracer.h"
+#include "CpuTopology.h"
+#include <coalpy.tasks/LockFreeQueue.h>
 #include <coalpy.core/Assert.h>
+#include <coalpy.core/Profiler.h>
 #include <thread>
 #include <iostream>
 
@@ -11,45 +15,25 @@ enum class ThreadMessageType
 {
     Exit,
     Signal,
-    RunJob,
-    RunAuxLambda
+    RunJob
 };
 
 struct ThreadWorkerMessage
 {
     ThreadMessageType type = ThreadMessageType::Exit;
     TaskFn fn = {};
-    TaskBlockFn blockFn = {};
     TaskContext ctx = {};
-    int targetStack = -1;
 };
 
-class ThreadWorkerQueue : public ThreadQueue<ThreadWorkerMessage>
-{
-public:
-    void addInactiveMessage(ThreadWorkerMessage& msg)
-    {
-        m_inactiveMessages.push_back(msg);
-    }
-
-    void recoverInactiveMessages()
-    {
-        for (const auto& m : m_inactiveMessages)
-        {
-            push(m);
-        }
-
-        m_inactiveMessages.clear();
-    }
-
-private:
-    std::vector<ThreadWorkerMessage> m_inactiveMessages;
-};
+class ThreadWorkerQueue : public LockFreeQueue<ThreadWorkerMessage> {};
 
 thread_local ThreadWorker* t_localWorker = nullptr;
 
 ThreadWorker::ThreadWorker()
 {
+    for (auto& d : m_deques)
+        d = new WorkStealingQueue<Task>;
+    m_counters = new ThreadWorkerCounters;
 }
 
 ThreadWorker::~ThreadWorker()
@@ -57,43 +41,37 @@ ThreadWorker::~ThreadWorker()
     signalStop();
     join();
     CPY_ASSERT(m_thread == nullptr);
-    CPY_ASSERT(m_auxThread == nullptr);
     if (m_queue)
         delete m_queue;
 
-    if (m_auxQueue)
-        delete m_auxQueue;
+    for (auto* d : m_deques)
+        delete d;
+
+    delete m_counters;
 }
 
-void ThreadWorker::start(OnTaskCompleteFn onTaskCompleteFn)
+void ThreadWorker::start(OnTaskCompleteFn onTaskCompleteFn, FindTaskFn findTaskFn, YieldFn yieldFn)
 {
     CPY_ASSERT_MSG(m_thread == nullptr, "system must call signalStop and then join to restart the thread worker.");
     if (m_thread)
         return;
 
     m_onTaskCompleteFn = onTaskCompleteFn;
+    m_findTaskFn = findTaskFn;
+    m_yieldFn = yieldFn;
+    m_exitRequested = false;
     if (!m_queue)
         m_queue = new ThreadWorkerQueue;
-    if (!m_auxQueue)
-        m_auxQueue = new ThreadWorkerQueue;
-
-    CPY_ASSERT(m_thread == nullptr && m_auxThread == nullptr);
 
     m_thread = new std::thread(
     [this](){
         CPY_ASSERT(t_localWorker == nullptr);
         t_localWorker = this;
-        m_activeDepth = 0;
+        Profiler::setThreadName((std::string("worker ") + std::to_string(m_workerId)).c_str());
+        //Best effort, the worker still runs if the os refuses (e.g. the core is outside a container's cpu set).
+        if (m_cpuId >= 0)
+            pinCurrentThread(m_cpuId);
         this->run();
-        CPY_ASSERT(m_activeDepth == 0);
-        t_localWorker = nullptr;
-    });
-
-    m_auxThread = new std::thread(
-    [this](){
-        CPY_ASSERT(t_localWorker == nullptr);
-        t_localWorker = this;
-        this->auxLoop();
         t_localWorker = nullptr;
     });
 }
@@ -107,11 +85,19 @@ int ThreadWorker::queueSize() const
 
 void ThreadWorker::run()
 {
+    if (m_findTaskFn)
+    {
+        runWorkStealing();
+        return;
+    }
+
+    //An exit picked up by park() while inside a task ends the loop once that task returns.
     bool active = true;
-    while (active)
+    while (active && !m_exitRequested)
     {
         ThreadWorkerMessage msg;
-        m_queue->waitPop(msg);
+        if (!m_queue->tryPop(msg))
+            idleWaitPop(msg);
 
         switch (msg.type)
         {
@@ -120,101 +106,151 @@ void ThreadWorker::run()
                 runInThread(msg.fn, msg.ctx);
             }
             break;
+        case ThreadMessageType::Signal:
+            break;
         case ThreadMessageType::Exit:
         default:
+            active = false;
+        }
+    }
+}
+
+void ThreadWorker::runWorkStealing()
+{
+    bool active = true;
+    while (active)
+    {
+        ThreadWorkerMessage msg;
+        bool hasMessage = m_queue->tryPop(msg);
+        if (!hasMessage)
+        {
+            TaskFn fn;
+            TaskContext ctx;
+            if (m_findTaskFn(*this, fn, ctx))
+            {
+                runInThread(fn, ctx);
+                continue;
+            }
+
+            //drain all the work before exiting the top level loop.
+            if (m_exitRequested)
             {
-                if (msg.targetStack == m_activeDepth || msg.targetStack < 0)
-                {
-                    active = false;
-                }
-                else
-                {
-                    m_queue->addInactiveMessage(msg);
-                }
+                active = false;
+                continue;
             }
+
+            idleWaitPop(msg);
         }
+
+        switch (msg.type)
+        {
+        case ThreadMessageType::Signal:
+            break;
+        case ThreadMessageType::Exit:
+        default:
+            m_exitRequested = true;
+        }
+    }
+}
+
+void ThreadWorker::park()
+{
+    ThreadWorkerMessage msg;
+    idleWaitPop(msg);
+    switch (msg.type)
+    {
+    case ThreadMessageType::RunJob:
+        runInThread(msg.fn, msg.ctx);
+        break;
+    case ThreadMessageType::Signal:
+        break;
+    case ThreadMessageType::Exit:
+    default:
+        m_exitRequested = true;
     }
 }
 
 bool ThreadWorker::stealJob(TaskFn& outFn, TaskContext& payload)
 {
+    //The queue is lock free, so control messages popped on the way to a job get pushed back.
+    //The owner might briefly miss them, but the push back wakes it up again.
     bool result = false;
     std::vector<ThreadWorkerMessage> tmpMessages;
-    m_queue->acquireThread();
     ThreadWorkerMessage currMessage;
-    while (m_queue->unsafePop(currMessage))
+    while (m_queue->tryPop(currMessage))
     {
         if (currMessage.type == ThreadMessageType::RunJob)
         {
-            outFn = currMessage.fn;
+            outFn = std::move(currMessage.fn);
             payload = currMessage.ctx;
             result = true;
             break;
         }
         else
         {
-            tmpMessages.push_back(currMessage);
+            tmpMessages.push_back(std::move(currMessage));
         }
     }
 
     for (auto& tmpMsg : tmpMessages)
-        m_queue->unsafePush(tmpMsg);
-    m_queue->releaseThread();
+        m_queue->push(std::move(tmpMsg));
     return result;
 }
 
+void ThreadWorker::idleWaitPop(ThreadWorkerMessage& msg)
+{
+    unsigned long long startNs = TaskTracer::now();
+    m_queue->waitPop(msg);
+    unsigned long long endNs = TaskTracer::now();
+    m_counters->idleTimeNs.fetch_add(endNs - startNs, std::memory_order_relaxed);
+    if (m_tracer)
+        m_tracer->record(TraceEventType::Idle, Task(), std::string(), startNs, endNs);
+}
+
 void ThreadWorker::runInThread(TaskFn fn, TaskContext& payload)
 {
     CPY_ASSERT(getLocalThreadWorker() == this);
 
+    //nested tasks run from wait() / yield() inside fn, restore the outer start time after.
+    unsigned long long outerTaskStartNs = m_taskStartNs;
+    if (m_tracer)
+        m_taskStartNs = TaskTracer::now();
+
+    Task outerTask = m_runningTask;
+    unsigned long long outerTaskStartTicks = m_taskStartTicks;
+    unsigned outerTaskStartFrame = m_taskStartFrame;
+    m_runningTask = payload.task;
+    m_taskStartTicks = Profiler::enabled() ? Profiler::now() : 0;
+    m_taskStartFrame = m_taskStartTicks != 0 ? Profiler::frame() : 0;
+
     if (fn)
         fn(payload);
     
     if (m_onTaskCompleteFn)
         m_onTaskCompleteFn(payload.task);
+
+    m_taskStartNs = outerTaskStartNs;
+    m_runningTask = outerTask;
+    m_taskStartTicks = outerTaskStartTicks;
+    m_taskStartFrame = outerTaskStartFrame;
 }
 
-void ThreadWorker::auxLoop()
+void ThreadWorker::waitUntil(TaskBlockFn fn)
 {
-    bool active = true;
-    while (active)
-    {
-        ThreadWorkerMessage msg;
-        m_auxQueue->waitPop(msg);
-
-        switch (msg.type)
-        {
-        case ThreadMessageType::RunAuxLambda:
-            {
-                CPY_ASSERT(msg.blockFn);
-                msg.blockFn(); //this function, which is set internally, usually waits for responses.
-
-                //send a message to the main thread which is waiting, to wake up and exit the current stack frame (and resume previously asleep work)
-                ThreadWorkerMessage response;
-                response.type = ThreadMessageType::Exit;
-                response.targetStack = msg.targetStack;
-                m_queue->push(response);
-                break;
-            }
-        case ThreadMessageType::Exit:
-        default:
-            active = false;
-        }
-    }
+    if (m_yieldFn)
+        m_yieldFn(*this, fn);
+    else
+        runBlocking(fn);
 }
 
-void ThreadWorker::waitUntil(TaskBlockFn fn)
+void ThreadWorker::runBlocking(TaskBlockFn& fn)
 {
-    ThreadWorkerMessage msg;
-    msg.type = ThreadMessageType::RunAuxLambda;
-    msg.blockFn = fn;
-    msg.targetStack = m_activeDepth + 1;
-    m_auxQueue->push(msg);
-    ++m_activeDepth;
-    run(); //trap and start a new job in the stack until the aux thread is finished.
-    --m_activeDepth;
-
-    m_queue->recoverInactiveMessages();
+    unsigned long long startNs = TaskTracer::now();
+    fn();
+    unsigned long long endNs = TaskTracer::now();
+    m_counters->blockedTimeNs.fetch_add(endNs - startNs, std::memory_order_relaxed);
+    if (m_tracer)
+        m_tracer->record(TraceEventType::Blocked, Task(), std::string("yieldUntil"), startNs, endNs);
 }
 
 void ThreadWorker::signalStop()
@@ -225,7 +261,6 @@ void ThreadWorker::signalStop()
     ThreadWorkerMessage exitMessage;
     exitMessage.type = ThreadMessageType::Exit;
     m_queue->push(exitMessage);
-    m_auxQueue->push(exitMessage);
 }
 
 void ThreadWorker::join()
@@ -236,13 +271,16 @@ void ThreadWorker::join()
         delete m_thread;
         m_thread = nullptr;
     }
+}
 
-    if (m_auxThread)
-    {
-        m_auxThread->join();
-        delete m_auxThread;
-        m_auxThread = nullptr;
-    }
+void ThreadWorker::signal()
+{
+    if (!m_thread)
+        return;
+
+    ThreadWorkerMessage signalMessage;
+    signalMessage.type = ThreadMessageType::Signal;
+    m_queue->push(signalMessage);
 }
 
 void ThreadWorker::schedule(TaskFn fn, TaskContext& context)
@@ -252,9 +290,9 @@ void ThreadWorker::schedule(TaskFn fn, TaskContext& context)
 
     ThreadWorkerMessage runMessage;
     runMessage.type = ThreadMessageType::RunJob;
-    runMessage.fn = fn;
+    runMessage.fn = std::move(fn);
     runMessage.ctx = context;
-    m_queue->push(runMessage);
+    m_queue->push(std::move(runMessage));
 }
 
 ThreadWorker* ThreadWorker::getLocalThreadWorker()
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <coalpy.tasks/TaskDefs.h>
+#include <atomic>
 #include <memory>
 #include <functional>
 
@@ -13,9 +14,26 @@ namespace coalpy
 {
 
 class ThreadWorkerQueue;
+class ThreadWorker;
+struct ThreadWorkerMessage;
+template<typename T> class WorkStealingQueue;
+class TaskTracer;
 
 using OnTaskCompleteFn = std::function<void(Task)>;
 
+//Work stealing mode: called by the worker when it needs a new task. If no task is found the worker
+//sleeps until signal() is called.
+using FindTaskFn = std::function<bool(ThreadWorker& worker, TaskFn& fn, TaskContext& ctx)>;
+
+//Called by TaskUtil::yieldUntil, decides where the blocking function runs. Without it the function runs inline.
+using YieldFn = std::function<void(ThreadWorker& worker, TaskBlockFn& blockFn)>;
+
+struct ThreadWorkerCounters
+{
+    std::atomic<unsigned long long> idleTimeNs = 0;
+    std::atomic<unsigned long long> blockedTimeNs = 0;
+};
+
 class ThreadWorker
 {
 public:
@@ -23,25 +41,60 @@ public:
     ~ThreadWorker();
     
     void setId(int workerId) { m_workerId = workerId; }
-    void start(OnTaskCompleteFn onTaskCompleteFn = nullptr);
+    int id() const { return m_workerId; }
+    void setTracer(TaskTracer* tracer) { m_tracer = tracer; }
+    //Logical core the thread gets pinned to when it starts, -1 leaves it to the os.
+    void setCpuAffinity(int cpuId) { m_cpuId = cpuId; }
+    //Cache domain, used to decide which workers to steal from first.
+    void setDomain(int domain) { m_domain = domain; }
+    int domain() const { return m_domain; }
+    //Start time of the innermost task running in this thread, only tracked while tracing.
+    unsigned long long taskStartNs() const { return m_taskStartNs; }
+    //Innermost task running in this thread, when it started on the Profiler clock (0 if the profiler was off) and in which frame.
+    Task runningTask() const { return m_runningTask; }
+    unsigned long long taskStartTicks() const { return m_taskStartTicks; }
+    unsigned taskStartFrame() const { return m_taskStartFrame; }
+    const ThreadWorkerCounters& counters() const { return *m_counters; }
+    void start(OnTaskCompleteFn onTaskCompleteFn = nullptr, FindTaskFn findTaskFn = nullptr, YieldFn yieldFn = nullptr);
     void schedule(TaskFn fn, TaskContext& payload);
+    void signal();
+    WorkStealingQueue<Task>& deque(TaskPriority priority) { return *m_deques[(int)priority]; }
     bool stealJob(TaskFn& fn, TaskContext& payload);
     void runInThread(TaskFn fn, TaskContext& payload);
     void signalStop();
     void join();
     int queueSize() const;
     void waitUntil(TaskBlockFn fn);
+    //Runs a blocking function on this thread, accounted as blocked time.
+    void runBlocking(TaskBlockFn& fn);
+    //Sleeps until the next message, for a thread waiting inside a task with nothing else to run.
+    //Jobs sent meanwhile run right away, an exit request ends the run loop once the task returns.
+    void park();
+    //Tasks waiting inside tasks running on this thread, see TaskSystem::wait.
+    int waitDepth() const { return m_waitDepth; }
+    void setWaitDepth(int depth) { m_waitDepth = depth; }
     static ThreadWorker* getLocalThreadWorker();
 private:
     void run();
-    void auxLoop();
+    void runWorkStealing();
+    void idleWaitPop(ThreadWorkerMessage& msg);
     std::thread* m_thread = nullptr;
     ThreadWorkerQueue* m_queue = nullptr;
-    std::thread* m_auxThread = nullptr;
-    ThreadWorkerQueue* m_auxQueue = nullptr;
+    WorkStealingQueue<Task>* m_deques[(int)TaskPriority::Count] = {};
     OnTaskCompleteFn m_onTaskCompleteFn = nullptr;
-    int m_activeDepth = 0;
+    FindTaskFn m_findTaskFn = nullptr;
+    YieldFn m_yieldFn = nullptr;
     int m_workerId = -1;
+    int m_cpuId = -1;
+    int m_domain = 0;
+    TaskTracer* m_tracer = nullptr;
+    ThreadWorkerCounters* m_counters = nullptr;
+    unsigned long long m_taskStartNs = 0;
+    Task m_runningTask;
+    unsigned long long m_taskStartTicks = 0;
+    unsigned m_taskStartFrame = 0;
+    int m_waitDepth = 0;
+    bool m_exitRequested = false;
 };
 
 }
@@ -0,0 +1,156 @@
+#pragma once
+
+#include <atomic>
+#include <vector>
+
+namespace coalpy
+{
+
+//Chase-Lev work stealing deque.
+//Only the owner thread is allowed to call push / pop (LIFO end).
+//Any thread is allowed to call steal (FIFO end).
+//Memory orders follow "Correct and Efficient Work-Stealing for Weak Memory Models" (Le et al. 2013)
+//T must be trivially copyable (task handles / pointers).
+template<typename T>
+class WorkStealingQueue
+{
+public:
+    explicit WorkStealingQueue(long long initialCapacity = 1024);
+    ~WorkStealingQueue();
+
+    void push(T item);
+    bool pop(T& item);
+    bool steal(T& item);
+
+    bool empty() const;
+    int size() const;
+
+private:
+    struct Buffer
+    {
+        long long capacity;
+        long long mask;
+        std::atomic<T>* items;
+
+        Buffer(long long c) : capacity(c), mask(c - 1), items(new std::atomic<T>[c]) {}
+        ~Buffer() { delete [] items; }
+
+        void put(long long i, T item) { items[i & mask].store(item, std::memory_order_relaxed); }
+        T get(long long i) const { return items[i & mask].load(std::memory_order_relaxed); }
+    };
+
+    Buffer* grow(Buffer* buffer, long long bottom, long long top);
+
+    alignas(64) std::atomic<long long> m_top;
+    alignas(64) std::atomic<long long> m_bottom;
+    alignas(64) std::atomic<Buffer*> m_buffer;
+
+    //Retired buffers, only touched by the owner. Thieves might still be reading from them so they
+    //get released when the queue is destroyed.
+    std::vector<Buffer*> m_retiredBuffers;
+};
+
+template<typename T>
+WorkStealingQueue<T>::WorkStealingQueue(long long initialCapacity)
+: m_top(0), m_bottom(0)
+{
+    long long capacity = 1;
+    while (capacity < initialCapacity)
+        capacity <<= 1;
+    m_buffer.store(new Buffer(capacity), std::memory_order_relaxed);
+}
+
+template<typename T>
+WorkStealingQueue<T>::~WorkStealingQueue()
+{
+    for (auto* b : m_retiredBuffers)
+        delete b;
+    delete m_buffer.load(std::memory_order_relaxed);
+}
+
+template<typename T>
+typename WorkStealingQueue<T>::Buffer* WorkStealingQueue<T>::grow(Buffer* buffer, long long bottom, long long top)
+{
+    Buffer* newBuffer = new Buffer(buffer->capacity * 2);
+    for (long long i = top; i < bottom; ++i)
+        newBuffer->put(i, buffer->get(i));
+    m_retiredBuffers.push_back(buffer);
+    m_buffer.store(newBuffer, std::memory_order_release);
+    return newBuffer;
+}
+
+template<typename T>
+void WorkStealingQueue<T>::push(T item)
+{
+    long long b = m_bottom.load(std::memory_order_relaxed);
+    long long t = m_top.load(std::memory_order_acquire);
+    Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+    if (b - t > buffer->capacity - 1)
+        buffer = grow(buffer, b, t);
+
+    buffer->put(b, item);
+    std::atomic_thread_fence(std::memory_order_release);
+    m_bottom.store(b + 1, std::memory_order_relaxed);
+}
+
+template<typename T>
+bool WorkStealingQueue<T>::pop(T& item)
+{
+    long long b = m_bottom.load(std::memory_order_relaxed) - 1;
+    Buffer* buffer = m_buffer.load(std::memory_order_relaxed);
+    m_bottom.store(b, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long t = m_top.load(std::memory_order_relaxed);
+
+    if (t > b)
+    {
+        //empty queue
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return false;
+    }
+
+    item = buffer->get(b);
+    if (t == b)
+    {
+        //last element, race against thieves.
+        bool won = m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+        return won;
+    }
+
+    return true;
+}
+
+template<typename T>
+bool WorkStealingQueue<T>::steal(T& item)
+{
+    long long t = m_top.load(std::memory_order_acquire);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    long long b = m_bottom.load(std::memory_order_acquire);
+    if (t >= b)
+        return false;
+
+    Buffer* buffer = m_buffer.load(std::memory_order_acquire);
+    T candidate = buffer->get(t);
+    if (!m_top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed))
+        return false;
+
+    item = candidate;
+    return true;
+}
+
+template<typename T>
+bool WorkStealingQueue<T>::empty() const
+{
+    return size() <= 0;
+}
+
+template<typename T>
+int WorkStealingQueue<T>::size() const
+{
+    long long b = m_bottom.load(std::memory_order_relaxed);
+    long long t = m_top.load(std::memory_order_relaxed);
+    return b > t ? (int)(b - t) : 0;
+}
+
+}
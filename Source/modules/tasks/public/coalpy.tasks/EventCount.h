@@ -0,0 +1,38 @@
+#pragma once
+
+#include <atomic>
+
+namespace coalpy
+{
+
+//Eventcount used to park threads waiting on lock free containers.
+//Waiters announce themselves with prepareWait, re-check their condition and then call wait / waitFor
+//with the key returned. Notifiers only touch the kernel if there is a registered waiter,
+//so the common (uncontended) path is a single atomic load.
+//Parking uses a futex on linux, and a mutex / condition variable elsewhere.
+class EventCount
+{
+public:
+    EventCount();
+    ~EventCount();
+
+    unsigned prepareWait();
+    void cancelWait();
+    void wait(unsigned key);
+
+    //returns false if the timeout was hit before a notification arrived.
+    bool waitFor(unsigned key, int milliseconds);
+
+    void notifyOne() { notify(false); }
+    void notifyAll() { notify(true); }
+
+private:
+    void notify(bool all);
+
+    std::atomic<unsigned> m_epoch;
+    std::atomic<int> m_waiters;
+    struct ParkState;
+    ParkState* m_parkState = nullptr;
+};
+
+}
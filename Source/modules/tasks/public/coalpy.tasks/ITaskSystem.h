@@ -1,5 +1,7 @@
 #pragma once
 #include <coalpy.tasks/TaskDefs.h>
+#include <algorithm>
+#include <vector>
 
 namespace coalpy
 {
@@ -12,6 +14,7 @@ public:
     virtual void start() = 0;
     virtual void signalStop() = 0;
     virtual void join() = 0;
+    //Returns an invalid task if the task table is full.
     virtual Task createTask(const TaskDesc& taskDesc, void* data = nullptr) = 0;
     virtual void depends(Task src, Task dst) = 0;
     virtual void depends(Task src, Task* dsts, int counts) = 0;
@@ -22,6 +25,45 @@ public:
     virtual void cleanTaskTree(Task src) = 0;
     virtual void yield() = 0;
 
+    //Runs fn over [begin, end) in sub ranges and blocks until all of them are done.
+    //Ranges are split in halves while other workers can take them, up to workers * log2(count / grainSize)
+    //ranges in total. Ranges of grainSize or smaller run inline on the calling thread. Can be called from inside tasks.
+    virtual void parallelFor(int begin, int end, int grainSize, ParallelForFn fn) = 0;
+
+    //Stackless continuation, only valid from inside the function of task self (one per run).
+    //Instead of blocking in wait(), self gets suspended when its function returns, and continuation runs
+    //as the rest of self once all the awaited tasks are finished (unscheduled ones get started).
+    //No thread is held while suspended and chains of waits don't grow the worker stack.
+    //Awaited tasks become dependencies of self, so cleanTaskTree(self) removes them.
+    virtual void continueAfter(Task self, Task* awaited, int counts, TaskFn continuation) = 0;
+
+    //Task graph templates. createGraph validates the graph once and freezes it into topologically sorted
+    //nodes with precomputed dependency counts, returns an invalid handle if the graph has a cycle.
+    //An instance allocates all its tasks and copies the edges under a single lock, nothing else gets resolved.
+    //Its tasks run the node descs of the template in place, so instances must be cleaned before destroyGraph.
+    //Every node runs with ctx.data = data, unless nodeData (one entry per node in addNode order) is provided.
+    //The returned task finishes after all the nodes: wait on it, and release the instance with cleanTaskTree.
+    //Instantiating returns an invalid task if the task table can't fit the instance.
+    virtual TaskGraph createGraph(const TaskGraphDesc& desc) = 0;
+    virtual void destroyGraph(TaskGraph graph) = 0;
+    //The instance does not start until the returned task is executed, so it can get more dependencies.
+    virtual Task instantiateGraph(TaskGraph graph, void* data = nullptr, void* const* nodeData = nullptr) = 0;
+    //Instantiates and starts right away, the nodes without dependencies get scheduled directly.
+    virtual Task executeGraph(TaskGraph graph, void* data = nullptr, void* const* nodeData = nullptr) = 0;
+
+    //Creates all the tasks of a batch and wires their dependencies under a single lock, handles end up in batch.tasks.
+    //The descs are moved out of the batch. If the task table can't fit the whole batch nothing gets created,
+    //batch.tasks is left with invalid handles and the descs stay in the batch.
+    //With execute, the tasks of the batch get started as if execute had been called on all of them at once.
+    virtual void submit(TaskBatch& batch, bool execute = true) = 0;
+
+    //True if the task was skipped, or if its token got cancelled or its deadline passed.
+    //Long running tasks poll this with ctx.task to bail out early.
+    virtual bool isCancelled(Task task) = 0;
+
+    //Finishes a task created with TaskFlags::External, from any thread. Its dependents get scheduled as usual.
+    virtual void signal(Task task) = 0;
+
     //convenience functions
     inline Task createTask()
     {
@@ -29,16 +71,72 @@ public:
         return createTask(emptyDesc);
     } 
 
+    inline void continueAfter(Task self, Task awaited, TaskFn continuation)
+    {
+        continueAfter(self, &awaited, 1, continuation);
+    }
+
+    //rangeFn(begin, end) returns the partial result of a range, reduceFn(a, b) combines two results.
+    //Partial results are combined in range order, so reduceFn only needs to be associative.
+    template<typename T, typename RangeFnType, typename ReduceFnType>
+    inline T parallelReduce(int begin, int end, int grainSize, T identity, RangeFnType rangeFn, ReduceFnType reduceFn)
+    {
+        if (end <= begin)
+            return identity;
+
+        grainSize = std::max(grainSize, 1);
+        int chunkCount = (end - begin + grainSize - 1) / grainSize;
+        if (chunkCount == 1)
+            return reduceFn(identity, rangeFn(begin, end));
+
+        struct Partial { T value; };
+        std::vector<Partial> partials(chunkCount, Partial { identity });
+        parallelFor(0, chunkCount, 1, [&](int chunkBegin, int chunkEnd)
+        {
+            for (int c = chunkBegin; c < chunkEnd; ++c)
+            {
+                int rangeBegin = begin + c * grainSize;
+                partials[c].value = rangeFn(rangeBegin, std::min(rangeBegin + grainSize, end));
+            }
+        });
+
+        T result = identity;
+        for (auto& p : partials)
+            result = reduceFn(result, p.value);
+        return result;
+    }
+
     struct Stats
     {
         int numElements;
+        //Ready tasks waiting in queues, not yet picked by a worker.
+        int queuedTasks;
+        int queuedIoTasks;
+        //Tasks taken from another worker's queue.
+        unsigned long long steals;
+        //Accumulated over all workers since the task system got created.
+        double idleTimeMs;
+        //Time spent inside TaskUtil::yieldUntil plus time threads outside the pool spent in wait().
+        double blockedTimeMs;
+        //Tasks skipped because they got cancelled, missed their deadline or depend on a skipped task.
+        unsigned long long cancelledTasks;
+        //Pool layout, see TaskSystemDesc.
+        int computeWorkers;
+        int ioWorkers;
+        int workerDomains;
     };
 
     virtual void getStats(Stats& outStats) = 0;
+
+    //Writes the recorded events in chrome trace_event json format (chrome://tracing, ui.perfetto.dev).
+    //Returns false if TaskSystemDesc::enableTracing is not set.
+    virtual bool writeTrace(std::string& outJson) = 0;
 };
 
 namespace TaskUtil
 {
+    //Runs a blocking function from inside a task. Io workers run it inline, compute workers hand it
+    //to the io lane and keep running other tasks until it returns.
     void yieldUntil(TaskBlockFn fn);
     void sleepThread(int ms);
 }
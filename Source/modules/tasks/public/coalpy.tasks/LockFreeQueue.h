@@ -0,0 +1,264 @@
+#pragma once
+
+#include <coalpy.tasks/EventCount.h>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace coalpy
+{
+
+//Multi producer / multi consumer queue: worker mailboxes, the scheduler and injection queues, the file watcher.
+//Same interface as ThreadQueue. Messages live in a bounded lock free ring buffer (Vyukov style, every cell carries a sequence number).
+//If the ring fills up, messages spill into a locked overflow list so push never blocks nor fails;
+//messages from a single producer are still popped in order.
+//Waiting consumers spin for a short while and then park on an eventcount, so push only
+//pays for a wake up when a consumer is actually asleep.
+template<typename MessageType>
+class LockFreeQueue
+{
+public:
+    explicit LockFreeQueue(int capacity = 1024);
+    ~LockFreeQueue();
+
+    //approximate, only meant for heuristics.
+    int size() const;
+
+    void push(const MessageType& msg);
+    void push(MessageType&& msg);
+    bool tryPop(MessageType& msg);
+    void waitPop(MessageType& msg);
+    bool waitPopUntil(MessageType& msg, int milliseconds);
+
+private:
+    enum { SpinCount = 64 };
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        MessageType data;
+    };
+
+    bool tryEnqueue(MessageType& msg);
+    bool tryDequeue(MessageType& msg);
+    bool tryPopOverflow(MessageType& msg);
+    bool spinPop(MessageType& msg);
+
+    Cell* m_cells = nullptr;
+    size_t m_mask = 0;
+    alignas(64) std::atomic<size_t> m_enqueuePos;
+    alignas(64) std::atomic<size_t> m_dequeuePos;
+    alignas(64) std::atomic<int> m_overflowCount;
+    std::mutex m_overflowMutex;
+    std::deque<MessageType> m_overflow;
+    EventCount m_eventCount;
+};
+
+template<typename MessageType>
+LockFreeQueue<MessageType>::LockFreeQueue(int capacity)
+: m_enqueuePos(0), m_dequeuePos(0), m_overflowCount(0)
+{
+    size_t cellCount = 2;
+    while (cellCount < (size_t)capacity)
+        cellCount <<= 1;
+
+    m_cells = new Cell[cellCount];
+    m_mask = cellCount - 1;
+    for (size_t i = 0; i < cellCount; ++i)
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+}
+
+template<typename MessageType>
+LockFreeQueue<MessageType>::~LockFreeQueue()
+{
+    delete [] m_cells;
+}
+
+template<typename MessageType>
+int LockFreeQueue<MessageType>::size() const
+{
+    size_t enqueuePos = m_enqueuePos.load(std::memory_order_relaxed);
+    size_t dequeuePos = m_dequeuePos.load(std::memory_order_relaxed);
+    int ringSize = enqueuePos > dequeuePos ? (int)(enqueuePos - dequeuePos) : 0;
+    return ringSize + m_overflowCount.load(std::memory_order_relaxed);
+}
+
+template<typename MessageType>
+void LockFreeQueue<MessageType>::push(const MessageType& msg)
+{
+    MessageType copy = msg;
+    push(std::move(copy));
+}
+
+template<typename MessageType>
+void LockFreeQueue<MessageType>::push(MessageType&& msg)
+{
+    //once something spilled, keep spilling until the overflow drains so a producer's messages stay in order.
+    if (m_overflowCount.load(std::memory_order_acquire) > 0 || !tryEnqueue(msg))
+    {
+        std::unique_lock<std::mutex> lock(m_overflowMutex);
+        m_overflow.push_back(std::move(msg));
+        m_overflowCount.fetch_add(1, std::memory_order_release);
+    }
+
+    m_eventCount.notifyOne();
+}
+
+template<typename MessageType>
+bool LockFreeQueue<MessageType>::tryPop(MessageType& msg)
+{
+    return tryDequeue(msg) || tryPopOverflow(msg);
+}
+
+template<typename MessageType>
+void LockFreeQueue<MessageType>::waitPop(MessageType& msg)
+{
+    if (spinPop(msg))
+        return;
+
+    while (true)
+    {
+        unsigned key = m_eventCount.prepareWait();
+        if (tryPop(msg))
+        {
+            m_eventCount.cancelWait();
+            return;
+        }
+        m_eventCount.wait(key);
+        if (tryPop(msg))
+            return;
+    }
+}
+
+template<typename MessageType>
+bool LockFreeQueue<MessageType>::waitPopUntil(MessageType& msg, int milliseconds)
+{
+    if (spinPop(msg))
+        return true;
+
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(milliseconds);
+    while (true)
+    {
+        unsigned key = m_eventCount.prepareWait();
+        if (tryPop(msg))
+        {
+            m_eventCount.cancelWait();
+            return true;
+        }
+
+        auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+        if (remaining <= 0)
+        {
+            m_eventCount.cancelWait();
+            return false;
+        }
+
+        m_eventCount.waitFor(key, (int)remaining);
+        if (tryPop(msg))
+            return true;
+    }
+}
+
+template<typename MessageType>
+bool LockFreeQueue<MessageType>::spinPop(MessageType& msg)
+{
+    for (int i = 0; i < SpinCount; ++i)
+    {
+        if (tryPop(msg))
+            return true;
+        std::this_thread::yield();
+    }
+    return false;
+}
+
+template<typename MessageType>
+bool LockFreeQueue<MessageType>::tryEnqueue(MessageType& msg)
+{
+    Cell* cell;
+    size_t pos = m_enqueuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+        cell = &m_cells[pos & m_mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)pos;
+        if (diff == 0)
+        {
+            if (m_enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            //ring is full
+            return false;
+        }
+        else
+        {
+            pos = m_enqueuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    cell->data = std::move(msg);
+    cell->sequence.store(pos + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename MessageType>
+bool LockFreeQueue<MessageType>::tryDequeue(MessageType& msg)
+{
+    Cell* cell;
+    size_t pos = m_dequeuePos.load(std::memory_order_relaxed);
+    while (true)
+    {
+        cell = &m_cells[pos & m_mask];
+        size_t seq = cell->sequence.load(std::memory_order_acquire);
+        intptr_t diff = (intptr_t)seq - (intptr_t)(pos + 1);
+        if (diff == 0)
+        {
+            if (m_dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                break;
+        }
+        else if (diff < 0)
+        {
+            //ring is empty (or the producer of this cell has not published it yet)
+            return false;
+        }
+        else
+        {
+            pos = m_dequeuePos.load(std::memory_order_relaxed);
+        }
+    }
+
+    msg = std::move(cell->data);
+    cell->data = MessageType(); //release whatever the moved from message still holds.
+    cell->sequence.store(pos + m_mask + 1, std::memory_order_release);
+    return true;
+}
+
+template<typename MessageType>
+bool LockFreeQueue<MessageType>::tryPopOverflow(MessageType& msg)
+{
+    if (m_overflowCount.load(std::memory_order_acquire) == 0)
+        return false;
+
+    std::unique_lock<std::mutex> lock(m_overflowMutex);
+    if (m_overflow.empty())
+        return false;
+
+    //Only take from the overflow once every ring cell got claimed by a consumer: a message still in
+    //the ring (or being published) can be older than the front of the overflow list.
+    //Checked under the lock so no producer can spill a newer message in between.
+    //The dequeue position is read first: if the later enqueue position matches it, the ring was empty at that point.
+    size_t dequeuePos = m_dequeuePos.load(std::memory_order_acquire);
+    if (m_enqueuePos.load(std::memory_order_acquire) != dequeuePos)
+        return false;
+
+    msg = std::move(m_overflow.front());
+    m_overflow.pop_front();
+    m_overflowCount.fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+}
@@ -3,6 +3,10 @@
 #include <coalpy.core/GenericHandle.h>
 #include <string>
 #include <functional>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
 
 namespace coalpy
 {
@@ -12,30 +16,182 @@ struct TaskDesc;
 struct TaskContext;
 class ITaskSystem;
 
+enum class TaskSchedulerMode
+{
+    //Tasks get pushed to the local deque of the worker that made them ready. Idle workers steal.
+    WorkStealing,
+    //Legacy mode: a single scheduler thread dispatches tasks round robin to the workers.
+    SchedulerThread
+};
+
+//How compute workers get grouped into cache domains. Workers steal inside their own domain
+//before crossing into another one, and domains on the same numa node come first.
+enum class TaskWorkerGrouping
+{
+    //A single domain, steal round robin.
+    None,
+    //Workers whose cores share the last level cache.
+    L3Cache,
+    NumaNode
+};
+
 struct TaskSystemDesc
 {
-    int threadPoolSize = 8u;
+    //Compute workers. 0 or less sizes the pool from the logical cores available to the process.
+    int threadPoolSize = 0;
+    //Workers dedicated to TaskFlags::IoBound tasks. With 0, io bound tasks run on the compute workers.
+    int ioThreadPoolSize = 2;
+    TaskSchedulerMode schedulerMode = TaskSchedulerMode::WorkStealing;
+    //Pins every compute worker to a logical core. Workers get laid out domain by domain,
+    //so without pinning the grouping is only a hint the os is free to ignore.
+    bool pinWorkers = false;
+    TaskWorkerGrouping workerGrouping = TaskWorkerGrouping::L3Cache;
+    //Records scheduling, run, steal, blocked and idle events per thread, see ITaskSystem::writeTrace.
+    bool enableTracing = false;
+    //Size of each thread's ring buffer, older events get overwritten.
+    int traceEventsPerThread = 1 << 16;
 };
 
 enum class TaskFlags : int
 {
-    AutoStart = 1 << 0
+    AutoStart = 1 << 0,
+    //Runs on the io lane, for tasks that block on files (TaskUtil::yieldUntil). Compute workers never pick these up.
+    IoBound = 1 << 1,
+    //Never runs and never gets picked up by execute: the task finishes when ITaskSystem::signal is called on it.
+    //Stands for work completed outside of the task system, like io completions.
+    External = 1 << 2
+};
+
+//Workers always pick the highest priority task available.
+enum class TaskPriority : int
+{
+    Critical,
+    Normal,
+    Background,
+    Count
 };
 
 using TaskBlockFn = std::function<void()>;
 using TaskFn = std::function<void(TaskContext& ctx)>;
+using ParallelForFn = std::function<void(int begin, int end)>;
 using Task = GenericHandle<unsigned int>;
+using TaskGraph = GenericHandle<unsigned int>;
+using TaskClock = std::chrono::steady_clock;
+
+//Shared cancellation flag, copies refer to the same flag. A default constructed token can never be cancelled.
+class CancelToken
+{
+public:
+    static CancelToken create()
+    {
+        CancelToken token;
+        token.m_flag = std::make_shared<std::atomic<bool>>(false);
+        return token;
+    }
+
+    bool valid() const { return m_flag != nullptr; }
+    void cancel() const { if (m_flag) m_flag->store(true, std::memory_order_release); }
+    bool isCancelled() const { return m_flag && m_flag->load(std::memory_order_acquire); }
+
+private:
+    std::shared_ptr<std::atomic<bool>> m_flag;
+};
 
 struct TaskDesc
 {
-    TaskDesc() : name(""), flags(0), fn(nullptr) {}
-    TaskDesc(TaskFn fn) : name(""), flags(0), fn(fn) {}
-    TaskDesc(std::string nm, int flags, TaskFn fn) : name(nm), flags(flags), fn(fn) {}
-    TaskDesc(std::string nm, TaskFn fn) : name(nm), flags(0), fn(fn) {}
+    TaskDesc() : name(""), flags(0), fn(nullptr), priority(TaskPriority::Normal) {}
+    TaskDesc(TaskFn fn) : name(""), flags(0), fn(fn), priority(TaskPriority::Normal) {}
+    TaskDesc(std::string nm, int flags, TaskFn fn, TaskPriority priority = TaskPriority::Normal) : name(nm), flags(flags), fn(fn), priority(priority) {}
+    TaskDesc(std::string nm, TaskFn fn, TaskPriority priority = TaskPriority::Normal) : name(nm), flags(0), fn(fn), priority(priority) {}
 
     std::string name;
     int flags;
     TaskFn fn;
+    TaskPriority priority;
+
+    //A cancelled task, or one still not dispatched when its deadline passes, is skipped: its function
+    //does not run and the tasks depending on it get skipped too. See ITaskSystem::isCancelled.
+    CancelToken cancelToken;
+    TaskClock::time_point deadline = TaskClock::time_point::max();
+};
+
+//Reusable dependency graph, frozen with ITaskSystem::createGraph and instantiated many times.
+struct TaskGraphDesc
+{
+    //Returns the index of the node.
+    int addNode(const TaskDesc& desc)
+    {
+        nodes.push_back(desc);
+        return (int)nodes.size() - 1;
+    }
+
+    //node runs once dependency finished.
+    void depends(int node, int dependency) { edges.push_back(Edge { node, dependency }); }
+
+    struct Edge
+    {
+        int node;
+        int dependency;
+    };
+
+    std::string name;
+    std::vector<TaskDesc> nodes;
+    std::vector<Edge> edges;
+};
+
+//Tasks recorded locally and published with a single ITaskSystem::submit call.
+//submit moves the descs into the task system, clear the batch before reusing it, the vectors keep their capacity.
+struct TaskBatch
+{
+    //Returns the index of the task in the batch.
+    int add(const TaskDesc& desc, void* data = nullptr)
+    {
+        descs.push_back(desc);
+        datas.push_back(data);
+        return (int)descs.size() - 1;
+    }
+
+    int add(TaskDesc&& desc, void* data = nullptr)
+    {
+        descs.push_back(std::move(desc));
+        datas.push_back(data);
+        return (int)descs.size() - 1;
+    }
+
+    //node runs once dependency finished, both are indices returned by add.
+    void depends(int node, int dependency) { edges.push_back(Edge { node, dependency }); }
+
+    //node runs once a task created outside of the batch finished.
+    void depends(int node, Task external) { externalEdges.push_back(ExternalEdge { node, external }); }
+
+    void clear()
+    {
+        descs.clear();
+        datas.clear();
+        edges.clear();
+        externalEdges.clear();
+        tasks.clear();
+    }
+
+    struct Edge
+    {
+        int node;
+        int dependency;
+    };
+
+    struct ExternalEdge
+    {
+        int node;
+        Task dependency;
+    };
+
+    std::vector<TaskDesc> descs;
+    std::vector<void*> datas;
+    std::vector<Edge> edges;
+    std::vector<ExternalEdge> externalEdges;
+
+    //Filled by submit, one handle per add call in the same order.
+    std::vector<Task> tasks;
 };
 
 struct TaskContext
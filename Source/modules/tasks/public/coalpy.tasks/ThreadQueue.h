@@ -1,5 +1,6 @@
 #pragma once
 
+#include <atomic>
 #include <queue>
 #include <condition_variable>
 #include <mutex>
@@ -8,46 +9,66 @@
 namespace coalpy
 {
 
+//Multi producer / multi consumer queue, a mutex and a condition variable.
+//The task system and the file watcher queues are LockFreeQueue, which has the same interface and beats this
+//one at every producer count in benchmarkThreadQueue. This one is the baseline it gets measured against.
 template<typename MessageType>
 class ThreadQueue
 {
 public:
     ~ThreadQueue() {}
 
+    //approximate, only meant for heuristics.
     int size() const;
+
     void push(const MessageType& msg);
-    void unsafePush(const MessageType& msg);
-    bool unsafePop(MessageType& msg);
+    void push(MessageType&& msg);
+    bool tryPop(MessageType& msg);
     void waitPop(MessageType& msg);
     bool waitPopUntil(MessageType& msg, int milliseconds);
-    void acquireThread() { m_mutex.lock(); }
-    void releaseThread() { m_mutex.unlock(); }
 
 private:
-    mutable std::mutex m_mutex;
+    bool unsafePop(MessageType& msg);
+
+    std::mutex m_mutex;
     std::condition_variable m_cv;
     std::queue<MessageType> m_queue;
+    //Mirrors m_queue.size() so size() and an empty tryPop don't take the lock.
+    std::atomic<int> m_count = 0;
 };
 
+template<typename MessageType>
+int ThreadQueue<MessageType>::size() const
+{
+    return m_count.load(std::memory_order_relaxed);
+}
+
 template<typename MessageType>
 void ThreadQueue<MessageType>::push(const MessageType& msg)
+{
+    MessageType copy = msg;
+    push(std::move(copy));
+}
+
+template<typename MessageType>
+void ThreadQueue<MessageType>::push(MessageType&& msg)
 {
     {
         std::unique_lock<std::mutex> lock(m_mutex);
-        unsafePush(msg);
+        m_queue.push(std::move(msg));
+        m_count.fetch_add(1, std::memory_order_relaxed);
     }
     m_cv.notify_one();
 }
 
 template<typename MessageType>
-int ThreadQueue<MessageType>::size() const
+bool ThreadQueue<MessageType>::tryPop(MessageType& msg)
 {
-    int sz;
-    {
-        std::unique_lock<std::mutex> lock(m_mutex);
-        sz = m_queue.size();
-    }
-    return sz;
+    if (m_count.load(std::memory_order_relaxed) == 0)
+        return false;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    return unsafePop(msg);
 }
 
 template<typename MessageType>
@@ -66,19 +87,14 @@ bool ThreadQueue<MessageType>::waitPopUntil(MessageType& msg, int milliseconds)
     return unsafePop(msg);
 }
 
-template<typename MessageType>
-void ThreadQueue<MessageType>::unsafePush(const MessageType& msg)
-{
-    m_queue.push(msg);
-}
-
 template<typename MessageType>
 bool ThreadQueue<MessageType>::unsafePop(MessageType& msg)
 {
     if (m_queue.empty())
         return false;
-    msg = m_queue.front();
+    msg = std::move(m_queue.front());
     m_queue.pop();
+    m_count.fetch_sub(1, std::memory_order_relaxed);
     return true;
 }
 
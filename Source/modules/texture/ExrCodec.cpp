@@ -1,14 +1,26 @@
 #include "ExrCodec.h"
 
 #include <coalpy.core/Assert.h>
+#include <coalpy.core/Profiler.h>
+#include <coalpy.tasks/ITaskSystem.h>
 #include <ImfChannelList.h>
 #include <ImfInputFile.h>
 #include <ImfStringAttribute.h>
 #include <ImfIO.h>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <vector>
 
 namespace coalpy
 {
 
+enum
+{
+    //Scanlines decoded per task, a multiple of the largest exr compression block (32 lines).
+    ExrRowsPerTask = 64
+};
+
 class ImfByteStream : public Imf::IStream
 {
 public:
@@ -52,8 +64,22 @@ private:
     Imf::Int64 m_i = 0;
 };
 
+//Decoder over the same source buffer as the main one, for the ranges read in parallel.
+struct ExrRangeReader
+{
+    ExrRangeReader(const unsigned char* buffer, size_t bufferSize, const Imf::FrameBuffer& fb)
+    : stream("exrFile", buffer, bufferSize), file(stream)
+    {
+        file.setFrameBuffer(fb);
+    }
+
+    ImfByteStream stream;
+    Imf::InputFile file;
+};
+
 ImgCodecResult ExrCodec::decompress(const unsigned char* buffer, size_t bufferSize, IImgImporter& outData)
 {
+    CPY_PROFILE_SCOPE("ExrCodec::decompress");
     try
     {
         ImfByteStream stream("exrFile", buffer, bufferSize);
@@ -106,8 +132,68 @@ ImgCodecResult ExrCodec::decompress(const unsigned char* buffer, size_t bufferSi
         else
             return ImgCodecResult{ TextureStatus::CorruptedFile, "EXR format must have channels R,RGB or RGBA" };
 
-        inputFile.setFrameBuffer(fb);
-        inputFile.readPixels(0, imageSize.y - 1);
+        if (m_ts == nullptr || imageSize.y <= ExrRowsPerTask)
+        {
+            inputFile.setFrameBuffer(fb);
+            inputFile.readPixels(0, imageSize.y - 1);
+        }
+        else
+        {
+            //Decoders are not thread safe, so each thread reading ranges takes its own one from a pool and
+            //returns it for the next range it picks up. The header and the line offset table get parsed
+            //once per thread instead of once per range, the first decoder is the one opened above.
+            inputFile.setFrameBuffer(fb);
+            std::mutex readersMutex;
+            std::vector<Imf::InputFile*> idleReaders = { &inputFile };
+            std::vector<std::unique_ptr<ExrRangeReader>> ownedReaders;
+            std::string errorMsg;
+            m_ts->parallelFor(0, imageSize.y, ExrRowsPerTask, [&](int rowBegin, int rowEnd)
+            {
+                Imf::InputFile* reader = nullptr;
+                {
+                    std::unique_lock lock(readersMutex);
+                    if (!errorMsg.empty())
+                        return;
+
+                    if (!idleReaders.empty())
+                    {
+                        reader = idleReaders.back();
+                        idleReaders.pop_back();
+                    }
+                }
+
+                try
+                {
+                    if (reader == nullptr)
+                    {
+                        auto newReader = std::make_unique<ExrRangeReader>(buffer, bufferSize, fb);
+                        reader = &newReader->file;
+                        std::unique_lock lock(readersMutex);
+                        ownedReaders.push_back(std::move(newReader));
+                    }
+
+                    reader->readPixels(rowBegin, rowEnd - 1);
+                }
+                catch (const std::exception& exc)
+                {
+                    //A decoder that threw is not handed out again.
+                    std::unique_lock lock(readersMutex);
+                    if (errorMsg.empty())
+                        errorMsg = exc.what();
+                    return;
+                }
+
+                std::unique_lock lock(readersMutex);
+                idleReaders.push_back(reader);
+            });
+
+            if (!errorMsg.empty())
+            {
+                std::stringstream ss;
+                ss << "Exception when reading EXR " << errorMsg;
+                return ImgCodecResult{ TextureStatus::CorruptedFile, ss.str() };
+            }
+        }
     }
     catch (const std::exception& exc)
     {
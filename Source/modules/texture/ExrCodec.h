@@ -8,11 +8,15 @@ namespace coalpy
 class ExrCodec : public IImgCodec
 {
 public:
+    explicit ExrCodec(ITaskSystem* ts) : m_ts(ts) {}
     virtual ImgFmt format() const override { return ImgFmt::Exr; }
     virtual ImgCodecResult decompress(
         const unsigned char* buffer,
         size_t bufferSize,
         IImgImporter& outData) override;
+
+private:
+    ITaskSystem* m_ts;
 };
 
 }
@@ -1,4 +1,5 @@
 #include "JpegCodec.h"
+#include <coalpy.core/Profiler.h>
 
 #include <jpeglib.h>
 #include <setjmp.h>
@@ -59,6 +60,7 @@ ImgCodecResult JpegCodec::decompress(
     size_t bufferSize,
     IImgImporter& outData)
 {
+    CPY_PROFILE_SCOPE("JpegCodec::decompress");
     JpegCodecContext context;
     auto& cinfo = context.cinfo;
     cinfo.err = jpeg_std_error(&context.errorMgr);
@@ -1,5 +1,6 @@
 #include "PngCodec.h"
 #include <coalpy.core/Assert.h>
+#include <coalpy.core/Profiler.h>
 #include <png.h>
 #include <zlib.h>
 #include <sstream>
@@ -12,6 +13,7 @@ ImgCodecResult PngCodec::decompress(
     size_t bufferSize,
     IImgImporter& outData)
 {
+    CPY_PROFILE_SCOPE("PngCodec::decompress");
     png_image image = {};
     image.version = PNG_IMAGE_VERSION;
     
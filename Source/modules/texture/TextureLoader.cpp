@@ -24,7 +24,7 @@ TextureLoader::TextureLoader(const TextureLoaderDesc& desc)
 {
     m_codecs[(int)ImgFmt::Jpeg] = new JpegCodec;
     m_codecs[(int)ImgFmt::Png] = new PngCodec;
-    m_codecs[(int)ImgFmt::Exr] = new ExrCodec;
+    m_codecs[(int)ImgFmt::Exr] = new ExrCodec(m_ts);
     m_fw->addListener(this);
 }
 
@@ -122,16 +122,14 @@ TextureLoadResult TextureLoader::loadTextureInternal(const char* fileName, rende
     imageLoader->texture() = loadState.texture;
 
     loadState.fileName = fileName;
+    loadState.cancelToken = CancelToken::create();
     
+    //Codecs decode straight from the mapped file, the view stays valid until cleanState closes the handle.
     FileReadRequest request(fileName, [this, &loadState](FileReadResponse& response)
     {
-        if (response.status == FileStatus::Reading)
+        if (response.status == FileStatus::Success)
         {
-            loadState.fileBuffer.append((const u8*)response.buffer, response.size);
-        }
-        else if (response.status == FileStatus::Success)
-        {
-            ImgCodecResult codecResult = loadState.codec->decompress(loadState.fileBuffer.data(), loadState.fileBuffer.size(), *loadState.imageImporter);
+            ImgCodecResult codecResult = loadState.codec->decompress((const u8*)response.buffer, (size_t)response.size, *loadState.imageImporter);
             if (codecResult.success())
             {
                 loadState.loadResult = TextureLoadResult { TextureStatus::Ok, render::Texture() };
@@ -158,6 +156,8 @@ TextureLoadResult TextureLoader::loadTextureInternal(const char* fileName, rende
     });
 
     request.additionalRoots = m_additionalPaths;
+    request.cancelToken = loadState.cancelToken;
+    request.flags = (int)FileRequestFlags::MemoryMap;
 
     loadState.fileHandle = m_fs->read(request);
 
@@ -191,7 +191,6 @@ void TextureLoader::processTextures(TextureReloadCallback reloadCb)
         while (!m_completeStates.empty() && loadBudget-- > 0)
         {
             auto* state = m_completeStates.front();
-            acquiredStates.push_back(state);
             m_completeStates.pop();
 
             //This happens when a state was deleted.
@@ -199,8 +198,10 @@ void TextureLoader::processTextures(TextureReloadCallback reloadCb)
             {
                 ++loadBudget;
                 freeLoadState(state);
+                continue;
             }
 
+            acquiredStates.push_back(state);
             m_loadingStates.erase(state->texture);
         }
     }
@@ -248,8 +249,12 @@ void TextureLoader::unloadTexture(render::Texture texture)
             ls = it->second;
             m_loadingStates.erase(it);
         }
+        //The read reports a cancellation right away instead of reading and decoding the whole file.
         if (ls != nullptr)
+        {
+            ls->cancelToken.cancel();
             cleanState(*ls, true);
+        }
     }
 
     {
@@ -83,21 +83,22 @@ private:
         bool loadSuccess = false;
         std::string fileName;
         std::string resolvedFileName;
-        ByteBuffer fileBuffer;
         TextureLoadResult loadResult;
         AsyncFileHandle fileHandle;
         render::Texture texture;
         IImgImporter* imageImporter = nullptr;
         IImgCodec* codec = nullptr;
+        //Cancelled by unloadTexture, the pending read bails out instead of finishing.
+        CancelToken cancelToken;
 
         void clear()
         {
             fileName.clear();
             resolvedFileName.clear();
-            fileBuffer.resize(0u);
             loadResult = TextureLoadResult();
             fileHandle = AsyncFileHandle();
             codec = nullptr;
+            cancelToken = CancelToken();
             texture = render::Texture();
             imageImporter->clean();
         }
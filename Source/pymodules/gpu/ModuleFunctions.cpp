@@ -16,6 +16,8 @@
 #include <coalpy.render/IimguiRenderer.h>
 #include <coalpy.render/ShaderDefs.h>
 #include <coalpy.core/Stopwatch.h>
+#include <coalpy.core/Profiler.h>
+#include <coalpy.core/ByteBuffer.h>
 #include <coalpy.core/String.h>
 #include <coalpy.files/IFileSystem.h>
 #include <coalpy.files/Utils.h>
@@ -280,6 +282,8 @@ PyObject* run(PyObject* self, PyObject* args)
 
     runArgs.onRender = [&realoadUITexturesCb, &state, &raiseException, renderArgs, &stopwatch, imguiBuilder, implotBuilder]()
     {
+        Profiler::nextFrame();
+        CPY_PROFILE_SCOPE("gpu::run frame");
         state.tl().processTextures(realoadUITexturesCb);
 
         unsigned long long mst = stopwatch.timeMicroSecondsLong();
@@ -499,6 +503,74 @@ PyObject* endCollectMarkers(PyObject* self, PyObject* vargs, PyObject* kwds)
     return (PyObject*)markerResultObj;
 }
 
+PyObject* enableProfiler(PyObject* self, PyObject* vargs, PyObject* kwds)
+{
+    int enabled = 1;
+    char* arguments[] = { "enabled", nullptr };
+    if (!PyArg_ParseTupleAndKeywords(vargs, kwds, "|p", arguments, &enabled))
+        return nullptr;
+
+    Profiler::setEnabled(enabled != 0);
+    Py_RETURN_NONE;
+}
+
+PyObject* nextProfilerFrame(PyObject* self, PyObject* vargs, PyObject* kwds)
+{
+    Profiler::nextFrame();
+    Py_RETURN_NONE;
+}
+
+PyObject* saveProfile(PyObject* self, PyObject* vargs, PyObject* kwds)
+{
+    ModuleState& moduleState = getState(self);
+    const char* path = nullptr;
+    int clear = 0;
+    char* arguments[] = { "path", "clear", nullptr };
+    if (!PyArg_ParseTupleAndKeywords(vargs, kwds, "s|p", arguments, &path, &clear))
+        return nullptr;
+
+    ProfileCapture capture;
+    Profiler::capture(capture);
+    if (clear)
+        Profiler::clear();
+
+    std::string pathStr = path;
+    bool isJson = pathStr.size() >= 5 && pathStr.compare(pathStr.size() - 5, 5, ".json") == 0;
+    std::string json;
+    ByteBuffer binary;
+    if (isJson)
+        Profiler::writeChromeTrace(capture, json);
+    else
+        Profiler::writeBinary(capture, binary);
+
+    bool success = true;
+    IFileSystem& fs = moduleState.fs();
+    AsyncFileHandle handle = fs.write(FileWriteRequest(
+        path, [&success](FileWriteResponse response)
+        {
+            success = success && response.status != FileStatus::Fail;
+        },
+        isJson ? json.c_str() : (const char*)binary.data(),
+        isJson ? (unsigned long long)json.size() : (unsigned long long)binary.size()));
+
+    if (!handle.valid())
+    {
+        PyErr_Format(moduleState.exObj(), "Could not write profile to %s, too many file requests in flight.", path);
+        return nullptr;
+    }
+
+    fs.execute(handle);
+    fs.wait(handle);
+    fs.closeHandle(handle);
+    if (!success)
+    {
+        PyErr_Format(moduleState.exObj(), "Failed writing profile to %s", path);
+        return nullptr;
+    }
+
+    Py_RETURN_NONE;
+}
+
 }
 }
 }
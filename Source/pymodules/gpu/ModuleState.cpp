@@ -46,13 +46,14 @@ ModuleState::ModuleState(CoalpyTypeObject** types, int typesCount)
 
     {
         TaskSystemDesc desc;
-        desc.threadPoolSize = 16;
         m_ts = ITaskSystem::create(desc);
     }
 
     {
         FileSystemDesc desc;
         desc.taskSystem = m_ts;
+        desc.watcher = m_fw;
+        desc.contentCacheBytes = 32 * 1024 * 1024;
         m_fs = IFileSystem::create(desc);
     }
 
@@ -202,6 +203,7 @@ bool ModuleState::createDevice(int index, int flags, ShaderModel shaderModel, bo
         devConfig.platform = platform;
         devConfig.moduleHandle = g_ModuleInstance;
         devConfig.shaderDb = m_db;
+        devConfig.ts = m_ts;
         devConfig.index = index;
         devConfig.flags = (render::DeviceFlags)flags;
         devConfig.resourcePath = modulePath;
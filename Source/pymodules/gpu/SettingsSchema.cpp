@@ -74,7 +74,7 @@ bool SettingsSchema::load(IFileSystem& fs, const char* filename, void* settingsO
                 root = cJSON_Parse(response.buffer);
                 success = true;
             }
-        }));
+        }, (int)FileRequestFlags::WholeFile));
 
     fs.execute(handle);
     fs.wait(handle);
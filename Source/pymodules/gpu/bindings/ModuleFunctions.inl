@@ -73,6 +73,34 @@ COALPY_FN(end_collect_markers, endCollectMarkers,
     )"
 )
 
+COALPY_FN(enable_profiler, enableProfiler,
+    R"(
+    Turns CPU zone recording on or off. Zones cover coalpy's internal work (file io, shader compilation,
+    texture decoding, every task run by the worker threads). Nothing is recorded while disabled.
+
+    Parameters:
+        enabled (bool)(optional): default True.
+    )"
+)
+
+COALPY_FN(next_profiler_frame, nextProfilerFrame,
+    R"(
+    Advances the frame number zones get tagged with. gpu.run advances it once per render loop iteration,
+    call it when driving frames without gpu.run.
+    )"
+)
+
+COALPY_FN(save_profile, saveProfile,
+    R"(
+    Writes the zones recorded so far to a file.
+
+    Parameters:
+        path (str): A path ending in .json gets a chrome trace (loads in chrome://tracing or ui.perfetto.dev),
+                    any other path gets the compact binary capture format.
+        clear (bool)(optional): default False. If True, drops the recorded zones once written.
+    )"
+)
+
 COALPY_FN(run, run, "Runs window rendering callbacks. This function blocks until all the existing windows are closed. Window objects must be created and referenced prior. Use the Window object to configure / specify callbacks and this function to run all the event loops for windows.")
 
 #undef COALPY_FN
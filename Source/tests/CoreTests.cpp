@@ -1,7 +1,26 @@
 #include "testsystem.h"
 #include <coalpy.core/Assert.h>
 #include <coalpy.core/ByteBuffer.h>
+#include <coalpy.core/ByteAllocator.h>
+#include <coalpy.core/Stopwatch.h>
+#include <coalpy.core/Profiler.h>
+#include <coalpy.core/Hash.h>
 #include <coalpy.core/HashStream.h>
+#include <coalpy.core/String.h>
+#include <coalpy.core/GenericHandle.h>
+#include <coalpy.core/HandleContainer.h>
+#include <coalpy.core/SparseHandleContainer.h>
+#include <coalpy.core/ConcurrentHandleContainer.h>
+#include <vector>
+#include <string>
+#include <thread>
+#include <chrono>
+#include <atomic>
+#include <mutex>
+#include <shared_mutex>
+#include <algorithm>
+#include <cstring>
+#include <stdio.h>
 
 namespace coalpy
 {
@@ -25,6 +44,627 @@ void testByteBuffer(TestContext& ctx)
     }
 }
 
+//Counts what goes through it, backed by malloc.
+class CountingAllocator : public IByteAllocator
+{
+public:
+    virtual u8* allocate(size_t size) override
+    {
+        ++allocations;
+        liveBytes += size;
+        return (u8*)malloc(size);
+    }
+
+    virtual void deallocate(u8* data, size_t size) override
+    {
+        liveBytes -= size;
+        ::free(data);
+    }
+
+    int allocations = 0;
+    size_t liveBytes = 0;
+};
+
+void testByteBufferGrowth(TestContext& ctx)
+{
+    {
+        ByteBuffer buffer;
+        const u8* object = (const u8*)&buffer;
+        int values[] = { 1, 2, 3, 4 };
+        buffer.append((const u8*)values, sizeof(values));
+        CPY_ASSERT_MSG(buffer.data() >= object && buffer.data() < object + sizeof(buffer), "small payload went to the heap");
+
+        ByteBuffer moved(std::move(buffer));
+        CPY_ASSERT(buffer.size() == 0 && moved.size() == sizeof(values));
+        CPY_ASSERT(memcmp(moved.data(), values, sizeof(values)) == 0);
+
+        moved.appendEmpty(ByteBuffer::InlineCapacity);
+        const u8* heapData = moved.data();
+        buffer = std::move(moved);
+        CPY_ASSERT(buffer.data() == heapData && memcmp(buffer.data(), values, sizeof(values)) == 0);
+    }
+
+    {
+        CountingAllocator allocator;
+        {
+            ByteBuffer buffer(&allocator);
+            const size_t chunkSize = 1000;
+            std::vector<u8> chunk(chunkSize);
+            for (int i = 0; i < 4096; ++i)
+            {
+                memset(chunk.data(), i & 0xff, chunkSize);
+                buffer.append(chunk.data(), chunkSize);
+            }
+
+            CPY_ASSERT_FMT(allocator.allocations < 24, "%d allocations for 4096 appends", allocator.allocations);
+            CPY_ASSERT(buffer.size() == 4096 * chunkSize);
+            bool contentsMatch = true;
+            for (int i = 0; i < 4096; ++i)
+                contentsMatch = contentsMatch && buffer.data()[i * chunkSize] == (u8)(i & 0xff) && buffer.data()[i * chunkSize + chunkSize - 1] == (u8)(i & 0xff);
+            CPY_ASSERT(contentsMatch);
+
+            buffer.resize(0);
+            int allocations = allocator.allocations;
+            buffer.appendEmpty(4096 * chunkSize);
+            CPY_ASSERT_MSG(allocator.allocations == allocations, "reuse after resize(0) allocated");
+        }
+        CPY_ASSERT(allocator.liveBytes == 0);
+    }
+}
+
+void testByteBufferArena(TestContext& ctx)
+{
+    ArenaAllocator arena(64 * 1024);
+    for (int frame = 0; frame < 3; ++frame)
+    {
+        std::vector<ByteBuffer> buffers;
+        for (int i = 0; i < 8; ++i)
+        {
+            buffers.emplace_back(&arena);
+            for (int j = 0; j < 100; ++j)
+                buffers.back().append(&j);
+        }
+
+        bool contentsMatch = true;
+        for (auto& b : buffers)
+            for (int j = 0; j < 100; ++j)
+                contentsMatch = contentsMatch && ((const int*)b.data())[j] == j;
+        CPY_ASSERT(contentsMatch);
+        CPY_ASSERT(((size_t)buffers.back().data() % ArenaAllocator::Alignment) == 0);
+
+        //A payload bigger than a block gets its own, dropped on reset.
+        ByteBuffer big(&arena);
+        big.appendEmpty(256 * 1024);
+        CPY_ASSERT(arena.reservedBytes() >= 256 * 1024 + 64 * 1024);
+
+        buffers.clear();
+        big.free();
+        arena.reset();
+        CPY_ASSERT(arena.usedBytes() == 0);
+        CPY_ASSERT_FMT(arena.reservedBytes() == 64 * 1024, "%llu bytes reserved after reset", (unsigned long long)arena.reservedBytes());
+    }
+}
+
+void benchmarkByteBuffer(TestContext& ctx)
+{
+    //Like accumulating a file from FileReadResponse chunks.
+    const size_t chunkSize = 16 * 1024;
+    std::vector<u8> chunk(chunkSize, 0x5a);
+    const size_t payloads[] = { 1ull << 20, 16ull << 20, 256ull << 20, 1ull << 30 };
+    for (size_t payload : payloads)
+    {
+        Stopwatch sw;
+        sw.start();
+        {
+            ByteBuffer buffer;
+            for (size_t written = 0; written < payload; written += chunkSize)
+                buffer.append(chunk.data(), chunkSize);
+            CPY_ASSERT(buffer.size() == payload);
+        }
+        double seconds = std::max((double)sw.timeMicroSecondsLong() / 1000000.0, 1e-9);
+        printf("    append %5llu MB in 16KB chunks: %8.1f ms %9.1f MB/s\n",
+            (unsigned long long)(payload >> 20), seconds * 1000.0, (double)payload / (1024.0 * 1024.0) / seconds);
+    }
+}
+
+using TestHandle = GenericHandle<unsigned>;
+
+void testSparseHandleContainer(TestContext& ctx)
+{
+    SparseHandleContainer<TestHandle, int, 8> container;
+    std::vector<TestHandle> handles(16);
+    for (int i = 0; i < 16; ++i)
+        container.allocate(handles[i]) = i;
+    CPY_ASSERT(container.elementsCount() == 16);
+
+    //Free the even ones, the odd ones get swapped in and must still resolve.
+    for (int i = 0; i < 16; i += 2)
+        container.free(handles[i]);
+    CPY_ASSERT(container.elementsCount() == 8);
+    for (int i = 0; i < 16; ++i)
+    {
+        CPY_ASSERT(container.contains(handles[i]) == ((i & 1) != 0));
+        if (i & 1)
+            CPY_ASSERT(container[handles[i]] == i);
+    }
+
+    int visited = 0;
+    int sum = 0;
+    container.forEach([&](TestHandle h, int& value) { ++visited; sum += value; CPY_ASSERT(container[h] == value); });
+    CPY_ASSERT(visited == 8);
+    CPY_ASSERT(sum == 1 + 3 + 5 + 7 + 9 + 11 + 13 + 15);
+
+    //Reused slots hand out a new generation, stale handles don't alias the new elements.
+    TestHandle reused;
+    container.allocate(reused) = 100;
+    CPY_ASSERT((reused.handleId & decltype(container)::IndexMask) == (handles[14].handleId & decltype(container)::IndexMask));
+    CPY_ASSERT(reused != handles[14]);
+    CPY_ASSERT(!container.contains(handles[14]));
+    CPY_ASSERT(container.contains(reused));
+    CPY_ASSERT(container[reused] == 100);
+
+    //Double free is ignored.
+    container.free(handles[14]);
+    CPY_ASSERT(container.contains(reused));
+    CPY_ASSERT(container.elementsCount() == 9);
+
+    container.clear();
+    CPY_ASSERT(container.elementsCount() == 0);
+    CPY_ASSERT(!container.contains(reused));
+}
+
+void benchmarkHandleContainer(TestContext& ctx)
+{
+    //Iteration cost once most elements are freed, like a table after a burst of work.
+    const int elements = 1 << 19;
+    HandleContainer<TestHandle, int> container;
+    SparseHandleContainer<TestHandle, int> sparseContainer;
+    std::vector<TestHandle> handles(elements);
+    std::vector<TestHandle> sparseHandles(elements);
+    for (int i = 0; i < elements; ++i)
+    {
+        container.allocate(handles[i]) = i;
+        sparseContainer.allocate(sparseHandles[i]) = i;
+    }
+
+    for (int i = 0; i < elements; ++i)
+    {
+        if (i % 8)
+        {
+            container.free(handles[i]);
+            sparseContainer.free(sparseHandles[i]);
+        }
+    }
+
+    long long sum = 0;
+    long long sparseSum = 0;
+    Stopwatch sw;
+    sw.start();
+    for (int i = 0; i < 32; ++i)
+        container.forEach([&sum](TestHandle h, int& value) { sum += value; });
+    double ms = (double)sw.timeMicroSecondsLong() / 1000.0;
+
+    sw.start();
+    for (int i = 0; i < 32; ++i)
+        sparseContainer.forEach([&sparseSum](TestHandle h, int& value) { sparseSum += value; });
+    double sparseMs = (double)sw.timeMicroSecondsLong() / 1000.0;
+
+    CPY_ASSERT(sum == sparseSum);
+    printf("    forEach over %d live of %d slots x32: HandleContainer %8.2f ms, SparseHandleContainer %8.2f ms\n",
+        sparseContainer.elementsCount(), elements, ms, sparseMs);
+}
+
+void testConcurrentHandleContainer(TestContext& ctx)
+{
+    ConcurrentHandleContainer<TestHandle, int, 4, 8> container;
+    TestHandle first;
+    container.allocate(first) = 1;
+    CPY_ASSERT(container.contains(first));
+    CPY_ASSERT(container.free(first));
+    CPY_ASSERT(!container.free(first));
+
+    TestHandle reused;
+    container.allocate(reused) = 2;
+    CPY_ASSERT((reused.handleId & decltype(container)::IndexMask) == (first.handleId & decltype(container)::IndexMask));
+    CPY_ASSERT(!container.contains(first));
+    CPY_ASSERT(container[reused] == 2);
+    CPY_ASSERT(container.free(reused));
+
+    //Batches take the recycled slots first, the rest come from fresh chunks.
+    TestHandle kept[3];
+    for (auto& h : kept)
+        container.allocate(h) = 3;
+    CPY_ASSERT(container.free(kept[0]));
+    CPY_ASSERT(container.free(kept[2]));
+    TestHandle batch[40];
+    container.allocate(batch, 40);
+    CPY_ASSERT(container.elementsCount() == 41);
+    CPY_ASSERT((batch[0].handleId & decltype(container)::IndexMask) == (kept[2].handleId & decltype(container)::IndexMask));
+    CPY_ASSERT((batch[1].handleId & decltype(container)::IndexMask) == (kept[0].handleId & decltype(container)::IndexMask));
+    for (int i = 0; i < 40; ++i)
+    {
+        CPY_ASSERT(container.contains(batch[i]));
+        CPY_ASSERT(batch[i] != kept[1]);
+        container[batch[i]] = i;
+    }
+    for (int i = 0; i < 40; ++i)
+        CPY_ASSERT(container[batch[i]] == i && container.free(batch[i]));
+    CPY_ASSERT(container.free(kept[1]));
+
+    {
+        //Full containers hand out invalid handles, batches that don't fit leave the free list as it was.
+        ConcurrentHandleContainer<TestHandle, int, 1, 1> tiny;
+        TestHandle handles[4];
+        for (auto& h : handles)
+            tiny.allocate(h) = 4;
+        TestHandle overflow;
+        tiny.allocate(overflow);
+        CPY_ASSERT(!overflow.valid());
+        CPY_ASSERT(tiny.free(handles[1]));
+        TestHandle tooMany[2];
+        CPY_ASSERT(!tiny.allocate(tooMany, 2));
+        CPY_ASSERT(!tooMany[0].valid() && !tooMany[1].valid());
+        CPY_ASSERT(tiny.elementsCount() == 3);
+        CPY_ASSERT(tiny.allocate(tooMany, 1));
+        CPY_ASSERT((tooMany[0].handleId & decltype(tiny)::IndexMask) == (handles[1].handleId & decltype(tiny)::IndexMask));
+        CPY_ASSERT(tiny.elementsCount() == 4);
+    }
+
+    //Threads churn through their own handles, checking nobody else's write landed in their slots.
+    //Half of them refill in batches.
+    const int threadCount = 4;
+    const int iterations = 20000;
+    std::atomic<int> failures = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < threadCount; ++t)
+    {
+        threads.emplace_back([&container, &failures, t, iterations]()
+        {
+            TestHandle handles[16];
+            bool batched = (t & 1) != 0;
+            int groupSize = batched ? 4 : 1;
+            for (int i = 0; i < iterations; i += groupSize)
+            {
+                TestHandle* group = &handles[i % 16];
+                for (int g = 0; g < groupSize; ++g)
+                    if (group[g].valid() && (!container.contains(group[g]) || container[group[g]] != t || !container.free(group[g])))
+                        failures.fetch_add(1);
+
+                if (batched)
+                    container.allocate(group, groupSize);
+                else
+                    container.allocate(group[0]);
+                for (int g = 0; g < groupSize; ++g)
+                    container[group[g]] = t;
+            }
+
+            for (auto& h : handles)
+                container.free(h);
+        });
+    }
+
+    for (auto& t : threads)
+        t.join();
+
+    CPY_ASSERT_FMT(failures == 0, "%d handles were aliased or lost", failures.load());
+    CPY_ASSERT(container.elementsCount() == 0);
+    int alive = 0;
+    container.forEach([&alive](TestHandle h, int& value) { ++alive; });
+    CPY_ASSERT(alive == 0);
+}
+
+void benchmarkConcurrentHandleContainer(TestContext& ctx)
+{
+    //Lookups racing allocations, what isTaskFinished and FileSystem::asTask do.
+    const int elements = 4096;
+    const int lookups = 1 << 20;
+    std::shared_mutex mutex;
+    HandleContainer<TestHandle, int> lockedContainer;
+    ConcurrentHandleContainer<TestHandle, int> container;
+    std::vector<TestHandle> lockedHandles(elements);
+    std::vector<TestHandle> handles(elements);
+    for (int i = 0; i < elements; ++i)
+    {
+        lockedContainer.allocate(lockedHandles[i]) = i;
+        container.allocate(handles[i]) = i;
+    }
+
+    for (int threadCount : { 1, 2, 4 })
+    {
+        double lockedMs = 0.0;
+        double ms = 0.0;
+        for (int concurrent = 0; concurrent < 2; ++concurrent)
+        {
+            std::atomic<bool> stop = false;
+            std::thread allocator([&]()
+            {
+                while (!stop.load(std::memory_order_relaxed))
+                {
+                    TestHandle h;
+                    if (concurrent)
+                    {
+                        container.allocate(h) = -1;
+                        container.free(h);
+                    }
+                    else
+                    {
+                        std::unique_lock lock(mutex);
+                        lockedContainer.allocate(h) = -1;
+                        lockedContainer.free(h);
+                    }
+                }
+            });
+
+            std::atomic<long long> sum = 0;
+            Stopwatch sw;
+            sw.start();
+            std::vector<std::thread> readers;
+            for (int t = 0; t < threadCount; ++t)
+            {
+                readers.emplace_back([&]()
+                {
+                    long long localSum = 0;
+                    for (int i = 0; i < lookups / threadCount; ++i)
+                    {
+                        int e = i & (elements - 1);
+                        if (concurrent)
+                        {
+                            localSum += container.contains(handles[e]) ? container[handles[e]] : 0;
+                        }
+                        else
+                        {
+                            std::shared_lock lock(mutex);
+                            localSum += lockedContainer.contains(lockedHandles[e]) ? lockedContainer[lockedHandles[e]] : 0;
+                        }
+                    }
+                    sum += localSum;
+                });
+            }
+
+            for (auto& r : readers)
+                r.join();
+            (concurrent ? ms : lockedMs) = (double)sw.timeMicroSecondsLong() / 1000.0;
+            stop = true;
+            allocator.join();
+        }
+
+        printf("    %d readers, %d lookups: shared_mutex %8.2f ms  lock free %8.2f ms\n", threadCount, lookups, lockedMs, ms);
+    }
+}
+
+void testHash64(TestContext& ctx)
+{
+    static_assert(stringHash("shaders/common.hlsl") != stringHash("shaders/common.hlsli"), "Compile time hashes must differ.");
+    constexpr uint64_t compileTimeHash = stringHash("shaders/common.hlsl");
+    std::string runtimeKey = "shaders/common.hlsl";
+    CPY_ASSERT(stringHash(runtimeKey) == compileTimeHash);
+    CPY_ASSERT(hash64(runtimeKey.data(), runtimeKey.size()) == compileTimeHash);
+    CPY_ASSERT(hash64(runtimeKey.data(), runtimeKey.size(), 1) != compileTimeHash);
+
+    //Every length goes through a different read pattern, flipping any single bit must change the hash.
+    std::vector<char> bytes(200);
+    for (int i = 0; i < (int)bytes.size(); ++i)
+        bytes[i] = (char)(i * 31 + 7);
+
+    std::vector<uint64_t> hashes;
+    for (size_t len = 0; len <= bytes.size(); ++len)
+    {
+        uint64_t h = hash64(bytes.data(), len);
+        hashes.push_back(h);
+        for (size_t i = 0; i < len; ++i)
+        {
+            bytes[i] ^= 0x10;
+            CPY_ASSERT(hash64(bytes.data(), len) != h);
+            bytes[i] ^= 0x10;
+        }
+    }
+
+    std::sort(hashes.begin(), hashes.end());
+    CPY_ASSERT(std::unique(hashes.begin(), hashes.end()) == hashes.end());
+
+    //No collisions over a set of similar paths.
+    std::vector<uint64_t> pathHashes;
+    for (int i = 0; i < 100000; ++i)
+        pathHashes.push_back(stringHash("shaders/generated/permutation_" + std::to_string(i) + ".hlsl"));
+    std::sort(pathHashes.begin(), pathHashes.end());
+    CPY_ASSERT(std::unique(pathHashes.begin(), pathHashes.end()) == pathHashes.end());
+}
+
+void benchmarkHash(TestContext& ctx)
+{
+    auto fnvHash = [](const char* b, size_t bytes)
+    {
+        unsigned int hash = 0;
+        for (size_t i = 0; i < bytes; ++i)
+        {
+            hash *= 0x811C9DC5;
+            hash ^= b[i];
+        }
+        return hash;
+    };
+
+    const size_t sizes[] = { 16, 64, 1024, 64 * 1024 };
+    std::vector<char> data(64 * 1024, 0x3c);
+    for (size_t size : sizes)
+    {
+        const size_t totalBytes = 64ull << 20;
+        size_t iterations = totalBytes / size;
+        volatile uint64_t sink = 0;
+
+        Stopwatch sw;
+        sw.start();
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            data[0] = (char)i;
+            sink += fnvHash(data.data(), size);
+        }
+        double fnvSeconds = std::max((double)sw.timeMicroSecondsLong() / 1000000.0, 1e-9);
+
+        sw.start();
+        for (size_t i = 0; i < iterations; ++i)
+        {
+            data[0] = (char)i;
+            sink += hash64(data.data(), size);
+        }
+        double seconds = std::max((double)sw.timeMicroSecondsLong() / 1000000.0, 1e-9);
+
+        printf("    %6llu byte keys: fnv32 %8.1f MB/s  hash64 %8.1f MB/s\n", (unsigned long long)size,
+            (double)totalBytes / (1024.0 * 1024.0) / fnvSeconds, (double)totalBytes / (1024.0 * 1024.0) / seconds);
+    }
+}
+
+void testProfiler(TestContext& ctx)
+{
+    //The tick rate has to agree with wall time.
+    uint64_t sleepBegin = Profiler::now();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    double sleptMs = (double)(Profiler::now() - sleepBegin) * 1000.0 / (double)Profiler::ticksPerSecond();
+    CPY_ASSERT_FMT(sleptMs >= 19.0 && sleptMs < 200.0, "slept for %.2f ms", sleptMs);
+
+    Profiler::setEnabled(true);
+    Profiler::clear();
+    Profiler::nextFrame();
+    uint32_t frame = Profiler::frame();
+
+    auto work = []()
+    {
+        CPY_PROFILE_SCOPE("test::outer");
+        for (int i = 0; i < 3; ++i)
+        {
+            CPY_PROFILE_SCOPE("test::inner");
+        }
+    };
+
+    work();
+    std::thread other([&work]()
+    {
+        Profiler::setThreadName("test \"other\"");
+        work();
+    });
+    other.join();
+
+    Profiler::setEnabled(false);
+    {
+        CPY_PROFILE_SCOPE("test::disabled");
+    }
+
+    ProfileCapture capture;
+    Profiler::capture(capture);
+    CPY_ASSERT(capture.ticksPerSecond > 0);
+    int outer = 0;
+    int inner = 0;
+    for (auto& thread : capture.threads)
+    {
+        for (auto& zone : thread.zones)
+        {
+            const std::string& name = capture.names[zone.name];
+            CPY_ASSERT(name != "test::disabled");
+            CPY_ASSERT(zone.endTicks >= zone.beginTicks);
+            CPY_ASSERT(zone.frame == frame);
+            outer += name == "test::outer" ? 1 : 0;
+            inner += name == "test::inner" ? 1 : 0;
+        }
+    }
+    CPY_ASSERT_FMT(outer == 2 && inner == 6, "%d outer and %d inner zones", outer, inner);
+
+    //Inner zones end first, so they get recorded before the zone they nest in.
+    const ProfileCapture::Thread* otherThread = nullptr;
+    for (auto& thread : capture.threads)
+        otherThread = thread.name == "test \"other\"" ? &thread : otherThread;
+    CPY_ASSERT(otherThread != nullptr && otherThread->zones.size() == 4);
+    if (otherThread != nullptr && otherThread->zones.size() == 4)
+    {
+        const auto& outerZone = otherThread->zones[3];
+        for (int i = 0; i < 3; ++i)
+            CPY_ASSERT(otherThread->zones[i].beginTicks >= outerZone.beginTicks && otherThread->zones[i].endTicks <= outerZone.endTicks);
+    }
+
+    std::string json;
+    Profiler::writeChromeTrace(capture, json);
+    CPY_ASSERT(json.find("\"name\":\"test::outer\"") != std::string::npos);
+    CPY_ASSERT(json.find("\"name\":\"test \\\"other\\\"\"") != std::string::npos);
+    CPY_ASSERT(json.back() == '}');
+
+    ByteBuffer binary;
+    Profiler::writeBinary(capture, binary);
+    ProfileCapture decoded;
+    CPY_ASSERT(Profiler::readBinary(binary.data(), binary.size(), decoded));
+    CPY_ASSERT(decoded.names == capture.names);
+    CPY_ASSERT(decoded.threads.size() == capture.threads.size());
+    bool zonesMatch = decoded.baseTicks == capture.baseTicks && decoded.ticksPerSecond == capture.ticksPerSecond;
+    for (size_t t = 0; zonesMatch && t < capture.threads.size(); ++t)
+    {
+        const auto& a = capture.threads[t];
+        const auto& b = decoded.threads[t];
+        zonesMatch = a.tid == b.tid && a.name == b.name && a.zones.size() == b.zones.size();
+        for (size_t z = 0; zonesMatch && z < a.zones.size(); ++z)
+            zonesMatch = a.zones[z].name == b.zones[z].name && a.zones[z].frame == b.zones[z].frame
+                && a.zones[z].beginTicks == b.zones[z].beginTicks && a.zones[z].endTicks == b.zones[z].endTicks;
+    }
+    CPY_ASSERT(zonesMatch);
+
+    for (size_t truncated = 0; truncated < binary.size(); truncated += 7)
+        CPY_ASSERT(!Profiler::readBinary(binary.data(), truncated, decoded));
+
+    Profiler::clear();
+    Profiler::capture(capture);
+    for (auto& thread : capture.threads)
+        CPY_ASSERT(thread.zones.empty());
+
+    //Exited threads hand their buffer to the next thread, only the zones of the last one are left.
+    size_t bufferCount = capture.threads.size();
+    Profiler::setEnabled(true);
+    for (int i = 0; i < 4; ++i)
+    {
+        std::thread shortLived(work);
+        shortLived.join();
+    }
+    Profiler::setEnabled(false);
+    Profiler::capture(capture);
+    CPY_ASSERT(capture.threads.size() == bufferCount);
+    outer = 0;
+    for (auto& thread : capture.threads)
+        for (auto& zone : thread.zones)
+            outer += capture.names[zone.name] == "test::outer" ? 1 : 0;
+    CPY_ASSERT(outer == 1);
+    Profiler::clear();
+
+    const char* interned = Profiler::internName(std::string("test::") + "interned");
+    const char* internedElsewhere = nullptr;
+    std::thread internThread([&internedElsewhere]() { internedElsewhere = Profiler::internName("test::interned"); });
+    internThread.join();
+    CPY_ASSERT(interned == internedElsewhere && std::string(interned) == "test::interned");
+}
+
+void benchmarkProfiler(TestContext& ctx)
+{
+    const int zones = 1 << 20;
+    for (int enabled = 0; enabled < 2; ++enabled)
+    {
+        Profiler::setEnabled(enabled != 0);
+        Stopwatch sw;
+        sw.start();
+        for (int i = 0; i < zones; ++i)
+        {
+            CPY_PROFILE_SCOPE("benchmark::zone");
+        }
+        double ns = (double)sw.timeMicroSecondsLong() * 1000.0 / (double)zones;
+        printf("    %s scope: %6.1f ns\n", enabled ? "enabled " : "disabled", ns);
+    }
+    Profiler::setEnabled(false);
+
+    ProfileCapture capture;
+    Profiler::capture(capture);
+    size_t zoneCount = 0;
+    for (auto& thread : capture.threads)
+        zoneCount += thread.zones.size();
+
+    ByteBuffer binary;
+    Profiler::writeBinary(capture, binary);
+    printf("    binary capture: %llu zones in %llu bytes\n", (unsigned long long)zoneCount, (unsigned long long)binary.size());
+    Profiler::clear();
+}
+
 void testHashStream(TestContext& ctx)
 {
     HashStream hsA;
@@ -44,6 +684,14 @@ void testHashStream(TestContext& ctx)
     CPY_ASSERT(hsA.val() != hsB.val());
     CPY_ASSERT(hsB.val() != hsC.val());
     CPY_ASSERT(hsA.val() != hsC.val());
+
+    //Strings hash by contents, not by the bytes of the object.
+    HashStream hsD;
+    hsD << std::string("coalpy");
+    HashStream hsE;
+    hsE << "coalpy";
+    CPY_ASSERT(hsD.val() == hsE.val());
+    CPY_ASSERT(hsD.val() == hash64("coalpy", 6));
 }
 
 
@@ -55,7 +703,18 @@ public:
     {
         static TestCase sCases[] = {
             { "byteBuffer", testByteBuffer },
-            { "hashstream", testHashStream }
+            { "byteBufferGrowth", testByteBufferGrowth },
+            { "byteBufferArena", testByteBufferArena },
+            { "benchmarkByteBuffer", benchmarkByteBuffer },
+            { "sparseHandleContainer", testSparseHandleContainer },
+            { "benchmarkHandleContainer", benchmarkHandleContainer },
+            { "concurrentHandleContainer", testConcurrentHandleContainer },
+            { "benchmarkConcurrentHandleContainer", benchmarkConcurrentHandleContainer },
+            { "hash64", testHash64 },
+            { "benchmarkHash", benchmarkHash },
+            { "hashstream", testHashStream },
+            { "profiler", testProfiler },
+            { "benchmarkProfiler", benchmarkProfiler }
         };
 
         caseCounts = (int)(sizeof(sCases) / sizeof(TestCase));
@@ -2,11 +2,20 @@
 #include <coalpy.core/Assert.h>
 #include <coalpy.tasks/ITaskSystem.h>
 #include <coalpy.files/IFileSystem.h>
+#include <coalpy.files/PakDefs.h>
 #include <coalpy.files/IFileWatcher.h>
 #include <coalpy.files/Utils.h>
+#include <coalpy.core/Stopwatch.h>
 #include <unordered_map>
 #include <sstream>
 #include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <stdio.h>
+#include <string.h>
 
 namespace coalpy
 {
@@ -130,6 +139,957 @@ void testFileReadWrite(TestContext& ctx)
     testContext.end();
 }
 
+void testFileReadCancel(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+
+    IFileSystem& fs = *testContext.fs;
+    std::string str = "cancelled before reading";
+    AsyncFileHandle writeHandle = fs.write(FileWriteRequest(".test_folder/cancel.txt", [](FileWriteResponse& response) {}, str.c_str(), (int)str.size()));
+    fs.execute(writeHandle);
+    fs.wait(writeHandle);
+    fs.closeHandle(writeHandle);
+
+    bool gotData = false;
+    IoError error = IoError::None;
+    FileReadRequest request(".test_folder/cancel.txt", [&gotData, &error](FileReadResponse& response)
+    {
+        if (response.status == FileStatus::Reading)
+            gotData = true;
+        else if (response.status == FileStatus::Fail)
+            error = response.error;
+    });
+    request.cancelToken = CancelToken::create();
+    request.cancelToken.cancel();
+
+    AsyncFileHandle readHandle = fs.read(request);
+    fs.execute(readHandle);
+    fs.wait(readHandle);
+
+    CPY_ASSERT(!gotData);
+    CPY_ASSERT_FMT(error == IoError::Cancelled, "%s", IoError2String(error));
+    fs.closeHandle(readHandle);
+
+    deleteAllDir(fs, ".test_folder");
+    testContext.end();
+}
+
+void writeTestFile(IFileSystem& fs, const std::string& path, const std::string& contents)
+{
+    bool writeSuccess = false;
+    AsyncFileHandle writeHandle = fs.write(FileWriteRequest(path, [&writeSuccess](FileWriteResponse& response)
+    {
+        if (response.status == FileStatus::Success)
+            writeSuccess = true;
+    }, contents.c_str(), (int)contents.size()));
+    fs.execute(writeHandle);
+    fs.wait(writeHandle);
+    fs.closeHandle(writeHandle);
+    CPY_ASSERT_FMT(writeSuccess, "failed writing %s", path.c_str());
+}
+
+std::string readTestFile(IFileSystem& fs, const std::string& path)
+{
+    std::string contents;
+    AsyncFileHandle readHandle = fs.read(FileReadRequest(path, [&contents](FileReadResponse& response)
+    {
+        CPY_ASSERT_FMT(response.status != FileStatus::Fail, "reading fail: %s", IoError2String(response.error));
+        if (response.status == FileStatus::Success)
+            contents.assign(response.buffer, response.size);
+    }, (int)FileRequestFlags::WholeFile));
+    fs.execute(readHandle);
+    fs.wait(readHandle);
+    fs.closeHandle(readHandle);
+    return contents;
+}
+
+void testFileWriteModes(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+
+    IFileSystem& fs = *testContext.fs;
+    const char* path = ".test_folder/writes.txt";
+    std::atomic<int> successes = 0;
+    auto onWrite = [&successes](FileWriteResponse& response)
+    {
+        CPY_ASSERT_FMT(response.status != FileStatus::Fail, "writing fail: %s", IoError2String(response.error));
+        if (response.status == FileStatus::Success)
+            ++successes;
+    };
+
+    std::string hello = "hello";
+    std::string world = " world";
+    {
+        AsyncFileHandle h = fs.write(FileWriteRequest(path, onWrite, hello.c_str(), (int)hello.size(), (int)FileRequestFlags::BorrowBuffer));
+        fs.execute(h);
+        fs.wait(h);
+        fs.closeHandle(h);
+    }
+    {
+        AsyncFileHandle h = fs.write(FileWriteRequest(path, onWrite, world.c_str(), (int)world.size(), (int)FileRequestFlags::Append | (int)FileRequestFlags::Sync));
+        fs.execute(h);
+        fs.wait(h);
+        fs.closeHandle(h);
+    }
+    CPY_ASSERT(readTestFile(fs, path) == "hello world");
+
+    {
+        //Disjoint ranges of the same file, written in parallel.
+        FileWriteRequest first(path, onWrite, "HE", 2, (int)FileRequestFlags::WriteAtOffset);
+        first.offset = 0;
+        FileWriteRequest second(path, onWrite, "LO", 2, (int)FileRequestFlags::WriteAtOffset);
+        second.offset = 3;
+        AsyncFileHandle handles[] = { fs.write(first), fs.write(second) };
+        for (auto h : handles)
+            fs.execute(h);
+        for (auto h : handles)
+        {
+            fs.wait(h);
+            fs.closeHandle(h);
+        }
+    }
+    std::string patched = readTestFile(fs, path);
+    CPY_ASSERT_FMT(patched == "HElLO world", "found %s", patched.c_str());
+
+    int streamFlags[] = { (int)FileRequestFlags::Sync, (int)FileRequestFlags::BorrowBuffer };
+    for (int flags : streamFlags)
+    {
+        std::string expected = "header";
+        std::vector<std::string> chunks;
+        for (int i = 0; i < 64; ++i)
+        {
+            chunks.emplace_back(4096 + i, (char)('a' + i % 26));
+            expected += chunks.back();
+        }
+
+        AsyncFileHandle h = fs.openWriteStream(FileWriteRequest(path, onWrite, "header", 6, flags));
+        for (auto& chunk : chunks)
+            fs.appendWriteStream(h, chunk.c_str(), (int)chunk.size());
+        fs.finishWriteStream(h);
+        fs.wait(h);
+        fs.closeHandle(h);
+
+        std::string streamed = readTestFile(fs, path);
+        CPY_ASSERT_FMT(streamed.size() == expected.size(), "streamed %d bytes, expected %d", (int)streamed.size(), (int)expected.size());
+        CPY_ASSERT(streamed == expected);
+    }
+
+    //The open and every chunk so far finish before the next append, the stream still waits for finishWriteStream.
+    {
+        AsyncFileHandle h = fs.openWriteStream(FileWriteRequest(path, onWrite, nullptr, 0));
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        fs.appendWriteStream(h, "slow", 4);
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        fs.appendWriteStream(h, " chunks", 7);
+        fs.finishWriteStream(h);
+        fs.wait(h);
+        fs.closeHandle(h);
+
+        std::string streamed = readTestFile(fs, path);
+        CPY_ASSERT_FMT(streamed == "slow chunks", "found %s", streamed.c_str());
+    }
+    CPY_ASSERT_FMT(successes == 7, "%d writes succeeded, expected 7", successes.load());
+
+    deleteAllDir(fs, ".test_folder");
+    testContext.end();
+}
+
+void testFileReadLarge(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+
+    //Spans several io ring chunks with a partial one at the end, read back with both backends.
+    std::string contents;
+    contents.resize(5 * 1024 * 1024 / 2 + 37);
+    for (size_t i = 0; i < contents.size(); ++i)
+        contents[i] = (char)((i * 31) ^ (i >> 11));
+    writeTestFile(*testContext.fs, ".test_folder/large.bin", contents);
+
+    FileSystemDesc preadDesc { testContext.ts };
+    preadDesc.useIoRing = false;
+    IFileSystem* preadFs = IFileSystem::create(preadDesc);
+    IFileSystem* fileSystems[] = { testContext.fs, preadFs };
+    for (IFileSystem* fs : fileSystems)
+    {
+        bool readSuccess = false;
+        std::string readResult;
+        AsyncFileHandle readHandle = fs->read(FileReadRequest(".test_folder/large.bin", [&readSuccess, &readResult](FileReadResponse& response)
+        {
+            CPY_ASSERT_FMT(response.status != FileStatus::Fail, "reading fail: %s", IoError2String(response.error));
+            if (response.status == FileStatus::Reading)
+                readResult.append(response.buffer, response.size);
+            else if (response.status == FileStatus::Success)
+                readSuccess = true;
+        }));
+        fs->execute(readHandle);
+        fs->wait(readHandle);
+        fs->closeHandle(readHandle);
+
+        CPY_ASSERT(readSuccess);
+        CPY_ASSERT_FMT(readResult.size() == contents.size(), "read %d bytes, expected %d", (int)readResult.size(), (int)contents.size());
+        CPY_ASSERT(readResult == contents);
+    }
+    delete preadFs;
+
+    deleteAllDir(*testContext.fs, ".test_folder");
+    testContext.end();
+}
+
+void testFileReadChunks(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+
+    std::string contents;
+    contents.resize(700 * 1024 + 5);
+    for (size_t i = 0; i < contents.size(); ++i)
+        contents[i] = (char)((i * 7) ^ (i >> 9));
+    writeTestFile(*testContext.fs, ".test_folder/chunks.bin", contents);
+
+    FileSystemDesc preadDesc { testContext.ts };
+    preadDesc.useIoRing = false;
+    IFileSystem* preadFs = IFileSystem::create(preadDesc);
+    IFileSystem* fileSystems[] = { testContext.fs, preadFs };
+    int chunkSizes[] = { 4 * 1024, 64 * 1024 + 3, 2 * 1024 * 1024 };
+    int flagSets[] = { 0, (int)FileRequestFlags::Readahead };
+    for (IFileSystem* fs : fileSystems)
+    {
+        for (int chunkSize : chunkSizes)
+        {
+            for (int flags : flagSets)
+            {
+                bool readSuccess = false;
+                int largestChunk = 0;
+                std::string readResult;
+                FileReadRequest request(".test_folder/chunks.bin", [&](FileReadResponse& response)
+                {
+                    CPY_ASSERT_FMT(response.status != FileStatus::Fail, "reading fail: %s", IoError2String(response.error));
+                    if (response.status == FileStatus::Reading)
+                    {
+                        largestChunk = std::max(largestChunk, (int)response.size);
+                        readResult.append(response.buffer, response.size);
+                    }
+                    else if (response.status == FileStatus::Success)
+                    {
+                        readSuccess = true;
+                    }
+                }, flags);
+                request.chunkSize = chunkSize;
+                AsyncFileHandle readHandle = fs->read(request);
+                fs->execute(readHandle);
+                fs->wait(readHandle);
+                fs->closeHandle(readHandle);
+
+                CPY_ASSERT(readSuccess);
+                CPY_ASSERT_FMT(largestChunk <= chunkSize, "chunk of %d bytes, requested %d", largestChunk, chunkSize);
+                CPY_ASSERT_FMT(readResult.size() == contents.size(), "read %d bytes, expected %d", (int)readResult.size(), (int)contents.size());
+                CPY_ASSERT(readResult == contents);
+            }
+        }
+    }
+    delete preadFs;
+
+    deleteAllDir(*testContext.fs, ".test_folder");
+    testContext.end();
+}
+
+void testFileReadMany(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+
+    //Files spread over two roots, plus one that exists in neither.
+    const int fileCount = 40;
+    std::vector<std::string> expected;
+    FileReadManyRequest request;
+    for (int i = 0; i < fileCount; ++i)
+    {
+        std::stringstream name, contents;
+        name << "many" << i << ".txt";
+        contents << "file number " << i << std::string(i * 97, (char)('a' + i % 26));
+        writeTestFile(*testContext.fs, std::string(i % 2 ? ".test_folder/rootB/" : ".test_folder/rootA/") + name.str(), contents.str());
+        request.paths.push_back(name.str());
+        expected.push_back(contents.str());
+    }
+    request.paths.push_back("notThere.txt");
+    request.additionalRoots = { ".test_folder/rootA", ".test_folder/missingRoot", ".test_folder/rootB/" };
+    request.queueDepth = 4;
+
+    FileSystemDesc preadDesc { testContext.ts };
+    preadDesc.useIoRing = false;
+    IFileSystem* preadFs = IFileSystem::create(preadDesc);
+    IFileSystem* fileSystems[] = { testContext.fs, preadFs };
+    for (IFileSystem* fs : fileSystems)
+    {
+        std::vector<std::string> results(request.paths.size());
+        std::vector<FileStatus> statuses(request.paths.size(), FileStatus::Idle);
+        std::atomic<int> inFlight = 0;
+        std::atomic<int> maxInFlight = 0;
+        int groupCalls = 0;
+        FileReadGroupResponse groupResponse;
+        request.fileCallback = [&](int fileIndex, FileReadResponse& response)
+        {
+            if (response.status == FileStatus::Opening)
+            {
+                int current = inFlight.fetch_add(1) + 1;
+                int seen = maxInFlight.load();
+                while (current > seen && !maxInFlight.compare_exchange_weak(seen, current)) {}
+            }
+            else if (response.status == FileStatus::Reading)
+            {
+                results[fileIndex].append(response.buffer, response.size);
+            }
+            else if (response.status == FileStatus::Success || response.status == FileStatus::Fail)
+            {
+                statuses[fileIndex] = response.status;
+                inFlight.fetch_sub(1);
+            }
+        };
+        request.groupCallback = [&](FileReadGroupResponse& response)
+        {
+            ++groupCalls;
+            groupResponse = response;
+        };
+
+        AsyncFileHandle handle = fs->readMany(request);
+        fs->execute(handle);
+        fs->wait(handle);
+        fs->closeHandle(handle);
+
+        CPY_ASSERT(groupCalls == 1);
+        CPY_ASSERT(groupResponse.fileCount == fileCount + 1);
+        CPY_ASSERT_FMT(groupResponse.failedCount == 1, "%d files failed", groupResponse.failedCount);
+        CPY_ASSERT_FMT(maxInFlight <= request.queueDepth, "%d files in flight", maxInFlight.load());
+        for (int i = 0; i < fileCount; ++i)
+        {
+            CPY_ASSERT_FMT(statuses[i] == FileStatus::Success, "file %d did not succeed", i);
+            CPY_ASSERT_FMT(results[i] == expected[i], "file %d mismatch", i);
+        }
+        CPY_ASSERT(statuses[fileCount] == FileStatus::Fail);
+    }
+    delete preadFs;
+
+    {
+        FileReadManyRequest emptyRequest;
+        int groupCalls = 0;
+        emptyRequest.fileCallback = [](int fileIndex, FileReadResponse& response) {};
+        emptyRequest.groupCallback = [&groupCalls](FileReadGroupResponse& response) { ++groupCalls; };
+        emptyRequest.flags = (int)FileRequestFlags::AutoStart;
+        AsyncFileHandle handle = testContext.fs->readMany(emptyRequest);
+        testContext.fs->wait(handle);
+        testContext.fs->closeHandle(handle);
+        CPY_ASSERT(groupCalls == 1);
+    }
+
+    deleteAllDir(*testContext.fs, ".test_folder/rootA");
+    deleteAllDir(*testContext.fs, ".test_folder/rootB");
+    testContext.fs->deleteDirectory(".test_folder");
+    testContext.end();
+}
+
+void testFileReadModes(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+
+    std::string contents;
+    contents.resize(3 * 1024 * 1024 + 11);
+    for (size_t i = 0; i < contents.size(); ++i)
+        contents[i] = (char)('a' + (i % 26));
+    writeTestFile(*testContext.fs, ".test_folder/modes.bin", contents);
+    writeTestFile(*testContext.fs, ".test_folder/empty.bin", std::string());
+
+    FileSystemDesc preadDesc { testContext.ts };
+    preadDesc.useIoRing = false;
+    IFileSystem* preadFs = IFileSystem::create(preadDesc);
+    IFileSystem* fileSystems[] = { testContext.fs, preadFs };
+    int modes[] = { (int)FileRequestFlags::WholeFile, (int)FileRequestFlags::MemoryMap };
+    for (IFileSystem* fs : fileSystems)
+    {
+        for (int mode : modes)
+        {
+            //null stands for the empty file.
+            const std::string* expectations[] = { &contents, nullptr };
+            for (const std::string* expected : expectations)
+            {
+                const char* path = expected ? ".test_folder/modes.bin" : ".test_folder/empty.bin";
+                int readingCount = 0;
+                const char* readingBuffer = nullptr;
+                const char* successBuffer = nullptr;
+                int successSize = -1;
+                AsyncFileHandle readHandle = fs->read(FileReadRequest(path, [&](FileReadResponse& response)
+                {
+                    CPY_ASSERT_FMT(response.status != FileStatus::Fail, "reading fail: %s", IoError2String(response.error));
+                    if (response.status == FileStatus::Reading)
+                    {
+                        ++readingCount;
+                        readingBuffer = response.buffer;
+                    }
+                    else if (response.status == FileStatus::Success)
+                    {
+                        successBuffer = response.buffer;
+                        successSize = (int)response.size;
+                    }
+                }, mode));
+                fs->execute(readHandle);
+                fs->wait(readHandle);
+
+                //Single response pointing at the whole file, still valid after the read finished.
+                size_t expectedSize = expected ? expected->size() : 0;
+                CPY_ASSERT(readingCount == 1);
+                CPY_ASSERT(successBuffer != nullptr && successBuffer == readingBuffer);
+                CPY_ASSERT_FMT(successSize == (int)expectedSize, "%d bytes, expected %d", successSize, (int)expectedSize);
+                if (expected)
+                    CPY_ASSERT(memcmp(successBuffer, expected->data(), expectedSize) == 0);
+                if (mode == (int)FileRequestFlags::WholeFile)
+                    CPY_ASSERT(successBuffer[expectedSize] == '\0');
+                fs->closeHandle(readHandle);
+            }
+        }
+    }
+    delete preadFs;
+
+    deleteAllDir(*testContext.fs, ".test_folder");
+    testContext.end();
+}
+
+//Issues all the reads at once and waits for them, returns the seconds it took.
+//Every page gets touched, so mapped reads pay for their page faults like the others pay for their copies.
+double runFileReadBenchmark(IFileSystem& fs, const std::vector<std::string>& files, size_t expectedBytes, int flags, int chunkSize)
+{
+    std::atomic<size_t> bytesRead = 0;
+    std::atomic<unsigned> pageSum = 0;
+    std::atomic<int> successes = 0;
+    std::vector<AsyncFileHandle> handles;
+    handles.reserve(files.size());
+
+    Stopwatch sw;
+    sw.start();
+    for (const auto& f : files)
+    {
+        FileReadRequest request(f, [&bytesRead, &successes, &pageSum](FileReadResponse& response)
+        {
+            if (response.status == FileStatus::Reading)
+            {
+                unsigned sum = 0;
+                for (unsigned long long i = 0; i < response.size; i += 4096)
+                    sum += (unsigned char)response.buffer[i];
+                pageSum.fetch_add(sum);
+                bytesRead.fetch_add((size_t)response.size);
+            }
+            else if (response.status == FileStatus::Success)
+                successes.fetch_add(1);
+        }, (int)FileRequestFlags::AutoStart | flags);
+        request.chunkSize = chunkSize;
+        handles.push_back(fs.read(request));
+    }
+    for (auto h : handles)
+        fs.wait(h);
+    double seconds = (double)sw.timeMicroSecondsLong() / 1000000.0;
+
+    for (auto h : handles)
+        fs.closeHandle(h);
+
+    CPY_ASSERT_FMT(successes == (int)files.size(), "%d files read, expected %d", successes.load(), (int)files.size());
+    CPY_ASSERT_FMT(bytesRead == expectedBytes, "%llu bytes read, expected %llu", (unsigned long long)bytesRead.load(), (unsigned long long)expectedBytes);
+    return seconds;
+}
+
+double runFileReadManyBenchmark(IFileSystem& fs, const std::vector<std::string>& files, size_t expectedBytes, int queueDepth)
+{
+    std::atomic<size_t> bytesRead = 0;
+    std::atomic<unsigned> pageSum = 0;
+    int failed = -1;
+
+    Stopwatch sw;
+    sw.start();
+    FileReadManyRequest request;
+    request.paths = files;
+    request.queueDepth = queueDepth;
+    request.flags = (int)FileRequestFlags::AutoStart;
+    request.fileCallback = [&bytesRead, &pageSum](int fileIndex, FileReadResponse& response)
+    {
+        if (response.status == FileStatus::Reading)
+        {
+            unsigned sum = 0;
+            for (unsigned long long i = 0; i < response.size; i += 4096)
+                sum += (unsigned char)response.buffer[i];
+            pageSum.fetch_add(sum);
+            bytesRead.fetch_add((size_t)response.size);
+        }
+    };
+    request.groupCallback = [&failed](FileReadGroupResponse& response)
+    {
+        failed = response.failedCount;
+    };
+    AsyncFileHandle handle = fs.readMany(request);
+    fs.wait(handle);
+    double seconds = (double)sw.timeMicroSecondsLong() / 1000000.0;
+    fs.closeHandle(handle);
+
+    CPY_ASSERT_FMT(failed == 0, "%d files failed", failed);
+    CPY_ASSERT_FMT(bytesRead == expectedBytes, "%llu bytes read, expected %llu", (unsigned long long)bytesRead.load(), (unsigned long long)expectedBytes);
+    return seconds;
+}
+
+void benchmarkFileRead(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+
+    struct FileSet
+    {
+        const char* name;
+        int fileCount;
+        size_t fileSize;
+        std::vector<std::string> paths;
+    } sets[] = {
+        { "small files", 512, 16 * 1024 },
+        { "huge files", 3, 48 * 1024 * 1024 }
+    };
+
+    for (auto& set : sets)
+    {
+        std::string contents(set.fileSize, 'x');
+        for (int i = 0; i < set.fileCount; ++i)
+        {
+            std::stringstream ss;
+            ss << ".test_folder/" << (set.fileSize > 1024 * 1024 ? "huge" : "small") << i << ".bin";
+            set.paths.push_back(ss.str());
+            writeTestFile(*testContext.fs, set.paths.back(), contents);
+        }
+    }
+
+    struct ReadMode
+    {
+        const char* name;
+        int flags;
+        int chunkSize;
+    } modes[] = {
+        { "chunks", 0, 0 },
+        { "ahead", (int)FileRequestFlags::Readahead, 256 * 1024 },
+        { "whole", (int)FileRequestFlags::WholeFile, 0 },
+        { "mmap", (int)FileRequestFlags::MemoryMap, 0 }
+    };
+
+    //Files were just written, so this measures the request engine on top of the page cache rather than the disk.
+    for (int useIoRing = 1; useIoRing >= 0; --useIoRing)
+    {
+        FileSystemDesc desc { testContext.ts };
+        desc.useIoRing = useIoRing != 0;
+        IFileSystem* fs = IFileSystem::create(desc);
+        for (auto& mode : modes)
+        {
+            for (auto& set : sets)
+            {
+                size_t totalBytes = set.fileSize * set.fileCount;
+                double seconds = std::max(runFileReadBenchmark(*fs, set.paths, totalBytes, mode.flags, mode.chunkSize), 1e-9);
+                printf("    %-6s %-8s %-12s %4d x %8llu bytes: %10.0f files/s %9.1f MB/s\n",
+                    useIoRing ? "ring" : "pread", mode.name, set.name, set.fileCount, (unsigned long long)set.fileSize,
+                    (double)set.fileCount / seconds, (double)totalBytes / (1024.0 * 1024.0) / seconds);
+            }
+        }
+
+        //Same files through a single readMany handle.
+        for (auto& set : sets)
+        {
+            size_t totalBytes = set.fileSize * set.fileCount;
+            double seconds = std::max(runFileReadManyBenchmark(*fs, set.paths, totalBytes, 16), 1e-9);
+            printf("    %-6s %-8s %-12s %4d x %8llu bytes: %10.0f files/s %9.1f MB/s\n",
+                useIoRing ? "ring" : "pread", "many", set.name, set.fileCount, (unsigned long long)set.fileSize,
+                (double)set.fileCount / seconds, (double)totalBytes / (1024.0 * 1024.0) / seconds);
+        }
+        delete fs;
+    }
+
+    deleteAllDir(*testContext.fs, ".test_folder");
+    testContext.end();
+}
+
+bool readFromRoots(IFileSystem& fs, const char* path, const std::vector<std::string>& roots, std::string& contents)
+{
+    bool success = false;
+    contents.clear();
+    FileReadRequest request(path, [&success, &contents](FileReadResponse& response)
+    {
+        if (response.status == FileStatus::Reading)
+            contents.append(response.buffer, response.size);
+        else if (response.status == FileStatus::Success)
+            success = true;
+    });
+    request.additionalRoots = roots;
+    AsyncFileHandle handle = fs.read(request);
+    fs.execute(handle);
+    fs.wait(handle);
+    fs.closeHandle(handle);
+    return success;
+}
+
+//Claims the directories added to it are watched but never reports a change,
+//so whatever a caching file system answers comes from its cache.
+class SilentFileWatcher : public IFileWatcher
+{
+public:
+    virtual void start() override {}
+    virtual void stop() override {}
+    virtual void addDirectory(const char* directory) override { m_directories.push_back(directory); }
+    virtual bool isWatched(const char* path) override
+    {
+        std::string p = path;
+        std::replace(p.begin(), p.end(), '\\', '/');
+        for (const auto& dir : m_directories)
+            if (p.size() > dir.size() && p.compare(0, dir.size(), dir) == 0 && p[dir.size()] == '/')
+                return true;
+        return false;
+    }
+    virtual void addListener(IFileWatchListener* listener) override {}
+    virtual void removeListener(IFileWatchListener* listener) override {}
+
+private:
+    std::vector<std::string> m_directories;
+};
+
+void testFilePathCache(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+
+    //testContext.fs plays whoever else touches the files, only cachedFs caches lookups.
+    IFileSystem& otherFs = *testContext.fs;
+    otherFs.carveDirectoryPath(".test_folder/rootA");
+    otherFs.carveDirectoryPath(".test_folder/rootB");
+    otherFs.carveDirectoryPath(".test_folder/rootC");
+    std::vector<std::string> roots = { ".test_folder/rootA", ".test_folder/rootB" };
+
+    FileWatchDesc watchDesc { 10 };
+    IFileWatcher* watcher = IFileWatcher::create(watchDesc);
+    watcher->start();
+    watcher->addDirectory(".test_folder/rootA");
+    watcher->addDirectory(".test_folder/rootB");
+    CPY_ASSERT(watcher->isWatched(".test_folder/rootA/a.txt"));
+    CPY_ASSERT(watcher->isWatched("./.test_folder/rootC/../rootB/a.txt"));
+    CPY_ASSERT(!watcher->isWatched(".test_folder/rootC/a.txt"));
+    CPY_ASSERT(!watcher->isWatched(".test_folder/rootAA/a.txt"));
+    CPY_ASSERT(!watcher->isWatched("a.txt"));
+
+    FileSystemDesc cachedDesc { testContext.ts };
+    cachedDesc.watcher = watcher;
+    IFileSystem* cachedFs = IFileSystem::create(cachedDesc);
+
+    std::string contents;
+    writeTestFile(otherFs, ".test_folder/rootB/a.txt", "B");
+    CPY_ASSERT(readFromRoots(*cachedFs, "a.txt", roots, contents) && contents == "B");
+
+    //A file appearing in an earlier root shadows the cached one once the watcher reports it.
+    writeTestFile(otherFs, ".test_folder/rootA/a.txt", "A");
+    bool shadowed = false;
+    for (int attempt = 0; attempt < 500 && !shadowed; ++attempt)
+    {
+        shadowed = readFromRoots(*cachedFs, "a.txt", roots, contents) && contents == "A";
+        if (!shadowed)
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    CPY_ASSERT_MSG(shadowed, "watcher notification did not invalidate the cached path");
+
+    //Roots the watcher does not cover are checked on every read.
+    std::vector<std::string> unwatchedRoots = { ".test_folder/rootA", ".test_folder/rootC" };
+    CPY_ASSERT(!readFromRoots(*cachedFs, "c.txt", unwatchedRoots, contents));
+    writeTestFile(otherFs, ".test_folder/rootC/c.txt", "c");
+    CPY_ASSERT_MSG(readFromRoots(*cachedFs, "c.txt", unwatchedRoots, contents) && contents == "c", "unwatched root was cached");
+
+    watcher->stop();
+    CPY_ASSERT(!watcher->isWatched(".test_folder/rootA/a.txt"));
+    delete cachedFs;
+    delete watcher;
+
+    //Lookups of a file in the last of several roots, see the benchmark below.
+    std::vector<std::string> manyRoots;
+    for (int i = 0; i < 6; ++i)
+    {
+        std::stringstream ss;
+        ss << ".test_folder/root" << i;
+        manyRoots.push_back(ss.str());
+    }
+    manyRoots.push_back(".test_folder/rootB");
+
+    //Without notifications the cache answers on its own.
+    SilentFileWatcher silentWatcher;
+    silentWatcher.addDirectory(".test_folder/rootA");
+    silentWatcher.addDirectory(".test_folder/rootB");
+    for (int i = 0; i < 6; ++i)
+        silentWatcher.addDirectory(manyRoots[i].c_str());
+    cachedDesc.watcher = &silentWatcher;
+    cachedFs = IFileSystem::create(cachedDesc);
+
+    CPY_ASSERT(readFromRoots(*cachedFs, "a.txt", roots, contents) && contents == "A");
+    otherFs.deleteFile(".test_folder/rootA/a.txt");
+    CPY_ASSERT_MSG(readFromRoots(*cachedFs, "a.txt", roots, contents) && contents == "B", "stale cached path did not fall back to probing");
+
+    CPY_ASSERT(!readFromRoots(*cachedFs, "b.txt", roots, contents));
+    writeTestFile(otherFs, ".test_folder/rootB/b.txt", "b");
+    CPY_ASSERT_MSG(!readFromRoots(*cachedFs, "b.txt", roots, contents), "missing file was not cached");
+    CPY_ASSERT(readFromRoots(otherFs, "b.txt", roots, contents));
+
+    //Writes through the caching file system invalidate right away.
+    writeTestFile(*cachedFs, ".test_folder/rootB/b.txt", "b2");
+    CPY_ASSERT(readFromRoots(*cachedFs, "b.txt", roots, contents) && contents == "b2");
+
+    //Lookups of a file in the last of several roots, probed every time vs answered by the cache.
+    IFileSystem* fileSystems[] = { &otherFs, cachedFs };
+    for (IFileSystem* fs : fileSystems)
+    {
+        const int reads = 2000;
+        Stopwatch sw;
+        sw.start();
+        for (int i = 0; i < reads; ++i)
+            readFromRoots(*fs, "b.txt", manyRoots, contents);
+        double seconds = std::max((double)sw.timeMicroSecondsLong() / 1000000.0, 1e-9);
+        printf("    %-8s %d reads through %d roots: %10.0f reads/s\n",
+            fs == cachedFs ? "cached" : "probed", reads, (int)manyRoots.size(), (double)reads / seconds);
+    }
+
+    delete cachedFs;
+
+    otherFs.deleteDirectory(".test_folder/rootA");
+    deleteAllDir(otherFs, ".test_folder/rootB");
+    deleteAllDir(otherFs, ".test_folder/rootC");
+    otherFs.deleteDirectory(".test_folder");
+    testContext.end();
+}
+
+//Reads path as a whole file and leaves the handle open, so outBuffer stays valid until the caller closes it.
+AsyncFileHandle readWholeFileOpen(IFileSystem& fs, const std::string& path, const char*& outBuffer, std::string& outContents)
+{
+    outBuffer = nullptr;
+    AsyncFileHandle handle = fs.read(FileReadRequest(path, [&outBuffer, &outContents](FileReadResponse& response)
+    {
+        CPY_ASSERT_FMT(response.status != FileStatus::Fail, "reading fail: %s", IoError2String(response.error));
+        if (response.status == FileStatus::Success)
+        {
+            outBuffer = response.buffer;
+            outContents.assign(response.buffer, response.size);
+        }
+    }, (int)FileRequestFlags::WholeFile));
+    fs.execute(handle);
+    fs.wait(handle);
+    return handle;
+}
+
+void testFileContentCache(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+
+    IFileSystem& otherFs = *testContext.fs;
+    FileSystemDesc cachedDesc { testContext.ts };
+    cachedDesc.contentCacheBytes = 64 * 1024;
+    IFileSystem* cachedFs = IFileSystem::create(cachedDesc);
+
+    //Open handles keep their buffers alive, so a new buffer never reuses the address of one that got evicted.
+    std::vector<AsyncFileHandle> handles;
+    const char* first = nullptr;
+    const char* second = nullptr;
+    std::string contents;
+
+    writeTestFile(otherFs, ".test_folder/a.txt", "a1");
+    handles.push_back(readWholeFileOpen(*cachedFs, ".test_folder/a.txt", first, contents));
+    CPY_ASSERT(contents == "a1");
+    handles.push_back(readWholeFileOpen(*cachedFs, ".test_folder/a.txt", second, contents));
+    CPY_ASSERT(contents == "a1");
+    CPY_ASSERT_MSG(first == second, "second read did not share the cached buffer");
+
+    //Changes the cache was never told about are caught by the write time and size.
+    writeTestFile(otherFs, ".test_folder/a.txt", "a22");
+    handles.push_back(readWholeFileOpen(*cachedFs, ".test_folder/a.txt", second, contents));
+    CPY_ASSERT_MSG(contents == "a22" && first != second, "file grown behind the cache returned stale contents");
+
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    writeTestFile(otherFs, ".test_folder/a.txt", "a33");
+    handles.push_back(readWholeFileOpen(*cachedFs, ".test_folder/a.txt", first, contents));
+    CPY_ASSERT_MSG(contents == "a33" && first != second, "file rewritten behind the cache returned stale contents");
+
+    //Writes through the caching file system drop the entry even if write time and size match.
+    writeTestFile(*cachedFs, ".test_folder/a.txt", "a44");
+    handles.push_back(readWholeFileOpen(*cachedFs, ".test_folder/a.txt", second, contents));
+    CPY_ASSERT_MSG(contents == "a44" && first != second, "write did not invalidate the cached contents");
+
+    //Three 30KB files don't fit in 64KB, the least recently used one goes.
+    const char* bufs[3] = {};
+    for (int i = 0; i < 3; ++i)
+    {
+        std::stringstream ss;
+        ss << ".test_folder/b" << i << ".bin";
+        writeTestFile(otherFs, ss.str(), std::string(30 * 1024, (char)('0' + i)));
+        handles.push_back(readWholeFileOpen(*cachedFs, ss.str(), bufs[i], contents));
+    }
+    handles.push_back(readWholeFileOpen(*cachedFs, ".test_folder/b2.bin", first, contents));
+    CPY_ASSERT_MSG(first == bufs[2], "most recent file was evicted");
+    handles.push_back(readWholeFileOpen(*cachedFs, ".test_folder/b0.bin", first, contents));
+    CPY_ASSERT_MSG(first != bufs[0] && contents == std::string(30 * 1024, '0'), "least recent file was not evicted");
+
+    for (auto h : handles)
+        cachedFs->closeHandle(h);
+
+    //The same header read over and over, like an include shared by many shader permutations.
+    writeTestFile(otherFs, ".test_folder/header.hlsl", std::string(16 * 1024, 'h'));
+    IFileSystem* fileSystems[] = { &otherFs, cachedFs };
+    for (IFileSystem* fs : fileSystems)
+    {
+        const int reads = 2000;
+        Stopwatch sw;
+        sw.start();
+        for (int i = 0; i < reads; ++i)
+            readTestFile(*fs, ".test_folder/header.hlsl");
+        double seconds = std::max((double)sw.timeMicroSecondsLong() / 1000000.0, 1e-9);
+        printf("    %-8s %d whole reads of a 16KB file: %10.0f reads/s\n",
+            fs == cachedFs ? "cached" : "disk", reads, (double)reads / seconds);
+    }
+
+    delete cachedFs;
+
+    deleteAllDir(otherFs, ".test_folder");
+    testContext.end();
+}
+
+void testFilePak(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+    IFileSystem& fs = *testContext.fs;
+
+    std::string text;
+    for (int i = 0; i < 200; ++i)
+        text += "compressible line of text\n";
+    std::string noise(40 * 1024, '\0');
+    unsigned seed = 7;
+    for (auto& c : noise)
+    {
+        seed = seed * 1103515245u + 12345u;
+        c = (char)(seed >> 24);
+    }
+
+    writeTestFile(fs, ".test_folder/src/a.txt", text);
+    writeTestFile(fs, ".test_folder/src/sub/noise.bin", noise);
+    //Stored right after noise.bin, so reading past the end of noise.bin would hit its 'x'.
+    writeTestFile(fs, ".test_folder/src/sub/noise2.bin", 'x' + noise.substr(1));
+    writeTestFile(fs, ".test_folder/src/empty.txt", "");
+    writeTestFile(fs, ".test_folder/loose/a.txt", "loose a");
+    writeTestFile(fs, ".test_folder/loose/c.txt", "loose c");
+
+    PakBuildDesc desc;
+    desc.archivePath = ".test_folder/test.pak";
+    PakUtils::collectDirectory(".test_folder/src", desc.entries);
+    CPY_ASSERT(desc.entries.size() == 4);
+    std::string error;
+    CPY_ASSERT_MSG(PakUtils::buildArchive(desc, error), error.c_str());
+
+    CPY_ASSERT_MSG(!fs.mountArchive(".test_folder/loose/a.txt"), "mounted a file that is not an archive");
+    CPY_ASSERT(fs.mountArchive(".test_folder/test.pak"));
+
+    //Archive entries win over loose files of any candidate.
+    std::vector<std::string> roots = { ".test_folder/loose" };
+    std::string contents;
+    CPY_ASSERT(readFromRoots(fs, "a.txt", roots, contents) && contents == text);
+    CPY_ASSERT(readTestFile(fs, "a.txt") == text);
+    CPY_ASSERT(readFromRoots(fs, "c.txt", roots, contents) && contents == "loose c");
+    CPY_ASSERT(readFromRoots(fs, "./sub/noise.bin", {}, contents) && contents == noise);
+    CPY_ASSERT(readTestFile(fs, "sub/noise.bin") == noise);
+    CPY_ASSERT(readFromRoots(fs, "empty.txt", {}, contents) && contents.empty());
+
+    {
+        std::vector<std::string> chunks;
+        FileReadRequest request("sub/noise.bin", [&chunks](FileReadResponse& response)
+        {
+            if (response.status == FileStatus::Reading)
+                chunks.emplace_back(response.buffer, response.size);
+        });
+        request.chunkSize = 16 * 1024;
+        AsyncFileHandle handle = fs.read(request);
+        fs.execute(handle);
+        fs.wait(handle);
+        fs.closeHandle(handle);
+        CPY_ASSERT(chunks.size() == 3 && chunks[2].size() == 8 * 1024);
+    }
+
+    //noise.bin is stored as is, WholeFile still gets its null terminator instead of the start of noise2.bin.
+    {
+        bool terminated = false;
+        std::string wholeContents;
+        AsyncFileHandle handle = fs.read(FileReadRequest("sub/noise.bin", [&terminated, &wholeContents](FileReadResponse& response)
+        {
+            if (response.status != FileStatus::Reading)
+                return;
+            wholeContents.assign(response.buffer, response.size);
+            terminated = response.buffer[response.size] == '\0';
+        }, (int)FileRequestFlags::WholeFile));
+        fs.execute(handle);
+        fs.wait(handle);
+        fs.closeHandle(handle);
+        CPY_ASSERT(terminated && wholeContents == noise);
+    }
+
+    CPY_ASSERT(fs.unmountArchive(".test_folder/test.pak"));
+    CPY_ASSERT(!fs.unmountArchive(".test_folder/test.pak"));
+    CPY_ASSERT(readFromRoots(fs, "a.txt", roots, contents) && contents == "loose a");
+    CPY_ASSERT(!readFromRoots(fs, "sub/noise.bin", {}, contents));
+
+    //Small files read one by one, loose vs packed.
+    const int fileCount = 256;
+    PakBuildDesc benchDesc;
+    benchDesc.archivePath = ".test_folder/bench.pak";
+    benchDesc.compress = false;
+    std::vector<std::string> paths;
+    for (int i = 0; i < fileCount; ++i)
+    {
+        std::stringstream ss;
+        ss << ".test_folder/bench/f" << i << ".txt";
+        paths.push_back(ss.str());
+        writeTestFile(fs, paths.back(), std::string(4 * 1024, (char)('a' + i % 26)));
+        benchDesc.entries.push_back(PakBuildEntry { paths.back(), paths.back() });
+    }
+    CPY_ASSERT_MSG(PakUtils::buildArchive(benchDesc, error), error.c_str());
+
+    for (int packed = 0; packed < 2; ++packed)
+    {
+        if (packed)
+            CPY_ASSERT(fs.mountArchive(benchDesc.archivePath.c_str()));
+        double seconds = std::max(runFileReadBenchmark(fs, paths, (size_t)fileCount * 4 * 1024, (int)FileRequestFlags::WholeFile, 0), 1e-9);
+        printf("    %-8s %d x 4096 bytes: %10.0f files/s\n", packed ? "packed" : "loose", fileCount, (double)fileCount / seconds);
+    }
+    CPY_ASSERT(fs.unmountArchive(benchDesc.archivePath.c_str()));
+
+    deleteAllDir(fs, ".test_folder/src/sub");
+    deleteAllDir(fs, ".test_folder/src");
+    deleteAllDir(fs, ".test_folder/loose");
+    deleteAllDir(fs, ".test_folder/bench");
+    deleteAllDir(fs, ".test_folder");
+    testContext.end();
+}
+
+void testFileLookup(TestContext& ctx)
+{
+    FileLookup a("shaders/a.hlsl");
+    FileLookup b("shaders/b.hlsl");
+    CPY_ASSERT(a == FileLookup(std::string("shaders/a.hlsl")));
+    CPY_ASSERT(a != b);
+    CPY_ASSERT((a < b) != (b < a));
+
+    //Forced hash collision: different files must stay different keys.
+    FileLookup collision = b;
+    collision.hash = a.hash;
+    CPY_ASSERT(!(collision == a));
+    CPY_ASSERT((collision < a) != (a < collision));
+
+    std::unordered_map<FileLookup, int> map;
+    map[a] = 1;
+    map[collision] = 2;
+    CPY_ASSERT(map.size() == 2);
+    CPY_ASSERT(map[a] == 1);
+}
+
 void testFileWatcher(TestContext& ctx)
 {
     auto& testContext = (FileSystemContext&)ctx;
@@ -242,6 +1202,103 @@ void testFileWatcher(TestContext& ctx)
 
 }
 
+void testFileWatcherTree(TestContext& ctx)
+{
+    auto& testContext = (FileSystemContext&)ctx;
+    testContext.begin();
+    IFileSystem& fs = *testContext.fs;
+    fs.carveDirectoryPath(".testWatchTree");
+
+    class TreeWatchObj : public IFileWatchListener
+    {
+    public:
+        virtual void onFilesChanged(const std::set<std::string>& filesChanged)
+        {
+            std::unique_lock lock(mutex);
+            for (auto& fn : filesChanged)
+            {
+                std::string resolvedPath;
+                FileUtils::getAbsolutePath(fn, resolvedPath);
+                ++reports[resolvedPath];
+            }
+        }
+
+        int reportCount(const std::string& fileName)
+        {
+            std::string resolvedPath;
+            FileUtils::getAbsolutePath(fileName, resolvedPath);
+            std::unique_lock lock(mutex);
+            return reports[resolvedPath];
+        }
+
+        //Waits for more than previousReports reports, returns the milliseconds it took or -1 on timeout.
+        int waitReport(const std::string& fileName, int previousReports = 0)
+        {
+            Stopwatch sw;
+            sw.start();
+            while (reportCount(fileName) <= previousReports)
+            {
+                if (sw.timeMicroSecondsLong() > 2000000)
+                    return -1;
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            }
+            return (int)(sw.timeMicroSecondsLong() / 1000);
+        }
+
+        std::mutex mutex;
+        std::unordered_map<std::string, int> reports;
+    } watchObj;
+
+    FileWatchDesc fwdesc;
+    fwdesc.debounceMS = 20;
+    IFileWatcher* fileWatcher = IFileWatcher::create(fwdesc);
+    fileWatcher->start();
+    fileWatcher->addListener(&watchObj);
+    fileWatcher->addDirectory(".testWatchTree");
+
+    //Directories created after the watch started get watched too.
+    fs.carveDirectoryPath(".testWatchTree/a/b");
+    writeTestFile(fs, ".testWatchTree/a/b/c.txt", "c");
+    int latencyMS = watchObj.waitReport(".testWatchTree/a/b/c.txt");
+    CPY_ASSERT_MSG(latencyMS != -1, "write in a new subdirectory was not reported");
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int previousReports = watchObj.reportCount(".testWatchTree/a/b/c.txt");
+    writeTestFile(fs, ".testWatchTree/a/b/c.txt", "cc");
+    latencyMS = watchObj.waitReport(".testWatchTree/a/b/c.txt", previousReports);
+    CPY_ASSERT_MSG(latencyMS != -1, "second write was not reported");
+    printf("    change reported after %d ms\n", latencyMS);
+
+    //A burst of saves to the same file is reported far fewer times than it got written.
+    const int saves = 10;
+    for (int i = 0; i < saves; ++i)
+        writeTestFile(fs, ".testWatchTree/d.txt", std::string(i + 1, 'd'));
+    CPY_ASSERT(watchObj.waitReport(".testWatchTree/d.txt") != -1);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int reports = watchObj.reportCount(".testWatchTree/d.txt");
+    CPY_ASSERT_FMT(reports < saves, "%d saves reported %d times", saves, reports);
+
+    //A directory renamed inside the tree is watched under its new path, one moved out stops being reported.
+    CPY_ASSERT(rename(".testWatchTree/a", ".testWatchTree/e") == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    writeTestFile(fs, ".testWatchTree/e/b/c.txt", "e");
+    CPY_ASSERT_MSG(watchObj.waitReport(".testWatchTree/e/b/c.txt") != -1, "write in a renamed subdirectory was not reported");
+    CPY_ASSERT(rename(".testWatchTree/e", ".testWatchMoved") == 0);
+    std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    int staleReports = watchObj.reportCount(".testWatchTree/e/b/c.txt");
+    writeTestFile(fs, ".testWatchMoved/b/c.txt", "moved");
+    std::this_thread::sleep_for(std::chrono::milliseconds(200));
+    CPY_ASSERT_MSG(watchObj.reportCount(".testWatchTree/e/b/c.txt") == staleReports, "write in a directory moved out of the tree was reported under its old path");
+
+    fileWatcher->removeListener(&watchObj);
+    fileWatcher->stop();
+    delete fileWatcher;
+
+    deleteAllDir(fs, ".testWatchMoved/b");
+    fs.deleteDirectory(".testWatchMoved");
+    deleteAllDir(fs, ".testWatchTree");
+    testContext.end();
+}
+
 class FileSystemTestSuite : public TestSuite
 {
 public:
@@ -251,7 +1308,19 @@ public:
         static TestCase sCases[] = {
             { "createDeleteDir", testCreateDeleteDir },
             { "fileReadWrite", testFileReadWrite },
-            { "fileWatcher", testFileWatcher }
+            { "fileReadCancel", testFileReadCancel },
+            { "fileWriteModes", testFileWriteModes },
+            { "fileReadLarge", testFileReadLarge },
+            { "fileReadChunks", testFileReadChunks },
+            { "fileReadMany", testFileReadMany },
+            { "fileReadModes", testFileReadModes },
+            { "fileWatcher", testFileWatcher },
+            { "fileWatcherTree", testFileWatcherTree },
+            { "filePathCache", testFilePathCache },
+            { "fileContentCache", testFileContentCache },
+            { "filePak", testFilePak },
+            { "fileLookup", testFileLookup },
+            { "benchmarkFileRead", benchmarkFileRead }
         };
 
         caseCounts = (int)(sizeof(sCases) / sizeof(TestCase));
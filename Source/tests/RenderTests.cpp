@@ -117,6 +117,7 @@ namespace coalpy
         {
             DeviceConfig config;
             config.shaderDb = db;
+            config.ts = ts;
             config.platform = platform;
             config.flags = DeviceFlags::EnableDebug;
             device = IDevice::create(config);
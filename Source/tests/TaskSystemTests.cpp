@@ -1,7 +1,20 @@
 #include "testsystem.h"
 #include <coalpy.core/Assert.h>
 #include <coalpy.tasks/ITaskSystem.h>
+#include <coalpy.tasks/ThreadQueue.h>
+#include <coalpy.tasks/LockFreeQueue.h>
+#include <coalpy.core/Stopwatch.h>
+#include <coalpy.core/Profiler.h>
+#include <cJSON.h>
 #include <vector>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+#include <mutex>
+#include <chrono>
+#include <string>
+#include <ctime>
+#include <stdio.h>
 
 namespace coalpy
 {
@@ -167,6 +180,1248 @@ void testTaskYield(TestContext& ctx)
     ts.join();
 }
 
+void testLargeGraph(TestContext& ctx)
+{
+    auto& testContext = (TaskSystemContext&)ctx;
+    auto& ts = *testContext.ts;
+    ASSERT_NO_TASKS(ts);
+    ts.start();
+
+    const int groupSize = 16;
+    const int groupCount = 100000 / groupSize;
+    std::vector<int> leafValues(groupSize * groupCount, 0);
+    std::vector<int> groupValues(groupCount, 0);
+
+    TaskDesc leafDesc("Leaf", [](TaskContext& ctx) { *(int*)ctx.data = 1; });
+    TaskDesc groupDesc("Group", [&leafValues, &groupValues](TaskContext& ctx)
+    {
+        int groupIndex = (int)(size_t)ctx.data;
+        int sum = 0;
+        for (int i = 0; i < groupSize; ++i)
+            sum += leafValues[groupIndex * groupSize + i];
+        groupValues[groupIndex] = sum;
+    });
+
+    //a dependency that finishes before the graph is built.
+    Task finishedTask = ts.createTask();
+    ts.execute(finishedTask);
+    ts.wait(finishedTask);
+
+    Stopwatch sw;
+    sw.start();
+    Task root = ts.createTask();
+    std::vector<Task> leaves(groupSize);
+    for (int g = 0; g < groupCount; ++g)
+    {
+        Task groupTask = ts.createTask(groupDesc, (void*)(size_t)g);
+        for (int i = 0; i < groupSize; ++i)
+            leaves[i] = ts.createTask(leafDesc, &leafValues[g * groupSize + i]);
+        ts.depends(groupTask, leaves.data(), groupSize);
+        ts.depends(root, groupTask);
+    }
+    ts.depends(root, finishedTask);
+
+    ts.execute(root);
+    ts.wait(root);
+    ts.cleanTaskTree(root);
+    float ms = (float)sw.timeMicroSecondsLong() / 1000.0f;
+    printf("    %d tasks built, executed and cleaned in %.3fms\n", groupCount * (groupSize + 1) + 1, ms);
+
+    for (int v : groupValues)
+        CPY_ASSERT_FMT(v == groupSize, "%d", v);
+
+    ASSERT_NO_TASKS(ts);
+    ts.signalStop();
+    ts.join();
+}
+
+//Splits are bounded by the worker count, not the element count.
+void testParallelForSplitBudget()
+{
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        TaskSystemDesc desc;
+        desc.threadPoolSize = 8;
+        desc.schedulerMode = mode;
+        ITaskSystem& ts = *ITaskSystem::create(desc);
+        ts.start();
+
+        const int elementCount = 1 << 22;
+        std::atomic<long long> visited = 0;
+        std::atomic<int> peakTasks = 0;
+        ts.parallelFor(0, elementCount, 1, [&ts, &visited, &peakTasks](int begin, int end)
+        {
+            visited.fetch_add(end - begin);
+            if ((begin & 0x3fff) != 0)
+                return;
+
+            ITaskSystem::Stats stats;
+            ts.getStats(stats);
+            int peak = peakTasks.load();
+            while (stats.numElements > peak && !peakTasks.compare_exchange_weak(peak, stats.numElements)) {}
+        });
+
+        CPY_ASSERT_FMT(visited == elementCount, "%lld", visited.load());
+        //8 workers and the caller, 23 halving levels, plus the root task.
+        CPY_ASSERT_FMT(peakTasks <= 9 * 23 + 1, "%d tasks alive at once", peakTasks.load());
+        ASSERT_NO_TASKS(ts);
+        ts.signalStop();
+        ts.join();
+        delete &ts;
+    }
+}
+
+void testParallelFor(TestContext& ctx)
+{
+    auto& testContext = (TaskSystemContext&)ctx;
+    auto& ts = *testContext.ts;
+    ASSERT_NO_TASKS(ts);
+    ts.start();
+
+    const int elementCount = 100000;
+    int grainSizes[] = { 1, 7, 1024, elementCount };
+    for (int grainSize : grainSizes)
+    {
+        std::vector<std::atomic<int>> visits(elementCount);
+        for (auto& v : visits)
+            v = 0;
+
+        std::atomic<bool> rangesInGrain = true;
+        ts.parallelFor(0, elementCount, grainSize, [&visits, &rangesInGrain, grainSize](int begin, int end)
+        {
+            rangesInGrain = rangesInGrain && (end - begin) <= grainSize;
+            for (int i = begin; i < end; ++i)
+                visits[i].fetch_add(1);
+        });
+
+        CPY_ASSERT(rangesInGrain);
+        for (int i = 0; i < elementCount; ++i)
+            CPY_ASSERT_FMT(visits[i] == 1, "element %d visited %d times with grain size %d", i, visits[i].load(), grainSize);
+        ASSERT_NO_TASKS(ts);
+    }
+
+    //parallelFor from inside a task, with nested parallelFor calls.
+    std::atomic<int> nestedSum = 0;
+    Task outerTask = ts.createTask(TaskDesc([&nestedSum](TaskContext& ctx)
+    {
+        ctx.ts->parallelFor(0, 64, 4, [&nestedSum, &ctx](int begin, int end)
+        {
+            for (int i = begin; i < end; ++i)
+                ctx.ts->parallelFor(0, 100, 10, [&nestedSum](int b, int e) { nestedSum.fetch_add(e - b); });
+        });
+    }));
+    ts.execute(outerTask);
+    ts.wait(outerTask);
+    ts.cleanTaskTree(outerTask);
+    CPY_ASSERT_FMT(nestedSum == 6400, "%d", nestedSum.load());
+
+    //ranges below the grain size run inline.
+    std::thread::id callerThread = std::this_thread::get_id();
+    bool ranInline = false;
+    ts.parallelFor(10, 20, 16, [&ranInline, callerThread](int begin, int end)
+    {
+        ranInline = begin == 10 && end == 20 && std::this_thread::get_id() == callerThread;
+    });
+    CPY_ASSERT(ranInline);
+
+    long long sum = ts.parallelReduce(0, elementCount, 100, 0ll,
+        [](int begin, int end)
+        {
+            long long partial = 0;
+            for (int i = begin; i < end; ++i)
+                partial += i;
+            return partial;
+        },
+        [](long long a, long long b) { return a + b; });
+    CPY_ASSERT_FMT(sum == (long long)elementCount * (elementCount - 1) / 2, "%lld", sum);
+
+    //partial results are combined in order.
+    std::string digits = ts.parallelReduce(0, 10, 1, std::string(),
+        [](int begin, int end) { return std::string(1, (char)('0' + begin)); },
+        [](const std::string& a, const std::string& b) { return a + b; });
+    CPY_ASSERT_FMT(digits == "0123456789", "%s", digits.c_str());
+
+    ASSERT_NO_TASKS(ts);
+    ts.signalStop();
+    ts.join();
+
+    testParallelForSplitBudget();
+}
+
+void testContinuations(TestContext& ctx)
+{
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        TaskSystemDesc desc;
+        desc.threadPoolSize = 1;
+        desc.schedulerMode = mode;
+        ITaskSystem& ts = *ITaskSystem::create(desc);
+        ts.start();
+
+        //Single compute worker: the child can only run if the parent gave the thread back.
+        int order = 0;
+        int parentOrder = -1;
+        int childOrder = -1;
+        int continuationOrder = -1;
+        Task child = ts.createTask(TaskDesc("child", [&](TaskContext& ctx) { childOrder = order++; }));
+        Task parent = ts.createTask(TaskDesc("parent", [&](TaskContext& ctx)
+        {
+            ctx.ts->continueAfter(ctx.task, child, [&](TaskContext& ctx) { continuationOrder = order++; });
+            parentOrder = order++;
+        }));
+
+        ts.execute(parent);
+        ts.wait(parent);
+        CPY_ASSERT_FMT(parentOrder == 0, "%d", parentOrder);
+        CPY_ASSERT_FMT(childOrder == 1, "%d", childOrder);
+        CPY_ASSERT_FMT(continuationOrder == 2, "%d", continuationOrder);
+        ts.cleanTaskTree(parent);
+        ASSERT_NO_TASKS(ts);
+
+        //A deep chain of awaits, each link waits for the next one. With blocking waits this nests once per link.
+        struct ChainState
+        {
+            int depth = 20000;
+            std::atomic<int> continuations = 0;
+            std::atomic<int> maxNesting = 0;
+            TaskFn link;
+        } chain;
+
+        static thread_local int t_nesting = 0;
+        chain.link = [&chain](TaskContext& ctx)
+        {
+            int nesting = ++t_nesting;
+            int prevMax = chain.maxNesting.load();
+            while (nesting > prevMax && !chain.maxNesting.compare_exchange_weak(prevMax, nesting));
+
+            int index = (int)(size_t)ctx.data;
+            if (index < chain.depth)
+            {
+                Task next = ctx.ts->createTask(TaskDesc("chainLink", chain.link), (void*)(size_t)(index + 1));
+                ctx.ts->continueAfter(ctx.task, next, [&chain](TaskContext& ctx) { chain.continuations.fetch_add(1); });
+            }
+            --t_nesting;
+        };
+
+        Task chainRoot = ts.createTask(TaskDesc("chainLink", chain.link), (void*)(size_t)0);
+        ts.execute(chainRoot);
+        ts.wait(chainRoot);
+        ts.cleanTaskTree(chainRoot);
+        ASSERT_NO_TASKS(ts);
+
+        CPY_ASSERT_FMT(chain.continuations == chain.depth, "%d", chain.continuations.load());
+        CPY_ASSERT_FMT(chain.maxNesting == 1, "%d", chain.maxNesting.load());
+
+        ts.signalStop();
+        ts.join();
+        delete &ts;
+    }
+}
+
+void testWorkerPlacement(TestContext& ctx)
+{
+    {
+        //Sized from the hardware by default.
+        TaskSystemDesc desc;
+        ITaskSystem* ts = ITaskSystem::create(desc);
+        ITaskSystem::Stats stats;
+        ts->getStats(stats);
+        //The process affinity mask can make it smaller than the machine.
+        int cores = std::max((int)std::thread::hardware_concurrency(), 1);
+        CPY_ASSERT_FMT(stats.computeWorkers >= 1 && stats.computeWorkers <= cores, "%d workers for %d cores", stats.computeWorkers, cores);
+        delete ts;
+    }
+
+    TaskWorkerGrouping groupings[] = { TaskWorkerGrouping::None, TaskWorkerGrouping::L3Cache, TaskWorkerGrouping::NumaNode };
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        for (auto grouping : groupings)
+        {
+            //More workers than most machines have cores, so the layout has to wrap around.
+            TaskSystemDesc desc;
+            desc.threadPoolSize = 12;
+            desc.schedulerMode = mode;
+            desc.pinWorkers = true;
+            desc.workerGrouping = grouping;
+            ITaskSystem& ts = *ITaskSystem::create(desc);
+            ts.start();
+
+            ITaskSystem::Stats stats;
+            ts.getStats(stats);
+            CPY_ASSERT_FMT(stats.computeWorkers == 12, "%d", stats.computeWorkers);
+            CPY_ASSERT_FMT(stats.workerDomains >= 1 && stats.workerDomains <= 12, "%d", stats.workerDomains);
+            if (grouping == TaskWorkerGrouping::None)
+                CPY_ASSERT_FMT(stats.workerDomains == 1, "%d", stats.workerDomains);
+
+            std::atomic<int> sum = 0;
+            ts.parallelFor(0, 10000, 16, [&sum](int begin, int end)
+            {
+                for (int i = begin; i < end; ++i)
+                    sum.fetch_add(i);
+            });
+            CPY_ASSERT_FMT(sum == 49995000, "%d", sum.load());
+
+            ASSERT_NO_TASKS(ts);
+            ts.signalStop();
+            ts.join();
+            delete &ts;
+        }
+    }
+}
+
+void testTaskBatch(TestContext& ctx)
+{
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        TaskSystemDesc desc;
+        desc.threadPoolSize = 4;
+        desc.schedulerMode = mode;
+        ITaskSystem& ts = *ITaskSystem::create(desc);
+        ts.start();
+
+        //An external task gates a fan out of leaves, joined by a sink. Everything runs once the sink executes.
+        const int leafCount = 500;
+        TaskBatch batch;
+        for (int round = 0; round < 3; ++round)
+        {
+            std::atomic<int> externalDone = 0;
+            std::atomic<int> leavesBeforeExternal = 0;
+            std::atomic<int> leavesDone = 0;
+            int leavesSeenBySink = -1;
+            Task external = ts.createTask(TaskDesc("external", [&externalDone](TaskContext& ctx) { externalDone = 1; }));
+
+            batch.clear();
+            int sink = batch.add(TaskDesc("sink", [&](TaskContext& ctx) { leavesSeenBySink = leavesDone.load(); }));
+            for (int i = 0; i < leafCount; ++i)
+            {
+                int leaf = batch.add(TaskDesc("leaf", [&](TaskContext& ctx)
+                {
+                    if (externalDone.load() == 0)
+                        leavesBeforeExternal.fetch_add(1);
+                    leavesDone.fetch_add(1);
+                }));
+                batch.depends(sink, leaf);
+                batch.depends(leaf, external);
+            }
+
+            //Not executed: the sink only starts through the regular execute path, which also starts the external task.
+            ts.submit(batch, false);
+            CPY_ASSERT_FMT((int)batch.tasks.size() == leafCount + 1, "%d", (int)batch.tasks.size());
+            Task sinkTask = batch.tasks[sink];
+            ts.execute(sinkTask);
+            ts.wait(sinkTask);
+            CPY_ASSERT_FMT(leavesSeenBySink == leafCount, "%d", leavesSeenBySink);
+            CPY_ASSERT_FMT(leavesBeforeExternal == 0, "%d", leavesBeforeExternal.load());
+
+            //Removes the external task too, it is a dependency of the leaves.
+            ts.cleanTaskTree(sinkTask);
+            ASSERT_NO_TASKS(ts);
+        }
+
+        //Chain submitted and started in one call.
+        std::vector<int> order;
+        batch.clear();
+        for (int i = 0; i < 100; ++i)
+        {
+            int t = batch.add(TaskDesc([&order](TaskContext& ctx) { order.push_back((int)(size_t)ctx.data); }), (void*)(size_t)i);
+            if (i > 0)
+                batch.depends(t, t - 1);
+        }
+        ts.submit(batch);
+        ts.wait(batch.tasks.back());
+        ts.cleanTaskTree(batch.tasks.back());
+        CPY_ASSERT_FMT(order.size() == 100, "%d", (int)order.size());
+        for (int i = 0; i < (int)order.size(); ++i)
+            CPY_ASSERT_FMT(order[i] == i, "%d at %d", order[i], i);
+        ASSERT_NO_TASKS(ts);
+
+        ts.signalStop();
+        ts.join();
+        delete &ts;
+    }
+}
+
+void testCancellation(TestContext& ctx)
+{
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        TaskSystemDesc desc;
+        desc.threadPoolSize = 2;
+        desc.schedulerMode = mode;
+        ITaskSystem& ts = *ITaskSystem::create(desc);
+        ts.start();
+
+        //Cancelled before dispatch: the task and everything depending on it gets skipped.
+        std::atomic<int> ran = 0;
+        CancelToken token = CancelToken::create();
+        TaskDesc cancelledDesc("cancelled", [&ran](TaskContext& ctx) { ran.fetch_add(1); });
+        cancelledDesc.cancelToken = token;
+        Task cancelled = ts.createTask(cancelledDesc);
+        Task dependent = ts.createTask(TaskDesc("dependent", [&ran](TaskContext& ctx) { ran.fetch_add(1); }));
+        Task sibling = ts.createTask(TaskDesc("sibling", [&ran](TaskContext& ctx) { ran.fetch_add(100); }));
+        Task root = ts.createTask(TaskDesc("root", [&ran](TaskContext& ctx) { ran.fetch_add(1); }));
+        ts.depends(dependent, cancelled);
+        ts.depends(root, dependent);
+        ts.depends(root, sibling);
+
+        token.cancel();
+        ts.execute(root);
+        ts.wait(root);
+        CPY_ASSERT_FMT(ran == 100, "%d", ran.load());
+        CPY_ASSERT(ts.isCancelled(cancelled));
+        CPY_ASSERT(ts.isCancelled(dependent));
+        CPY_ASSERT(ts.isCancelled(root));
+        CPY_ASSERT(!ts.isCancelled(sibling));
+        ts.cleanTaskTree(root);
+
+        //Deadline already passed when dispatched.
+        ran = 0;
+        TaskDesc lateDesc("late", [&ran](TaskContext& ctx) { ran.fetch_add(1); });
+        lateDesc.deadline = TaskClock::now() - std::chrono::milliseconds(1);
+        Task late = ts.createTask(lateDesc);
+        ts.execute(late);
+        ts.wait(late);
+        CPY_ASSERT_FMT(ran == 0, "%d", ran.load());
+        ts.cleanTaskTree(late);
+
+        //A running task polls its token and bails out.
+        std::atomic<bool> started = false;
+        std::atomic<bool> bailedOut = false;
+        CancelToken pollToken = CancelToken::create();
+        TaskDesc pollDesc("polling", [&](TaskContext& ctx)
+        {
+            started = true;
+            while (!ctx.ts->isCancelled(ctx.task))
+                std::this_thread::yield();
+            bailedOut = true;
+        });
+        pollDesc.cancelToken = pollToken;
+        Task polling = ts.createTask(pollDesc);
+        ts.execute(polling);
+        while (!started)
+            std::this_thread::yield();
+        pollToken.cancel();
+        ts.wait(polling);
+        CPY_ASSERT(bailedOut);
+        ts.cleanTaskTree(polling);
+
+        ITaskSystem::Stats stats;
+        ts.getStats(stats);
+        CPY_ASSERT_FMT(stats.cancelledTasks == 4, "%llu", stats.cancelledTasks);
+
+        ASSERT_NO_TASKS(ts);
+        ts.signalStop();
+        ts.join();
+        delete &ts;
+    }
+}
+
+void testExternalSignal(TestContext& ctx)
+{
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        TaskSystemDesc desc;
+        desc.threadPoolSize = 2;
+        desc.schedulerMode = mode;
+        ITaskSystem& ts = *ITaskSystem::create(desc);
+        ts.start();
+
+        //Executing the dependent does not start the external task, only signal finishes it.
+        std::atomic<bool> ran = false;
+        Task external = ts.createTask(TaskDesc("external", (int)TaskFlags::External, nullptr));
+        Task dependent = ts.createTask(TaskDesc("dependent", [&ran](TaskContext& ctx) { ran = true; }));
+        ts.depends(dependent, external);
+        ts.execute(dependent);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        CPY_ASSERT(!ran);
+
+        std::thread signaller([&ts, external]() { ts.signal(external); });
+        ts.wait(dependent);
+        signaller.join();
+        CPY_ASSERT(ran);
+        ts.cleanTaskTree(dependent);
+
+        //A continuation awaiting an external task resumes once it gets signalled from another thread.
+        std::atomic<int> steps = 0;
+        Task signalled = ts.createTask(TaskDesc("signalled", (int)TaskFlags::External, nullptr));
+        Task waiting = ts.createTask(TaskDesc("waiting", [&steps, signalled](TaskContext& ctx)
+        {
+            steps.fetch_add(1);
+            ctx.ts->continueAfter(ctx.task, signalled, [&steps](TaskContext& ctx) { steps.fetch_add(1); });
+        }));
+        ts.execute(waiting);
+        while (steps == 0)
+            std::this_thread::yield();
+        CPY_ASSERT(steps == 1);
+        ts.signal(signalled);
+        ts.wait(waiting);
+        CPY_ASSERT_FMT(steps == 2, "%d", steps.load());
+        ts.cleanTaskTree(waiting);
+
+        //A worker waiting inside a task with nothing else to run parks, it does not burn the cpu until the signal.
+        Task late = ts.createTask(TaskDesc("late", (int)TaskFlags::External, nullptr));
+        std::atomic<bool> waitStarted = false;
+        Task blocked = ts.createTask(TaskDesc("blocked", [&waitStarted, late](TaskContext& ctx)
+        {
+            waitStarted = true;
+            ctx.ts->wait(late);
+        }));
+        ts.execute(blocked);
+        while (!waitStarted)
+            std::this_thread::yield();
+        std::clock_t cpuStart = std::clock();
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        double cpuMs = 1000.0 * (double)(std::clock() - cpuStart) / CLOCKS_PER_SEC;
+        ts.signal(late);
+        ts.wait(blocked);
+        CPY_ASSERT_FMT(cpuMs < 50.0, "%f", cpuMs);
+        ts.cleanTaskTree(blocked);
+        ts.cleanTaskTree(late);
+
+        ASSERT_NO_TASKS(ts);
+        ts.signalStop();
+        ts.join();
+        delete &ts;
+    }
+}
+
+void testGraphTemplates(TestContext& ctx)
+{
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        TaskSystemDesc desc;
+        desc.threadPoolSize = 4;
+        desc.schedulerMode = mode;
+        ITaskSystem& ts = *ITaskSystem::create(desc);
+        ts.start();
+
+        //read -> (decode, hash) -> upload, nodes added out of order on purpose.
+        struct Payload
+        {
+            std::atomic<int> step = 0;
+            int readStep = -1;
+            int decodeStep = -1;
+            int hashStep = -1;
+            int uploadStep = -1;
+        };
+
+        TaskGraphDesc graphDesc;
+        graphDesc.name = "loadTexture";
+        int upload = graphDesc.addNode(TaskDesc("upload", [](TaskContext& ctx) { auto& p = *(Payload*)ctx.data; p.uploadStep = p.step++; }));
+        int decode = graphDesc.addNode(TaskDesc("decode", [](TaskContext& ctx) { auto& p = *(Payload*)ctx.data; p.decodeStep = p.step++; }));
+        int hash = graphDesc.addNode(TaskDesc("hash", [](TaskContext& ctx) { auto& p = *(Payload*)ctx.data; p.hashStep = p.step++; }));
+        int read = graphDesc.addNode(TaskDesc("read", [](TaskContext& ctx) { auto& p = *(Payload*)ctx.data; p.readStep = p.step++; }));
+        graphDesc.depends(decode, read);
+        graphDesc.depends(hash, read);
+        graphDesc.depends(upload, decode);
+        graphDesc.depends(upload, hash);
+
+        TaskGraph graph = ts.createGraph(graphDesc);
+        CPY_ASSERT(graph.valid());
+
+        //Many instances in flight at once, each with its own payload.
+        const int instanceCount = 64;
+        std::vector<Payload> payloads(instanceCount);
+        std::vector<Task> instances(instanceCount);
+        for (int i = 0; i < instanceCount; ++i)
+            instances[i] = ts.executeGraph(graph, &payloads[i]);
+
+        for (int i = 0; i < instanceCount; ++i)
+        {
+            ts.wait(instances[i]);
+            ts.cleanTaskTree(instances[i]);
+            const Payload& p = payloads[i];
+            CPY_ASSERT_FMT(p.step == 4, "%d", p.step.load());
+            CPY_ASSERT_FMT(p.readStep == 0, "%d", p.readStep);
+            CPY_ASSERT(p.decodeStep > p.readStep && p.hashStep > p.readStep);
+            CPY_ASSERT_FMT(p.uploadStep == 3, "%d", p.uploadStep);
+        }
+        ASSERT_NO_TASKS(ts);
+
+        //Per node payloads, in addNode order. A delayed instance only starts when executed.
+        int nodeValues[4] = {};
+        void* nodeData[4] = { &nodeValues[0], &nodeValues[1], &nodeValues[2], &nodeValues[3] };
+        TaskGraphDesc counterDesc;
+        for (int i = 0; i < 4; ++i)
+            counterDesc.addNode(TaskDesc([](TaskContext& ctx) { ++*(int*)ctx.data; }));
+        counterDesc.depends(1, 0);
+        TaskGraph counterGraph = ts.createGraph(counterDesc);
+        Task delayed = ts.instantiateGraph(counterGraph, nullptr, nodeData);
+        Task before = ts.createTask(TaskDesc([&nodeValues](TaskContext& ctx) { nodeValues[0] = 10; }));
+        ts.depends(delayed, before);
+        ts.execute(delayed);
+        ts.wait(delayed);
+        ts.cleanTaskTree(delayed);
+        CPY_ASSERT_FMT(nodeValues[0] == 11 && nodeValues[1] == 1 && nodeValues[2] == 1 && nodeValues[3] == 1,
+            "%d %d %d %d", nodeValues[0], nodeValues[1], nodeValues[2], nodeValues[3]);
+        ASSERT_NO_TASKS(ts);
+
+        ts.destroyGraph(counterGraph);
+        ts.destroyGraph(graph);
+        ts.signalStop();
+        ts.join();
+        delete &ts;
+    }
+}
+
+void testPriorities(TestContext& ctx)
+{
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        TaskSystemDesc desc;
+        desc.threadPoolSize = 1;
+        desc.ioThreadPoolSize = 1;
+        desc.schedulerMode = mode;
+        ITaskSystem& ts = *ITaskSystem::create(desc);
+        ts.start();
+
+        //keep the only compute worker busy while the rest of the work gets queued.
+        std::atomic<bool> releaseGate = false;
+        Task gate = ts.createTask(TaskDesc([&releaseGate](TaskContext& ctx)
+        {
+            while (!releaseGate)
+                std::this_thread::yield();
+        }));
+        ts.execute(gate);
+
+        //io bound tasks have their own lane, they run while all compute workers are busy.
+        bool ioTaskDone = false;
+        Task ioTask = ts.createTask(TaskDesc("IoTask", (int)TaskFlags::IoBound, [&ioTaskDone](TaskContext& ctx) { ioTaskDone = true; }));
+        ts.execute(ioTask);
+        ts.wait(ioTask);
+        CPY_ASSERT(ioTaskDone);
+
+        std::vector<TaskPriority> executionOrder;
+        TaskPriority priorities[] = { TaskPriority::Background, TaskPriority::Normal, TaskPriority::Critical };
+        std::vector<Task> tasks;
+        for (int i = 0; i < 10; ++i)
+        {
+            for (auto priority : priorities)
+            {
+                tasks.push_back(ts.createTask(TaskDesc("PriorityTask", [&executionOrder, priority](TaskContext& ctx)
+                {
+                    executionOrder.push_back(priority);
+                }, priority)));
+            }
+        }
+
+        Task root = ts.createTask();
+        ts.depends(root, tasks.data(), (int)tasks.size());
+        ts.execute(root);
+        releaseGate = true;
+        ts.wait(root);
+
+        CPY_ASSERT(executionOrder.size() == tasks.size());
+        CPY_ASSERT_MSG(std::is_sorted(executionOrder.begin(), executionOrder.end()), "Tasks did not run in priority order.");
+
+        ts.cleanTaskTree(root);
+        ts.cleanTaskTree(gate);
+        ts.cleanTaskTree(ioTask);
+        ASSERT_NO_TASKS(ts);
+        ts.signalStop();
+        ts.join();
+        delete &ts;
+    }
+}
+
+void spinMicroseconds(int us)
+{
+    auto endTime = std::chrono::steady_clock::now() + std::chrono::microseconds(us);
+    while (std::chrono::steady_clock::now() < endTime);
+}
+
+void testTracing(TestContext& ctx)
+{
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        TaskSystemDesc desc;
+        desc.threadPoolSize = 2;
+        desc.schedulerMode = mode;
+        desc.enableTracing = true;
+        ITaskSystem& ts = *ITaskSystem::create(desc);
+        ts.start();
+        Profiler::setEnabled(true);
+        Profiler::clear();
+
+        std::vector<Task> tasks;
+        for (int i = 0; i < 64; ++i)
+            tasks.push_back(ts.createTask(TaskDesc("TracedLeaf", [](TaskContext& ctx) { spinMicroseconds(20); })));
+        tasks.push_back(ts.createTask(TaskDesc("TracedYield", [](TaskContext& ctx)
+        {
+            TaskUtil::yieldUntil([](){ TaskUtil::sleepThread(10); });
+        })));
+
+        Task root = ts.createTask(TaskDesc("TracedRoot", [](TaskContext& ctx) {}));
+        ts.depends(root, tasks.data(), (int)tasks.size());
+        ts.execute(root);
+        ts.wait(root);
+        ts.cleanTaskTree(root);
+
+        //Task runs are profiler zones too, named after the tasks.
+        Profiler::setEnabled(false);
+        ProfileCapture capture;
+        Profiler::capture(capture);
+        Profiler::clear();
+        int leafZones = 0;
+        int rootZones = 0;
+        for (auto& thread : capture.threads)
+        {
+            for (auto& zone : thread.zones)
+            {
+                leafZones += capture.names[zone.name] == "TracedLeaf" ? 1 : 0;
+                rootZones += capture.names[zone.name] == "TracedRoot" ? 1 : 0;
+            }
+        }
+        CPY_ASSERT_FMT(leafZones == 64 && rootZones == 1, "%d leaf and %d root zones", leafZones, rootZones);
+
+        std::string json;
+        CPY_ASSERT(ts.writeTrace(json));
+        ts.signalStop();
+        ts.join();
+        ASSERT_NO_TASKS(ts);
+
+        //idle time gets accounted when a parked worker wakes up, so read it once they all exited.
+        ITaskSystem::Stats stats;
+        ts.getStats(stats);
+        CPY_ASSERT_FMT(stats.blockedTimeMs >= 10.0, "%f", stats.blockedTimeMs);
+        CPY_ASSERT(stats.idleTimeMs > 0.0);
+        CPY_ASSERT_FMT(stats.queuedTasks == 0, "%d", stats.queuedTasks);
+        delete &ts;
+
+        cJSON* trace = cJSON_Parse(json.c_str());
+        CPY_ASSERT(trace != nullptr);
+        cJSON* events = cJSON_GetObjectItem(trace, "traceEvents");
+        CPY_ASSERT(cJSON_IsArray(events));
+
+        int leafRuns = 0;
+        int scheduled = 0;
+        bool hasYield = false;
+        bool hasBlocked = false;
+        cJSON* e = nullptr;
+        cJSON_ArrayForEach(e, events)
+        {
+            std::string name = cJSON_GetStringValue(cJSON_GetObjectItem(e, "name"));
+            std::string cat = cJSON_IsString(cJSON_GetObjectItem(e, "cat")) ? cJSON_GetStringValue(cJSON_GetObjectItem(e, "cat")) : "";
+            leafRuns += name == "TracedLeaf" && cat == "run" ? 1 : 0;
+            cJSON* taskName = cJSON_GetObjectItem(cJSON_GetObjectItem(e, "args"), "taskName");
+            //yieldUntil from a compute worker schedules its own helper task, only count the test's tasks.
+            scheduled += cat == "scheduled" && cJSON_IsString(taskName) && std::string(cJSON_GetStringValue(taskName)).rfind("Traced", 0) == 0 ? 1 : 0;
+            hasYield = hasYield || name == "TracedYield";
+            hasBlocked = hasBlocked || (cat == "blocked" && cJSON_GetObjectItem(e, "dur")->valuedouble >= 10000.0);
+        }
+        cJSON_Delete(trace);
+
+        CPY_ASSERT_FMT(leafRuns == 64, "%d", leafRuns);
+        CPY_ASSERT_FMT(scheduled == 66, "%d", scheduled);
+        CPY_ASSERT(hasYield);
+        CPY_ASSERT(hasBlocked);
+    }
+
+    //A thread recording into several tracers in turn keeps a single buffer in each of them.
+    {
+        TaskSystemDesc tracedDesc;
+        tracedDesc.threadPoolSize = 1;
+        tracedDesc.enableTracing = true;
+        ITaskSystem* systems[] = { ITaskSystem::create(tracedDesc), ITaskSystem::create(tracedDesc) };
+        for (auto* s : systems)
+            s->start();
+
+        for (int i = 0; i < 8; ++i)
+        {
+            for (auto* s : systems)
+            {
+                Task t = s->createTask(TaskDesc("Alternating", [](TaskContext& ctx) {}));
+                s->execute(t);
+                s->wait(t);
+                s->cleanTaskTree(t);
+            }
+        }
+
+        std::string json;
+        CPY_ASSERT(systems[0]->writeTrace(json));
+        for (auto* s : systems)
+        {
+            s->signalStop();
+            s->join();
+            delete s;
+        }
+
+        cJSON* trace = cJSON_Parse(json.c_str());
+        CPY_ASSERT(trace != nullptr);
+        int threadRows = 0;
+        cJSON* e = nullptr;
+        cJSON_ArrayForEach(e, cJSON_GetObjectItem(trace, "traceEvents"))
+        {
+            cJSON* threadName = cJSON_GetObjectItem(cJSON_GetObjectItem(e, "args"), "name");
+            if (std::string(cJSON_GetStringValue(cJSON_GetObjectItem(e, "ph"))) == "M" && cJSON_IsString(threadName))
+                threadRows += std::string(cJSON_GetStringValue(threadName)).rfind("thread ", 0) == 0 ? 1 : 0;
+        }
+        cJSON_Delete(trace);
+        CPY_ASSERT_FMT(threadRows == 1, "%d", threadRows);
+    }
+
+    //tracing is opt in
+    TaskSystemDesc desc;
+    ITaskSystem* ts = ITaskSystem::create(desc);
+    std::string json;
+    CPY_ASSERT(!ts->writeTrace(json));
+    delete ts;
+}
+
+//Latency of short probe tasks submitted while the pool is saturated with background work.
+void runPriorityLatencyBenchmark(bool usePriorities)
+{
+    TaskSystemDesc desc;
+    desc.threadPoolSize = 4;
+    ITaskSystem& ts = *ITaskSystem::create(desc);
+    ts.start();
+
+    const int backgroundCount = 2000;
+    const int probeCount = 100;
+    TaskDesc backgroundDesc("Background", [](TaskContext& ctx) { spinMicroseconds(50); }, usePriorities ? TaskPriority::Background : TaskPriority::Normal);
+
+    std::vector<Task> backgroundTasks(backgroundCount);
+    for (auto& t : backgroundTasks)
+        t = ts.createTask(backgroundDesc);
+    Task backgroundRoot = ts.createTask();
+    ts.depends(backgroundRoot, backgroundTasks.data(), backgroundCount);
+
+    using Clock = std::chrono::steady_clock;
+    struct ProbeSample
+    {
+        Clock::time_point submitTime;
+        double latencyUs;
+    };
+
+    std::vector<ProbeSample> samples(probeCount);
+    TaskDesc probeDesc("Probe", [](TaskContext& ctx)
+    {
+        auto& sample = *(ProbeSample*)ctx.data;
+        sample.latencyUs = (double)std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - sample.submitTime).count() / 1000.0;
+    }, usePriorities ? TaskPriority::Critical : TaskPriority::Normal);
+
+    ts.execute(backgroundRoot);
+    std::vector<Task> probes(probeCount);
+    for (int i = 0; i < probeCount; ++i)
+    {
+        probes[i] = ts.createTask(probeDesc, &samples[i]);
+        samples[i].submitTime = Clock::now();
+        ts.execute(probes[i]);
+        spinMicroseconds(200);
+    }
+
+    Task probeRoot = ts.createTask();
+    ts.depends(probeRoot, probes.data(), probeCount);
+    ts.execute(probeRoot);
+    ts.wait(probeRoot);
+    ts.wait(backgroundRoot);
+    ts.cleanTaskTree(probeRoot);
+    ts.cleanTaskTree(backgroundRoot);
+    ASSERT_NO_TASKS(ts);
+    ts.signalStop();
+    ts.join();
+    delete &ts;
+
+    std::vector<double> latencies;
+    for (auto& s : samples)
+        latencies.push_back(s.latencyUs);
+    std::sort(latencies.begin(), latencies.end());
+    printf("    %-16s probe latency p50: %10.1fus  p99: %10.1fus\n",
+        usePriorities ? "critical probes" : "no priorities",
+        latencies[probeCount / 2], latencies[(probeCount * 99) / 100]);
+}
+
+void benchmarkPriorityLatency(TestContext& ctx)
+{
+    runPriorityLatencyBenchmark(false);
+    runPriorityLatencyBenchmark(true);
+}
+
+struct QueueTestMessage
+{
+    int producer = -1;
+    int sequence = -1;
+    std::vector<int> payload;
+};
+
+template<typename QueueType>
+void runQueueOrderTest(QueueType& queue)
+{
+    const int producerCount = 4;
+    const int consumerCount = 3;
+    const int messagesPerProducer = 5000;
+
+    QueueTestMessage msg;
+    CPY_ASSERT(!queue.tryPop(msg));
+    CPY_ASSERT(!queue.waitPopUntil(msg, 1));
+
+    std::vector<std::thread> producers;
+    for (int p = 0; p < producerCount; ++p)
+    {
+        producers.emplace_back([&queue, p, messagesPerProducer]()
+        {
+            for (int i = 0; i < messagesPerProducer; ++i)
+            {
+                QueueTestMessage m;
+                m.producer = p;
+                m.sequence = i;
+                m.payload.assign(4, i);
+                queue.push(std::move(m));
+            }
+        });
+    }
+
+    std::atomic<int> received = 0;
+    std::atomic<bool> inOrder = true;
+    std::vector<std::thread> consumers;
+    for (int c = 0; c < consumerCount; ++c)
+    {
+        consumers.emplace_back([&]()
+        {
+            std::vector<int> lastSequence(producerCount, -1);
+            while (true)
+            {
+                QueueTestMessage m;
+                queue.waitPop(m);
+                if (m.producer < 0)
+                    break;
+
+                //messages of one producer must never be reordered.
+                if (m.sequence <= lastSequence[m.producer] || m.payload.size() != 4 || m.payload[0] != m.sequence)
+                    inOrder = false;
+                lastSequence[m.producer] = m.sequence;
+                received.fetch_add(1);
+            }
+        });
+    }
+
+    for (auto& t : producers)
+        t.join();
+
+    for (int c = 0; c < consumerCount; ++c)
+        queue.push(QueueTestMessage());
+
+    for (auto& t : consumers)
+        t.join();
+
+    CPY_ASSERT(inOrder);
+    CPY_ASSERT_FMT(received == producerCount * messagesPerProducer, "received %d", received.load());
+    CPY_ASSERT(queue.size() == 0);
+}
+
+void testThreadQueue(TestContext& ctx)
+{
+    {
+        ThreadQueue<QueueTestMessage> queue;
+        runQueueOrderTest(queue);
+    }
+
+    {
+        //small capacity so the ring spills into the overflow list.
+        LockFreeQueue<QueueTestMessage> queue(16);
+        runQueueOrderTest(queue);
+    }
+}
+
+template<typename QueueType>
+double runQueueContentionBenchmark(int threadsPerSide, int messagesPerProducer)
+{
+    QueueType queue;
+    std::vector<std::thread> threads;
+    Stopwatch sw;
+    sw.start();
+    for (int c = 0; c < threadsPerSide; ++c)
+    {
+        threads.emplace_back([&queue]()
+        {
+            while (true)
+            {
+                TaskFn fn;
+                queue.waitPop(fn);
+                if (!fn)
+                    break;
+            }
+        });
+    }
+
+    for (int p = 0; p < threadsPerSide; ++p)
+    {
+        threads.emplace_back([&queue, messagesPerProducer]()
+        {
+            for (int i = 0; i < messagesPerProducer; ++i)
+                queue.push(TaskFn([i](TaskContext&) {}));
+        });
+    }
+
+    for (int p = 0; p < threadsPerSide; ++p)
+        threads[threadsPerSide + p].join();
+
+    for (int c = 0; c < threadsPerSide; ++c)
+        queue.push(TaskFn());
+
+    for (int c = 0; c < threadsPerSide; ++c)
+        threads[c].join();
+
+    return (double)sw.timeMicroSecondsLong() / 1000000.0;
+}
+
+void benchmarkThreadQueue(TestContext& ctx)
+{
+    const int messagesPerProducer = 100000;
+    const int maxThreads = std::max(4, (int)std::thread::hardware_concurrency() / 2);
+    for (int threads = 1; threads <= maxThreads; threads *= 2)
+    {
+        double mutexSeconds = runQueueContentionBenchmark<ThreadQueue<TaskFn>>(threads, messagesPerProducer);
+        double lockFreeSeconds = runQueueContentionBenchmark<LockFreeQueue<TaskFn>>(threads, messagesPerProducer);
+        double messageCount = (double)(threads * messagesPerProducer);
+        printf("    producers/consumers: %-3d mutex: %10.0f msgs/s  lock free: %10.0f msgs/s\n",
+            threads, messageCount / std::max(mutexSeconds, 1e-9), messageCount / std::max(lockFreeSeconds, 1e-9));
+    }
+}
+
+const char* schedulerModeName(TaskSchedulerMode mode)
+{
+    return mode == TaskSchedulerMode::WorkStealing ? "WorkStealing" : "SchedulerThread";
+}
+
+double runFanOutBenchmark(ITaskSystem& ts, int taskCount)
+{
+    std::atomic<int> counter = 0;
+    TaskDesc leafDesc("FanOutLeaf", [&counter](TaskContext& ctx) { counter.fetch_add(1); });
+
+    std::vector<Task> tasks(taskCount);
+    for (auto& t : tasks)
+        t = ts.createTask(leafDesc);
+
+    Task root = ts.createTask();
+    ts.depends(root, tasks.data(), taskCount);
+
+    Stopwatch sw;
+    sw.start();
+    ts.execute(root);
+    ts.wait(root);
+    double seconds = (double)sw.timeMicroSecondsLong() / 1000000.0;
+
+    ts.cleanTaskTree(root);
+    CPY_ASSERT_FMT(counter == taskCount, "%d tasks ran, expected %d", counter.load(), taskCount);
+    return seconds;
+}
+
+double runChainBenchmark(ITaskSystem& ts, int taskCount)
+{
+    int lastValue = -1;
+    bool inOrder = true;
+    TaskDesc linkDesc("ChainLink", [&lastValue, &inOrder](TaskContext& ctx)
+    {
+        int index = (int)(size_t)ctx.data;
+        inOrder = inOrder && (lastValue + 1) == index;
+        lastValue = index;
+    });
+
+    std::vector<Task> tasks(taskCount);
+    for (int i = 0; i < taskCount; ++i)
+    {
+        tasks[i] = ts.createTask(linkDesc, (void*)(size_t)i);
+        if (i > 0)
+            ts.depends(tasks[i], tasks[i - 1]);
+    }
+
+    Stopwatch sw;
+    sw.start();
+    ts.execute(tasks.back());
+    ts.wait(tasks.back());
+    double seconds = (double)sw.timeMicroSecondsLong() / 1000000.0;
+
+    ts.cleanTaskTree(tasks.back());
+    CPY_ASSERT(inOrder);
+    CPY_ASSERT_FMT(lastValue == taskCount - 1, "%d", lastValue);
+    return seconds;
+}
+
+void benchmarkScheduling(TestContext& ctx)
+{
+    const int taskCount = 4000;
+    const int maxThreads = std::max(8, (int)std::thread::hardware_concurrency());
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        for (int threads = 1; threads <= maxThreads; threads *= 2)
+        {
+            TaskSystemDesc desc;
+            desc.threadPoolSize = threads;
+            desc.schedulerMode = mode;
+            ITaskSystem* ts = ITaskSystem::create(desc);
+            ts->start();
+
+            double fanOutSeconds = runFanOutBenchmark(*ts, taskCount);
+            double chainSeconds = runChainBenchmark(*ts, taskCount);
+
+            ts->signalStop();
+            ts->join();
+            ts->cleanFinishedTasks();
+            ASSERT_NO_TASKS((*ts));
+            delete ts;
+
+            printf("    %-15s threads: %-3d fan-out: %10.0f tasks/s  chain: %10.0f tasks/s\n",
+                schedulerModeName(mode), threads,
+                (double)taskCount / std::max(fanOutSeconds, 1e-9),
+                (double)taskCount / std::max(chainSeconds, 1e-9));
+        }
+    }
+}
+
+double runCreateFanOutBenchmark(ITaskSystem& ts, int taskCount, bool useBatch)
+{
+    std::atomic<int> counter = 0;
+    TaskDesc leafDesc("FanOutLeaf", [&counter](TaskContext& ctx) { counter.fetch_add(1); });
+    TaskDesc rootDesc("FanOutRoot", [](TaskContext& ctx) {});
+
+    Stopwatch sw;
+    sw.start();
+    Task root;
+    if (useBatch)
+    {
+        TaskBatch batch;
+        int rootIndex = batch.add(rootDesc);
+        for (int i = 0; i < taskCount; ++i)
+            batch.depends(rootIndex, batch.add(leafDesc));
+        ts.submit(batch);
+        root = batch.tasks[rootIndex];
+    }
+    else
+    {
+        root = ts.createTask(rootDesc);
+        for (int i = 0; i < taskCount; ++i)
+            ts.depends(root, ts.createTask(leafDesc));
+        ts.execute(root);
+    }
+    ts.wait(root);
+    double seconds = (double)sw.timeMicroSecondsLong() / 1000000.0;
+
+    ts.cleanTaskTree(root);
+    CPY_ASSERT_FMT(counter == taskCount, "%d tasks ran, expected %d", counter.load(), taskCount);
+    return seconds;
+}
+
+void benchmarkTaskBatch(TestContext& ctx)
+{
+    const int taskCount = 20000;
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        TaskSystemDesc desc;
+        desc.threadPoolSize = 4;
+        desc.schedulerMode = mode;
+        ITaskSystem* ts = ITaskSystem::create(desc);
+        ts->start();
+
+        double createSeconds = runCreateFanOutBenchmark(*ts, taskCount, false);
+        double batchSeconds = runCreateFanOutBenchmark(*ts, taskCount, true);
+        printf("    %-15s create + depends: %10.0f tasks/s  batch: %10.0f tasks/s\n",
+            schedulerModeName(mode),
+            (double)taskCount / std::max(createSeconds, 1e-9),
+            (double)taskCount / std::max(batchSeconds, 1e-9));
+
+        ts->signalStop();
+        ts->join();
+        ASSERT_NO_TASKS((*ts));
+        delete ts;
+    }
+}
+
+double runGraphRebuildBenchmark(ITaskSystem& ts, int iterations, int width)
+{
+    std::atomic<int> counter = 0;
+    TaskDesc nodeDesc("GraphNode", [&counter](TaskContext& ctx) { counter.fetch_add(1); });
+    std::vector<Task> stage(width);
+
+    Stopwatch sw;
+    sw.start();
+    for (int it = 0; it < iterations; ++it)
+    {
+        Task source = ts.createTask(nodeDesc);
+        Task sink = ts.createTask(nodeDesc);
+        for (auto& t : stage)
+        {
+            t = ts.createTask(nodeDesc);
+            ts.depends(t, source);
+        }
+        ts.depends(sink, stage.data(), width);
+        ts.execute(sink);
+        ts.wait(sink);
+        ts.cleanTaskTree(sink);
+    }
+    double seconds = (double)sw.timeMicroSecondsLong() / 1000000.0;
+    CPY_ASSERT_FMT(counter == iterations * (width + 2), "%d", counter.load());
+    return seconds;
+}
+
+double runGraphTemplateBenchmark(ITaskSystem& ts, int iterations, int width)
+{
+    std::atomic<int> counter = 0;
+    TaskDesc nodeDesc("GraphNode", [](TaskContext& ctx) { ((std::atomic<int>*)ctx.data)->fetch_add(1); });
+    TaskGraphDesc graphDesc;
+    int source = graphDesc.addNode(nodeDesc);
+    int sink = graphDesc.addNode(nodeDesc);
+    for (int i = 0; i < width; ++i)
+    {
+        int n = graphDesc.addNode(nodeDesc);
+        graphDesc.depends(n, source);
+        graphDesc.depends(sink, n);
+    }
+    TaskGraph graph = ts.createGraph(graphDesc);
+
+    Stopwatch sw;
+    sw.start();
+    for (int it = 0; it < iterations; ++it)
+    {
+        Task instance = ts.executeGraph(graph, &counter);
+        ts.wait(instance);
+        ts.cleanTaskTree(instance);
+    }
+    double seconds = (double)sw.timeMicroSecondsLong() / 1000000.0;
+    ts.destroyGraph(graph);
+    CPY_ASSERT_FMT(counter == iterations * (width + 2), "%d", counter.load());
+    return seconds;
+}
+
+void benchmarkGraphTemplates(TestContext& ctx)
+{
+    const int iterations = 2000;
+    const int widths[] = { 1, 8, 64 };
+    TaskSchedulerMode modes[] = { TaskSchedulerMode::WorkStealing, TaskSchedulerMode::SchedulerThread };
+    for (auto mode : modes)
+    {
+        TaskSystemDesc desc;
+        desc.threadPoolSize = 4;
+        desc.schedulerMode = mode;
+        ITaskSystem* ts = ITaskSystem::create(desc);
+        ts->start();
+        for (int width : widths)
+        {
+            double rebuildSeconds = runGraphRebuildBenchmark(*ts, iterations, width);
+            double templateSeconds = runGraphTemplateBenchmark(*ts, iterations, width);
+            printf("    %-15s width: %-3d rebuild: %10.0f graphs/s  template: %10.0f graphs/s\n",
+                schedulerModeName(mode), width,
+                (double)iterations / std::max(rebuildSeconds, 1e-9),
+                (double)iterations / std::max(templateSeconds, 1e-9));
+        }
+        ts->signalStop();
+        ts->join();
+        ASSERT_NO_TASKS((*ts));
+        delete ts;
+    }
+}
+
 }
 
 class TaskSystemTestSuite : public TestSuite
@@ -179,7 +1434,23 @@ public:
             { "simpleParallel", testParallel0 },
             { "simpleParallelRestart", testParallel0 },
             { "dependencies", testTaskDeps },
-            { "yield", testTaskYield }
+            { "yield", testTaskYield },
+            { "largeGraph", testLargeGraph },
+            { "parallelFor", testParallelFor },
+            { "priorities", testPriorities },
+            { "continuations", testContinuations },
+            { "graphTemplates", testGraphTemplates },
+            { "workerPlacement", testWorkerPlacement },
+            { "taskBatch", testTaskBatch },
+            { "cancellation", testCancellation },
+            { "externalSignal", testExternalSignal },
+            { "threadQueue", testThreadQueue },
+            { "tracing", testTracing },
+            { "benchmarkScheduling", benchmarkScheduling },
+            { "benchmarkPriorityLatency", benchmarkPriorityLatency },
+            { "benchmarkThreadQueue", benchmarkThreadQueue },
+            { "benchmarkGraphTemplates", benchmarkGraphTemplates },
+            { "benchmarkTaskBatch", benchmarkTaskBatch }
         };
 
         caseCounts = (int)(sizeof(sCases) / sizeof(TestCase));
@@ -0,0 +1,73 @@
+#include <iostream>
+#include <coalpy.core/ClParser.h>
+#include <coalpy.core/Stopwatch.h>
+#include <coalpy.files/PakDefs.h>
+#include <string>
+#include <vector>
+
+//hack bring definition of assert into this unit for release builds
+#ifndef _DEBUG
+#include "../../modules/core/Assert.cpp"
+#endif
+
+using namespace coalpy;
+
+struct ArgParameters
+{
+    bool help = false;
+    bool store = false;
+    int level = 6;
+    const char* input = "";
+    const char* output = "";
+};
+
+bool prepareCli(ClParser& p, ArgParameters& params)
+{
+    ClParser::GroupId gid= p.createGroup("General", "General Params:");
+    p.bind(gid, &params);
+    CliSwitch(gid, "help", "h", "help", Bool, ArgParameters, help);
+    CliSwitch(gid, "Directory to pack, entries are named relative to it", "i", "input", String, ArgParameters, input);
+    CliSwitch(gid, "Archive file to write", "o", "output", String, ArgParameters, output);
+    CliSwitch(gid, "Store entries without compressing them", "s", "store", Bool, ArgParameters, store);
+    CliSwitch(gid, "zlib compression level (1 to 9)", "l", "level", Int, ArgParameters, level);
+    return true;
+}
+
+int main(int argc, char* argv[])
+{
+    ArgParameters params;
+    ClParser p;
+    if (!prepareCli(p, params))
+    {
+        std::cerr << "Error setting up cli parser\n";
+        return -1;
+    }
+
+    if (!p.parse(argc, argv))
+        return -1;
+
+    if (params.help || params.input[0] == '\0' || params.output[0] == '\0')
+    {
+        p.prettyPrintHelp();
+        return params.help ? 0 : -1;
+    }
+
+    Stopwatch sw;
+    sw.start();
+
+    PakBuildDesc desc;
+    desc.archivePath = params.output;
+    desc.compress = !params.store;
+    desc.compressionLevel = params.level;
+    PakUtils::collectDirectory(params.input, desc.entries);
+
+    std::string error;
+    if (!PakUtils::buildArchive(desc, error))
+    {
+        std::cerr << error << std::endl;
+        return -1;
+    }
+
+    printf("%s: %d files packed (%.3fms)\n", params.output, (int)desc.entries.size(), (float)sw.timeMicroSeconds() / 1000.0f);
+    return 0;
+}